@@ -1301,4 +1301,39 @@ FreeImage_GetMetadataCount(FREE_IMAGE_MDMODEL model, FIBITMAP *dib) {
 
 // ----------------------------------------------------------
 
+void 
+StoreSizeInfo(FIBITMAP *dib, const char *format, int width, int height) {
+	char key[64];
+	char buffer[32];
+	// create a tag
+	FITAG *tag = FreeImage_CreateTag();
+	if(tag) {
+		size_t length = 0;
+		// set the original width
+		sprintf(buffer, "%d", width);
+		length = strlen(buffer) + 1;	// include the NULL/0 value
+		sprintf(key, "Original%sWidth", format);
+		FreeImage_SetTagKey(tag, key);
+		FreeImage_SetTagLength(tag, (DWORD)length);
+		FreeImage_SetTagCount(tag, (DWORD)length);
+		FreeImage_SetTagType(tag, FIDT_ASCII);
+		FreeImage_SetTagValue(tag, buffer);
+		FreeImage_SetMetadata(FIMD_COMMENTS, dib, FreeImage_GetTagKey(tag), tag);
+		// set the original height
+		sprintf(buffer, "%d", height);
+		length = strlen(buffer) + 1;	// include the NULL/0 value
+		sprintf(key, "Original%sHeight", format);
+		FreeImage_SetTagKey(tag, key);
+		FreeImage_SetTagLength(tag, (DWORD)length);
+		FreeImage_SetTagCount(tag, (DWORD)length);
+		FreeImage_SetTagType(tag, FIDT_ASCII);
+		FreeImage_SetTagValue(tag, buffer);
+		FreeImage_SetMetadata(FIMD_COMMENTS, dib, FreeImage_GetTagKey(tag), tag);
+		// destroy the tag
+		FreeImage_DeleteTag(tag);
+	}
+}
+
+// ----------------------------------------------------------
+
 
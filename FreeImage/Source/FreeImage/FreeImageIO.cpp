@@ -166,3 +166,93 @@ SetMemoryIO(FreeImageIO *io) {
 	io->tell_proc  = _MemoryTellProc;
 	io->write_proc = _MemoryWriteProc;
 }
+
+// =====================================================================
+// Buffered reader
+// =====================================================================
+
+#define BUFFERED_READER_SIZE (64 * 1024)
+
+BufferedReader::BufferedReader(FreeImageIO *io, fi_handle handle) 
+: m_io(io), m_handle(handle), m_pos(0), m_end(0) {
+	m_start = io->tell_proc(handle);
+	m_buffer = (BYTE*)malloc(BUFFERED_READER_SIZE);
+	m_size = BUFFERED_READER_SIZE;
+	if(!m_buffer) {
+		m_buffer = m_fallback;
+		m_size = sizeof(m_fallback);
+	}
+}
+
+BufferedReader::~BufferedReader() {
+	if(m_buffer != m_fallback) {
+		free(m_buffer);
+	}
+}
+
+BOOL 
+BufferedReader::refill() {
+	// the handle is always positioned at the end of the buffered data
+	m_start += (long)m_end;
+	m_pos = 0;
+	m_end = m_io->read_proc(m_buffer, 1, m_size, m_handle);
+	return (m_end > 0) ? TRUE : FALSE;
+}
+
+unsigned 
+BufferedReader::read(void *buffer, unsigned count) {
+	BYTE *dst = (BYTE*)buffer;
+	unsigned done = 0;
+
+	while(done < count) {
+		if(m_pos == m_end) {
+			if(count - done >= m_size) {
+				// large remainder, bypass the buffer
+				m_start += (long)m_end;
+				m_pos = m_end = 0;
+				const unsigned got = m_io->read_proc(dst + done, 1, count - done, m_handle);
+				m_start += (long)got;
+				return done + got;
+			}
+			if(!refill()) {
+				break;
+			}
+		}
+		const unsigned n = MIN(m_end - m_pos, count - done);
+		memcpy(dst + done, m_buffer + m_pos, n);
+		m_pos += n;
+		done += n;
+	}
+	return done;
+}
+
+unsigned 
+BufferedReader::skip(unsigned count) {
+	unsigned done = 0;
+
+	while(done < count) {
+		if((m_pos == m_end) && !refill()) {
+			break;
+		}
+		const unsigned n = MIN(m_end - m_pos, count - done);
+		m_pos += n;
+		done += n;
+	}
+	return done;
+}
+
+void 
+BufferedReader::seek(long position) {
+	if((position >= m_start) && (position <= m_start + (long)m_end)) {
+		m_pos = (unsigned)(position - m_start);
+	} else {
+		m_io->seek_proc(m_handle, position, SEEK_SET);
+		m_start = position;
+		m_pos = m_end = 0;
+	}
+}
+
+void 
+BufferedReader::sync() {
+	m_io->seek_proc(m_handle, tell(), SEEK_SET);
+}
@@ -47,6 +47,9 @@
 #define PSDP_COMPRESSION_NONE	0	// Raw data
 #define PSDP_COMPRESSION_RLE	1	// RLE compression (same as TIFF packed bits)
 
+// Compressed bytes of plane data read and decoded at once
+#define PSDP_RLE_BAND_SIZE	(4 * 1024 * 1024)
+
 #define SAFE_DELETE_ARRAY(_p_) { if (NULL != (_p_)) { delete [] (_p_); (_p_) = NULL; } }
 
 // --------------------------------------------------------------------------
@@ -445,6 +448,134 @@ BOOL invertColor(FIBITMAP* dib) {
 	}
 }
 
+/**
+Uncompress a PackBits RLE line.
+Corrupt data never reads or writes out of bounds, a short line is padded with zeros.
+*/
+static void
+psdUnpackBits(const BYTE *src, unsigned srcSize, BYTE *dst, unsigned dstSize) {
+	const BYTE* const src_end = src + srcSize;
+	BYTE* const dst_end = dst + dstSize;
+
+	while(src < src_end && dst < dst_end) {
+		// NOTE len is signed byte in PackBits RLE
+		unsigned len = *src++;
+
+		if(len < 128) {
+			// uncompressed packet, (len + 1) bytes of data are copied
+			++len;
+			const unsigned n = MIN(len, MIN<unsigned>((unsigned)(src_end - src), (unsigned)(dst_end - dst)));
+			memcpy(dst, src, n);
+			dst += n;
+			src += n;
+		}
+		else if(len > 128) {
+			// RLE compressed packet, one byte of data is repeated (-len + 1) times
+			if(src == src_end) {
+				break;
+			}
+			len = 257 - len;
+			const unsigned n = MIN(len, (unsigned)(dst_end - dst));
+			memset(dst, *src++, n);
+			dst += n;
+		}
+		// 128: do nothing
+	}
+
+	if(dst < dst_end) {
+		memset(dst, 0, dst_end - dst);
+	}
+}
+
+/**
+Interleave the big endian channel lines of one row into a scanline.
+Channels nPlanes and up of the destination pixels are left untouched.
+*/
+static void
+psdInterleave(BYTE* const *planes, unsigned nPlanes, unsigned bytes, unsigned lineSize, BYTE *dst, unsigned dstBpp) {
+	unsigned i = 0;
+
+	if(bytes == 1) {
+		if(nPlanes == 1 && dstBpp == 1) {
+			memcpy(dst, planes[0], lineSize);
+			return;
+		}
+		if(nPlanes == 4 && dstBpp == 4) {
+			const BYTE *p0 = planes[0], *p1 = planes[1], *p2 = planes[2], *p3 = planes[3];
+#ifdef FI_SSE2
+			for(; i + 16 <= lineSize; i += 16) {
+				const __m128i c0 = _mm_loadu_si128((const __m128i*)(p0 + i));
+				const __m128i c1 = _mm_loadu_si128((const __m128i*)(p1 + i));
+				const __m128i c2 = _mm_loadu_si128((const __m128i*)(p2 + i));
+				const __m128i c3 = _mm_loadu_si128((const __m128i*)(p3 + i));
+				const __m128i lo01 = _mm_unpacklo_epi8(c0, c1), hi01 = _mm_unpackhi_epi8(c0, c1);
+				const __m128i lo23 = _mm_unpacklo_epi8(c2, c3), hi23 = _mm_unpackhi_epi8(c2, c3);
+				__m128i *out = (__m128i*)(dst + 4 * i);
+				_mm_storeu_si128(out + 0, _mm_unpacklo_epi16(lo01, lo23));
+				_mm_storeu_si128(out + 1, _mm_unpackhi_epi16(lo01, lo23));
+				_mm_storeu_si128(out + 2, _mm_unpacklo_epi16(hi01, hi23));
+				_mm_storeu_si128(out + 3, _mm_unpackhi_epi16(hi01, hi23));
+			}
+#endif // FI_SSE2
+			for(BYTE *pixel = dst + 4 * i; i < lineSize; ++i, pixel += 4) {
+				pixel[0] = p0[i];
+				pixel[1] = p1[i];
+				pixel[2] = p2[i];
+				pixel[3] = p3[i];
+			}
+			return;
+		}
+		if(nPlanes == 3 && dstBpp == 3) {
+			const BYTE *p0 = planes[0], *p1 = planes[1], *p2 = planes[2];
+			for(BYTE *pixel = dst; i < lineSize; ++i, pixel += 3) {
+				pixel[0] = p0[i];
+				pixel[1] = p1[i];
+				pixel[2] = p2[i];
+			}
+			return;
+		}
+	}
+#ifdef FI_SSE2
+	else if(bytes == 2 && nPlanes == 4 && dstBpp == 8) {
+		// swap to little endian while interleaving 8 samples per channel at a time
+		const BYTE *p0 = planes[0], *p1 = planes[1], *p2 = planes[2], *p3 = planes[3];
+		for(; i + 16 <= lineSize; i += 16) {
+			__m128i c0 = _mm_loadu_si128((const __m128i*)(p0 + i));
+			__m128i c1 = _mm_loadu_si128((const __m128i*)(p1 + i));
+			__m128i c2 = _mm_loadu_si128((const __m128i*)(p2 + i));
+			__m128i c3 = _mm_loadu_si128((const __m128i*)(p3 + i));
+			c0 = _mm_or_si128(_mm_slli_epi16(c0, 8), _mm_srli_epi16(c0, 8));
+			c1 = _mm_or_si128(_mm_slli_epi16(c1, 8), _mm_srli_epi16(c1, 8));
+			c2 = _mm_or_si128(_mm_slli_epi16(c2, 8), _mm_srli_epi16(c2, 8));
+			c3 = _mm_or_si128(_mm_slli_epi16(c3, 8), _mm_srli_epi16(c3, 8));
+			const __m128i lo01 = _mm_unpacklo_epi16(c0, c1), hi01 = _mm_unpackhi_epi16(c0, c1);
+			const __m128i lo23 = _mm_unpacklo_epi16(c2, c3), hi23 = _mm_unpackhi_epi16(c2, c3);
+			__m128i *out = (__m128i*)(dst + 4 * i);
+			_mm_storeu_si128(out + 0, _mm_unpacklo_epi32(lo01, lo23));
+			_mm_storeu_si128(out + 1, _mm_unpackhi_epi32(lo01, lo23));
+			_mm_storeu_si128(out + 2, _mm_unpacklo_epi32(hi01, hi23));
+			_mm_storeu_si128(out + 3, _mm_unpackhi_epi32(hi01, hi23));
+		}
+	}
+#endif // FI_SSE2
+
+	// generic (and tail) byte by byte copy, channel by channel
+	for(unsigned c = 0; c < nPlanes; ++c) {
+		const BYTE *line = planes[c] + i;
+		BYTE *dst_line = dst + (i / bytes) * dstBpp + c * bytes;
+		for(; line < planes[c] + lineSize; line += bytes, dst_line += dstBpp) {
+#ifdef FREEIMAGE_BIGENDIAN
+			memcpy(dst_line, line, bytes);
+#else
+			// reverse copy bytes
+			for (unsigned b = 0; b < bytes; ++b) {
+				dst_line[b] = line[(bytes-1) - b];
+			}
+#endif // FREEIMAGE_BIGENDIAN
+		}
+	}
+}
+
 //---------------------------------------------------------------------------
 
 psdParser::psdParser() {
@@ -467,18 +598,11 @@ bool psdParser::ReadLayerAndMaskInfoSection(FreeImageIO *io, fi_handle handle)	{
 	bool bSuccess = false;
 	
 	BYTE DataLength[4];
-	int nBytes = 0;
 	int n = (int)io->read_proc(&DataLength, sizeof(DataLength), 1, handle);
-	int nTotalBytes = psdGetValue( DataLength, sizeof(DataLength) );
+	const unsigned nTotalBytes = (unsigned)psdGetValue( DataLength, sizeof(DataLength) );
 	
-	BYTE data[1];
-	while( n && ( nBytes < nTotalBytes ) ) {
-		data[0] = '\0';
-		n = (int)io->read_proc(&data, sizeof(data), 1, handle);
-		nBytes += n * sizeof(data);
-	}
-	
-	if ( nBytes == nTotalBytes ) {
+	// layers and masks are not loaded, seek straight to the merged image data
+	if ( n && ( 0 == io->seek_proc(handle, (long)nTotalBytes, SEEK_CUR) ) ) {
 		bSuccess = true;
 	}
 	
@@ -651,7 +775,10 @@ FIBITMAP* psdParser::ReadImageData(FreeImageIO *io, fi_handle handle) {
 	bool header_only = (_fi_flags & FIF_LOAD_NOPIXELS) == FIF_LOAD_NOPIXELS;
 	
 	WORD nCompression = 0;
-	io->read_proc(&nCompression, sizeof(nCompression), 1, handle);
+	if(io->read_proc(&nCompression, sizeof(nCompression), 1, handle) != 1) {
+		// e.g. a truncated layer and mask section
+		return NULL;
+	}
 	
 #ifndef FREEIMAGE_BIGENDIAN
 	SwapShort(&nCompression);
@@ -794,6 +921,7 @@ FIBITMAP* psdParser::ReadImageData(FreeImageIO *io, fi_handle handle) {
 		
 		case PSDP_COMPRESSION_RLE: // RLE compression	
 		{			
+			SAFE_DELETE_ARRAY(line_start);
 									
 			// The RLE-compressed data is preceeded by a 2-byte line size for each row in the data,
 			// store an array of these
@@ -803,13 +931,25 @@ FIBITMAP* psdParser::ReadImageData(FreeImageIO *io, fi_handle handle) {
 
 			if(!rleLineSizeList) {
 				FreeImage_Unload(bitmap);
-				SAFE_DELETE_ARRAY(line_start);
 				throw std::bad_alloc();
 			}	
 			
 			io->read_proc(rleLineSizeList, 2, nChannels * nHeight, handle);
-			
-			WORD largestRLELine = 0;
+
+			// extra channels are never read
+			// @todo write to extra channels
+			const unsigned nPlanes = MIN(nChannels, dstChannels);
+
+			// offset of each row, relative to the start of the compressed data
+			long *rleLineOffset = new (std::nothrow) long[nPlanes*nHeight];
+			if(!rleLineOffset) {
+				FreeImage_Unload(bitmap);
+				SAFE_DELETE_ARRAY(rleLineSizeList);
+				throw std::bad_alloc();
+			}
+
+			long offset = 0;
+			unsigned largestRLERow = 0;
 			for(unsigned ch = 0; ch < nChannels; ++ch) {
 				for(unsigned h = 0; h < nHeight; ++h) {
 					const unsigned index = ch * nHeight + h;
@@ -817,101 +957,120 @@ FIBITMAP* psdParser::ReadImageData(FreeImageIO *io, fi_handle handle) {
 #ifndef FREEIMAGE_BIGENDIAN 
 					SwapShort(&rleLineSizeList[index]);
 #endif
-					if(largestRLELine < rleLineSizeList[index]) {
-						largestRLELine = rleLineSizeList[index];
+					if(ch < nPlanes) {
+						rleLineOffset[index] = offset;
+						offset += rleLineSizeList[index];
 					}
 				}
 			}
+			for(unsigned h = 0; h < nHeight; ++h) {
+				unsigned rowSize = 0;
+				for(unsigned ch = 0; ch < nPlanes; ++ch) {
+					rowSize += rleLineSizeList[ch * nHeight + h];
+				}
+				largestRLERow = MAX(largestRLERow, rowSize);
+			}
 
-			BYTE* rle_line_start = new (std::nothrow) BYTE[largestRLELine];
-			if(!rle_line_start) {
+			// The planes are stored one after another. Read them in bands of rows,
+			// one contiguous read per channel, then uncompress and interleave the
+			// rows of a band in parallel, each straight into its own scanline.
+
+			const long dataStart = io->tell_proc(handle);
+			const unsigned bandCapacity = MAX<unsigned>(MIN<unsigned>(offset, PSDP_RLE_BAND_SIZE), largestRLERow);
+
+			BYTE* band = new (std::nothrow) BYTE[bandCapacity];
+			if(!band) {
 				FreeImage_Unload(bitmap);
-				SAFE_DELETE_ARRAY(line_start);
 				SAFE_DELETE_ARRAY(rleLineSizeList);
+				SAFE_DELETE_ARRAY(rleLineOffset);
 				throw std::bad_alloc();
 			}
-			
-			// Read the RLE data (assume 8-bit)
-			
-			const BYTE* const line_end = line_start + lineSize;
 
-			for (unsigned ch = 0; ch < nChannels; ch++) {
-				const unsigned channelOffset = ch * bytes;
-				
-				BYTE* dst_line_start = dst_first_line;
-				for(unsigned h = 0; h < nHeight; ++h, dst_line_start -= dstLineSize) {//<*** flipped
-					const unsigned index = ch * nHeight + h;
-					
-					// - read and uncompress line -
-					
-					const WORD rleLineSize = rleLineSizeList[index];
-					
-					io->read_proc(rle_line_start, rleLineSize, 1, handle);
-					
-					for (BYTE* rle_line = rle_line_start, *line = line_start; 
-						rle_line < rle_line_start + rleLineSize, line < line_end;) {
+			long filePos = 0;
+			bool bOutOfMemory = false;
+
+			for(unsigned first = 0; first < nHeight && !bOutOfMemory; ) {
+				// collect rows until the band is full
+				unsigned last = first;
+				unsigned bandSize = 0;
+				while(last < nHeight) {
+					unsigned rowSize = 0;
+					for(unsigned ch = 0; ch < nPlanes; ++ch) {
+						rowSize += rleLineSizeList[ch * nHeight + last];
+					}
+					if(last > first && bandSize + rowSize > bandCapacity) {
+						break;
+					}
+					bandSize += rowSize;
+					++last;
+				}
 
-						int len = *rle_line++;
-						
-						// NOTE len is signed byte in PackBits RLE
-						
-						if ( len < 128 ) { //<- MSB is not set
-							// uncompressed packet
-							
-							// (len + 1) bytes of data are copied
-							
-							++len;
-							
-							// assert we don't write beyound eol
-							memcpy(line, rle_line, line + len > line_end ? line_end - line : len);
-							line += len;
-							rle_line += len;
-						}
-						else if ( len > 128 ) { //< MSB is set
-						
-							// RLE compressed packet
-							
-							// One byte of data is repeated (–len + 1) times
-							
-							len ^= 0xFF; // same as (-len + 1) & 0xFF 
-							len += 2;    //
+				// read each channel's part of the band, and remember where its rows went
+				BYTE* bandRow[4];
+				BYTE* dst = band;
+				for(unsigned ch = 0; ch < nPlanes; ++ch) {
+					const unsigned index = ch * nHeight;
+					const long start = rleLineOffset[index + first];
+					const unsigned segment = (unsigned)(rleLineOffset[index + last - 1] + rleLineSizeList[index + last - 1] - start);
+
+					if(start != filePos) {
+						io->seek_proc(handle, dataStart + start, SEEK_SET);
+					}
+					const unsigned got = (unsigned)io->read_proc(dst, 1, segment, handle);
+					if(got < segment) {
+						// truncated file
+						memset(dst + got, 0, segment - got);
+					}
+					filePos = start + segment;
+
+					bandRow[ch] = dst;
+					dst += segment;
+				}
 
-							// assert we don't write beyound eol
-							memset(line, *rle_line++, line + len > line_end ? line_end - line : len);							
-							line += len;
+				const int nFirst = (int)first;
+				const int nLast = (int)last;
+
+#pragma omp parallel
+				{
+					// per thread channel lines
+					BYTE* lines = new (std::nothrow) BYTE[nPlanes * lineSize];
+					BYTE* planes[4];
+					for(unsigned ch = 0; ch < nPlanes; ++ch) {
+						planes[ch] = lines + ch * lineSize;
+					}
+					if(!lines) {
+						bOutOfMemory = true;
+					}
 
+#pragma omp for
+					for(int h = nFirst; h < nLast; ++h) {
+						if(!lines) {
+							continue;
 						}
-						else if ( 128 == len ) {
-							// Do nothing
+						BYTE* dst_line_start = dst_first_line - h * dstLineSize;//<*** flipped
+
+						for(unsigned ch = 0; ch < nPlanes; ++ch) {
+							const unsigned index = ch * nHeight + h;
+							const BYTE* rle_line = bandRow[ch] + (rleLineOffset[index] - rleLineOffset[ch * nHeight + nFirst]);
+							psdUnpackBits(rle_line, rleLineSizeList[index], planes[ch], lineSize);
 						}
-					}//< rle_line
-					
-					// - write line to destination -
-					
-					if(ch >= dstChannels) {
-						// @todo write to extra channels
-						break; 
+						psdInterleave(planes, nPlanes, bytes, lineSize, dst_line_start, dstBpp);
 					}
-						
-					// byte by byte copy a single channel to pixel
-					for (BYTE *line = line_start, *dst_line = dst_line_start; line < line_start + lineSize; 
-						line += bytes, dst_line += dstBpp) {
 
-#ifdef FREEIMAGE_BIGENDIAN
-							memcpy(dst_line + channelOffset, line, bytes);
-#else
-							// reverse copy bytes
-							for (unsigned b = 0; b < bytes; ++b) {
-								dst_line[channelOffset + b] = line[(bytes-1) - b];							
-							}
-#endif // FREEIMAGE_BIGENDIAN
-					}	
-				}//< h
-			}//< ch
-			
-			SAFE_DELETE_ARRAY(line_start);
+					SAFE_DELETE_ARRAY(lines);
+				}
+
+				first = last;
+			}
+
 			SAFE_DELETE_ARRAY(rleLineSizeList);
-			SAFE_DELETE_ARRAY(rle_line_start);
+			SAFE_DELETE_ARRAY(rleLineOffset);
+			SAFE_DELETE_ARRAY(band);
+
+			if(bOutOfMemory) {
+				FreeImage_Unload(bitmap);
+				throw std::bad_alloc();
+			}
 		}
 		break;
 		
@@ -1016,6 +1175,22 @@ FIBITMAP* psdParser::Load(FreeImageIO *io, fi_handle handle, int s_format_id, in
 		if (!ReadImageResources(io, handle)) {
 			throw("Error in Image Resource");
 		}
+
+		// when the requested size (upper 16 bits of flags) is no larger than the
+		// embedded thumbnail, return the thumbnail instead of the merged image
+		const int requested_size = flags >> 16;
+		FIBITMAP *thumbnail = _thumbnail.getDib();
+		if ((requested_size > 0) && thumbnail && !(flags & FIF_LOAD_NOPIXELS)) {
+			const int thumb_size = (int)MAX(FreeImage_GetWidth(thumbnail), FreeImage_GetHeight(thumbnail));
+			if (thumb_size >= requested_size) {
+				Bitmap = FreeImage_Clone(thumbnail);
+				if (NULL == Bitmap) {
+					throw FI_MSG_ERROR_DIB_MEMORY;
+				}
+				StoreSizeInfo(Bitmap, "PSD", _headerInfo._Width, _headerInfo._Height);
+				return Bitmap;
+			}
+		}
 		
 		if (!ReadLayerAndMaskInfoSection(io, handle)) {
 			throw("Error in Mask Info");
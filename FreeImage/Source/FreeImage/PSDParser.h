@@ -251,7 +251,7 @@ private:
 	int _fi_format_id;
 	
 private:
-	/**	Actually ignore it */
+	/**	Actually ignore it, seeking past the section */
 	bool ReadLayerAndMaskInfoSection(FreeImageIO *io, fi_handle handle);
 	FIBITMAP* ReadImageData(FreeImageIO *io, fi_handle handle);
 
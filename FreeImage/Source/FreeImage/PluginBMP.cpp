@@ -25,6 +25,7 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "FreeImageIO.h"
 
 // ----------------------------------------------------------
 //   Constants + headers
@@ -43,6 +44,9 @@ static const BYTE BI_BITFIELDS      = 3;	// compression: Bit field or Huffman 1D
 //static const BYTE BI_PNG            = 5;	// compression: PNG
 static const BYTE BI_ALPHABITFIELDS = 6;	// compression: Bit field (this value is valid in Windows CE .NET 4.0 and later)
 
+// bytes of bitfield pixels converted at once, small enough to stay in the cache
+#define BMP_BAND_SIZE	(1024 * 1024)
+
 // ----------------------------------------------------------
 
 #ifdef _WIN32
@@ -195,6 +199,341 @@ LoadPixelData(FreeImageIO *io, fi_handle handle, FIBITMAP *dib, int height, unsi
 	return TRUE;
 }
 
+/**
+Position of the red, green, blue and alpha channels in a 16- or 32-bit bitfield pixel, 
+wider channels being narrowed to their 8 most significant bits
+*/
+typedef struct tagBitfieldLayout {
+	unsigned shift[4];		//! lowest bit of the channel
+	unsigned mask[4];		//! channel mask after the shift, 0 for a missing channel
+	BYTE expand[4][256];	//! channel value to 8 bits
+	BOOL bytes;				//! all present channels are 8 bits wide
+} BitfieldLayout;
+
+static void 
+GetBitfieldLayout(BitfieldLayout *layout, const DWORD masks[4]) {
+	layout->bytes = TRUE;
+	for(int c = 0; c < 4; c++) {
+		DWORD m = masks[c];
+		unsigned shift = 0, width = 0;
+		if(m) {
+			for(; !(m & 1); m >>= 1) {
+				shift++;
+			}
+			for(; m; m >>= 1) {
+				width++;
+			}
+			if(width > 8) {
+				shift += width - 8;
+				width = 8;
+			}
+		}
+		layout->shift[c] = shift;
+		layout->mask[c] = (1U << width) - 1;
+		layout->expand[c][0] = 0;
+		for(unsigned v = 1; v <= layout->mask[c]; v++) {
+			layout->expand[c][v] = (BYTE)((v * 0xFF) / layout->mask[c]);
+		}
+		if(width && (width < 8)) {
+			layout->bytes = FALSE;
+		}
+	}
+}
+
+/**
+Read the channel masks of a 16- or 32-bit bitmap, which follow the info header. 
+@param masks Red, green, blue and alpha masks, holding the BI_RGB layout on input
+*/
+static void 
+ReadBitfields(FreeImageIO *io, fi_handle handle, const BITMAPINFOHEADER *bih, int type, DWORD masks[4]) {
+	// V2 and later headers always have room for the masks, V3 and later for the alpha mask too
+	unsigned count = 0;
+	if(type >= 56) count = 4;
+	else if(type == 52) count = 3;
+	else if(bih->biCompression == BI_ALPHABITFIELDS) count = 4;
+	else if(bih->biCompression == BI_BITFIELDS) count = 3;
+	if(!count) {
+		return;
+	}
+
+	DWORD fields[4] = { 0, 0, 0, 0 };
+	io->read_proc(fields, count * sizeof(DWORD), 1, handle);
+#ifdef FREEIMAGE_BIGENDIAN
+	for(unsigned i = 0; i < count; i++) {
+		SwapLong(&fields[i]);
+	}
+#endif
+
+	// the masks are only meaningful for the bitfield compressions
+	if((bih->biCompression == BI_BITFIELDS) || (bih->biCompression == BI_ALPHABITFIELDS)) {
+		if(fields[0] | fields[1] | fields[2]) {
+			memcpy(masks, fields, sizeof(fields));
+		}
+	}
+}
+
+/**
+Line y of the file, counted from the first one stored
+*/
+static inline BYTE * 
+GetFileLine(FIBITMAP *dib, int height, unsigned y) {
+	// NB: height can be < 0 for top-down BMP data
+	return FreeImage_GetScanLine(dib, (height > 0) ? y : (unsigned)(-height) - 1 - y);
+}
+
+/**
+Convert a line of bitfield pixels to 24- or 32-bit, src and dst may be the same. 
+Accumulates the alpha values written in alpha_or and alpha_and.
+*/
+static void 
+ConvertBitfieldLine(BYTE *dst, const BYTE *src, unsigned width, unsigned src_bpp, unsigned dst_bpp, const BitfieldLayout *layout, BYTE *alpha_or, BYTE *alpha_and) {
+	const unsigned src_bytes = src_bpp / 8;
+	const unsigned dst_bytes = dst_bpp / 8;
+	BYTE a_or = *alpha_or, a_and = *alpha_and;
+	unsigned x = 0;
+
+#if defined(FI_SSE2) && (FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR)
+	if((src_bytes == 4) && (dst_bytes == 4) && layout->bytes) {
+		// byte wide channels: shift each into place, 4 pixels at a time
+		const __m128i shift_r = _mm_cvtsi32_si128(layout->shift[0]);
+		const __m128i shift_g = _mm_cvtsi32_si128(layout->shift[1]);
+		const __m128i shift_b = _mm_cvtsi32_si128(layout->shift[2]);
+		const __m128i shift_a = _mm_cvtsi32_si128(layout->shift[3]);
+		const __m128i mask_r = _mm_set1_epi32(layout->mask[0]);
+		const __m128i mask_g = _mm_set1_epi32(layout->mask[1]);
+		const __m128i mask_b = _mm_set1_epi32(layout->mask[2]);
+		const __m128i mask_a = _mm_set1_epi32(layout->mask[3]);
+		const __m128i opaque = _mm_set1_epi32(layout->mask[3] ? 0 : 0xFF000000);
+		__m128i v_or = _mm_setzero_si128();
+		__m128i v_and = _mm_set1_epi32(-1);
+		for(; x + 4 <= width; x += 4) {
+			const __m128i v = _mm_loadu_si128((const __m128i*)(src + 4 * x));
+			const __m128i r = _mm_and_si128(_mm_srl_epi32(v, shift_r), mask_r);
+			const __m128i g = _mm_and_si128(_mm_srl_epi32(v, shift_g), mask_g);
+			const __m128i b = _mm_and_si128(_mm_srl_epi32(v, shift_b), mask_b);
+			const __m128i a = _mm_and_si128(_mm_srl_epi32(v, shift_a), mask_a);
+			const __m128i bgra = _mm_or_si128(
+				_mm_or_si128(b, _mm_slli_epi32(g, 8)), 
+				_mm_or_si128(_mm_slli_epi32(r, 16), _mm_or_si128(_mm_slli_epi32(a, 24), opaque)));
+			_mm_storeu_si128((__m128i*)(dst + 4 * x), bgra);
+			v_or = _mm_or_si128(v_or, bgra);
+			v_and = _mm_and_si128(v_and, bgra);
+		}
+		v_or = _mm_or_si128(v_or, _mm_shuffle_epi32(v_or, _MM_SHUFFLE(1, 0, 3, 2)));
+		v_or = _mm_or_si128(v_or, _mm_shuffle_epi32(v_or, _MM_SHUFFLE(2, 3, 0, 1)));
+		v_and = _mm_and_si128(v_and, _mm_shuffle_epi32(v_and, _MM_SHUFFLE(1, 0, 3, 2)));
+		v_and = _mm_and_si128(v_and, _mm_shuffle_epi32(v_and, _MM_SHUFFLE(2, 3, 0, 1)));
+		a_or |= (BYTE)((DWORD)_mm_cvtsi128_si32(v_or) >> 24);
+		a_and &= (BYTE)((DWORD)_mm_cvtsi128_si32(v_and) >> 24);
+	}
+#endif // FI_SSE2
+
+	src += x * src_bytes;
+	dst += x * dst_bytes;
+	for(; x < width; x++, src += src_bytes, dst += dst_bytes) {
+		DWORD pixel = src[0] | (src[1] << 8);
+		if(src_bytes == 4) {
+			pixel |= (src[2] << 16) | ((DWORD)src[3] << 24);
+		}
+		const BYTE r = layout->expand[0][(pixel >> layout->shift[0]) & layout->mask[0]];
+		const BYTE g = layout->expand[1][(pixel >> layout->shift[1]) & layout->mask[1]];
+		const BYTE b = layout->expand[2][(pixel >> layout->shift[2]) & layout->mask[2]];
+		dst[FI_RGBA_RED] = r;
+		dst[FI_RGBA_GREEN] = g;
+		dst[FI_RGBA_BLUE] = b;
+		if(dst_bytes == 4) {
+			const BYTE a = layout->mask[3] ? layout->expand[3][(pixel >> layout->shift[3]) & layout->mask[3]] : 0xFF;
+			dst[FI_RGBA_ALPHA] = a;
+			a_or |= a;
+			a_and &= a;
+		}
+	}
+
+	*alpha_or = a_or;
+	*alpha_and = a_and;
+}
+
+/**
+Accumulate the alpha values of a 32-bit line in alpha_or and alpha_and
+*/
+static void 
+ScanAlphaLine(const BYTE *line, unsigned width, BYTE *alpha_or, BYTE *alpha_and) {
+	BYTE a_or = *alpha_or, a_and = *alpha_and;
+	unsigned x = 0;
+#ifdef FI_SSE2
+	__m128i v_or = _mm_setzero_si128();
+	__m128i v_and = _mm_set1_epi32(-1);
+	for(; x + 4 <= width; x += 4) {
+		const __m128i v = _mm_loadu_si128((const __m128i*)(line + 4 * x));
+		v_or = _mm_or_si128(v_or, v);
+		v_and = _mm_and_si128(v_and, v);
+	}
+	v_or = _mm_or_si128(v_or, _mm_shuffle_epi32(v_or, _MM_SHUFFLE(1, 0, 3, 2)));
+	v_or = _mm_or_si128(v_or, _mm_shuffle_epi32(v_or, _MM_SHUFFLE(2, 3, 0, 1)));
+	v_and = _mm_and_si128(v_and, _mm_shuffle_epi32(v_and, _MM_SHUFFLE(1, 0, 3, 2)));
+	v_and = _mm_and_si128(v_and, _mm_shuffle_epi32(v_and, _MM_SHUFFLE(2, 3, 0, 1)));
+	a_or |= (BYTE)((DWORD)_mm_cvtsi128_si32(v_or) >> (8 * FI_RGBA_ALPHA));
+	a_and &= (BYTE)((DWORD)_mm_cvtsi128_si32(v_and) >> (8 * FI_RGBA_ALPHA));
+#endif // FI_SSE2
+	for(const BYTE *pixel = line + 4 * x; x < width; x++, pixel += 4) {
+		a_or |= pixel[FI_RGBA_ALPHA];
+		a_and &= pixel[FI_RGBA_ALPHA];
+	}
+	*alpha_or = a_or;
+	*alpha_and = a_and;
+}
+
+/**
+Make the pixels of a 32-bit line opaque as long as their alpha is 0. 
+@return Returns the position of the first pixel with some alpha, width if there is none
+*/
+static unsigned 
+OpaqueEmptyAlphaLine(BYTE *line, unsigned width) {
+	unsigned x = 0;
+#ifdef FI_SSE2
+	const __m128i alpha = _mm_set1_epi32(0xFF << (8 * FI_RGBA_ALPHA));
+	for(; x + 4 <= width; x += 4) {
+		const __m128i v = _mm_loadu_si128((const __m128i*)(line + 4 * x));
+		if(_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(v, alpha), _mm_setzero_si128())) != 0xFFFF) {
+			break;
+		}
+		_mm_storeu_si128((__m128i*)(line + 4 * x), _mm_or_si128(v, alpha));
+	}
+#endif // FI_SSE2
+	for(BYTE *pixel = line + 4 * x; (x < width) && !pixel[FI_RGBA_ALPHA]; x++, pixel += 4) {
+		pixel[FI_RGBA_ALPHA] = 0xFF;
+	}
+	return x;
+}
+
+static void 
+FillAlphaLine(BYTE *line, unsigned width, BYTE alpha) {
+	unsigned x = 0;
+#ifdef FI_SSE2
+	const __m128i keep = _mm_set1_epi32(~(0xFF << (8 * FI_RGBA_ALPHA)));
+	const __m128i value = _mm_set1_epi32(alpha << (8 * FI_RGBA_ALPHA));
+	for(; x + 4 <= width; x += 4) {
+		const __m128i v = _mm_loadu_si128((const __m128i*)(line + 4 * x));
+		_mm_storeu_si128((__m128i*)(line + 4 * x), _mm_or_si128(_mm_and_si128(v, keep), value));
+	}
+#endif // FI_SSE2
+	for(line += 4 * x; x < width; x++, line += 4) {
+		line[FI_RGBA_ALPHA] = alpha;
+	}
+}
+
+/**
+Load 16- or 32-bit bitfield pixels into a 24- or 32-bit dib, converting them while reading. 
+Pixels are read straight into the dib when the bit depth does not change, and each band of 
+lines is converted while still in the cache. 
+An alpha channel holding nothing but zeros (the unused fourth byte of most 32-bit BMPs) 
+is loaded as opaque.
+@param io FreeImage IO
+@param handle FreeImage IO handle
+@param dib Image to be loaded 
+@param height Image height, < 0 for top-down data
+@param pitch Pitch of the file lines
+@param bit_count Bit-depth of the file (16- or 32-bit)
+@param layout Channels of the file pixels
+@return Returns TRUE if successful, returns FALSE otherwise
+*/
+static BOOL 
+LoadPixelDataBitfields(FreeImageIO *io, fi_handle handle, FIBITMAP *dib, int height, unsigned pitch, unsigned bit_count, const BitfieldLayout *layout) {
+	const unsigned width = FreeImage_GetWidth(dib);
+	const unsigned lines = FreeImage_GetHeight(dib);
+	const unsigned dst_bpp = FreeImage_GetBPP(dib);
+	const BOOL in_place = (dst_bpp == bit_count);
+	const BOOL has_alpha = (dst_bpp == 32) && layout->mask[3];
+	const unsigned band_lines = MAX(1U, BMP_BAND_SIZE / pitch);
+
+	// pixels already in the dib layout only need their alpha checked
+	const BOOL identity = in_place && (bit_count == 32) && layout->bytes && 
+		(layout->shift[0] == 8 * FI_RGBA_RED) && (layout->shift[1] == 8 * FI_RGBA_GREEN) && (layout->shift[2] == 8 * FI_RGBA_BLUE) && (layout->shift[3] == 8 * FI_RGBA_ALPHA) && 
+		(layout->mask[0] == 0xFF) && (layout->mask[1] == 0xFF) && (layout->mask[2] == 0xFF) && (layout->mask[3] == 0xFF);
+
+	BYTE *buffer = NULL;
+	if(!in_place) {
+		buffer = (BYTE*)malloc(MIN(band_lines, lines) * pitch);
+		if(!buffer) {
+			return FALSE;
+		}
+	}
+
+	BOOL bResult = TRUE;
+	BOOL seen_alpha = FALSE;	// a nonzero alpha value was found
+	BOOL transparent = FALSE;
+
+	for(unsigned first = 0; first < lines; first += band_lines) {
+		const unsigned count = MIN(band_lines, lines - first);
+
+		// read the band
+		if(!in_place) {
+			bResult = (io->read_proc(buffer, count * pitch, 1, handle) == 1);
+		} else if(height > 0) {
+			bResult = (io->read_proc(FreeImage_GetScanLine(dib, first), count * pitch, 1, handle) == 1);
+		} else {
+			for(unsigned i = 0; (i < count) && bResult; i++) {
+				bResult = (io->read_proc(GetFileLine(dib, height, first + i), pitch, 1, handle) == 1);
+			}
+		}
+		if(!bResult) {
+			break;
+		}
+
+		// convert it, line by line while in the cache
+		for(unsigned i = 0; i < count; i++) {
+			const unsigned y = first + i;
+			BYTE *dst = GetFileLine(dib, height, y);
+			BYTE alpha_or = 0, alpha_and = 0xFF;
+			if(identity && has_alpha && !seen_alpha) {
+				// no alpha so far: make the line opaque on the way, unless some shows up
+				const unsigned x = OpaqueEmptyAlphaLine(dst, width);
+				if(x == width) {
+					continue;
+				}
+				FillAlphaLine(dst, x, 0);
+				ScanAlphaLine(dst + 4 * x, width - x, &alpha_or, &alpha_and);
+				if(x) {
+					alpha_and = 0;
+				}
+			} else if(identity) {
+				ScanAlphaLine(dst, width, &alpha_or, &alpha_and);
+			} else {
+				const BYTE *src = in_place ? dst : buffer + i * pitch;
+				ConvertBitfieldLine(dst, src, width, bit_count, dst_bpp, layout, &alpha_or, &alpha_and);
+			}
+
+			if(!has_alpha) {
+				continue;
+			}
+			if(!seen_alpha && !alpha_or) {
+				// no alpha so far, opaque unless some shows up later
+				FillAlphaLine(dst, width, 0xFF);
+				continue;
+			}
+			if(!seen_alpha) {
+				// the lines before had an empty alpha after all
+				seen_alpha = TRUE;
+				for(unsigned k = 0; k < y; k++) {
+					FillAlphaLine(GetFileLine(dib, height, k), width, 0);
+				}
+				if(y) {
+					transparent = TRUE;
+				}
+			}
+			if(alpha_and != 0xFF) {
+				transparent = TRUE;
+			}
+		}
+	}
+
+	free(buffer);
+
+	FreeImage_SetTransparent(dib, transparent);
+
+	return bResult;
+}
+
 /**
 Load image pixels for 4-bit RLE compressed dib
 @param io FreeImage IO
@@ -207,11 +546,13 @@ Load image pixels for 4-bit RLE compressed dib
 static BOOL 
 LoadPixelDataRLE4(FreeImageIO *io, fi_handle handle, int width, int height, FIBITMAP *dib) {
 	int status_byte = 0;
-	BYTE second_byte = 0;
+	int second_byte = 0;
 	int bits = 0;
 
 	BYTE *pixels = NULL;	// temporary 8-bit buffer
 
+	BufferedReader reader(io, handle);
+
 	try {
 		height = abs(height);
 
@@ -226,13 +567,13 @@ LoadPixelDataRLE4(FreeImageIO *io, fi_handle handle, int width, int height, FIBI
 			if (q < pixels || q  >= end) {
 				break;
 			}
-			if(io->read_proc(&status_byte, sizeof(BYTE), 1, handle) != 1) {
+			if((status_byte = reader.next_byte()) == EOF) {
 				throw(1);
 			}
 			if (status_byte != 0)	{
 				status_byte = (int)MIN((size_t)status_byte, (size_t)(end - q));
 				// Encoded mode
-				if(io->read_proc(&second_byte, sizeof(BYTE), 1, handle) != 1) {
+				if((second_byte = reader.next_byte()) == EOF) {
 					throw(1);
 				}
 				for (int i = 0; i < status_byte; i++)	{
@@ -242,7 +583,7 @@ LoadPixelDataRLE4(FreeImageIO *io, fi_handle handle, int width, int height, FIBI
 			}
 			else {
 				// Escape mode
-				if(io->read_proc(&status_byte, sizeof(BYTE), 1, handle) != 1) {
+				if((status_byte = reader.next_byte()) == EOF) {
 					throw(1);
 				}
 				switch (status_byte) {
@@ -264,13 +605,10 @@ LoadPixelDataRLE4(FreeImageIO *io, fi_handle handle, int width, int height, FIBI
 					{
 						// read the delta values
 
-						BYTE delta_x = 0;
-						BYTE delta_y = 0;
+						const int delta_x = reader.next_byte();
+						const int delta_y = reader.next_byte();
 
-						if(io->read_proc(&delta_x, sizeof(BYTE), 1, handle) != 1) {
-							throw(1);
-						}
-						if(io->read_proc(&delta_y, sizeof(BYTE), 1, handle) != 1) {
+						if((delta_x == EOF) || (delta_y == EOF)) {
 							throw(1);
 						}
 
@@ -288,7 +626,7 @@ LoadPixelDataRLE4(FreeImageIO *io, fi_handle handle, int width, int height, FIBI
 						status_byte = (int)MIN((size_t)status_byte, (size_t)(end - q));
 						for (int i = 0; i < status_byte; i++) {
 							if ((i & 0x01) == 0) {
-								if(io->read_proc(&second_byte, sizeof(BYTE), 1, handle) != 1) {
+								if((second_byte = reader.next_byte()) == EOF) {
 									throw(1);
 								}
 							}
@@ -297,8 +635,7 @@ LoadPixelDataRLE4(FreeImageIO *io, fi_handle handle, int width, int height, FIBI
 						bits += status_byte;
 						// Read pad byte
 						if (((status_byte & 0x03) == 1) || ((status_byte & 0x03) == 2)) {
-							BYTE padding = 0;
-							if(io->read_proc(&padding, sizeof(BYTE), 1, handle) != 1) {
+							if(reader.next_byte() == EOF) {
 								throw(1);
 							}
 						}
@@ -349,19 +686,21 @@ Load image pixels for 8-bit RLE compressed dib
 */
 static BOOL 
 LoadPixelDataRLE8(FreeImageIO *io, fi_handle handle, int width, int height, FIBITMAP *dib) {
-	BYTE status_byte = 0;
-	BYTE second_byte = 0;
+	int status_byte = 0;
+	int second_byte = 0;
 	int scanline = 0;
 	int bits = 0;
 
+	BufferedReader reader(io, handle);
+
 	for (;;) {
-		if( io->read_proc(&status_byte, sizeof(BYTE), 1, handle) != 1) {
+		if((status_byte = reader.next_byte()) == EOF) {
 			return FALSE;
 		}
 
 		switch (status_byte) {
 			case RLE_COMMAND :
-				if(io->read_proc(&status_byte, sizeof(BYTE), 1, handle) != 1) {
+				if((status_byte = reader.next_byte()) == EOF) {
 					return FALSE;
 				}
 
@@ -378,13 +717,10 @@ LoadPixelDataRLE8(FreeImageIO *io, fi_handle handle, int width, int height, FIBI
 					{
 						// read the delta values
 
-						BYTE delta_x = 0;
-						BYTE delta_y = 0;
+						const int delta_x = reader.next_byte();
+						const int delta_y = reader.next_byte();
 
-						if(io->read_proc(&delta_x, sizeof(BYTE), 1, handle) != 1) {
-							return FALSE;
-						}
-						if(io->read_proc(&delta_y, sizeof(BYTE), 1, handle) != 1) {
+						if((delta_x == EOF) || (delta_y == EOF)) {
 							return FALSE;
 						}
 
@@ -402,18 +738,22 @@ LoadPixelDataRLE8(FreeImageIO *io, fi_handle handle, int width, int height, FIBI
 							return TRUE;
 						}
 
-						int count = MIN((int)status_byte, width - bits);
+						int count = MAX(0, MIN(status_byte, width - bits));
 
 						BYTE *sline = FreeImage_GetScanLine(dib, scanline);
 
-						if(io->read_proc((void *)(sline + bits), sizeof(BYTE) * count, 1, handle) != 1) {
+						// pixels beyond the line are read and dropped
+						if(reader.read(sline + bits, count) != (unsigned)count) {
+							return FALSE;
+						}
+						if(reader.skip(status_byte - count) != (unsigned)(status_byte - count)) {
 							return FALSE;
 						}
 						
 						// align run length to even number of bytes 
 
 						if ((status_byte & 1) == 1) {
-							if(io->read_proc(&second_byte, sizeof(BYTE), 1, handle) != 1) {
+							if(reader.next_byte() == EOF) {
 								return FALSE;
 							}
 						}
@@ -436,12 +776,12 @@ LoadPixelDataRLE8(FreeImageIO *io, fi_handle handle, int width, int height, FIBI
 
 				BYTE *sline = FreeImage_GetScanLine(dib, scanline);
 
-				if(io->read_proc(&second_byte, sizeof(BYTE), 1, handle) != 1) {
+				if((second_byte = reader.next_byte()) == EOF) {
 					return FALSE;
 				}
 
 				for (int i = 0; i < count; i++) {
-					*(sline + bits) = second_byte;
+					*(sline + bits) = (BYTE)second_byte;
 
 					bits++;					
 				}
@@ -566,18 +906,18 @@ LoadWindowsBMP(FreeImageIO *io, fi_handle handle, int flags, unsigned bitmap_bit
 
 			case 16 :
 			{
-				int use_bitfields = 0;
-				if (bih.biCompression == BI_BITFIELDS) use_bitfields = 3;
-				else if (bih.biCompression == BI_ALPHABITFIELDS) use_bitfields = 4;
-				else if (type == 52) use_bitfields = 3;
-				else if (type >= 56) use_bitfields = 4;
-				
-				if (use_bitfields > 0) {
- 					DWORD bitfields[4];
-					io->read_proc(bitfields, use_bitfields * sizeof(DWORD), 1, handle);
+				DWORD bitfields[4] = { FI16_555_RED_MASK, FI16_555_GREEN_MASK, FI16_555_BLUE_MASK, 0 };
+				ReadBitfields(io, handle, &bih, type, bitfields);
+
+				// 555 and 565 are kept as they are, anything else is converted
+				const BOOL native = (bitfields[3] == 0) && 
+					(((bitfields[0] == FI16_555_RED_MASK) && (bitfields[1] == FI16_555_GREEN_MASK) && (bitfields[2] == FI16_555_BLUE_MASK)) ||
+					 ((bitfields[0] == FI16_565_RED_MASK) && (bitfields[1] == FI16_565_GREEN_MASK) && (bitfields[2] == FI16_565_BLUE_MASK)));
+
+				if (native) {
 					dib = FreeImage_AllocateHeader(header_only, width, height, bit_count, bitfields[0], bitfields[1], bitfields[2]);
 				} else {
-					dib = FreeImage_AllocateHeader(header_only, width, height, bit_count, FI16_555_RED_MASK, FI16_555_GREEN_MASK, FI16_555_BLUE_MASK);
+					dib = FreeImage_AllocateHeader(header_only, width, height, bitfields[3] ? 32 : 24, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
 				}
 
 				if (dib == NULL) {
@@ -596,34 +936,22 @@ LoadWindowsBMP(FreeImageIO *io, fi_handle handle, int flags, unsigned bitmap_bit
 				// seek to the actual pixel data
 				io->seek_proc(handle, bitmap_bits_offset, SEEK_SET);
 
-				// load pixel data and swap as needed if OS is Big Endian
-				LoadPixelData(io, handle, dib, height, pitch, bit_count);
+				if (native) {
+					// load pixel data and swap as needed if OS is Big Endian
+					LoadPixelData(io, handle, dib, height, pitch, bit_count);
+				} else {
+					BitfieldLayout layout;
+					GetBitfieldLayout(&layout, bitfields);
+					LoadPixelDataBitfields(io, handle, dib, height, pitch, bit_count, &layout);
+				}
 
 				return dib;
 			}
 			break; // 16-bit
 
 			case 24 :
-			case 32 :
 			{
-				int use_bitfields = 0;
-				if (bih.biCompression == BI_BITFIELDS) use_bitfields = 3;
-				else if (bih.biCompression == BI_ALPHABITFIELDS) use_bitfields = 4;
-				else if (type == 52) use_bitfields = 3;
-				else if (type >= 56) use_bitfields = 4;
-
- 				if (use_bitfields > 0) {
-					DWORD bitfields[4];
-					io->read_proc(bitfields, use_bitfields * sizeof(DWORD), 1, handle);
-					dib = FreeImage_AllocateHeader(header_only, width, height, bit_count, bitfields[0], bitfields[1], bitfields[2]);
-				} else {
-					if( bit_count == 32 ) {
-						dib = FreeImage_AllocateHeader(header_only, width, height, bit_count, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
-					} else {
-						dib = FreeImage_AllocateHeader(header_only, width, height, bit_count, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
-					}
-				}
-
+				dib = FreeImage_AllocateHeader(header_only, width, height, bit_count, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
 				if (dib == NULL) {
 					throw FI_MSG_ERROR_DIB_MEMORY;
 				}
@@ -648,13 +976,41 @@ LoadWindowsBMP(FreeImageIO *io, fi_handle handle, int flags, unsigned bitmap_bit
 				// load pixel data and swap as needed if OS is Big Endian
 				LoadPixelData(io, handle, dib, height, pitch, bit_count);
 
-				// check if the bitmap contains transparency, if so enable it in the header
+				return dib;
+			}
+			break; // 24-bit
 
-				FreeImage_SetTransparent(dib, (FreeImage_GetColorType(dib) == FIC_RGBALPHA));
+			case 32 :
+			{
+				// BI_RGB: the fourth byte is used as alpha, unless it is empty
+				DWORD bitfields[4] = { 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000 };
+				ReadBitfields(io, handle, &bih, type, bitfields);
+
+				dib = FreeImage_AllocateHeader(header_only, width, height, bit_count, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
+				if (dib == NULL) {
+					throw FI_MSG_ERROR_DIB_MEMORY;
+				}
+
+				// set resolution information
+				FreeImage_SetDotsPerMeterX(dib, bih.biXPelsPerMeter);
+				FreeImage_SetDotsPerMeterY(dib, bih.biYPelsPerMeter);
+
+				if(header_only) {
+					// header only mode
+					return dib;
+				}
+
+				// seek to the actual pixel data
+				io->seek_proc(handle, bitmap_bits_offset, SEEK_SET);
+
+				// read the pixels, converting them to the dib layout and checking for transparency on the way
+				BitfieldLayout layout;
+				GetBitfieldLayout(&layout, bitfields);
+				LoadPixelDataBitfields(io, handle, dib, height, pitch, bit_count, &layout);
 
 				return dib;
 			}
-			break; // 24-, 32-bit
+			break; // 32-bit
 		}
 	} catch(const char *message) {
 		if(dib) {
@@ -117,52 +117,40 @@ typedef struct tagDDSHEADER {
 #define FOURCC_DXT3	MAKEFOURCC('D','X','T','3')
 #define FOURCC_DXT4	MAKEFOURCC('D','X','T','4')
 #define FOURCC_DXT5	MAKEFOURCC('D','X','T','5')
-
-// ----------------------------------------------------------
-//   Structures used by DXT textures
-// ----------------------------------------------------------
-
-typedef struct tagColor8888 {
-	BYTE b;
-	BYTE g;
-	BYTE r;
-	BYTE a;
-} Color8888;
-
-typedef struct tagColor565 {
-	WORD b : 5;
-	WORD g : 6;
-	WORD r : 5;
-} Color565;
-
-typedef struct tagDXTColBlock {
-	Color565 colors[2];
-	BYTE row[4];
-} DXTColBlock;
-
-typedef struct tagDXTAlphaBlockExplicit {
-	WORD row[4];
-} DXTAlphaBlockExplicit;
-
-typedef struct tagDXTAlphaBlock3BitLinear {
-	BYTE alpha[2];
-	BYTE data[6];
-} DXTAlphaBlock3BitLinear;
-
-typedef struct tagDXT1Block
-{
-	DXTColBlock color;
-} DXT1Block;
-
-typedef struct tagDXT3Block {		// also used by dxt2
-	DXTAlphaBlockExplicit alpha;
-	DXTColBlock color;
-} DXT3Block;
-
-typedef struct tagDXT5Block {		// also used by dxt4
-	DXTAlphaBlock3BitLinear alpha;
-	DXTColBlock color;
-} DXT5Block;
+#define FOURCC_ATI1	MAKEFOURCC('A','T','I','1')
+#define FOURCC_BC4U	MAKEFOURCC('B','C','4','U')
+#define FOURCC_ATI2	MAKEFOURCC('A','T','I','2')
+#define FOURCC_BC5U	MAKEFOURCC('B','C','5','U')
+#define FOURCC_DX10	MAKEFOURCC('D','X','1','0')
+
+// Extended header following DDSHEADER when the FourCC is "DX10"
+typedef struct tagDDSHEADER_DXT10 {
+	DWORD dxgiFormat;		// see DXGI_FORMAT_*
+	DWORD resourceDimension;
+	DWORD miscFlag;
+	DWORD arraySize;
+	DWORD miscFlags2;
+} DDSHEADER_DXT10;
+
+// Block compressed DXGI formats
+enum {
+	DXGI_FORMAT_BC1_TYPELESS	= 70,
+	DXGI_FORMAT_BC1_UNORM		= 71,
+	DXGI_FORMAT_BC1_UNORM_SRGB	= 72,
+	DXGI_FORMAT_BC2_TYPELESS	= 73,
+	DXGI_FORMAT_BC2_UNORM		= 74,
+	DXGI_FORMAT_BC2_UNORM_SRGB	= 75,
+	DXGI_FORMAT_BC3_TYPELESS	= 76,
+	DXGI_FORMAT_BC3_UNORM		= 77,
+	DXGI_FORMAT_BC3_UNORM_SRGB	= 78,
+	DXGI_FORMAT_BC4_TYPELESS	= 79,
+	DXGI_FORMAT_BC4_UNORM		= 80,
+	DXGI_FORMAT_BC5_TYPELESS	= 82,
+	DXGI_FORMAT_BC5_UNORM		= 83,
+	DXGI_FORMAT_BC7_TYPELESS	= 97,
+	DXGI_FORMAT_BC7_UNORM		= 98,
+	DXGI_FORMAT_BC7_UNORM_SRGB	= 99
+};
 
 #ifdef _WIN32
 #	pragma pack(pop)
@@ -204,188 +192,478 @@ SwapHeader(DDSHEADER *header) {
 #endif
 
 // ==========================================================
+//   Block decoders
+//
+// Each decoder turns one 4x4 block into 16 texels in FreeImage's 32-bit byte
+// order, written to 4 rows that are step bytes apart. Palettes are built with
+// SSE2 where available.
+// ==========================================================
+
+/** Compressed bytes of a mip level read and decoded at once */
+#define DDS_BAND_SIZE	(4 * 1024 * 1024)
+
+/** Texel i of a block, row by row */
+static inline BYTE *
+TexelAt(BYTE *dst, long step, int i) {
+	return dst + (i >> 2) * step + (i & 3) * 4;
+}
+
+static inline void
+SetTexel(DWORD &texel, unsigned r, unsigned g, unsigned b, unsigned a) {
+	BYTE *p = (BYTE *)&texel;
+	p[FI_RGBA_RED] = (BYTE)r;
+	p[FI_RGBA_GREEN] = (BYTE)g;
+	p[FI_RGBA_BLUE] = (BYTE)b;
+	p[FI_RGBA_ALPHA] = (BYTE)a;
+}
 
 // Get the 4 possible colors for a block
 //
-static void 
-GetBlockColors (const DXTColBlock &block, Color8888 colors[4], bool isDXT1) {
-	int i;
+static void
+GetBlockColors (const BYTE *block, DWORD colors[4], bool isDXT1) {
+	const unsigned c0 = block[0] | (block[1] << 8);
+	const unsigned c1 = block[2] | (block[3] << 8);
+
 	// expand from 565 to 888
-	for (i = 0; i < 2; i++)	{
-		colors[i].a = 0xff;
-		/*
-		colors[i].r = (BYTE)(block.colors[i].r * 0xff / 0x1f);
-		colors[i].g = (BYTE)(block.colors[i].g * 0xff / 0x3f);
-		colors[i].b = (BYTE)(block.colors[i].b * 0xff / 0x1f);
-		*/
-		colors[i].r = (BYTE)((block.colors[i].r << 3U) | (block.colors[i].r >> 2U));
-		colors[i].g = (BYTE)((block.colors[i].g << 2U) | (block.colors[i].g >> 4U));
-		colors[i].b = (BYTE)((block.colors[i].b << 3U) | (block.colors[i].b >> 2U));
-	}
-
-	WORD *wCol = (WORD *)block.colors;
-	if (wCol[0] > wCol[1] || !isDXT1) {
-		// 4 color block
-		for (i = 0; i < 2; i++)	{
-			colors[i + 2].a = 0xff;
-			colors[i + 2].r = (BYTE)((WORD (colors[0].r) * (2 - i) + WORD (colors[1].r) * (1 + i)) / 3);
-			colors[i + 2].g = (BYTE)((WORD (colors[0].g) * (2 - i) + WORD (colors[1].g) * (1 + i)) / 3);
-			colors[i + 2].b = (BYTE)((WORD (colors[0].b) * (2 - i) + WORD (colors[1].b) * (1 + i)) / 3);
+	const unsigned r0 = c0 >> 11, g0 = (c0 >> 5) & 0x3F, b0 = c0 & 0x1F;
+	const unsigned r1 = c1 >> 11, g1 = (c1 >> 5) & 0x3F, b1 = c1 & 0x1F;
+	const short r[2] = { (short)((r0 << 3) | (r0 >> 2)), (short)((r1 << 3) | (r1 >> 2)) };
+	const short g[2] = { (short)((g0 << 2) | (g0 >> 4)), (short)((g1 << 2) | (g1 >> 4)) };
+	const short b[2] = { (short)((b0 << 3) | (b0 >> 2)), (short)((b1 << 3) | (b1 >> 2)) };
+
+	const bool fourColors = (c0 > c1) || !isDXT1;
+
+#ifdef FI_SSE2
+	// both endpoints as 16-bit lanes, and the same with the halves swapped
+#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
+	const __m128i e01 = _mm_setr_epi16(b[0], g[0], r[0], 0xFF, b[1], g[1], r[1], 0xFF);
+#else
+	const __m128i e01 = _mm_setr_epi16(r[0], g[0], b[0], 0xFF, r[1], g[1], b[1], 0xFF);
+#endif
+	const __m128i e10 = _mm_shuffle_epi32(e01, _MM_SHUFFLE(1, 0, 3, 2));
+	__m128i mid;
+	if (fourColors) {
+		// (2 * c0 + c1) / 3 and (c0 + 2 * c1) / 3, x / 3 == (x * 0xAAAB) >> 17 for x < 2^16
+		mid = _mm_add_epi16(_mm_add_epi16(e01, e01), e10);
+		mid = _mm_srli_epi16(_mm_mulhi_epu16(mid, _mm_set1_epi16((short)0xAAAB)), 1);
+	}
+	else {
+		// 3 color block, (c0 + c1) / 2 and number 4 is transparent black
+		mid = _mm_srli_epi16(_mm_add_epi16(e01, e10), 1);
+		mid = _mm_unpacklo_epi64(mid, _mm_setzero_si128());
+	}
+	_mm_storeu_si128((__m128i *)colors, _mm_packus_epi16(e01, mid));
+#else
+	for (int i = 0; i < 2; i++) {
+		SetTexel(colors[i], r[i], g[i], b[i], 0xFF);
+	}
+	if (fourColors) {
+		SetTexel(colors[2], (2 * r[0] + r[1]) / 3, (2 * g[0] + g[1]) / 3, (2 * b[0] + b[1]) / 3, 0xFF);
+		SetTexel(colors[3], (r[0] + 2 * r[1]) / 3, (g[0] + 2 * g[1]) / 3, (b[0] + 2 * b[1]) / 3, 0xFF);
+	}
+	else {
+		// 3 color block, number 4 is transparent black
+		SetTexel(colors[2], (r[0] + r[1]) / 2, (g[0] + g[1]) / 2, (b[0] + b[1]) / 2, 0xFF);
+		colors[3] = 0;
+	}
+#endif // FI_SSE2
+}
+
+// Get the 8 possible values of an interpolated alpha (BC3) or channel (BC4, BC5) block
+//
+static void
+GetBlockAlphas (const BYTE *block, BYTE alphas[8]) {
+	const unsigned a0 = block[0];
+	const unsigned a1 = block[1];
+
+#ifdef FI_SSE2
+	// ((7 - i) * a0 + i * a1 + 3) / 7 for i = 0..7, and ((5 - i) * a0 + i * a1 + 2) / 5 for i = 0..5
+	// x / 7 == (x * 9363) >> 16 and x / 5 == (x * 13108) >> 16 for the ranges involved
+	__m128i v;
+	if (a0 > a1) {
+		const __m128i w0 = _mm_setr_epi16(7, 0, 6, 5, 4, 3, 2, 1);
+		const __m128i w1 = _mm_setr_epi16(0, 7, 1, 2, 3, 4, 5, 6);
+		v = _mm_add_epi16(_mm_mullo_epi16(w0, _mm_set1_epi16((short)a0)), _mm_mullo_epi16(w1, _mm_set1_epi16((short)a1)));
+		v = _mm_mulhi_epu16(_mm_add_epi16(v, _mm_set1_epi16(3)), _mm_set1_epi16(9363));
+	}
+	else {
+		const __m128i w0 = _mm_setr_epi16(5, 0, 4, 3, 2, 1, 0, 0);
+		const __m128i w1 = _mm_setr_epi16(0, 5, 1, 2, 3, 4, 0, 0);
+		v = _mm_add_epi16(_mm_mullo_epi16(w0, _mm_set1_epi16((short)a0)), _mm_mullo_epi16(w1, _mm_set1_epi16((short)a1)));
+		v = _mm_mulhi_epu16(_mm_add_epi16(v, _mm_set1_epi16(2)), _mm_set1_epi16(13108));
+		// 0 and 0xFF
+		v = _mm_or_si128(v, _mm_setr_epi16(0, 0, 0, 0, 0, 0, 0, 0xFF));
+	}
+	_mm_storel_epi64((__m128i *)alphas, _mm_packus_epi16(v, v));
+#else
+	alphas[0] = (BYTE)a0;
+	alphas[1] = (BYTE)a1;
+	if (a0 > a1) {
+		// 8 alpha block
+		for (int i = 0; i < 6; i++) {
+			alphas[i + 2] = (BYTE)(((6 - i) * a0 + (1 + i) * a1 + 3) / 7);
 		}
 	}
 	else {
-		// 3 color block, number 4 is transparent
-		colors[2].a = 0xff;
-		colors[2].r = (BYTE)((WORD (colors[0].r) + WORD (colors[1].r)) / 2);
-		colors[2].g = (BYTE)((WORD (colors[0].g) + WORD (colors[1].g)) / 2);
-		colors[2].b = (BYTE)((WORD (colors[0].b) + WORD (colors[1].b)) / 2);
+		// 6 alpha block
+		for (int i = 0; i < 4; i++) {
+			alphas[i + 2] = (BYTE)(((4 - i) * a0 + (1 + i) * a1 + 2) / 5);
+		}
+		alphas[6] = 0;
+		alphas[7] = 0xFF;
+	}
+#endif // FI_SSE2
+}
 
-		colors[3].a = 0x00;
-		colors[3].g = 0x00;
-		colors[3].b = 0x00;
-		colors[3].r = 0x00;
+/** 48 bits of 3-bit indices of an interpolated alpha block */
+static inline UINT64
+GetAlphaBits (const BYTE *block) {
+	UINT64 bits = 0;
+	for (int i = 5; i >= 0; i--) {
+		bits = (bits << 8) | block[2 + i];
 	}
+	return bits;
 }
 
-struct DXT_INFO_1 {
-	typedef DXT1Block Block;
-	enum {
-		isDXT1 = 1,
-		bytesPerBlock = 8
-	};
-};
+static inline void
+DecodeColorBlock (const BYTE *block, BYTE *dst, long step, bool isDXT1) {
+	DWORD colors[4];
+	GetBlockColors (block, colors, isDXT1);
+	for (int y = 0; y < 4; y++, dst += step) {
+		const unsigned row = block[4 + y];
+		DWORD *texel = (DWORD *)dst;
+		texel[0] = colors[row & 3];
+		texel[1] = colors[(row >> 2) & 3];
+		texel[2] = colors[(row >> 4) & 3];
+		texel[3] = colors[row >> 6];
+	}
+}
 
-struct DXT_INFO_3 {
-	typedef DXT3Block Block;
-	enum {
-		isDXT1 = 1,
-		bytesPerBlock = 16
-	};
+static inline void
+DecodeAlphaBlock (const BYTE *block, BYTE *dst, long step, int channel) {
+	BYTE alphas[8];
+	GetBlockAlphas (block, alphas);
+	UINT64 bits = GetAlphaBits (block);
+	for (int i = 0; i < 16; i++, bits >>= 3) {
+		TexelAt(dst, step, i)[channel] = alphas[bits & 7];
+	}
+}
+
+struct DXT_BLOCKDECODER_BC1 {
+	enum { bytesPerBlock = 8 };
+
+	static void Decode (const BYTE *block, BYTE *dst, long step) {
+		DecodeColorBlock (block, dst, step, true);
+	}
 };
 
-struct DXT_INFO_5 {
-	typedef DXT5Block Block;
-	enum
-	{
-		isDXT1 = 1,
-		bytesPerBlock = 16
-	};
+struct DXT_BLOCKDECODER_BC2 {
+	enum { bytesPerBlock = 16 };
+
+	static void Decode (const BYTE *block, BYTE *dst, long step) {
+		DecodeColorBlock (block + 8, dst, step, false);
+		// explicit 4-bit alpha
+		for (int i = 0; i < 16; i++) {
+			const unsigned bits = (block[i >> 1] >> ((i & 1) * 4)) & 0xF;
+			TexelAt(dst, step, i)[FI_RGBA_ALPHA] = (BYTE)(bits * 0x11);
+		}
+	}
 };
 
-template <class INFO> class DXT_BLOCKDECODER_BASE {
-protected:
-	Color8888 m_colors[4];
-	const typename INFO::Block *m_pBlock;
-	unsigned m_colorRow;
+struct DXT_BLOCKDECODER_BC3 {
+	enum { bytesPerBlock = 16 };
 
-public:
-	void Setup (const BYTE *pBlock) {
-		m_pBlock = (const typename INFO::Block *)pBlock;
-		GetBlockColors (m_pBlock->color, m_colors, INFO::isDXT1);
+	static void Decode (const BYTE *block, BYTE *dst, long step) {
+		DecodeColorBlock (block + 8, dst, step, false);
+		DecodeAlphaBlock (block, dst, step, FI_RGBA_ALPHA);
 	}
+};
 
-	void SetY (int y) {
-		m_colorRow = m_pBlock->color.row[y];
+struct DXT_BLOCKDECODER_BC4 {
+	enum { bytesPerBlock = 8 };
+
+	// single channel, shown as grey
+	static void Decode (const BYTE *block, BYTE *dst, long step) {
+		BYTE alphas[8];
+		GetBlockAlphas (block, alphas);
+		UINT64 bits = GetAlphaBits (block);
+		for (int i = 0; i < 16; i++, bits >>= 3) {
+			const BYTE v = alphas[bits & 7];
+			SetTexel (*(DWORD *)TexelAt(dst, step, i), v, v, v, 0xFF);
+		}
 	}
+};
 
-	void GetColor (int x, int y, Color8888 &color) {
-		unsigned bits = (m_colorRow >> (x * 2)) & 3;
-		color = m_colors[bits];
+struct DXT_BLOCKDECODER_BC5 {
+	enum { bytesPerBlock = 16 };
+
+	// red and green channels (usually a normal map), blue is left empty
+	static void Decode (const BYTE *block, BYTE *dst, long step) {
+		for (int i = 0; i < 16; i++) {
+			SetTexel (*(DWORD *)TexelAt(dst, step, i), 0, 0, 0, 0xFF);
+		}
+		DecodeAlphaBlock (block, dst, step, FI_RGBA_RED);
+		DecodeAlphaBlock (block + 8, dst, step, FI_RGBA_GREEN);
 	}
 };
 
-class DXT_BLOCKDECODER_1 : public DXT_BLOCKDECODER_BASE <DXT_INFO_1> {
-public:
-	typedef DXT_INFO_1 INFO;
+// ----------------------------------------------------------
+//   BC7
+// ----------------------------------------------------------
+
+typedef struct tagBC7Mode {
+	BYTE subsets;
+	BYTE partitionBits;
+	BYTE rotationBits;
+	BYTE indexSelectionBits;
+	BYTE colorBits;
+	BYTE alphaBits;
+	BYTE endpointPBits;		// one P-bit per endpoint
+	BYTE sharedPBits;		// one P-bit per subset
+	BYTE indexBits;
+	BYTE indexBits2;		// secondary index set (modes 4 and 5)
+} BC7Mode;
+
+static const BC7Mode s_bc7Modes[8] = {
+	{ 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+	{ 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+	{ 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+	{ 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+	{ 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+	{ 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+	{ 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+	{ 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 }
 };
 
-class DXT_BLOCKDECODER_3 : public DXT_BLOCKDECODER_BASE <DXT_INFO_3> {
-public:
-	typedef DXT_BLOCKDECODER_BASE <DXT_INFO_3> base;
-	typedef DXT_INFO_3 INFO;
+// subset of each texel (bit i) for the 2 subset partitions
+static const WORD s_bc7Partitions2[64] = {
+	0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80,
+	0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+	0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE,
+	0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+	0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A,
+	0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+	0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C,
+	0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22
+};
+
+// subset of each texel (bits 2i, 2i+1) for the 3 subset partitions
+static const DWORD s_bc7Partitions3[64] = {
+	0xAA685050, 0x6A5A5040, 0x5A5A4200, 0x5450A0A8,
+	0xA5A50000, 0xA0A05050, 0x5555A0A0, 0x5A5A5050,
+	0xAA550000, 0xAA555500, 0xAAAA5500, 0x90909090,
+	0x94949494, 0xA4A4A4A4, 0xA9A59450, 0x2A0A4250,
+	0xA5945040, 0x0A425054, 0xA5A5A500, 0x55A0A0A0,
+	0xA8A85454, 0x6A6A4040, 0xA4A45000, 0x1A1A0500,
+	0x0050A4A4, 0xAAA59090, 0x14696914, 0x69691400,
+	0xA08585A0, 0xAA821414, 0x50A4A450, 0x6A5A0200,
+	0xA9A58000, 0x5090A0A8, 0xA8A09050, 0x24242424,
+	0x00AA5500, 0x24924924, 0x24499224, 0x50A50A50,
+	0x500AA550, 0xAAAA4444, 0x66660000, 0xA5A0A5A0,
+	0x50A050A0, 0x69286928, 0x44AAAA44, 0x66666600,
+	0xAA444444, 0x54A854A8, 0x95809580, 0x96969600,
+	0xA85454A8, 0x80959580, 0xAA141414, 0x96960000,
+	0xAAAA1414, 0xA05050A0, 0xA0A5A5A0, 0x96000000,
+	0x40804080, 0xA9A8A9A8, 0xAAAAAA44, 0x2A4A5254
+};
+
+// anchor texel of the second subset, 2 subset partitions
+static const BYTE s_bc7Anchors2[64] = {
+	15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+	15,  2,  8,  2,  2,  8,  8, 15,  2,  8,  2,  2,  8,  8,  2,  2,
+	15, 15,  6,  8,  2,  8, 15, 15,  2,  8,  2,  2,  2, 15, 15,  6,
+	 6,  2,  6,  8, 15, 15,  2,  2, 15, 15, 15, 15, 15,  2,  2, 15
+};
+
+// anchor texels of the second and third subset, 3 subset partitions
+static const BYTE s_bc7Anchors3[2][64] = {
+	{
+	 3,  3, 15, 15,  8,  3, 15, 15,  8,  8,  6,  6,  6,  5,  3,  3,
+	 3,  3,  8, 15,  3,  3,  6, 10,  5,  8,  8,  6,  8,  5, 15, 15,
+	 8, 15,  3,  5,  6, 10,  8, 15, 15,  3, 15,  5, 15, 15, 15, 15,
+	 3, 15,  5,  5,  5,  8,  5, 10,  5, 10,  8, 13, 15, 12,  3,  3
+	},
+	{
+	15,  8,  8,  3, 15, 15,  3,  8, 15, 15, 15, 15, 15, 15, 15,  8,
+	15,  8, 15,  3, 15,  8, 15,  8,  3, 15,  6, 10, 15, 15, 10,  8,
+	15,  3, 15, 10, 10,  8,  9, 10,  6, 15,  8, 15,  3,  6,  6,  8,
+	15,  3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,  3, 15, 15,  8
+	}
+};
 
-protected:
-	unsigned m_alphaRow;
+static const BYTE s_bc7Weights2[4] = { 0, 21, 43, 64 };
+static const BYTE s_bc7Weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+static const BYTE s_bc7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+/** Reads the fields of a 128-bit block, least significant bit first */
+class BC7_BITREADER {
+private:
+	UINT64 m_lo, m_hi;
+	unsigned m_pos;
 
 public:
-	void SetY (int y) {
-		base::SetY (y);
-		m_alphaRow = m_pBlock->alpha.row[y];
+	BC7_BITREADER (const BYTE *block) : m_lo(0), m_hi(0), m_pos(0) {
+		for (int i = 7; i >= 0; i--) {
+			m_lo = (m_lo << 8) | block[i];
+			m_hi = (m_hi << 8) | block[8 + i];
+		}
 	}
 
-	void GetColor (int x, int y, Color8888 &color) {
-		base::GetColor (x, y, color);
-		const unsigned bits = (m_alphaRow >> (x * 4)) & 0xF;
-		color.a = (BYTE)((bits * 0xFF) / 0xF);
+	unsigned Read (unsigned bits) {
+		UINT64 value;
+		if (m_pos >= 64) {
+			value = m_hi >> (m_pos - 64);
+		} else {
+			value = m_lo >> m_pos;
+			if (m_pos + bits > 64) {
+				value |= m_hi << (64 - m_pos);
+			}
+		}
+		m_pos += bits;
+		return (unsigned)value & ((1U << bits) - 1);
 	}
 };
 
-class DXT_BLOCKDECODER_5 : public DXT_BLOCKDECODER_BASE <DXT_INFO_5> {
-public:
-	typedef DXT_BLOCKDECODER_BASE <DXT_INFO_5> base;
-	typedef DXT_INFO_5 INFO;
+static inline const BYTE *
+GetBC7Weights (unsigned bits) {
+	return (bits == 2) ? s_bc7Weights2 : (bits == 3) ? s_bc7Weights3 : s_bc7Weights4;
+}
 
-protected:
-	unsigned m_alphas[8];
-	unsigned m_alphaBits;
-	int m_offset;
+struct DXT_BLOCKDECODER_BC7 {
+	enum { bytesPerBlock = 16 };
 
-public:
-	void Setup (const BYTE *pBlock) {
-		base::Setup (pBlock);
-
-		const DXTAlphaBlock3BitLinear &block = m_pBlock->alpha;
-		m_alphas[0] = block.alpha[0];
-		m_alphas[1] = block.alpha[1];
-		if (m_alphas[0] > m_alphas[1]) {
-			// 8 alpha block
-			for (int i = 0; i < 6; i++) {
-				m_alphas[i + 2] = ((6 - i) * m_alphas[0] + (1 + i) * m_alphas[1] + 3) / 7;
+	static void Decode (const BYTE *block, BYTE *dst, long step) {
+		// the mode is the number of zero bits before the first set one
+		unsigned mode = 0;
+		while (mode < 8 && !(block[0] & (1 << mode))) {
+			mode++;
+		}
+		if (mode == 8) {
+			// reserved, decodes to transparent black
+			for (int y = 0; y < 4; y++) {
+				memset(dst + y * step, 0, 4 * sizeof(DWORD));
 			}
+			return;
 		}
-		else {
-			// 6 alpha block
-			for (int i = 0; i < 4; i++) {
-				m_alphas[i + 2] = ((4 - i) * m_alphas[0] + (1 + i) * m_alphas[1] + 2) / 5;
+
+		const BC7Mode &m = s_bc7Modes[mode];
+		BC7_BITREADER bits (block);
+		bits.Read (mode + 1);
+
+		const unsigned partition = bits.Read (m.partitionBits);
+		const unsigned rotation = bits.Read (m.rotationBits);
+		const unsigned indexSelection = bits.Read (m.indexSelectionBits);
+
+		// endpoints[subset * 2 + endpoint][channel], RGBA
+		unsigned endpoints[6][4];
+		const unsigned nEndpoints = m.subsets * 2;
+		for (unsigned c = 0; c < 3; c++) {
+			for (unsigned e = 0; e < nEndpoints; e++) {
+				endpoints[e][c] = bits.Read (m.colorBits);
 			}
-			m_alphas[6] = 0;
-			m_alphas[7] = 0xFF;
+		}
+		for (unsigned e = 0; e < nEndpoints; e++) {
+			endpoints[e][3] = m.alphaBits ? bits.Read (m.alphaBits) : 0xFF;
 		}
 
-	}
+		// P-bits add a least significant bit to every channel
+		unsigned colorBits = m.colorBits;
+		unsigned alphaBits = m.alphaBits;
+		if (m.endpointPBits || m.sharedPBits) {
+			unsigned pbits[6];
+			if (m.endpointPBits) {
+				for (unsigned e = 0; e < nEndpoints; e++) {
+					pbits[e] = bits.Read (1);
+				}
+			} else {
+				for (unsigned s = 0; s < m.subsets; s++) {
+					pbits[2 * s] = pbits[2 * s + 1] = bits.Read (1);
+				}
+			}
+			const unsigned channels = m.alphaBits ? 4 : 3;
+			for (unsigned e = 0; e < nEndpoints; e++) {
+				for (unsigned c = 0; c < channels; c++) {
+					endpoints[e][c] = (endpoints[e][c] << 1) | pbits[e];
+				}
+			}
+			colorBits++;
+			if (alphaBits) {
+				alphaBits++;
+			}
+		}
 
-	void SetY (int y) {
-		base::SetY (y);
-		int i = y / 2;
-		const DXTAlphaBlock3BitLinear &block = m_pBlock->alpha;
-		m_alphaBits = unsigned(block.data[0 + i * 3]) | (unsigned(block.data[1 + i * 3]) << 8)
-			| (unsigned(block.data[2 + i * 3]) << 16);
-		m_offset = (y & 1) * 12;
-	}
+		// expand to 8 bits by replicating the high bits
+		for (unsigned e = 0; e < nEndpoints; e++) {
+			for (unsigned c = 0; c < 3; c++) {
+				endpoints[e][c] = (endpoints[e][c] << (8 - colorBits)) | (endpoints[e][c] >> (2 * colorBits - 8));
+			}
+			if (alphaBits) {
+				endpoints[e][3] = (endpoints[e][3] << (8 - alphaBits)) | (endpoints[e][3] >> (2 * alphaBits - 8));
+			}
+		}
 
-	void GetColor (int x, int y, Color8888 &color) {
-		base::GetColor (x, y, color);
-		unsigned bits = (m_alphaBits >> (x * 3 + m_offset)) & 7;
-		color.a = (BYTE)m_alphas[bits];
-	}
-};
+		// subset and anchor (index stored with one bit less) of every texel
+		BYTE subset[16];
+		unsigned anchors = 1;
+		for (int i = 0; i < 16; i++) {
+			switch (m.subsets) {
+				case 1:
+					subset[i] = 0;
+					break;
+				case 2:
+					subset[i] = (BYTE)((s_bc7Partitions2[partition] >> i) & 1);
+					break;
+				default:
+					subset[i] = (BYTE)((s_bc7Partitions3[partition] >> (2 * i)) & 3);
+					break;
+			}
+		}
+		if (m.subsets == 2) {
+			anchors |= 1 << s_bc7Anchors2[partition];
+		} else if (m.subsets == 3) {
+			anchors |= (1 << s_bc7Anchors3[0][partition]) | (1 << s_bc7Anchors3[1][partition]);
+		}
+
+		BYTE indices[16], indices2[16];
+		for (int i = 0; i < 16; i++) {
+			indices[i] = (BYTE)bits.Read (m.indexBits - ((anchors >> i) & 1));
+		}
+		if (m.indexBits2) {
+			for (int i = 0; i < 16; i++) {
+				indices2[i] = (BYTE)bits.Read (m.indexBits2 - (i == 0));
+			}
+		}
 
-template <class DECODER> void DecodeDXTBlock (BYTE *dstData, const BYTE *srcBlock, long dstPitch, int bw, int bh) {
-	DECODER decoder;
-	decoder.Setup (srcBlock);
-	for (int y = 0; y < bh; y++) {
-		BYTE *dst = dstData - y * dstPitch;
-		decoder.SetY (y);
-		for (int x = 0; x < bw; x++) {
-			decoder.GetColor (x, y, (Color8888 &)*dst);
-
-#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_RGB 
-			INPLACESWAP(dst[FI_RGBA_RED], dst[FI_RGBA_BLUE]);
-#endif 
-			dst += 4;
+		// the index selection bit swaps which index set is used for color and alpha
+		const BYTE *colorIndices = indices, *alphaIndices = indices;
+		const BYTE *colorWeights = GetBC7Weights (m.indexBits), *alphaWeights = colorWeights;
+		if (m.indexBits2) {
+			alphaIndices = indices2;
+			alphaWeights = GetBC7Weights (m.indexBits2);
+			if (indexSelection) {
+				const BYTE *t = colorIndices; colorIndices = alphaIndices; alphaIndices = t;
+				t = colorWeights; colorWeights = alphaWeights; alphaWeights = t;
+			}
+		}
+
+		for (int i = 0; i < 16; i++) {
+			const unsigned *e0 = endpoints[2 * subset[i]];
+			const unsigned *e1 = endpoints[2 * subset[i] + 1];
+			const unsigned cw = colorWeights[colorIndices[i]];
+			const unsigned aw = alphaWeights[alphaIndices[i]];
+			unsigned rgba[4];
+			for (int c = 0; c < 3; c++) {
+				rgba[c] = ((64 - cw) * e0[c] + cw * e1[c] + 32) >> 6;
+			}
+			rgba[3] = ((64 - aw) * e0[3] + aw * e1[3] + 32) >> 6;
+			if (rotation) {
+				// the alpha channel was swapped with a color channel
+				const unsigned t = rgba[3]; rgba[3] = rgba[rotation - 1]; rgba[rotation - 1] = t;
+			}
+			SetTexel (*(DWORD *)TexelAt(dst, step, i), rgba[0], rgba[1], rgba[2], rgba[3]);
 		}
 	}
-}
+};
 
 // ==========================================================
 // Plugin Interface
@@ -399,8 +677,8 @@ static int s_format_id;
 
 static FIBITMAP *
 LoadRGB (DDSURFACEDESC2 &desc, FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
-	int width = (int)desc.dwWidth & ~3;
-	int height = (int)desc.dwHeight & ~3;
+	int width = (int)desc.dwWidth;
+	int height = (int)desc.dwHeight;
 	int bpp = (int)desc.ddpfPixelFormat.dwRGBBitCount;
 	
 	// allocate a new dib
@@ -442,55 +720,143 @@ LoadRGB (DDSURFACEDESC2 &desc, FreeImageIO *io, fi_handle handle, int page, int
 	return dib;
 }
 
-template <class DECODER> static void 
-LoadDXT_Helper (FreeImageIO *io, fi_handle handle, int page, int flags, void *data, FIBITMAP *dib, int width, int height, int line) {
-	typedef typename DECODER::INFO INFO;
-	typedef typename INFO::Block Block;
-
-	Block *input_buffer = new(std::nothrow) Block[(width + 3) / 4];
-	if(!input_buffer) return;
-
-	int widthRest = (int) width & 3;
-	int heightRest = (int) height & 3;
-	int inputLine = (width + 3) / 4;
-	int y = 0;
+/**
+Reads the DX10 extended header and returns the block compression type of its format,
+or 0 if that is not supported
+*/
+static int
+GetDX10Type (FreeImageIO *io, fi_handle handle) {
+	DDSHEADER_DXT10 header;
+	if (io->read_proc (&header, sizeof(header), 1, handle) != 1) {
+		return 0;
+	}
+#ifdef FREEIMAGE_BIGENDIAN
+	SwapLong(&header.dxgiFormat);
+#endif
+	switch (header.dxgiFormat) {
+		case DXGI_FORMAT_BC1_TYPELESS:
+		case DXGI_FORMAT_BC1_UNORM:
+		case DXGI_FORMAT_BC1_UNORM_SRGB:
+			return 1;
+		case DXGI_FORMAT_BC2_TYPELESS:
+		case DXGI_FORMAT_BC2_UNORM:
+		case DXGI_FORMAT_BC2_UNORM_SRGB:
+			return 2;
+		case DXGI_FORMAT_BC3_TYPELESS:
+		case DXGI_FORMAT_BC3_UNORM:
+		case DXGI_FORMAT_BC3_UNORM_SRGB:
+			return 3;
+		case DXGI_FORMAT_BC4_TYPELESS:
+		case DXGI_FORMAT_BC4_UNORM:
+			return 4;
+		case DXGI_FORMAT_BC5_TYPELESS:
+		case DXGI_FORMAT_BC5_UNORM:
+			return 5;
+		case DXGI_FORMAT_BC7_TYPELESS:
+		case DXGI_FORMAT_BC7_UNORM:
+		case DXGI_FORMAT_BC7_UNORM_SRGB:
+			return 7;
+		default:
+			return 0;
+	}
+}
 
-	if (height >= 4) {
-		for (; y < height; y += 4) {
-			io->read_proc (input_buffer, sizeof (typename INFO::Block), inputLine, handle);
-			// TODO: probably need some endian work here
-			BYTE *pbSrc = (BYTE *)input_buffer;
-			BYTE *pbDst = FreeImage_GetScanLine (dib, height - y - 1);
+/**
+Skips the mip levels larger than needed for a requested size, so the smallest level 
+that is at least that large is read next. desc is updated to describe that level. 
+blockBytes is the size of a 4x4 block for block compressed surfaces, 0 for RGB ones.
+Returns the number of levels skipped.
+*/
+static int
+SkipMipLevels (DDSURFACEDESC2 &desc, int blockBytes, int requested_size, FreeImageIO *io, fi_handle handle) {
+	if ((requested_size <= 0) || !(desc.dwFlags & DDSD_MIPMAPCOUNT) || (desc.dwMipMapCount < 2)) {
+		return 0;
+	}
+	if (desc.ddsCaps.dwCaps2 & DDSCAPS2_VOLUME) {
+		// all depth slices of a level come before the next level
+		return 0;
+	}
 
-			if (width >= 4) {
-				for (int x = 0; x < width; x += 4) {
-					DecodeDXTBlock <DECODER> (pbDst, pbSrc,	line, 4, 4);
-					pbSrc += INFO::bytesPerBlock;
-					pbDst += 4 * 4;
-				}
-			}
-			if (widthRest) {
-				DecodeDXTBlock <DECODER> (pbDst, pbSrc, line, widthRest, 4);
-			}
+	unsigned width = desc.dwWidth;
+	unsigned height = desc.dwHeight;
+	long skip = 0;
+	int level = 0;
+	for (; level + 1 < (int)desc.dwMipMapCount; level++) {
+		const unsigned next_width = MAX(1U, width >> 1);
+		const unsigned next_height = MAX(1U, height >> 1);
+		if (MAX(next_width, next_height) < (unsigned)requested_size) {
+			break;
 		}
+		if (blockBytes) {
+			skip += (long)((width + 3) / 4) * (long)((height + 3) / 4) * blockBytes;
+		}
+		else if ((level == 0) && (desc.dwFlags & DDSD_PITCH)) {
+			skip += (long)desc.dwPitchOrLinearSize * (long)height;
+		}
+		else {
+			skip += (long)CalculateLine(width, desc.ddpfPixelFormat.dwRGBBitCount) * (long)height;
+		}
+		width = next_width;
+		height = next_height;
+	}
+	if (level) {
+		io->seek_proc (handle, skip, SEEK_CUR);
+		desc.dwWidth = width;
+		desc.dwHeight = height;
+		// the pitch is the one of the first level
+		desc.dwFlags &= ~DDSD_PITCH;
 	}
-	if (heightRest)	{
-		io->read_proc (input_buffer, sizeof (typename INFO::Block), inputLine, handle);
-		// TODO: probably need some endian work here
-		BYTE *pbSrc = (BYTE *)input_buffer;
-		BYTE *pbDst = FreeImage_GetScanLine (dib, height - y - 1);
-
-		if (width >= 4) {
-			for (int x = 0; x < width; x += 4) {
-				DecodeDXTBlock <DECODER> (pbDst, pbSrc,	line, 4, heightRest);
-				pbSrc += INFO::bytesPerBlock;
-				pbDst += 4 * 4;
+	return level;
+}
+
+template <class DECODER> static void
+DecodeBlockRow (const BYTE *src, BYTE *dst, long dstPitch, int width, int rows) {
+	for (int x = 0; x < width; x += 4, src += DECODER::bytesPerBlock) {
+		BYTE *pixel = dst + 4 * x;
+		if (rows == 4 && x + 4 <= width) {
+			// straight into the (upside down) scanlines
+			DECODER::Decode (src, pixel, -dstPitch);
+		}
+		else {
+			// clip blocks at the right and bottom edge
+			DWORD texels[16];
+			DECODER::Decode (src, (BYTE *)texels, 4 * sizeof(DWORD));
+			const int bw = MIN(4, width - x);
+			for (int y = 0; y < rows; y++, pixel -= dstPitch) {
+				memcpy(pixel, texels + 4 * y, bw * sizeof(DWORD));
 			}
 		}
-		if (widthRest) {
-			DecodeDXTBlock <DECODER> (pbDst, pbSrc,	line, widthRest, heightRest);
+	}
+}
+
+template <class DECODER> static void
+LoadDXT_Helper (FreeImageIO *io, fi_handle handle, FIBITMAP *dib, int width, int height) {
+	const int blocksPerRow = (width + 3) / 4;
+	const int blockRows = (height + 3) / 4;
+	const unsigned rowSize = blocksPerRow * DECODER::bytesPerBlock;
+	const int bandRows = MAX(1, (int)(DDS_BAND_SIZE / rowSize));
+
+	BYTE *input_buffer = new(std::nothrow) BYTE[MIN(bandRows, blockRows) * rowSize];
+	if(!input_buffer) return;
+
+	const long pitch = (long)FreeImage_GetPitch (dib);
+
+	// read bands of block rows, then decode the rows of a band in parallel
+	for (int first = 0; first < blockRows; first += bandRows) {
+		const int count = MIN(bandRows, blockRows - first);
+		const unsigned size = count * rowSize;
+		const unsigned got = (unsigned)io->read_proc (input_buffer, 1, size, handle);
+		if (got < size) {
+			// truncated file
+			memset(input_buffer + got, 0, size - got);
 		}
 
+#pragma omp parallel for
+		for (int i = 0; i < count; i++) {
+			const int y = (first + i) * 4;
+			BYTE *pbDst = FreeImage_GetScanLine (dib, height - y - 1);
+			DecodeBlockRow <DECODER> (input_buffer + i * rowSize, pbDst, pitch, width, MIN(4, height - y));
+		}
 	}
 
 	delete [] input_buffer;
@@ -498,28 +864,33 @@ LoadDXT_Helper (FreeImageIO *io, fi_handle handle, int page, int flags, void *da
 
 static FIBITMAP *
 LoadDXT (int type, DDSURFACEDESC2 &desc, FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
-	int width = (int)desc.dwWidth & ~3;
-	int height = (int)desc.dwHeight & ~3;
+	int width = (int)desc.dwWidth;
+	int height = (int)desc.dwHeight;
 
 	// allocate a 32-bit dib
 	FIBITMAP *dib = FreeImage_Allocate (width, height, 32, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
 	if (dib == NULL)
 		return NULL;
 
-	int bpp = FreeImage_GetBPP (dib);
-	int line = CalculateLine (width, bpp);
-	//BYTE *bits = FreeImage_GetBits (dib);
-
 	// select the right decoder
 	switch (type) {
 		case 1:
-			LoadDXT_Helper <DXT_BLOCKDECODER_1> (io, handle, page, flags, data, dib, width, height, line);
+			LoadDXT_Helper <DXT_BLOCKDECODER_BC1> (io, handle, dib, width, height);
+			break;
+		case 2:
+			LoadDXT_Helper <DXT_BLOCKDECODER_BC2> (io, handle, dib, width, height);
 			break;
 		case 3:
-			LoadDXT_Helper <DXT_BLOCKDECODER_3> (io, handle, page, flags, data, dib, width, height, line);
+			LoadDXT_Helper <DXT_BLOCKDECODER_BC3> (io, handle, dib, width, height);
+			break;
+		case 4:
+			LoadDXT_Helper <DXT_BLOCKDECODER_BC4> (io, handle, dib, width, height);
 			break;
 		case 5:
-			LoadDXT_Helper <DXT_BLOCKDECODER_5> (io, handle, page, flags, data, dib, width, height, line);
+			LoadDXT_Helper <DXT_BLOCKDECODER_BC5> (io, handle, dib, width, height);
+			break;
+		case 7:
+			LoadDXT_Helper <DXT_BLOCKDECODER_BC7> (io, handle, dib, width, height);
 			break;
 	}
 	
@@ -603,21 +974,51 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 #ifdef FREEIMAGE_BIGENDIAN
 	SwapHeader(&header);
 #endif
+	// with a requested size, load the smallest mip level that covers it
+	const int requested_size = flags >> 16;
+	const int width = (int)header.surfaceDesc.dwWidth;
+	const int height = (int)header.surfaceDesc.dwHeight;
+	int skipped = 0;
+
 	if (header.surfaceDesc.ddpfPixelFormat.dwFlags & DDPF_RGB) {
+		skipped = SkipMipLevels (header.surfaceDesc, 0, requested_size, io, handle);
 		dib = LoadRGB (header.surfaceDesc, io, handle, page, flags, data);
 	}
 	else if (header.surfaceDesc.ddpfPixelFormat.dwFlags & DDPF_FOURCC) {
+		// block compression type, BC1 to BC7
+		int type = 0;
 		switch (header.surfaceDesc.ddpfPixelFormat.dwFourCC) {
 			case FOURCC_DXT1:
-				dib = LoadDXT (1, header.surfaceDesc, io, handle, page, flags, data);
+				type = 1;
 				break;
+			case FOURCC_DXT2:	// premultiplied alpha, shown as is
 			case FOURCC_DXT3:
-				dib = LoadDXT (3, header.surfaceDesc, io, handle, page, flags, data);
+				type = 2;
 				break;
+			case FOURCC_DXT4:	// premultiplied alpha, shown as is
 			case FOURCC_DXT5:
-				dib = LoadDXT (5, header.surfaceDesc, io, handle, page, flags, data);
+				type = 3;
+				break;
+			case FOURCC_ATI1:
+			case FOURCC_BC4U:
+				type = 4;
+				break;
+			case FOURCC_ATI2:
+			case FOURCC_BC5U:
+				type = 5;
+				break;
+			case FOURCC_DX10:
+				type = GetDX10Type (io, handle);
 				break;
 		}
+		if (type) {
+			const int blockBytes = ((type == 1) || (type == 4)) ? 8 : 16;
+			skipped = SkipMipLevels (header.surfaceDesc, blockBytes, requested_size, io, handle);
+			dib = LoadDXT (type, header.surfaceDesc, io, handle, page, flags, data);
+		}
+	}
+	if (dib && skipped) {
+		StoreSizeInfo(dib, "DDS", width, height);
 	}
 	return dib;
 }
@@ -97,9 +97,18 @@ protected:
 	int firstPixelPassed; // A specific flag that indicates if the first pixel
 	                      // of the whole image had already been read
 
-	std::string m_strings[MAX_LZW_CODE]; //This is what is really the "string table" data for the Decompressor
+	//This is what is really the "string table" data for the Decompressor: every code is
+	//its prefix code plus one suffix byte, so strings never have to be copied around
+	WORD m_codePrefix[MAX_LZW_CODE];
+	BYTE m_codeSuffix[MAX_LZW_CODE];
+	BYTE m_codeFirst[MAX_LZW_CODE]; //first byte of the string, needed to extend the table
+	WORD m_codeLength[MAX_LZW_CODE];
 	int* m_strmap;
 
+	//tail of a string that did not fit into the output buffer last time
+	BYTE m_pending[MAX_LZW_CODE];
+	int m_pendingPos, m_pendingSize;
+
 	//input buffer
 	BYTE *m_buffer;
 	int m_bufferSize, m_bufferRealSize, m_bufferPos, m_bufferShift;
@@ -201,7 +210,8 @@ void StringTable::Initialize(int minCodeSize)
 	m_done = false;
 
 	m_bpp = 8;
-	m_minCodeSize = minCodeSize;
+	//codes are 12 bits at most, anything above is a broken file
+	m_minCodeSize = MIN(minCodeSize, 11);
 	m_clearCode = 1 << m_minCodeSize;
 	if(m_clearCode > MAX_LZW_CODE) {
 		m_clearCode = MAX_LZW_CODE;
@@ -210,6 +220,7 @@ void StringTable::Initialize(int minCodeSize)
 
 	m_partial = 0;
 	m_partialSize = 0;
+	m_pendingPos = m_pendingSize = 0;
 
 	m_bufferSize = 0;
 	ClearCompressorTable();
@@ -363,59 +374,110 @@ bool StringTable::Compress(BYTE *buf, int *len)
 
 bool StringTable::Decompress(BYTE *buf, int *len)
 {
-	if( m_bufferSize == 0 || m_done ) {
+	if( (m_bufferSize == 0 && m_pendingSize == 0) || m_done ) {
 		return false;
 	}
 
 	BYTE *bufpos = buf;
-	for( ; m_bufferPos < m_bufferSize; m_bufferPos++ ) {
-		m_partial |= (int)m_buffer[m_bufferPos] << m_partialSize;
-		m_partialSize += 8;
-		while( m_partialSize >= m_codeSize ) {
-			int code = m_partial & m_codeMask;
-			m_partial >>= m_codeSize;
-			m_partialSize -= m_codeSize;
-
-			if( code > m_nextCode || /*(m_nextCode == MAX_LZW_CODE && code != m_clearCode) || */code == m_endCode ) {
-				m_done = true;
-				*len = (int)(bufpos - buf);
-				return true;
-			}
-			if( code == m_clearCode ) {
-				ClearDecompressorTable();
-				continue;
+	BYTE *bufend = buf + *len;
+
+	//first finish the string we ran out of space for last time
+	if( m_pendingSize > 0 ) {
+		int n = MIN(m_pendingSize - m_pendingPos, *len);
+		memcpy(bufpos, m_pending + m_pendingPos, n);
+		bufpos += n;
+		m_pendingPos += n;
+		if( m_pendingPos == m_pendingSize ) {
+			m_pendingPos = m_pendingSize = 0;
+		}
+		if( bufpos == bufend ) {
+			*len = (int)(bufpos - buf);
+			return true;
+		}
+	}
+
+	for( ;; ) {
+		if( m_partialSize < m_codeSize ) {
+			if( m_bufferPos == m_bufferSize ) {
+				break;
 			}
+			m_partial |= (int)m_buffer[m_bufferPos++] << m_partialSize;
+			m_partialSize += 8;
+			continue;
+		}
+
+		int code = m_partial & m_codeMask;
+		m_partial >>= m_codeSize;
+		m_partialSize -= m_codeSize;
 
+		if( code > m_nextCode || /*(m_nextCode == MAX_LZW_CODE && code != m_clearCode) || */code == m_endCode ) {
+			m_done = true;
+			*len = (int)(bufpos - buf);
+			return true;
+		}
+		if( code == m_clearCode ) {
+			ClearDecompressorTable();
+			continue;
+		}
+
+		if( m_oldCode != MAX_LZW_CODE ) {
 			//add new string to string table, if not the first pass since a clear code
-			if( m_oldCode != MAX_LZW_CODE && m_nextCode < MAX_LZW_CODE) {
-				m_strings[m_nextCode] = m_strings[m_oldCode] + m_strings[code == m_nextCode ? m_oldCode : code][0];
+			if( m_nextCode < MAX_LZW_CODE ) {
+				m_codePrefix[m_nextCode] = (WORD)m_oldCode;
+				m_codeSuffix[m_nextCode] = m_codeFirst[code == m_nextCode ? m_oldCode : code];
+				m_codeFirst[m_nextCode] = m_codeFirst[m_oldCode];
+				m_codeLength[m_nextCode] = m_codeLength[m_oldCode] + 1;
 			}
+		} else if( code >= m_clearCode ) {
+			//the first code after a clear must be a root, anything else is garbage
+			m_done = true;
+			*len = (int)(bufpos - buf);
+			return true;
+		}
 
-			if( (int)m_strings[code].size() > *len - (bufpos - buf) ) {
-				//out of space, stuff the code back in for next time
-				m_partial <<= m_codeSize;
-				m_partialSize += m_codeSize;
-				m_partial |= code;
-				m_bufferPos++;
-				*len = (int)(bufpos - buf);
-				return true;
+		//output the string into the buffer, walking the chain from its last byte backwards
+		int length = m_codeLength[code];
+		if( length == 1 ) {
+			*bufpos++ = (BYTE)code;
+		} else {
+			BYTE *out = bufpos;
+			if( length > bufend - bufpos ) {
+				//out of space, keep the whole string around for next time
+				out = m_pending;
+			}
+			BYTE *p = out + length;
+			int c = code;
+			while( c >= m_clearCode ) {
+				*--p = m_codeSuffix[c];
+				c = m_codePrefix[c];
 			}
+			*--p = (BYTE)c;
 
-			//output the string into the buffer
-			memcpy(bufpos, m_strings[code].data(), m_strings[code].size());
-			bufpos += m_strings[code].size();
+			if( out == m_pending ) {
+				m_pendingPos = (int)(bufend - bufpos);
+				m_pendingSize = length;
+				memcpy(bufpos, m_pending, m_pendingPos);
+				bufpos = bufend;
+			} else {
+				bufpos += length;
+			}
+		}
 
-			//increment the next highest valid code, add a bit to the mask if we need to increase the code size
-			if( m_oldCode != MAX_LZW_CODE && m_nextCode < MAX_LZW_CODE ) {
-				if( ++m_nextCode < MAX_LZW_CODE ) {
-					if( (m_nextCode & m_codeMask) == 0 ) {
-						m_codeSize++;
-						m_codeMask |= m_nextCode;
-					}
+		//increment the next highest valid code, add a bit to the mask if we need to increase the code size
+		if( m_oldCode != MAX_LZW_CODE && m_nextCode < MAX_LZW_CODE ) {
+			if( ++m_nextCode < MAX_LZW_CODE ) {
+				if( (m_nextCode & m_codeMask) == 0 ) {
+					m_codeSize++;
+					m_codeMask |= m_nextCode;
 				}
 			}
+		}
 
-			m_oldCode = code;
+		m_oldCode = code;
+
+		if( bufpos == bufend ) {
+			*len = (int)(bufpos - buf);
+			return true;
 		}
 	}
 
@@ -444,8 +506,8 @@ void StringTable::ClearCompressorTable(void)
 void StringTable::ClearDecompressorTable(void)
 {
 	for( int i = 0; i < m_clearCode; i++ ) {
-		m_strings[i].resize(1);
-		m_strings[i][0] = (char)i;
+		m_codeSuffix[i] = m_codeFirst[i] = (BYTE)i;
+		m_codeLength[i] = 1;
 	}
 	m_nextCode = m_endCode + 1;
 
@@ -914,6 +976,32 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 		io->read_proc(&b, 1, 1, handle);
 		while( b ) {
 			io->read_proc(stringtable->FillInputBuffer(b), b, 1, handle);
+			if( bpp == 8 ) {
+				//decode straight into the scanlines
+				int size = width - x;
+				while( stringtable->Decompress(scanline + x, &size) ) {
+					x += size;
+					if( x >= width ) {
+						if( interlaced ) {
+							y += g_GifInterlaceIncrement[interlacepass];
+							if( y >= height && ++interlacepass < GIF_INTERLACE_PASSES ) {
+								y = g_GifInterlaceOffset[interlacepass];
+							} 						
+						} else {
+							y++;
+						}
+						if( y >= height ) {
+							stringtable->Done();
+							break;
+						}
+						x = 0;
+						scanline = FreeImage_GetScanLine(dib, height - y - 1);
+					}
+					size = width - x;
+				}
+				io->read_proc(&b, 1, 1, handle);
+				continue;
+			}
 			int size = sizeof(buf);
 			while( stringtable->Decompress(buf, &size) ) {
 				for( int i = 0; i < size; i++ ) {
@@ -37,6 +37,9 @@ static int s_format_id;
 // maximum size of a line in the header
 #define HDR_MAXLINE	256
 
+// bytes of pixel data read and decoded at once
+#define HDR_BAND_SIZE	(4 * 1024 * 1024)
+
 // flags indicating which fields in an rgbeHeaderInfo are valid
 #define RGBE_VALID_PROGRAMTYPE	0x01
 #define RGBE_VALID_COMMENT		0x02
@@ -83,12 +86,11 @@ typedef enum {
 static BOOL rgbe_Error(rgbe_error_code error_code, const char *msg);
 static BOOL rgbe_GetLine(FreeImageIO *io, fi_handle handle, char *buffer, int length);
 static inline void rgbe_FloatToRGBE(BYTE rgbe[4], FIRGBF *rgbf);
-static inline void rgbe_RGBEToFloat(FIRGBF *rgbf, BYTE rgbe[4]);
+static inline void rgbe_RGBEToFloat(FIRGBF *rgbf, const BYTE rgbe[4]);
 static BOOL rgbe_ReadHeader(FreeImageIO *io, fi_handle handle, unsigned *width, unsigned *height, rgbeHeaderInfo *header_info);
 static BOOL rgbe_WriteHeader(FreeImageIO *io, fi_handle handle, unsigned width, unsigned height, rgbeHeaderInfo *info);
-static BOOL rgbe_ReadPixels(FreeImageIO *io, fi_handle handle, FIRGBF *data, unsigned numpixels);
 static BOOL rgbe_WritePixels(FreeImageIO *io, fi_handle handle, FIRGBF *data, unsigned numpixels);
-static BOOL rgbe_ReadPixels_RLE(FreeImageIO *io, fi_handle handle, FIRGBF *data, int scanline_width, unsigned num_scanlines);
+static BOOL rgbe_ReadPixels_RLE(FreeImageIO *io, fi_handle handle, FIBITMAP *dib, int scanline_width, unsigned num_scanlines);
 static BOOL rgbe_WriteBytes_RLE(FreeImageIO *io, fi_handle handle, BYTE *data, int numbytes);
 static BOOL rgbe_WritePixels_RLE(FreeImageIO *io, fi_handle handle, FIRGBF *data, unsigned scanline_width, unsigned num_scanlines);
 static BOOL rgbe_ReadMetadata(FIBITMAP *dib, rgbeHeaderInfo *header_info);
@@ -160,22 +162,63 @@ rgbe_FloatToRGBE(BYTE rgbe[4], FIRGBF *rgbf) {
 	}
 }
 
+/**
+Scale factors for each exponent, ldexp(1.0, exp - (128+8)), 0 for a zero exponent. 
+Filled by InitHDR.
+*/
+static float s_rgbe_exponent[256];
+
 /**
 Standard conversion from rgbe to float pixels. 
 Note: Ward uses ldexp(col+0.5,exp-(128+8)). 
 However we wanted pixels in the range [0,1] to map back into the range [0,1].
 */
 static inline void 
-rgbe_RGBEToFloat(FIRGBF *rgbf, BYTE rgbe[4]) {
-	if (rgbe[3]) {   // nonzero pixel
-		float f = (float)(ldexp(1.0, rgbe[3] - (int)(128+8)));
-		rgbf->red   = rgbe[0] * f;
-		rgbf->green = rgbe[1] * f;
-		rgbf->blue  = rgbe[2] * f;
+rgbe_RGBEToFloat(FIRGBF *rgbf, const BYTE rgbe[4]) {
+	const float f = s_rgbe_exponent[rgbe[3]];
+	rgbf->red   = rgbe[0] * f;
+	rgbf->green = rgbe[1] * f;
+	rgbf->blue  = rgbe[2] * f;
+}
 
+/**
+Conversion of a scanline held as separate r, g, b and e planes 
+*/
+static void 
+rgbe_PlanesToFloat(FIRGBF *data, const BYTE *planes, int scanline_width) {
+	const BYTE *r = planes;
+	const BYTE *g = r + scanline_width;
+	const BYTE *b = g + scanline_width;
+	const BYTE *e = b + scanline_width;
+	int i = 0;
+#ifdef FI_SSE2
+	// 4 pixels at a time, then from planar back to r,g,b triples
+	const __m128i zero = _mm_setzero_si128();
+	float *dst = (float*)data;
+	for(; i + 4 <= scanline_width; i += 4, dst += 12) {
+		__m128 R = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(*(const int*)(r + i)), zero), zero));
+		__m128 G = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(*(const int*)(g + i)), zero), zero));
+		__m128 B = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(*(const int*)(b + i)), zero), zero));
+		const __m128 F = _mm_setr_ps(s_rgbe_exponent[e[i]], s_rgbe_exponent[e[i+1]], s_rgbe_exponent[e[i+2]], s_rgbe_exponent[e[i+3]]);
+		R = _mm_mul_ps(R, F);
+		G = _mm_mul_ps(G, F);
+		B = _mm_mul_ps(B, F);
+		const __m128 rg_lo = _mm_unpacklo_ps(R, G);	// r0 g0 r1 g1
+		const __m128 rg_hi = _mm_unpackhi_ps(R, G);	// r2 g2 r3 g3
+		const __m128 gb_lo = _mm_unpacklo_ps(G, B);	// g0 b0 g1 b1
+		const __m128 gb_hi = _mm_unpackhi_ps(G, B);	// g2 b2 g3 b3
+		const __m128 br_lo = _mm_unpacklo_ps(B, R);	// b0 r0 b1 r1
+		const __m128 br_hi = _mm_unpackhi_ps(B, R);	// b2 r2 b3 r3
+		_mm_storeu_ps(dst + 0, _mm_shuffle_ps(rg_lo, br_lo, _MM_SHUFFLE(3, 0, 1, 0)));	// r0 g0 b0 r1
+		_mm_storeu_ps(dst + 4, _mm_shuffle_ps(gb_lo, rg_hi, _MM_SHUFFLE(1, 0, 3, 2)));	// g1 b1 r2 g2
+		_mm_storeu_ps(dst + 8, _mm_shuffle_ps(br_hi, gb_hi, _MM_SHUFFLE(3, 2, 3, 0)));	// b2 r3 g3 b3
 	}
-	else {
-		rgbf->red = rgbf->green = rgbf->blue = 0;
+#endif // FI_SSE2
+	for(; i < scanline_width; i++) {
+		const float f = s_rgbe_exponent[e[i]];
+		data[i].red   = r[i] * f;
+		data[i].green = g[i] * f;
+		data[i].blue  = b[i] * f;
 	}
 }
 
@@ -312,23 +355,6 @@ rgbe_WriteMetadata(FIBITMAP *dib, rgbeHeaderInfo *header_info) {
 	return TRUE;
 }
 
-/** 
-Simple read routine. Will not correctly handle run length encoding 
-*/
-static BOOL 
-rgbe_ReadPixels(FreeImageIO *io, fi_handle handle, FIRGBF *data, unsigned numpixels) {
-  BYTE rgbe[4];
-
-  for(unsigned x = 0; x < numpixels; x++) {
-	if(io->read_proc(rgbe, 1, sizeof(rgbe), handle) < 1) {
-		return rgbe_Error(rgbe_read_error, NULL);
-	}
-	rgbe_RGBEToFloat(&data[x], rgbe);
-  }
-
-  return TRUE;
-}
-
 /**
  Simple write routine that does not use run length encoding. 
  These routines can be made faster by allocating a larger buffer and
@@ -347,94 +373,191 @@ rgbe_WritePixels(FreeImageIO *io, fi_handle handle, FIRGBF *data, unsigned numpi
   return TRUE;
 }
 
-static BOOL 
-rgbe_ReadPixels_RLE(FreeImageIO *io, fi_handle handle, FIRGBF *data, int scanline_width, unsigned num_scanlines) {
-	BYTE rgbe[4], *scanline_buffer, *ptr, *ptr_end;
-	int i, count;
-	BYTE buf[2];
-	
-	if ((scanline_width < 8)||(scanline_width > 0x7fff)) {
-		// run length encoding is not allowed so read flat
-		return rgbe_ReadPixels(io, handle, data, scanline_width * num_scanlines);
-	}
-	scanline_buffer = NULL;
-	// read in each successive scanline 
-	while(num_scanlines > 0) {
-		if(io->read_proc(rgbe, 1, sizeof(rgbe), handle) < 1) {
-			free(scanline_buffer);
-			return rgbe_Error(rgbe_read_error,NULL);
+/**
+Returns TRUE if a scanline starts with a run length encoding header. 
+Scanlines without it hold flat r,g,b,e pixels.
+*/
+static inline BOOL 
+rgbe_IsScanlineRLE(const BYTE *line, int scanline_width) {
+	// run length encoding is not allowed for too short or too long scanlines
+	return (scanline_width >= 8) && (scanline_width <= 0x7fff) && 
+		(line[0] == 2) && (line[1] == 2) && !(line[2] & 0x80);
+}
+
+/**
+Finds the end of the scanline at line, without decoding it. 
+@return Returns the size in bytes of the scanline, 0 if it does not fit into size, 
+or -1 for a bad scanline
+*/
+static long 
+rgbe_ScanLine(const BYTE *line, size_t size, int scanline_width) {
+	if(size < 4) {
+		return 0;
+	}
+	if(!rgbe_IsScanlineRLE(line, scanline_width)) {
+		const size_t flat_size = 4 * (size_t)scanline_width;
+		return (size >= flat_size) ? (long)flat_size : 0;
+	}
+	if((((int)line[2]) << 8 | line[3]) != scanline_width) {
+		rgbe_Error(rgbe_format_error, "wrong scanline width");
+		return -1;
+	}
+	// walk the packet headers of the four channels
+	size_t pos = 4;
+	for(int i = 0; i < 4; i++) {
+		int filled = 0;
+		while(filled < scanline_width) {
+			if(pos >= size) {
+				return 0;
+			}
+			int count = line[pos];
+			if(count > 128) {
+				// a run of the same value
+				count -= 128;
+				pos += 2;
+			}
+			else {
+				// a non-run
+				pos += 1 + count;
+			}
+			if((count == 0) || (count > scanline_width - filled)) {
+				rgbe_Error(rgbe_format_error, "bad scanline data");
+				return -1;
+			}
+			filled += count;
 		}
-		if((rgbe[0] != 2) || (rgbe[1] != 2) || (rgbe[2] & 0x80)) {
-			// this file is not run length encoded
-			rgbe_RGBEToFloat(data, rgbe);
-			data ++;
-			free(scanline_buffer);
-			return rgbe_ReadPixels(io, handle, data, scanline_width * num_scanlines - 1);
+	}
+	return (pos <= size) ? (long)pos : 0;
+}
+
+/**
+Decodes a scanline found by rgbe_ScanLine. 
+planes is a buffer of 4 * scanline_width bytes for the channels of the scanline.
+*/
+static void 
+rgbe_DecodeScanline(const BYTE *line, int scanline_width, BYTE *planes, FIRGBF *data) {
+	if(!rgbe_IsScanlineRLE(line, scanline_width)) {
+		for(int i = 0; i < scanline_width; i++, line += 4) {
+			rgbe_RGBEToFloat(&data[i], line);
 		}
-		if((((int)rgbe[2]) << 8 | rgbe[3]) != scanline_width) {
-			free(scanline_buffer);
-			return rgbe_Error(rgbe_format_error,"wrong scanline width");
+		return;
+	}
+	// each of the four channels, the packets were checked by rgbe_ScanLine
+	line += 4;
+	BYTE *ptr = planes;
+	BYTE *ptr_end = planes + 4 * scanline_width;
+	while(ptr < ptr_end) {
+		int count = *line++;
+		if(count > 128) {
+			// a run of the same value
+			count -= 128;
+			memset(ptr, *line++, count);
 		}
-		if(scanline_buffer == NULL) {
-			scanline_buffer = (BYTE*)malloc(sizeof(BYTE) * 4 * scanline_width);
-			if(scanline_buffer == NULL) {
-				return rgbe_Error(rgbe_memory_error, "unable to allocate buffer space");
-			}
+		else {
+			// a non-run
+			memcpy(ptr, line, count);
+			line += count;
 		}
-		
-		ptr = &scanline_buffer[0];
-		// read each of the four channels for the scanline into the buffer
-		for(i = 0; i < 4; i++) {
-			ptr_end = &scanline_buffer[(i+1)*scanline_width];
-			while(ptr < ptr_end) {
-				if(io->read_proc(buf, 1, 2 * sizeof(BYTE), handle) < 1) {
-					free(scanline_buffer);
-					return rgbe_Error(rgbe_read_error, NULL);
-				}
-				if(buf[0] > 128) {
-					// a run of the same value
-					count = buf[0] - 128;
-					if((count == 0) || (count > ptr_end - ptr)) {
-						free(scanline_buffer);
-						return rgbe_Error(rgbe_format_error, "bad scanline data");
-					}
-					while(count-- > 0)
-						*ptr++ = buf[1];
+		ptr += count;
+	}
+	rgbe_PlanesToFloat(data, planes, scanline_width);
+}
+
+/**
+Reads the pixels of all scanlines, from top to bottom. 
+Bands of the file are read at once, the scanlines found in a band are then 
+decoded in parallel.
+*/
+static BOOL 
+rgbe_ReadPixels_RLE(FreeImageIO *io, fi_handle handle, FIBITMAP *dib, int scanline_width, unsigned num_scanlines) {
+	// a run length encoded scanline takes at most 2 bytes per channel and pixel
+	const size_t max_line = 4 + 8 * (size_t)scanline_width;
+	const size_t band_size = MAX((size_t)HDR_BAND_SIZE, 2 * max_line);
+
+	BYTE *band = (BYTE*)malloc(band_size);
+	long *line_start = (long*)malloc(num_scanlines * sizeof(long));
+	if(!band || !line_start) {
+		free(band);
+		free(line_start);
+		return rgbe_Error(rgbe_memory_error, "unable to allocate buffer space");
+	}
+
+	const unsigned pitch = FreeImage_GetPitch(dib);
+	BYTE *first_line = FreeImage_GetScanLine(dib, num_scanlines - 1);
+
+	BOOL bResult = TRUE;
+	BOOL bOutOfMemory = FALSE;
+	BOOL bEOF = FALSE;
+	size_t avail = 0;
+	unsigned y = 0;
+
+	while(y < num_scanlines) {
+		// fill up the band
+		if(!bEOF) {
+			const size_t wanted = band_size - avail;
+			const size_t got = io->read_proc(band + avail, 1, (unsigned)wanted, handle);
+			bEOF = (got < wanted);
+			avail += got;
+		}
+
+		// find the scanlines that are complete
+		size_t pos = 0;
+		int count = 0;
+		while(y + count < num_scanlines) {
+			const long length = rgbe_ScanLine(band + pos, avail - pos, scanline_width);
+			if(length <= 0) {
+				if(length < 0) {
+					bResult = FALSE;
 				}
-				else {
-					// a non-run
-					count = buf[0];
-					if((count == 0) || (count > ptr_end - ptr)) {
-						free(scanline_buffer);
-						return rgbe_Error(rgbe_format_error, "bad scanline data");
-					}
-					*ptr++ = buf[1];
-					if(--count > 0) {
-						if(io->read_proc(ptr, 1, sizeof(BYTE) * count, handle) < 1) {
-							free(scanline_buffer);
-							return rgbe_Error(rgbe_read_error, NULL);
-						}
-						ptr += count;
-					}
+				break;
+			}
+			line_start[count++] = (long)pos;
+			pos += length;
+		}
+		if(count == 0) {
+			if(bResult) {
+				bResult = rgbe_Error(rgbe_read_error, NULL);
+			}
+			break;
+		}
+
+#pragma omp parallel
+		{
+			// per thread channel planes
+			BYTE *planes = (BYTE*)malloc(4 * scanline_width);
+			if(!planes) {
+				bOutOfMemory = TRUE;
+			}
+
+#pragma omp for
+			for(int i = 0; i < count; i++) {
+				if(!planes) {
+					continue;
 				}
+				FIRGBF *data = (FIRGBF*)(first_line - (size_t)(y + i) * pitch);
+				rgbe_DecodeScanline(band + line_start[i], scanline_width, planes, data);
 			}
+
+			free(planes);
 		}
-		// now convert data from buffer into floats
-		for(i = 0; i < scanline_width; i++) {
-			rgbe[0] = scanline_buffer[i];
-			rgbe[1] = scanline_buffer[i+scanline_width];
-			rgbe[2] = scanline_buffer[i+2*scanline_width];
-			rgbe[3] = scanline_buffer[i+3*scanline_width];
-			rgbe_RGBEToFloat(data, rgbe);
-			data ++;
+		if(bOutOfMemory) {
+			bResult = rgbe_Error(rgbe_memory_error, "unable to allocate buffer space");
+			break;
+		}
+		if(!bResult) {
+			break;
 		}
 
-		num_scanlines--;
+		// keep the incomplete scanline for the next band
+		y += count;
+		avail -= pos;
+		memmove(band, band + pos, avail);
 	}
 
-	free(scanline_buffer);
-	
-	return TRUE;
+	free(line_start);
+	free(band);
+
+	return bResult;
 }
 
 /**
@@ -637,13 +760,9 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 		}
 
 		// read the image pixels and fill the dib
-		
-		for(unsigned y = 0; y < height; y++) {
-			FIRGBF *scanline = (FIRGBF*)FreeImage_GetScanLine(dib, height - 1 - y);
-			if(!rgbe_ReadPixels_RLE(io, handle, scanline, width, 1)) {
-				FreeImage_Unload(dib);
-				return NULL;
-			}
+		if(!rgbe_ReadPixels_RLE(io, handle, dib, width, height)) {
+			FreeImage_Unload(dib);
+			return NULL;
 		}
 
 	}
@@ -702,6 +821,11 @@ void DLL_CALLCONV
 InitHDR(Plugin *plugin, int format_id) {
 	s_format_id = format_id;
 
+	s_rgbe_exponent[0] = 0;
+	for(int i = 1; i < 256; i++) {
+		s_rgbe_exponent[i] = (float)(ldexp(1.0, i - (int)(128+8)));
+	}
+
 	plugin->format_proc = Format;
 	plugin->description_proc = Description;
 	plugin->extension_proc = Extension;
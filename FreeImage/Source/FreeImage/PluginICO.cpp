@@ -378,8 +378,65 @@ LoadStandardIcon(FreeImageIO *io, fi_handle handle, int flags, BOOL header_only)
 	return dib;
 }
 
+/**
+Find the icon that suits a requested size best, from the directory alone: the smallest one 
+at least that large, or the largest one when none is. Among icons of the same size, the 
+deepest colors win.
+*/
+static int
+SelectIcon(const ICONDIRENTRY *icon_list, int count, int requested_size) {
+	int best = 0;
+	int best_size = 0, best_depth = 0;
+	for(int i = 0; i < count; i++) {
+		// a width or height of 0 means 256
+		const int width = icon_list[i].bWidth ? icon_list[i].bWidth : 256;
+		const int height = icon_list[i].bHeight ? icon_list[i].bHeight : 256;
+		const int size = MAX(width, height);
+		int depth = icon_list[i].wBitCount;
+		if(!depth) {
+			// older writers only fill in the number of colors
+			depth = (icon_list[i].bColorCount == 2) ? 1 : (icon_list[i].bColorCount == 16) ? 4 : 8;
+		}
+
+		BOOL better = FALSE;
+		if(i == 0) {
+			better = TRUE;
+		} else if(size == best_size) {
+			better = (depth > best_depth);
+		} else if(best_size < requested_size) {
+			// anything larger is an improvement
+			better = (size > best_size);
+		} else {
+			// the smallest one that is still large enough
+			better = (size >= requested_size) && (size < best_size);
+		}
+		if(better) {
+			best = i;
+			best_size = size;
+			best_depth = depth;
+		}
+	}
+	return best;
+}
+
+/**
+Check for a PNG stream at the current position, without moving it
+*/
+static BOOL
+IsPNGIcon(FreeImageIO *io, fi_handle handle) {
+	static const BYTE png_signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+	BYTE signature[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+	const long start = io->tell_proc(handle);
+	io->read_proc(signature, 1, sizeof(signature), handle);
+	io->seek_proc(handle, start, SEEK_SET);
+	return (memcmp(signature, png_signature, sizeof(png_signature)) == 0) ? TRUE : FALSE;
+}
+
 static FIBITMAP * DLL_CALLCONV
 Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
+	// without a page, a requested size in the upper 16 bits selects the icon
+	const int requested_size = flags >> 16;
+	const BOOL select = (page == -1) && (requested_size > 0);
 	if (page == -1) {
 		page = 0;
 	}
@@ -404,15 +461,19 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 			SwapIconDirEntries(icon_list, icon_header->idCount);
 #endif
 
+			if (select) {
+				page = SelectIcon(icon_list, icon_header->idCount, requested_size);
+			}
+
 			// load the requested icon
 			if (page < icon_header->idCount) {
 				// seek to the start of the bitmap data for the icon
 				io->seek_proc(handle, 0, SEEK_SET);
 				io->seek_proc(handle, icon_list[page].dwImageOffset, SEEK_CUR);
 
-				if((icon_list[page].bWidth == 0) && (icon_list[page].bHeight == 0)) {
+				if(IsPNGIcon(io, handle)) {
 					// Vista icon support
-					dib = FreeImage_LoadFromHandle(FIF_PNG, io, handle, header_only ? FIF_LOAD_NOPIXELS : PNG_DEFAULT);
+					dib = FreeImage_LoadFromHandle(FreeImage_GetFIFFromFormat("PNG"), io, handle, header_only ? FIF_LOAD_NOPIXELS : PNG_DEFAULT);
 				}
 				else {
 					// standard icon support
@@ -734,7 +795,7 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 			
 			if((icon_list[k].bWidth == 0) && (icon_list[k].bHeight == 0)) {
 				// Vista icon support
-				FreeImage_SaveToHandle(FIF_PNG, icon_dib, io, handle, PNG_DEFAULT);
+				FreeImage_SaveToHandle(FreeImage_GetFIFFromFormat("PNG"), icon_dib, io, handle, PNG_DEFAULT);
 			}
 			else {
 				// standard icon support
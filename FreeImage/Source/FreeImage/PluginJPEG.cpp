@@ -62,6 +62,8 @@ static int s_format_id;
 #define EXIF_MARKER		(JPEG_APP0+1)	// EXIF marker / Adobe XMP marker
 #define ICC_MARKER		(JPEG_APP0+2)	// ICC profile marker
 #define IPTC_MARKER		(JPEG_APP0+13)	// IPTC marker / BIM marker 
+#define SOI_MARKER		0xD8			// start of image
+#define SOS_MARKER		0xDA			// start of scan
 
 #define ICC_HEADER_SIZE 14				// size of non-profile data in APP2
 #define MAX_BYTES_IN_MARKER 65533L		// maximum data length of a JPEG marker
@@ -69,6 +71,9 @@ static int s_format_id;
 
 #define MAX_JFXX_THUMB_SIZE (MAX_BYTES_IN_MARKER - 5 - 1)
 
+#define JPEG_BAND_ROWS	16		// minimum # of MCU rows decoded by one restart band
+#define JPEG_STRIP_ROWS	32		// # of decoded rows transposed at once for Exif rotation
+
 #define JFXX_TYPE_JPEG 	0x10	// JFIF extension marker: JPEG-compressed thumbnail image
 #define JFXX_TYPE_8bit 	0x11	// JFIF extension marker: palette thumbnail image
 #define JFXX_TYPE_24bit	0x13	// JFIF extension marker: RGB thumbnail image
@@ -106,6 +111,43 @@ typedef struct tagDestinationManager {
 	JOCTET * buffer;
 } DestinationManager;
 
+typedef struct tagOrientedWriter {
+	/// destination, allocated in display orientation
+	FIBITMAP *dib;
+	/// Exif orientation, 1 to 8
+	int orientation;
+	/// size of the decoded image and bytes per pixel
+	unsigned width, height, bytespp;
+	/// decoded rows waiting to be stored (orientation 2, 3 and 5 to 8)
+	BYTE *strip;
+	/// capacity of the strip, first decoded row in it and # of rows in it
+	unsigned strip_rows, strip_first, strip_count;
+} OrientedWriter;
+
+typedef struct tagRestartIndex {
+	/// whole JPEG stream
+	const BYTE *data;
+	/// # of bytes up to and including the SOS segment
+	size_t header_size;
+	/// # of entropy-coded segments
+	unsigned count;
+	/// start of each segment, followed by the offset of the marker ending the scan
+	size_t *start;
+} RestartIndex;
+
+typedef struct tagBandSourceManager {
+	/// public fields
+	struct jpeg_source_mgr pub;
+	/// entropy-coded segments of the stream
+	const RestartIndex *index;
+	/// first and last + 1 segment of the band
+	unsigned first, last;
+	/// next piece to hand out: header, then segment data and marker in turn
+	unsigned piece;
+	/// RSTn or EOI marker following a segment
+	JOCTET marker[2];
+} BandSourceManager;
+
 typedef SourceManager*		freeimage_src_ptr;
 typedef DestinationManager* freeimage_dst_ptr;
 typedef ErrorManager*		freeimage_error_ptr;
@@ -169,6 +211,15 @@ jpeg_output_message (j_common_ptr cinfo) {
 	FreeImage_OutputMessageProc(s_format_id, buffer);
 }
 
+/**
+	Output of JPEG messages of a band decoder: nothing is sent, as bands run
+	on several threads at once. A band with an error or a warning makes the
+	caller decode the image serially, which reports them once.
+*/
+METHODDEF(void)
+jpeg_band_output_message (j_common_ptr cinfo) {
+}
+
 // ----------------------------------------------------------
 //   Destination manager
 // ----------------------------------------------------------
@@ -332,7 +383,7 @@ skip_input_data (j_decompress_ptr cinfo, long num_bytes) {
 		while (num_bytes > (long) src->pub.bytes_in_buffer) {
 		  num_bytes -= (long) src->pub.bytes_in_buffer;
 
-		  (void) fill_input_buffer(cinfo);
+		  (void) (*src->pub.fill_input_buffer) (cinfo);
 
 		  /* note we assume that fill_input_buffer will never return FALSE,
 		   * so suspension need not be handled.
@@ -1053,36 +1104,480 @@ write_markers(j_compress_ptr cinfo, FIBITMAP *dib) {
 }
 
 // ------------------------------------------------------------
-//   Keep original size info when using scale option on loading
+//   Exif orientation applied while decoding
 // ------------------------------------------------------------
-static void 
-store_size_info(FIBITMAP *dib, JDIMENSION width, JDIMENSION height) {
-	char buffer[256];
-	// create a tag
-	FITAG *tag = FreeImage_CreateTag();
-	if(tag) {
-		size_t length = 0;
-		// set the original width
-		sprintf(buffer, "%d", (int)width);
-		length = strlen(buffer) + 1;	// include the NULL/0 value
-		FreeImage_SetTagKey(tag, "OriginalJPEGWidth");
-		FreeImage_SetTagLength(tag, (DWORD)length);
-		FreeImage_SetTagCount(tag, (DWORD)length);
-		FreeImage_SetTagType(tag, FIDT_ASCII);
-		FreeImage_SetTagValue(tag, buffer);
-		FreeImage_SetMetadata(FIMD_COMMENTS, dib, FreeImage_GetTagKey(tag), tag);
-		// set the original height
-		sprintf(buffer, "%d", (int)height);
-		length = strlen(buffer) + 1;	// include the NULL/0 value
-		FreeImage_SetTagKey(tag, "OriginalJPEGHeight");
-		FreeImage_SetTagLength(tag, (DWORD)length);
-		FreeImage_SetTagCount(tag, (DWORD)length);
-		FreeImage_SetTagType(tag, FIDT_ASCII);
-		FreeImage_SetTagValue(tag, buffer);
-		FreeImage_SetMetadata(FIMD_COMMENTS, dib, FreeImage_GetTagKey(tag), tag);
-		// destroy the tag
-		FreeImage_DeleteTag(tag);
+
+static inline WORD
+exif_get_short(const BYTE *p, BOOL msb_order) {
+	return msb_order ? (WORD)((p[0] << 8) | p[1]) : (WORD)((p[1] << 8) | p[0]);
+}
+
+static inline DWORD
+exif_get_long(const BYTE *p, BOOL msb_order) {
+	return msb_order ?
+		((DWORD)p[0] << 24) | ((DWORD)p[1] << 16) | ((DWORD)p[2] << 8) | p[3] :
+		((DWORD)p[3] << 24) | ((DWORD)p[2] << 16) | ((DWORD)p[1] << 8) | p[0];
+}
+
+/**
+	Read the Exif orientation from IFD0 of the saved APP1 markers,
+	before the markers are attached to the dib.
+	@return Returns the orientation in range [1..8], 1 if there is none
+*/
+static int
+jpeg_read_exif_orientation(j_decompress_ptr cinfo) {
+	// Exif signature is "Exif" followed by 2 bytes set to 0
+	static const BYTE exif_signature[6] = { 0x45, 0x78, 0x69, 0x66, 0x00, 0x00 };
+
+	for (jpeg_saved_marker_ptr marker = cinfo->marker_list; marker != NULL; marker = marker->next) {
+		if ((marker->marker != EXIF_MARKER) || (marker->data_length < sizeof(exif_signature) + 8) ||
+			(memcmp(marker->data, exif_signature, sizeof(exif_signature)) != 0)) {
+			continue;
+		}
+
+		const BYTE *tiff = marker->data + sizeof(exif_signature);
+		const DWORD length = marker->data_length - sizeof(exif_signature);
+
+		BOOL msb_order;
+		if ((tiff[0] == 'I') && (tiff[1] == 'I')) {
+			msb_order = FALSE;
+		} else if ((tiff[0] == 'M') && (tiff[1] == 'M')) {
+			msb_order = TRUE;
+		} else {
+			return 1;
+		}
+
+		const DWORD ifd = exif_get_long(tiff + 4, msb_order);
+		if ((ifd < 8) || (ifd > length - 2)) {
+			return 1;
+		}
+		const unsigned count = exif_get_short(tiff + ifd, msb_order);
+		for (unsigned i = 0; i < count; i++) {
+			const DWORD entry = ifd + 2 + 12 * i;
+			if (entry + 12 > length) {
+				break;
+			}
+			// TAG_ORIENTATION, stored as a SHORT
+			if ((exif_get_short(tiff + entry, msb_order) == 0x0112) && (exif_get_short(tiff + entry + 2, msb_order) == 3)) {
+				const int orientation = exif_get_short(tiff + entry + 8, msb_order);
+				return ((orientation >= 1) && (orientation <= 8)) ? orientation : 1;
+			}
+		}
+		return 1;
+	}
+
+	return 1;
+}
+
+/**
+	Place decoded scanlines into a dib allocated in display orientation.
+	Flipped rows go straight into their destination scanline; mirrored rows
+	are reversed from a one row buffer. For the orientations that swap
+	width and height, rows are collected into a strip of JPEG_STRIP_ROWS
+	and transposed strip by strip, so that every destination scanline
+	receives a contiguous run of pixels at a time.
+*/
+static void
+oriented_init(OrientedWriter *writer, j_common_ptr cinfo, FIBITMAP *dib, int orientation, unsigned width, unsigned height, unsigned bytespp) {
+	writer->dib = dib;
+	writer->orientation = orientation;
+	writer->width = width;
+	writer->height = height;
+	writer->bytespp = bytespp;
+	writer->strip_rows = (orientation >= 5) ? JPEG_STRIP_ROWS : (((orientation == 2) || (orientation == 3)) ? 1 : 0);
+	writer->strip_first = 0;
+	writer->strip_count = 0;
+	writer->strip = NULL;
+	if (writer->strip_rows) {
+		// released along with the decompressor
+		writer->strip = (BYTE*) (*cinfo->mem->alloc_large)
+			(cinfo, JPOOL_IMAGE, (size_t)writer->strip_rows * width * bytespp);
+	}
+}
+
+/**
+	Return the buffer receiving the decoded scanline y
+*/
+static BYTE*
+oriented_row(OrientedWriter *writer, unsigned y) {
+	switch (writer->orientation) {
+		case 1:
+			return FreeImage_GetScanLine(writer->dib, writer->height - 1 - y);
+		case 4:
+			return FreeImage_GetScanLine(writer->dib, y);
+		default:
+			if (writer->strip_count == 0) {
+				writer->strip_first = y;
+			}
+			return writer->strip + (size_t)writer->strip_count * writer->width * writer->bytespp;
+	}
+}
+
+/**
+	Store the rows collected in the strip
+*/
+static void
+oriented_flush(OrientedWriter *writer) {
+	const unsigned count = writer->strip_count;
+	if (count == 0) {
+		return;
+	}
+	writer->strip_count = 0;
+
+	const unsigned width = writer->width;
+	const unsigned bytespp = writer->bytespp;
+	const size_t line = (size_t)width * bytespp;
+	const int orientation = writer->orientation;
+
+	if (orientation < 5) {
+		// mirror the row
+		const unsigned y = writer->strip_first;
+		const BYTE *src = writer->strip;
+		BYTE *dst = FreeImage_GetScanLine(writer->dib, (orientation == 2) ? writer->height - 1 - y : y) + line - bytespp;
+		for (unsigned x = 0; x < width; x++) {
+			for (unsigned k = 0; k < bytespp; k++) {
+				dst[k] = src[k];
+			}
+			src += bytespp;
+			dst -= bytespp;
+		}
+		return;
+	}
+
+	// transpose the strip: decoded column x becomes destination row x (5, 6)
+	// or width - 1 - x (7, 8), decoded rows become columns left to right (5, 8)
+	// or right to left (6, 7)
+	const BOOL reverse = (orientation == 6) || (orientation == 7);
+	const unsigned first_column = reverse ? writer->height - (writer->strip_first + count) : writer->strip_first;
+	const unsigned pitch = FreeImage_GetPitch(writer->dib);
+	BYTE *bits = FreeImage_GetBits(writer->dib);
+
+	for (unsigned x = 0; x < width; x++) {
+		const unsigned v = ((orientation == 5) || (orientation == 6)) ? x : width - 1 - x;
+		BYTE *dst = bits + (size_t)(width - 1 - v) * pitch + (size_t)first_column * bytespp;
+		const BYTE *src = writer->strip + (size_t)x * bytespp;
+		if (reverse) {
+			src += (size_t)(count - 1) * line;
+		}
+		const ptrdiff_t step = reverse ? -(ptrdiff_t)line : (ptrdiff_t)line;
+
+		switch (bytespp) {
+			case 1:
+				for (unsigned i = 0; i < count; i++, src += step) {
+					dst[i] = src[0];
+				}
+				break;
+			case 3:
+				for (unsigned i = 0; i < count; i++, src += step, dst += 3) {
+					dst[0] = src[0];
+					dst[1] = src[1];
+					dst[2] = src[2];
+				}
+				break;
+			default:
+				for (unsigned i = 0; i < count; i++, src += step, dst += bytespp) {
+					memcpy(dst, src, bytespp);
+				}
+				break;
+		}
+	}
+}
+
+/**
+	Called after each decoded scanline
+*/
+static void
+oriented_commit(OrientedWriter *writer) {
+	if (writer->strip_rows) {
+		if (++writer->strip_count == writer->strip_rows) {
+			oriented_flush(writer);
+		}
+	}
+}
+
+// ------------------------------------------------------------
+//   Restart interval decoding
+// ------------------------------------------------------------
+
+/**
+	Hand out the next piece of a band: the stream header, then each
+	entropy-coded segment of the band followed by its restart marker.
+	Markers are renumbered from RST0 so that the band looks like a
+	complete scan, and the last segment is closed with an EOI marker.
+*/
+METHODDEF(boolean)
+band_fill_input_buffer (j_decompress_ptr cinfo) {
+	BandSourceManager *src = (BandSourceManager*) cinfo->src;
+	const RestartIndex *index = src->index;
+
+	do {
+		const unsigned piece = src->piece++;
+
+		if (piece == 0) {
+			src->pub.next_input_byte = index->data;
+			src->pub.bytes_in_buffer = index->header_size;
+		} else {
+			const unsigned segment = src->first + (piece - 1) / 2;
+
+			if (segment >= src->last) {
+				// past the band, keep returning EOI markers
+				src->piece--;
+				src->marker[0] = (JOCTET) 0xFF;
+				src->marker[1] = (JOCTET) JPEG_EOI;
+				src->pub.next_input_byte = src->marker;
+				src->pub.bytes_in_buffer = 2;
+			} else if (piece & 1) {
+				// segment data, up to the marker that follows it
+				const size_t start = index->start[segment];
+				const size_t end = (segment + 1 < index->count) ? index->start[segment + 1] - 2 : index->start[index->count];
+				src->pub.next_input_byte = index->data + start;
+				src->pub.bytes_in_buffer = end - start;
+			} else {
+				src->marker[0] = (JOCTET) 0xFF;
+				src->marker[1] = (JOCTET) ((segment + 1 < src->last) ? JPEG_RST0 + ((segment - src->first) & 7) : JPEG_EOI);
+				src->pub.next_input_byte = src->marker;
+				src->pub.bytes_in_buffer = 2;
+			}
+		}
+	} while (src->pub.bytes_in_buffer == 0);
+
+	return TRUE;
+}
+
+/**
+	Prepare for input of the segments [first, last) of an indexed stream.
+*/
+static void
+jpeg_band_src (j_decompress_ptr cinfo, const RestartIndex *index, unsigned first, unsigned last) {
+	BandSourceManager *src;
+
+	if (cinfo->src == NULL) {
+		cinfo->src = (struct jpeg_source_mgr *) (*cinfo->mem->alloc_small)
+			((j_common_ptr) cinfo, JPOOL_PERMANENT, sizeof(BandSourceManager));
+	}
+
+	src = (BandSourceManager*) cinfo->src;
+	src->pub.init_source = term_source;	// nothing to do either
+	src->pub.fill_input_buffer = band_fill_input_buffer;
+	src->pub.skip_input_data = skip_input_data;
+	src->pub.resync_to_restart = jpeg_resync_to_restart; // use default method
+	src->pub.term_source = term_source;
+	src->index = index;
+	src->first = first;
+	src->last = last;
+	src->piece = 0;
+	src->pub.bytes_in_buffer = 0;		// forces fill_input_buffer on first read
+	src->pub.next_input_byte = NULL;	// until buffer loaded
+}
+
+/**
+	Locate the SOS segment and the restart markers of a single scan stream.
+	The markers must appear in order and their number must match the
+	number of segments expected for the scan.
+	@return Returns TRUE if successful, returns FALSE otherwise
+*/
+static BOOL
+jpeg_index_restarts(RestartIndex *index, size_t size, unsigned expected) {
+	const BYTE *data = index->data;
+	size_t pos = 2;
+
+	if ((size < 4) || (data[0] != 0xFF) || (data[1] != SOI_MARKER)) {
+		return FALSE;
+	}
+
+	// skip the marker segments up to SOS
+	for (;;) {
+		if ((pos + 4 > size) || (data[pos] != 0xFF)) {
+			return FALSE;
+		}
+		while ((pos + 4 <= size) && (data[pos + 1] == 0xFF)) {
+			pos++;	// fill bytes
+		}
+		const BYTE marker = data[pos + 1];
+		if ((marker == 0x01) || ((marker >= JPEG_RST0) && (marker <= JPEG_RST0 + 7))) {
+			pos += 2;	// parameterless marker
+			continue;
+		}
+		pos += 2 + (((size_t)data[pos + 2] << 8) | data[pos + 3]);
+		if (marker == SOS_MARKER) {
+			break;
+		}
+	}
+	if (pos >= size) {
+		return FALSE;
+	}
+	index->header_size = pos;
+
+	// find the restart markers in the entropy-coded data
+	unsigned count = 0;
+	index->start[count++] = pos;
+	for (; pos + 1 < size; pos++) {
+		if (data[pos] != 0xFF) {
+			continue;
+		}
+		const BYTE marker = data[pos + 1];
+		if ((marker == 0) || (marker == 0xFF)) {
+			// stuffed zero byte or fill byte
+			continue;
+		}
+		if ((marker < JPEG_RST0) || (marker > JPEG_RST0 + 7)) {
+			// end of scan
+			break;
+		}
+		if ((count == expected) || (marker != JPEG_RST0 + ((count - 1) & 7))) {
+			return FALSE;
+		}
+		pos++;
+		index->start[count++] = pos + 1;
+	}
+	if ((count != expected) || (pos + 1 >= size)) {
+		return FALSE;
+	}
+	index->start[count] = pos;
+	index->count = count;
+
+	return TRUE;
+}
+
+/**
+	Decode the MCU rows [first_row, last_row) of the image with a decompressor
+	of its own, fed with the restart segments covering these rows.
+	@return Returns TRUE if successful, returns FALSE on an error or a warning
+*/
+static BOOL
+jpeg_decode_band(j_decompress_ptr master, const RestartIndex *index, unsigned first_row, unsigned last_row, FIBITMAP *dib, int orientation) {
+	struct jpeg_decompress_struct cinfo;
+	ErrorManager fi_error_mgr;
+
+	const unsigned MCUs_per_row = master->MCUs_per_row;
+	const unsigned interval = master->restart_interval;
+	const unsigned first = (first_row * MCUs_per_row) / interval;
+	const unsigned last = MIN(index->count, (last_row * MCUs_per_row + interval - 1) / interval);
+
+	cinfo.err = jpeg_std_error(&fi_error_mgr.pub);
+	fi_error_mgr.pub.error_exit     = jpeg_error_exit;
+	fi_error_mgr.pub.output_message = jpeg_band_output_message;
+
+	if (setjmp(fi_error_mgr.setjmp_buffer)) {
+		// jpeg_error_exit has already released the decompressor
+		return FALSE;
+	}
+
+	jpeg_create_decompress(&cinfo);
+	jpeg_band_src(&cinfo, index, first, last);
+	jpeg_read_header(&cinfo, TRUE);
+
+	// decode exactly as the master does
+	cinfo.scale_num = master->scale_num;
+	cinfo.scale_denom = master->scale_denom;
+	cinfo.dct_method = master->dct_method;
+	cinfo.do_fancy_upsampling = master->do_fancy_upsampling;
+	cinfo.out_color_space = master->out_color_space;
+
+	jpeg_start_decompress(&cinfo);
+
+	if ((cinfo.output_width != master->output_width) || (cinfo.output_height != master->output_height) ||
+		(cinfo.output_components != master->output_components)) {
+		jpeg_destroy_decompress(&cinfo);
+		return FALSE;
+	}
+
+	const unsigned rows_per_iMCU = cinfo.max_v_samp_factor * cinfo.min_DCT_v_scaled_size;
+	const unsigned first_line = first_row * rows_per_iMCU;
+	const unsigned num_lines = MIN(last_row * rows_per_iMCU, (unsigned)cinfo.output_height) - first_line;
+
+	OrientedWriter writer;
+	oriented_init(&writer, (j_common_ptr) &cinfo, dib, orientation, cinfo.output_width, cinfo.output_height, cinfo.output_components);
+
+	while (cinfo.output_scanline < num_lines) {
+		JSAMPROW dst = oriented_row(&writer, first_line + cinfo.output_scanline);
+
+		jpeg_read_scanlines(&cinfo, &dst, 1);
+		oriented_commit(&writer);
+	}
+	oriented_flush(&writer);
+
+	// corrupt data is only warned about: leave it to the serial decode
+	const BOOL bClean = (fi_error_mgr.pub.num_warnings == 0);
+
+	// the rest of the image belongs to other bands
+	jpeg_destroy_decompress(&cinfo);
+
+	return bClean;
+}
+
+/**
+	Decode a sequential image with restart markers in parallel bands.
+	The restart intervals are independent of each other, so bands of whole
+	MCU rows starting at a restart marker can be decoded by separate
+	decompressors straight into the dib (in the given Exif orientation).
+	The stream is read into memory
+	from start_pos and the handle is left where it was.
+	@return Returns TRUE if the image was decoded, returns FALSE if the caller
+	should decode it serially
+*/
+static BOOL
+jpeg_read_restart_bands(j_decompress_ptr cinfo, FreeImageIO *io, fi_handle handle, long start_pos, FIBITMAP *dib, int orientation) {
+	const unsigned interval = cinfo->restart_interval;
+
+	if ((interval == 0) || jpeg_has_multiple_scans(cinfo) || (cinfo->MCU_rows_in_scan != cinfo->total_iMCU_rows)) {
+		return FALSE;
+	}
+
+	// bands must start at a restart marker and an MCU row at the same time
+	const unsigned MCUs_per_row = cinfo->MCUs_per_row;
+	unsigned a = interval, b = MCUs_per_row;
+	while (b) {
+		const unsigned t = a % b;
+		a = b;
+		b = t;
+	}
+	const unsigned step = interval / a;
+	const unsigned band_rows = ((JPEG_BAND_ROWS + step - 1) / step) * step;
+	const unsigned num_rows = cinfo->MCU_rows_in_scan;
+	const int num_bands = (int)((num_rows + band_rows - 1) / band_rows);
+	if (num_bands < 2) {
+		return FALSE;
+	}
+
+	// read the whole stream
+	const long cur_pos = io->tell_proc(handle);
+	io->seek_proc(handle, 0, SEEK_END);
+	const long end_pos = io->tell_proc(handle);
+	io->seek_proc(handle, start_pos, SEEK_SET);
+
+	const unsigned expected = (unsigned)(((size_t)MCUs_per_row * num_rows + interval - 1) / interval);
+	const size_t size = (end_pos > start_pos) ? (size_t)(end_pos - start_pos) : 0;
+	BYTE *data = size ? (BYTE*)malloc(size) : NULL;
+	size_t *start = (size_t*)malloc((expected + 1) * sizeof(size_t));
+
+	BOOL bResult = FALSE;
+
+	if (data && start && (io->read_proc(data, 1, (unsigned)size, handle) == size)) {
+		RestartIndex index;
+		index.data = data;
+		index.start = start;
+
+		if (jpeg_index_restarts(&index, size, expected)) {
+			bResult = TRUE;
+
+#pragma omp parallel for schedule(dynamic)
+			for (int i = 0; i < num_bands; i++) {
+				const unsigned first_row = i * band_rows;
+				const unsigned last_row = MIN(first_row + band_rows, num_rows);
+				if (!jpeg_decode_band(cinfo, &index, first_row, last_row, dib, orientation)) {
+					bResult = FALSE;
+				}
+			}
+		}
 	}
+
+	free(start);
+	free(data);
+
+	io->seek_proc(handle, cur_pos, SEEK_SET);
+
+	return bResult;
 }
 
 // ==========================================================
@@ -1156,6 +1651,9 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 
 		BOOL header_only = (flags & FIF_LOAD_NOPIXELS) == FIF_LOAD_NOPIXELS;
 
+		// restart bands re-read the stream from here
+		const long start_pos = io->tell_proc(handle);
+
 		// set up the jpeglib structures
 
 		struct jpeg_decompress_struct cinfo;
@@ -1229,22 +1727,31 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 			jpeg_start_decompress(&cinfo);
 
 			// step 5b: allocate dib and init header
+			// with JPEG_EXIFROTATE, the dib is allocated in display orientation and filled while decoding
+
+			int orientation = 1;
+			if(!header_only && ((flags & JPEG_EXIFROTATE) == JPEG_EXIFROTATE)) {
+				orientation = jpeg_read_exif_orientation(&cinfo);
+			}
+			const BOOL transposed = (orientation >= 5);
+			const unsigned dib_width  = transposed ? cinfo.output_height : cinfo.output_width;
+			const unsigned dib_height = transposed ? cinfo.output_width : cinfo.output_height;
 
 			if((cinfo.output_components == 4) && (cinfo.out_color_space == JCS_CMYK)) {
 				// CMYK image
 				if((flags & JPEG_CMYK) == JPEG_CMYK) {
 					// load as CMYK
-					dib = FreeImage_AllocateHeader(header_only, cinfo.output_width, cinfo.output_height, 32, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
+					dib = FreeImage_AllocateHeader(header_only, dib_width, dib_height, 32, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
 					if(!dib) throw FI_MSG_ERROR_DIB_MEMORY;
 					FreeImage_GetICCProfile(dib)->flags |= FIICC_COLOR_IS_CMYK;
 				} else {
 					// load as CMYK and convert to RGB
-					dib = FreeImage_AllocateHeader(header_only, cinfo.output_width, cinfo.output_height, 24, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
+					dib = FreeImage_AllocateHeader(header_only, dib_width, dib_height, 24, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
 					if(!dib) throw FI_MSG_ERROR_DIB_MEMORY;
 				}
 			} else {
 				// RGB or greyscale image
-				dib = FreeImage_AllocateHeader(header_only, cinfo.output_width, cinfo.output_height, 8 * cinfo.output_components, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
+				dib = FreeImage_AllocateHeader(header_only, dib_width, dib_height, 8 * cinfo.output_components, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
 				if(!dib) throw FI_MSG_ERROR_DIB_MEMORY;
 
 				if (cinfo.output_components == 1) {
@@ -1260,7 +1767,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 			}
 			if(scale_denom != 1) {
 				// store original size info if a scaling was requested
-				store_size_info(dib, cinfo.image_width, cinfo.image_height);
+				StoreSizeInfo(dib, "JPEG", (int)cinfo.image_width, (int)cinfo.image_height);
 			}
 
 			// step 5c: handle metrices
@@ -1274,6 +1781,11 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 				FreeImage_SetDotsPerMeterX(dib, (unsigned) (cinfo.X_density * 100));
 				FreeImage_SetDotsPerMeterY(dib, (unsigned) (cinfo.Y_density * 100));
 			}
+			if (transposed) {
+				const unsigned dpm_x = FreeImage_GetDotsPerMeterX(dib);
+				FreeImage_SetDotsPerMeterX(dib, FreeImage_GetDotsPerMeterY(dib));
+				FreeImage_SetDotsPerMeterY(dib, dpm_x);
+			}
 			
 			// step 6: read special markers
 			
@@ -1290,6 +1802,11 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 
 			// step 7a: while (scan lines remain to be read) jpeg_read_scanlines(...);
 
+			BOOL bands_done = FALSE;	// decoded by jpeg_read_restart_bands
+
+			OrientedWriter writer;
+			oriented_init(&writer, (j_common_ptr) &cinfo, dib, orientation, cinfo.output_width, cinfo.output_height, FreeImage_GetBPP(dib) / 8);
+
 			if((cinfo.out_color_space == JCS_CMYK) && ((flags & JPEG_CMYK) != JPEG_CMYK)) {
 				// convert from CMYK to RGB
 
@@ -1303,7 +1820,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 
 				while (cinfo.output_scanline < cinfo.output_height) {
 					JSAMPROW src = buffer[0];
-					JSAMPROW dst = FreeImage_GetScanLine(dib, cinfo.output_height - cinfo.output_scanline - 1);
+					JSAMPROW dst = oriented_row(&writer, cinfo.output_scanline);
 
 					jpeg_read_scanlines(&cinfo, buffer, 1);
 
@@ -1315,7 +1832,9 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 						src += 4;
 						dst += 3;
 					}
+					oriented_commit(&writer);
 				}
+				oriented_flush(&writer);
 			} else if((cinfo.out_color_space == JCS_CMYK) && ((flags & JPEG_CMYK) == JPEG_CMYK)) {
 				// convert from LibJPEG CMYK to standard CMYK
 
@@ -1329,7 +1848,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 
 				while (cinfo.output_scanline < cinfo.output_height) {
 					JSAMPROW src = buffer[0];
-					JSAMPROW dst = FreeImage_GetScanLine(dib, cinfo.output_height - cinfo.output_scanline - 1);
+					JSAMPROW dst = oriented_row(&writer, cinfo.output_scanline);
 
 					jpeg_read_scanlines(&cinfo, buffer, 1);
 
@@ -1342,15 +1861,25 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 						src += 4;
 						dst += 4;
 					}
+					oriented_commit(&writer);
 				}
+				oriented_flush(&writer);
 
 			} else {
 				// normal case (RGB or greyscale image)
 
-				while (cinfo.output_scanline < cinfo.output_height) {
-					JSAMPROW dst = FreeImage_GetScanLine(dib, cinfo.output_height - cinfo.output_scanline - 1);
+				if (jpeg_read_restart_bands(&cinfo, io, handle, start_pos, dib, orientation)) {
+					// all scanlines are in the dib, drop the rest of the scan
+					jpeg_abort_decompress(&cinfo);
+					bands_done = TRUE;
+				} else {
+					while (cinfo.output_scanline < cinfo.output_height) {
+						JSAMPROW dst = oriented_row(&writer, cinfo.output_scanline);
 
-					jpeg_read_scanlines(&cinfo, &dst, 1);
+						jpeg_read_scanlines(&cinfo, &dst, 1);
+						oriented_commit(&writer);
+					}
+					oriented_flush(&writer);
 				}
 
 				// step 7b: swap red and blue components (see LibJPEG/jmorecfg.h: #define RGB_RED, ...)
@@ -1364,17 +1893,14 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 
 			// step 8: finish decompression
 
-			jpeg_finish_decompress(&cinfo);
+			if (!bands_done) {
+				jpeg_finish_decompress(&cinfo);
+			}
 
 			// step 9: release JPEG decompression object
 
 			jpeg_destroy_decompress(&cinfo);
 
-			// check for automatic Exif rotation
-			if(!header_only && ((flags & JPEG_EXIFROTATE) == JPEG_EXIFROTATE)) {
-				RotateExif(&dib);
-			}
-
 			// everything went well. return the loaded dib
 
 			return dib;
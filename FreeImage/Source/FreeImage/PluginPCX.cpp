@@ -25,12 +25,7 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
-
-// ----------------------------------------------------------
-//   Constants + headers
-// ----------------------------------------------------------
-
-#define IO_BUF_SIZE	2048
+#include "FreeImageIO.h"
 
 // ----------------------------------------------------------
 
@@ -97,7 +92,7 @@ pcx_validate(FreeImageIO *io, fi_handle handle) {
 }
 
 static unsigned
-readline(FreeImageIO &io, fi_handle handle, BYTE *buffer, unsigned length, BOOL rle, BYTE * ReadBuf, int * ReadPos) {
+readline(BufferedReader &reader, BYTE *buffer, unsigned length, BOOL rle) {
 	// -----------------------------------------------------------//
 	// Read either run-length encoded or normal image data        //
 	//                                                            //
@@ -112,49 +107,36 @@ readline(FreeImageIO &io, fi_handle handle, BYTE *buffer, unsigned length, BOOL
 	//  Note that a scanline always has an even number of bytes   //
 	// -------------------------------------------------------------
 
-	BYTE count = 0, value = 0;
 	unsigned written = 0;
 
 	if (rle) {
 		// run-length encoded read
 
-		while (length--) {
-			if (count == 0) {
-				if (*ReadPos >= IO_BUF_SIZE - 1 ) {
-					if (*ReadPos == IO_BUF_SIZE - 1) {
-						// we still have one BYTE, copy it to the start pos
+		while (written < length) {
+			int value = reader.next_byte();
+			unsigned count = 1;
 
-						*ReadBuf = ReadBuf[IO_BUF_SIZE - 1];
-
-						io.read_proc(ReadBuf + 1, 1, IO_BUF_SIZE - 1, handle);
-					} else {
-						// read the complete buffer
-
-						io.read_proc(ReadBuf, 1, IO_BUF_SIZE, handle);
-					}
-
-					*ReadPos = 0;
-				}
-
-				value = *(ReadBuf + (*ReadPos)++);
-
-				if ((value & 0xC0) == 0xC0) {
-					count = value & 0x3F;
-					value = *(ReadBuf + (*ReadPos)++);
-				} else {
-					count = 1;
+			if (value == EOF) {
+				break;
+			}
+			if ((value & 0xC0) == 0xC0) {
+				count = value & 0x3F;
+				value = reader.next_byte();
+				if (value == EOF) {
+					break;
 				}
 			}
 
-			count--;
-
-			*(buffer + written++) = value;
+			// a run never continues on the next line
+			count = MIN(count, length - written);
+			memset(buffer + written, value, count);
+			written += count;
 		}
 
 	} else {
 		// normal read
 
-		written = io.read_proc(buffer, length, 1, handle);
+		written = reader.read(buffer, length);
 	}
 
 	return written;
@@ -336,7 +318,6 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 	BYTE *bits;			  // Pointer to dib data
 	RGBQUAD *pal;		  // Pointer to dib palette
 	BYTE *line = NULL;	  // PCX raster line
-	BYTE *ReadBuf = NULL; // buffer;
 	BOOL bIsRLE;		  // True if the file is run-length encoded
 
 	if(!handle) {
@@ -480,43 +461,33 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 		line = (BYTE*)malloc(linelength * sizeof(BYTE));
 		if(!line) throw FI_MSG_ERROR_MEMORY;
 		
-		ReadBuf = (BYTE*)malloc(IO_BUF_SIZE * sizeof(BYTE));
-		if(!ReadBuf) throw FI_MSG_ERROR_MEMORY;
-		
 		bits = FreeImage_GetScanLine(dib, height - 1);
 
-		int ReadPos = IO_BUF_SIZE;
+		BufferedReader reader(io, handle);
 
 		if ((header.planes == 1) && ((header.bpp == 1) || (header.bpp == 8))) {
-			BYTE skip;
-			unsigned written;
-
 			for (unsigned y = 0; y < height; y++) {
-				written = readline(*io, handle, bits, linelength, bIsRLE, ReadBuf, &ReadPos);
-
-				// skip trailing garbage at the end of the scanline
-
-				for (unsigned count = written; count < linelength; count++) {
-					if (ReadPos < IO_BUF_SIZE) {
-						ReadPos++;
-					} else {
-						io->read_proc(&skip, sizeof(BYTE), 1, handle);
-					}
+				if (linelength <= pitch) {
+					readline(reader, bits, linelength, bIsRLE);
+				} else {
+					// the raster line is padded beyond the DIB line
+					readline(reader, line, linelength, bIsRLE);
+					memcpy(bits, line, pitch);
 				}
 
 				bits -= pitch;
 			}
 		} else if ((header.planes == 4) && (header.bpp == 1)) {
-			BYTE bit,  mask, skip;
+			BYTE bit,  mask;
 			unsigned index;
 			BYTE *buffer;
-			unsigned x, y, written;
+			unsigned x, y;
 
 			buffer = (BYTE*)malloc(width * sizeof(BYTE));
 			if(!buffer) throw FI_MSG_ERROR_MEMORY;
 
 			for (y = 0; y < height; y++) {
-				written = readline(*io, handle, line, linelength, bIsRLE, ReadBuf, &ReadPos);
+				readline(reader, line, linelength, bIsRLE);
 
 				// build a nibble using the 4 planes
 
@@ -538,16 +509,6 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 					bits[x] = (buffer[2*x] << 4) | buffer[2*x+1];
 				}
 
-				// skip trailing garbage at the end of the scanline
-
-				for (unsigned count = written; count < linelength; count++) {
-					if (ReadPos < IO_BUF_SIZE) {
-						ReadPos++;
-					} else {
-						io->read_proc(&skip, sizeof(BYTE), 1, handle);
-					}
-				}
-
 				bits -= pitch;
 			}
 
@@ -557,7 +518,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 			BYTE *pline;
 
 			for (unsigned y = 0; y < height; y++) {
-				readline(*io, handle, line, linelength, bIsRLE, ReadBuf, &ReadPos);
+				readline(reader, line, linelength, bIsRLE);
 
 				// convert the plane stream to BGR (RRRRGGGGBBBB -> BGRBGRBGRBGR)
 				// well, now with the FI_RGBA_x macros, on BIGENDIAN we convert to RGB
@@ -587,7 +548,6 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 		}
 
 		free(line);
-		free(ReadBuf);
 
 		return dib;
 
@@ -600,9 +560,6 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 		if (line != NULL) {
 			free(line);
 		}
-		if (ReadBuf != NULL) {
-			free(ReadBuf);
-		}
 
 		FreeImage_OutputMessageProc(s_format_id, text);
 	}
@@ -29,15 +29,24 @@
 /** maximum size of a line in the header */
 #define PFM_MAXLINE	256
 
-/** Big endian / Little endian float conversion */
-#define REVERSEBYTES(source, dest)		\
-{										\
-	char *j = (char *) source;			\
-	char *dj = (char *) dest;			\
-	dj[0] = j[3];						\
-	dj[1] = j[2];						\
-	dj[2] = j[1];						\
-	dj[3] = j[0];						\
+/**
+Big endian / Little endian float conversion, in place
+*/
+static void 
+pfm_swap_floats(float *values, unsigned count) {
+	unsigned i = 0;
+#ifdef FI_SSE2
+	for(; i + 4 <= count; i += 4) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(values + i));
+		// swap the 16-bit halves, then the bytes of each half
+		v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+		v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+		_mm_storeu_si128((__m128i*)(values + i), v);
+	}
+#endif // FI_SSE2
+	for(; i < count; i++) {
+		SwapLong((DWORD*)(values + i));
+	}
 }
 
 /**
@@ -192,7 +201,6 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 	char line_buffer[PFM_MAXLINE];
 	char id_one = 0, id_two = 0;
 	FIBITMAP *dib = NULL;
-	float *lineBuffer = NULL;
 
 	if (!handle) {
 		return NULL;
@@ -246,77 +254,30 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 			return dib;
 		}
 
-		// Read the image...
+		// Read the image, straight into the dib a line at a time. 
+		// The sign of the scale factor gives the byte order: positive for big endian.
 
-		if(image_type == FIT_RGBF) {
-			const unsigned lineWidth = 3 * width;
-			lineBuffer = (float*)malloc(lineWidth * sizeof(float));
-			if(!lineBuffer) {
-				throw FI_MSG_ERROR_MEMORY;
-			}
+#ifdef FREEIMAGE_BIGENDIAN
+		const BOOL bSwap = (scalefactor < 0) ? TRUE : FALSE;
+#else
+		const BOOL bSwap = (scalefactor > 0) ? TRUE : FALSE;
+#endif
+		const unsigned lineWidth = (image_type == FIT_RGBF) ? 3 * width : width;
 
-			for (unsigned y = 0; y < height; y++) {	
-				FIRGBF *bits = (FIRGBF*)FreeImage_GetScanLine(dib, height - 1 - y);
+		for (unsigned y = 0; y < height; y++) {	
+			float *bits = (float*)FreeImage_GetScanLine(dib, height - 1 - y);
 
-				if(io->read_proc(lineBuffer, sizeof(float), lineWidth, handle) != lineWidth) {
-					throw "Read error";
-				}
-				float *channel = lineBuffer;
-				if(scalefactor > 0) {
-					// MSB
-					for (unsigned x = 0; x < width; x++) {
-						REVERSEBYTES(channel++, &bits[x].red);
-						REVERSEBYTES(channel++, &bits[x].green);
-						REVERSEBYTES(channel++, &bits[x].blue);
-					}
-				} else {
-					// LSB					
-					for (unsigned x = 0; x < width; x++) {
-						bits[x].red		= *channel++;
-						bits[x].green	= *channel++;
-						bits[x].blue	= *channel++;
-					}
-				}
+			if(io->read_proc(bits, sizeof(float), lineWidth, handle) != lineWidth) {
+				throw "Read error";
 			}
-
-			free(lineBuffer);
-			lineBuffer = NULL;
-
-		} else if(image_type == FIT_FLOAT) {
-			const unsigned lineWidth = width;
-			lineBuffer = (float*)malloc(lineWidth * sizeof(float));
-			if(!lineBuffer) {
-				throw FI_MSG_ERROR_MEMORY;
+			if(bSwap) {
+				pfm_swap_floats(bits, lineWidth);
 			}
-
-			for (unsigned y = 0; y < height; y++) {	
-				float *bits = (float*)FreeImage_GetScanLine(dib, height - 1 - y);
-
-				if(io->read_proc(lineBuffer, sizeof(float), lineWidth, handle) != lineWidth) {
-					throw "Read error";
-				}
-				float *channel = lineBuffer;
-				if(scalefactor > 0) {
-					// MSB - File is Big endian
-					for (unsigned x = 0; x < width; x++) {
-						REVERSEBYTES(channel++, &bits[x]);
-					}
-				} else {
-					// LSB - File is Little Endian
-					for (unsigned x = 0; x < width; x++) {
-						bits[x] = *channel++;
-					}
-				}
-			}
-
-			free(lineBuffer);
-			lineBuffer = NULL;
 		}
 		
 		return dib;
 
 	} catch (const char *text)  {
-		if(lineBuffer) free(lineBuffer);
 		if(dib) FreeImage_Unload(dib);
 
 		if(NULL != text) {
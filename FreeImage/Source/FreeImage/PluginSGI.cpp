@@ -30,6 +30,7 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "FreeImageIO.h"
 
 // ----------------------------------------------------------
 //   Constants + headers
@@ -129,15 +130,11 @@ SwapHeader(SGIHeader *header) {
 #endif
 
 static int 
-get_rlechar(FreeImageIO *io, fi_handle handle, RLEStatus *pstatus) {
+get_rlechar(BufferedReader &reader, RLEStatus *pstatus) {
 	if (!pstatus->cnt) {
 		int cnt = 0;
 		while (0 == cnt) {
-			BYTE packed = 0;
-			if(io->read_proc(&packed, sizeof(BYTE), 1, handle) < 1) {
-				return EOF;
-			}
-			cnt = packed;
+			cnt = reader.next_byte();
 		}
 		if (cnt == EOF) {
 			return EOF;
@@ -146,20 +143,15 @@ get_rlechar(FreeImageIO *io, fi_handle handle, RLEStatus *pstatus) {
 		if (cnt & 0x80) {
 			pstatus->val = -1;
 		} else {
-			BYTE packed = 0;
-			if(io->read_proc(&packed, sizeof(BYTE), 1, handle) < 1) {
+			pstatus->val = reader.next_byte();
+			if (pstatus->val == EOF) {
 				return EOF;
 			}
-			pstatus->val = packed;
 		}
 	}
 	pstatus->cnt--;
 	if (pstatus->val == -1) {
-		BYTE packed = 0;
-		if(io->read_proc(&packed, sizeof(BYTE), 1, handle) < 1) {
-			return EOF;
-		}
-		return packed;
+		return reader.next_byte();
 	}
 	else {
 		return pstatus->val;
@@ -261,15 +253,18 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 			height = sgiHeader.ysize;
 		}
 		
+		BufferedReader reader(io, handle);
+
 		if(bIsRLE) {
 			// read the Offset Tables 
 			int index_len = height * zsize;
-			pRowIndex = (LONG*)malloc(index_len * sizeof(LONG));
+			const unsigned index_size = (unsigned)(index_len * sizeof(LONG));
+			pRowIndex = (LONG*)malloc(index_size);
 			if(!pRowIndex) {
 				throw FI_MSG_ERROR_MEMORY;
 			}
 			
-			if ((unsigned)index_len != io->read_proc(pRowIndex, sizeof(LONG), index_len, handle)) {
+			if (index_size != reader.read(pRowIndex, index_size)) {
 				throw SGI_EOF_IN_RLE_INDEX;
 			}
 			
@@ -279,12 +274,9 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 				SwapLong((DWORD*)&pRowIndex[i]);
 			}
 #endif
-			// Discard row size index
-			for (i = 0; i < (int)(index_len * sizeof(LONG)); i++) {
-				BYTE packed = 0;
-				if( io->read_proc(&packed, sizeof(BYTE), 1, handle) < 1 ) {
-					throw SGI_EOF_IN_RLE_INDEX;
-				}
+			// Discard row size index (skipped through the reader, as seeking past the end would not fail)
+			if (index_size != reader.skip(index_size)) {
+				throw SGI_EOF_IN_RLE_INDEX;
 			}
 		}
 		
@@ -351,22 +343,14 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 				BYTE *p = pRow;
 				if (bIsRLE) {
 					my_rle_status.cnt = 0;
-					io->seek_proc(handle, *pri, SEEK_SET);
+					reader.seek(*pri);
 				}
 				for (int k = 0; k < width; k++, p += numChannels) {
-					int ch;
-					BYTE packed = 0;
-					if (bIsRLE) {
-						ch = get_rlechar(io, handle, &my_rle_status);
-						packed = (BYTE)ch;
-					}
-					else {
-						ch = io->read_proc(&packed, sizeof(BYTE), 1, handle);
-					}
+					const int ch = bIsRLE ? get_rlechar(reader, &my_rle_status) : reader.next_byte();
 					if (ch == EOF) {
 						throw SGI_EOF_IN_IMAGE_DATA;
 					}
-					*p = packed;
+					*p = (BYTE)ch;
 				}
 			}
 		}
@@ -39,6 +39,106 @@ static int s_format_id;
 //   Helpers for the load function
 // ----------------------------------------------------------
 
+/**
+Location of a chunk payload in the input stream
+*/
+typedef struct tagWebPChunkPos {
+	long offset;	// 0 if the chunk is not present
+	DWORD size;
+} WebPChunkPos;
+
+/**
+Plugin data. 
+Still images are decoded straight from the input stream, using the chunk positions 
+gathered by Open. Only animations (and the writer) use a mux object, which holds 
+the whole file in memory.
+*/
+typedef struct tagWebPInfo {
+	WebPMux *mux;
+	long start;		// position of the RIFF header
+	WebPChunkPos iccp, exif, xmp;
+} WebPInfo;
+
+static inline DWORD
+ReadLE32(const BYTE *p) {
+	return (DWORD)p[0] | ((DWORD)p[1] << 8) | ((DWORD)p[2] << 16) | ((DWORD)p[3] << 24);
+}
+
+/**
+Walk the RIFF chunk headers, seeking over the payloads, and remember where the 
+metadata chunks are
+@param animated Set to TRUE if the file holds an animation
+@return Returns FALSE if this is not a WebP file
+*/
+static BOOL
+ScanChunks(FreeImageIO *io, fi_handle handle, WebPInfo *info, BOOL *animated) {
+	BYTE header[12];	// "RIFF" <size> "WEBP"
+
+	*animated = FALSE;
+
+	if(io->read_proc(header, 1, 12, handle) != 12) {
+		return FALSE;
+	}
+	if((memcmp(header, "RIFF", 4) != 0) || (memcmp(header + 8, "WEBP", 4) != 0)) {
+		return FALSE;
+	}
+
+	const long end = info->start + 8 + (long)MIN(ReadLE32(header + 4), (DWORD)0x7FFFFFF0);
+	long pos = info->start + 12;
+
+	while(pos + 8 <= end) {
+		BYTE chunk[8];	// <fourcc> <size>
+		if(io->read_proc(chunk, 1, 8, handle) != 8) {
+			break;
+		}
+		const long payload = pos + 8;
+		const DWORD size = ReadLE32(chunk + 4);
+		if(size > (DWORD)(end - payload)) {
+			break;
+		}
+
+		if(memcmp(chunk, "ICCP", 4) == 0) {
+			info->iccp.offset = payload;
+			info->iccp.size = size;
+		} else if(memcmp(chunk, "EXIF", 4) == 0) {
+			info->exif.offset = payload;
+			info->exif.size = size;
+		} else if(memcmp(chunk, "XMP ", 4) == 0) {
+			info->xmp.offset = payload;
+			info->xmp.size = size;
+		} else if((memcmp(chunk, "ANIM", 4) == 0) || (memcmp(chunk, "ANMF", 4) == 0)) {
+			*animated = TRUE;
+		}
+
+		// payloads are padded to an even size
+		pos = payload + (long)size + (long)(size & 1);
+		if(io->seek_proc(handle, pos, SEEK_SET) != 0) {
+			break;
+		}
+	}
+
+	return TRUE;
+}
+
+/**
+Read a chunk payload found by ScanChunks
+@return Returns a buffer to be released using free, or NULL
+*/
+static BYTE *
+ReadChunk(FreeImageIO *io, fi_handle handle, const WebPChunkPos *chunk) {
+	if(!chunk->offset || !chunk->size) {
+		return NULL;
+	}
+	BYTE *payload = (BYTE*)malloc(chunk->size);
+	if(payload) {
+		if((io->seek_proc(handle, chunk->offset, SEEK_SET) != 0) || (io->read_proc(payload, 1, chunk->size, handle) != chunk->size)) {
+			free(payload);
+			payload = NULL;
+		}
+	}
+	return payload;
+}
+
 /**
 Read the whole file into memory
 */
@@ -164,51 +264,207 @@ SupportsNoPixels() {
 
 // ----------------------------------------------------------
 
+// GIF compatible disposal values, see PluginGIF.cpp
+#define WEBP_DISPOSAL_LEAVE			1
+#define WEBP_DISPOSAL_BACKGROUND	2
+
+static BOOL 
+FreeImage_SetMetadataEx(FREE_IMAGE_MDMODEL model, FIBITMAP *dib, const char *key, WORD id, FREE_IMAGE_MDTYPE type, DWORD count, DWORD length, const void *value)
+{
+	BOOL bResult = FALSE;
+	FITAG *tag = FreeImage_CreateTag();
+	if(tag) {
+		FreeImage_SetTagKey(tag, key);
+		FreeImage_SetTagID(tag, id);
+		FreeImage_SetTagType(tag, type);
+		FreeImage_SetTagCount(tag, count);
+		FreeImage_SetTagLength(tag, length);
+		FreeImage_SetTagValue(tag, value);
+		if(model == FIMD_ANIMATION) {
+			TagLib& s = TagLib::instance();
+			// get the tag description
+			const char *description = s.getTagDescription(TagLib::ANIMATION, id);
+			FreeImage_SetTagDescription(tag, description);
+		}
+		// store the tag
+		bResult = FreeImage_SetMetadata(model, dib, key, tag);
+		FreeImage_DeleteTag(tag);
+	}
+	return bResult;
+}
+
+/**
+Store the animation metadata of a frame, using the same tags as the GIF plugin. 
+Canvas size and loop count are stored with the first frame only.
+*/
+static void
+SetAnimationMetadata(FIBITMAP *dib, WebPMux *mux, const WebPMuxFrameInfo *frame, int page) {
+	if(page == 0) {
+		int canvas_width = 0, canvas_height = 0;
+		if(WebPMuxGetCanvasSize(mux, &canvas_width, &canvas_height) == WEBP_MUX_OK) {
+			WORD logicalwidth = (WORD)canvas_width;
+			WORD logicalheight = (WORD)canvas_height;
+			FreeImage_SetMetadataEx(FIMD_ANIMATION, dib, "LogicalWidth", ANIMTAG_LOGICALWIDTH, FIDT_SHORT, 1, 2, &logicalwidth);
+			FreeImage_SetMetadataEx(FIMD_ANIMATION, dib, "LogicalHeight", ANIMTAG_LOGICALHEIGHT, FIDT_SHORT, 1, 2, &logicalheight);
+		}
+		WebPMuxAnimParams params;
+		if(WebPMuxGetAnimationParams(mux, &params) == WEBP_MUX_OK) {
+			LONG loop = params.loop_count;
+			FreeImage_SetMetadataEx(FIMD_ANIMATION, dib, "Loop", ANIMTAG_LOOP, FIDT_LONG, 1, 4, &loop);
+		}
+	}
+
+	WORD left = (WORD)frame->x_offset;
+	WORD top = (WORD)frame->y_offset;
+	LONG delay_time = frame->duration;
+	FreeImage_SetMetadataEx(FIMD_ANIMATION, dib, "FrameLeft", ANIMTAG_FRAMELEFT, FIDT_SHORT, 1, 2, &left);
+	FreeImage_SetMetadataEx(FIMD_ANIMATION, dib, "FrameTop", ANIMTAG_FRAMETOP, FIDT_SHORT, 1, 2, &top);
+	FreeImage_SetMetadataEx(FIMD_ANIMATION, dib, "FrameTime", ANIMTAG_FRAMETIME, FIDT_LONG, 1, 4, &delay_time);
+	BYTE b = (frame->dispose_method == WEBP_MUX_DISPOSE_BACKGROUND) ? WEBP_DISPOSAL_BACKGROUND : WEBP_DISPOSAL_LEAVE;
+	FreeImage_SetMetadataEx(FIMD_ANIMATION, dib, "DisposalMethod", ANIMTAG_DISPOSALMETHOD, FIDT_BYTE, 1, 1, &b);
+	b = (BYTE)frame->blend_method;
+	FreeImage_SetMetadataEx(FIMD_ANIMATION, dib, "BlendMethod", ANIMTAG_BLENDMETHOD, FIDT_BYTE, 1, 1, &b);
+}
+
+// ----------------------------------------------------------
+
 static void * DLL_CALLCONV
 Open(FreeImageIO *io, fi_handle handle, BOOL read) {
-	WebPMux *mux = NULL;
 	int copy_data = 1;	// 1 : copy data into the mux, 0 : keep a link to local data
 
+	WebPInfo *info = new(std::nothrow) WebPInfo;
+	if(!info) {
+		return NULL;
+	}
+	memset(info, 0, sizeof(WebPInfo));
+
 	if(read) {
-		// create the MUX object from the input stream
-		WebPData bitstream;
-		// read the input file and put it in memory
-		if(!ReadFileToWebPData(io, handle, &bitstream)) {
+		BOOL animated = FALSE;
+		info->start = io->tell_proc(handle);
+		if(!ScanChunks(io, handle, info, &animated)) {
+			delete info;
 			return NULL;
 		}
-		// create the MUX object
-		mux = WebPMuxCreate(&bitstream, copy_data);
-		// no longer needed since copy_data == 1
-		free((void*)bitstream.bytes);
-		if(mux == NULL) {
-			FreeImage_OutputMessageProc(s_format_id, "Failed to create mux object from file");
-			return NULL;
+		if(animated) {
+			// create the MUX object from the input stream
+			WebPData bitstream;
+			// read the input file and put it in memory
+			io->seek_proc(handle, info->start, SEEK_SET);
+			if(!ReadFileToWebPData(io, handle, &bitstream)) {
+				delete info;
+				return NULL;
+			}
+			// create the MUX object
+			info->mux = WebPMuxCreate(&bitstream, copy_data);
+			// no longer needed since copy_data == 1
+			free((void*)bitstream.bytes);
+			if(info->mux == NULL) {
+				FreeImage_OutputMessageProc(s_format_id, "Failed to create mux object from file");
+				delete info;
+				return NULL;
+			}
 		}
 	} else {
 		// creates an empty mux object
-		mux = WebPMuxNew();
-		if(mux == NULL) {
+		info->mux = WebPMuxNew();
+		if(info->mux == NULL) {
 			FreeImage_OutputMessageProc(s_format_id, "Failed to create empty mux object");
+			delete info;
 			return NULL;
 		}
 	}
 	
-	return mux;
+	return info;
+}
+
+static int DLL_CALLCONV
+PageCount(FreeImageIO *io, fi_handle handle, void *data) {
+	WebPMux *mux = data ? ((WebPInfo*)data)->mux : NULL;
+	int frames = 0;
+
+	// animated files expose each frame as a page, still images a single one
+	if(mux && (WebPMuxNumChunks(mux, WEBP_CHUNK_ANMF, &frames) == WEBP_MUX_OK) && (frames > 0)) {
+		return frames;
+	}
+	return 1;
 }
 
 static void DLL_CALLCONV
 Close(FreeImageIO *io, fi_handle handle, void *data) {
-	WebPMux *mux = (WebPMux*)data;
-	if(mux != NULL) {
-		// free the MUX object
-		WebPMuxDelete(mux);
+	WebPInfo *info = (WebPInfo*)data;
+	if(info != NULL) {
+		if(info->mux != NULL) {
+			// free the MUX object
+			WebPMuxDelete(info->mux);
+		}
+		delete info;
 	}
 }
 
 // ----------------------------------------------------------
 
 /**
-Decode a WebP image and returns a FIBITMAP image
+Allocate the dib described by the bitstream features in decoder_config, and let the 
+decoder output go straight into its pixels
+@param decoder_config Decoder configuration, with the input features filled in
+@param header_only TRUE if only the header is needed
+@param requested_size Size of the larger side the image should be scaled down to, 0 for the full size
+@return Returns a dib if successfull, returns NULL otherwise
+*/
+static FIBITMAP *
+AllocateOutput(WebPDecoderConfig *decoder_config, BOOL header_only, int requested_size) {
+	// Output buffer
+	WebPDecBuffer* const output_buffer = &decoder_config->output;
+	// Features gathered from the bitstream
+	WebPBitstreamFeatures* const bitstream = &decoder_config->input;
+
+	unsigned bpp = bitstream->has_alpha ? 32 : 24;	
+	unsigned width = (unsigned)bitstream->width;
+	unsigned height = (unsigned)bitstream->height;
+
+	// let the decoder rescale while decoding, rather than decoding everything first
+	BOOL scaled = FALSE;
+	if((requested_size > 0) && ((int)MAX(width, height) > requested_size)) {
+		const double scale = (double)requested_size / (double)MAX(width, height);
+		width = MAX((unsigned)(width * scale + 0.5), 1U);
+		height = MAX((unsigned)(height * scale + 0.5), 1U);
+		decoder_config->options.use_scaling = 1;
+		decoder_config->options.scaled_width = (int)width;
+		decoder_config->options.scaled_height = (int)height;
+		scaled = TRUE;
+	}
+
+	FIBITMAP *dib = FreeImage_AllocateHeader(header_only, width, height, bpp, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
+	if(!dib) {
+		return NULL;
+	}
+	if(scaled) {
+		// store original size info if a scaling was requested
+		StoreSizeInfo(dib, "WebP", bitstream->width, bitstream->height);
+	}
+	if(header_only) {
+		return dib;
+	}
+
+	// set output color space
+#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
+	output_buffer->colorspace = bitstream->has_alpha ? MODE_BGRA : MODE_BGR;
+#else
+	output_buffer->colorspace = bitstream->has_alpha ? MODE_RGBA : MODE_RGB;
+#endif
+
+	// dib scanlines are stored bottom-up: start at the top line and use a negative stride
+	const unsigned pitch = FreeImage_GetPitch(dib);
+	output_buffer->is_external_memory = 1;
+	output_buffer->u.RGBA.rgba = FreeImage_GetScanLine(dib, height - 1);
+	output_buffer->u.RGBA.stride = -(int)pitch;
+	output_buffer->u.RGBA.size = (size_t)pitch * height;
+
+	return dib;
+}
+
+/**
+Decode a WebP image held in memory and returns a FIBITMAP image
 @param webp_image Raw WebP image
 @param flags FreeImage load flags
 @return Returns a dib if successfull, returns NULL otherwise
@@ -245,30 +501,18 @@ DecodeImage(WebPData *webp_image, int flags) {
 			throw FI_MSG_ERROR_PARSING;
 		}
 
-		// Allocate output dib
-
-		unsigned bpp = bitstream->has_alpha ? 32 : 24;	
-		unsigned width = (unsigned)bitstream->width;
-		unsigned height = (unsigned)bitstream->height;
-
-		dib = FreeImage_AllocateHeader(header_only, width, height, bpp, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
+		// Allocate output dib (animation frames are not scaled, their offsets refer to the full canvas)
+		dib = AllocateOutput(&decoder_config, header_only, 0);
 		if(!dib) {
 			throw FI_MSG_ERROR_DIB_MEMORY;
 		}
 
 		if(header_only) {
-			WebPFreeDecBuffer(output_buffer);
 			return dib;
 		}
 
-		// --- Set decoding options ---
-
 		// use multi-threaded decoding
 		decoder_config.options.use_threads = 1;
-		// set output color space
-		output_buffer->colorspace = bitstream->has_alpha ? MODE_BGRA : MODE_BGR;
-
-		// ---
 
 		// decode the input stream, taking 'config' into account. 
 		
@@ -277,51 +521,131 @@ DecodeImage(WebPData *webp_image, int flags) {
 			throw FI_MSG_ERROR_PARSING;
 		}
 
-		// fill the dib with the decoded data
+		// Free the decoder
+		WebPFreeDecBuffer(output_buffer);
 
-		const BYTE *src_bitmap = output_buffer->u.RGBA.rgba;
-		const unsigned src_pitch = (unsigned)output_buffer->u.RGBA.stride;
+		return dib;
 
-		switch(bpp) {
-			case 24:
-				for(unsigned y = 0; y < height; y++) {
-					const BYTE *src_bits = src_bitmap + y * src_pitch;						
-					BYTE *dst_bits = (BYTE*)FreeImage_GetScanLine(dib, height-1-y);
-					for(unsigned x = 0; x < width; x++) {
-						dst_bits[FI_RGBA_BLUE]	= src_bits[0];	// B
-						dst_bits[FI_RGBA_GREEN]	= src_bits[1];	// G
-						dst_bits[FI_RGBA_RED]	= src_bits[2];	// R
-						src_bits += 3;
-						dst_bits += 3;
-					}
+	} catch (const char *text) {
+		if(dib) {
+			FreeImage_Unload(dib);
+		}
+		WebPFreeDecBuffer(output_buffer);
+
+		if(NULL != text) {
+			FreeImage_OutputMessageProc(s_format_id, text);
+		}
+
+		return NULL;
+	}
+}
+
+/**
+Decode a still WebP image from the input stream and returns a FIBITMAP image. 
+The stream is fed to the incremental decoder in chunks, so the file is never held 
+in memory as a whole.
+@param io FreeImage IO
+@param handle FreeImage IO handle, positioned at the RIFF header
+@param flags FreeImage load flags, the upper 16 bits may hold a requested size in pixels
+@return Returns a dib if successfull, returns NULL otherwise
+*/
+static FIBITMAP *
+DecodeStream(FreeImageIO *io, fi_handle handle, int flags) {
+	const size_t chunk_size = 64 * 1024;
+
+	FIBITMAP *dib = NULL;
+	WebPIDecoder *idec = NULL;
+
+	BYTE *buffer = NULL;
+	size_t buffer_size = 0, data_size = 0;
+
+    VP8StatusCode webp_status = VP8_STATUS_OK;
+
+	BOOL header_only = (flags & FIF_LOAD_NOPIXELS) == FIF_LOAD_NOPIXELS;
+
+	// Main object storing the configuration for advanced decoding
+	WebPDecoderConfig decoder_config;
+	// Output buffer
+	WebPDecBuffer* const output_buffer = &decoder_config.output;
+	// Features gathered from the bitstream
+	WebPBitstreamFeatures* const bitstream = &decoder_config.input;
+
+	try {
+		// Initialize the configuration as empty
+		if(!WebPInitDecoderConfig(&decoder_config)) {
+			throw "Library version mismatch";
+		}
+
+		// Read until the features are known. This is usually the first chunk, 
+		// unless there is a large ICC profile in front of the image data
+		do {
+			if(buffer_size - data_size < chunk_size) {
+				BYTE *grown = (BYTE*)realloc(buffer, buffer_size + chunk_size);
+				if(!grown) {
+					throw FI_MSG_ERROR_MEMORY;
 				}
+				buffer = grown;
+				buffer_size += chunk_size;
+			}
+			const unsigned read = io->read_proc(buffer + data_size, 1, (unsigned)chunk_size, handle);
+			data_size += read;
+			webp_status = WebPGetFeatures(buffer, data_size, bitstream);
+			if(!read) {
 				break;
-			case 32:
-				for(unsigned y = 0; y < height; y++) {
-					const BYTE *src_bits = src_bitmap + y * src_pitch;						
-					BYTE *dst_bits = (BYTE*)FreeImage_GetScanLine(dib, height-1-y);
-					for(unsigned x = 0; x < width; x++) {
-						dst_bits[FI_RGBA_BLUE]	= src_bits[0];	// B
-						dst_bits[FI_RGBA_GREEN]	= src_bits[1];	// G
-						dst_bits[FI_RGBA_RED]	= src_bits[2];	// R
-						dst_bits[FI_RGBA_ALPHA]	= src_bits[3];	// A
-						src_bits += 4;
-						dst_bits += 4;
-					}
-				}
+			}
+		} while(webp_status == VP8_STATUS_NOT_ENOUGH_DATA);
+
+		if(webp_status != VP8_STATUS_OK) {
+			throw FI_MSG_ERROR_PARSING;
+		}
+
+		// Allocate output dib, scaled down to the requested size if any
+		dib = AllocateOutput(&decoder_config, header_only, flags >> 16);
+		if(!dib) {
+			throw FI_MSG_ERROR_DIB_MEMORY;
+		}
+
+		if(header_only) {
+			free(buffer);
+			return dib;
+		}
+
+		// use multi-threaded decoding
+		decoder_config.options.use_threads = 1;
+
+		idec = WebPIDecode(NULL, 0, &decoder_config);
+		if(!idec) {
+			throw FI_MSG_ERROR_MEMORY;
+		}
+
+		// the decoder keeps its own copy of what it still needs, so the buffer can be reused
+		webp_status = WebPIAppend(idec, buffer, data_size);
+		while(webp_status == VP8_STATUS_SUSPENDED) {
+			const unsigned read = io->read_proc(buffer, 1, (unsigned)chunk_size, handle);
+			if(!read) {
 				break;
+			}
+			webp_status = WebPIAppend(idec, buffer, read);
+		}
+		if(webp_status != VP8_STATUS_OK) {
+			throw FI_MSG_ERROR_PARSING;
 		}
 
-		// Free the decoder
+		WebPIDelete(idec);
 		WebPFreeDecBuffer(output_buffer);
+		free(buffer);
 
 		return dib;
 
 	} catch (const char *text) {
+		if(idec) {
+			WebPIDelete(idec);
+		}
 		if(dib) {
 			FreeImage_Unload(dib);
 		}
 		WebPFreeDecBuffer(output_buffer);
+		free(buffer);
 
 		if(NULL != text) {
 			FreeImage_OutputMessageProc(s_format_id, text);
@@ -333,11 +657,8 @@ DecodeImage(WebPData *webp_image, int flags) {
 
 static FIBITMAP * DLL_CALLCONV
 Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
-	WebPMux *mux = NULL;
+	WebPInfo *info = NULL;
 	WebPMuxFrameInfo webp_frame = { 0 };	// raw image
-	WebPData color_profile;	// ICC raw data
-	WebPData xmp_metadata;	// XMP raw data
-	WebPData exif_metadata;	// EXIF raw data
 	FIBITMAP *dib = NULL;
 	WebPMuxError error_status;
 
@@ -346,77 +667,90 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 	}
 
 	try {
-		// get the MUX object
-		mux = (WebPMux*)data;
-		if(!mux) {
-			throw (1);
-		}
-		
-		// gets the feature flags from the mux object
-		uint32_t webp_flags = 0;
-		error_status = WebPMuxGetFeatures(mux, &webp_flags);
-		if(error_status != WEBP_MUX_OK) {
+		// get the plugin data
+		info = (WebPInfo*)data;
+		if(!info) {
 			throw (1);
 		}
 
-		// get image data
-		error_status = WebPMuxGetFrame(mux, 1, &webp_frame);
+		// page -1 means the first page
+		if(page < 0) {
+			page = 0;
+		}
 
-		if(error_status == WEBP_MUX_OK) {
+		if(info->mux) {
+			// get image data (frames are 1-based)
+			error_status = WebPMuxGetFrame(info->mux, page + 1, &webp_frame);
+			if(error_status != WEBP_MUX_OK) {
+				throw (1);
+			}
 			// decode the data (can be limited to the header if flags uses FIF_LOAD_NOPIXELS)
 			dib = DecodeImage(&webp_frame.bitstream, flags);
 			if(!dib) {
 				throw (1);
 			}
-			
-			// get ICC profile
-			if(webp_flags & ICCP_FLAG) {
-				error_status = WebPMuxGetChunk(mux, "ICCP", &color_profile);
-				if(error_status == WEBP_MUX_OK) {
-					FreeImage_CreateICCProfile(dib, (void*)color_profile.bytes, (long)color_profile.size);
-				}
-			}
 
-			// get XMP metadata
-			if(webp_flags & XMP_FLAG) {
-				error_status = WebPMuxGetChunk(mux, "XMP ", &xmp_metadata);
-				if(error_status == WEBP_MUX_OK) {
-					// create a tag
-					FITAG *tag = FreeImage_CreateTag();
-					if(tag) {
-						FreeImage_SetTagKey(tag, g_TagLib_XMPFieldName);
-						FreeImage_SetTagLength(tag, (DWORD)xmp_metadata.size);
-						FreeImage_SetTagCount(tag, (DWORD)xmp_metadata.size);
-						FreeImage_SetTagType(tag, FIDT_ASCII);
-						FreeImage_SetTagValue(tag, xmp_metadata.bytes);
-						
-						// store the tag
-						FreeImage_SetMetadata(FIMD_XMP, dib, FreeImage_GetTagKey(tag), tag);
-
-						// destroy the tag
-						FreeImage_DeleteTag(tag);
-					}
-				}
+			// get animation data
+			SetAnimationMetadata(dib, info->mux, &webp_frame, page);
+
+			WebPDataClear(&webp_frame.bitstream);
+		} else {
+			if(page > 0) {
+				throw (1);
 			}
+			// decode the image while reading it (can be limited to the header if flags uses FIF_LOAD_NOPIXELS)
+			io->seek_proc(handle, info->start, SEEK_SET);
+			dib = DecodeStream(io, handle, flags);
+			if(!dib) {
+				throw (1);
+			}
+		}
 
-			// get Exif metadata
-			if(webp_flags & EXIF_FLAG) {
-				error_status = WebPMuxGetChunk(mux, "EXIF", &exif_metadata);
-				if(error_status == WEBP_MUX_OK) {
-					// read the Exif raw data as a blob
-					jpeg_read_exif_profile_raw(dib, exif_metadata.bytes, (unsigned)exif_metadata.size);
-					// read and decode the Exif data
-					jpeg_read_exif_profile(dib, exif_metadata.bytes, (unsigned)exif_metadata.size);
-				}
+		// get ICC profile
+		BYTE *color_profile = ReadChunk(io, handle, &info->iccp);
+		if(color_profile) {
+			FreeImage_CreateICCProfile(dib, color_profile, (long)info->iccp.size);
+			free(color_profile);
+		}
+
+		// get XMP metadata
+		BYTE *xmp_metadata = ReadChunk(io, handle, &info->xmp);
+		if(xmp_metadata) {
+			// create a tag
+			FITAG *tag = FreeImage_CreateTag();
+			if(tag) {
+				FreeImage_SetTagKey(tag, g_TagLib_XMPFieldName);
+				FreeImage_SetTagLength(tag, info->xmp.size);
+				FreeImage_SetTagCount(tag, info->xmp.size);
+				FreeImage_SetTagType(tag, FIDT_ASCII);
+				FreeImage_SetTagValue(tag, xmp_metadata);
+				
+				// store the tag
+				FreeImage_SetMetadata(FIMD_XMP, dib, FreeImage_GetTagKey(tag), tag);
+
+				// destroy the tag
+				FreeImage_DeleteTag(tag);
 			}
+			free(xmp_metadata);
 		}
 
-		WebPDataClear(&webp_frame.bitstream);
+		// get Exif metadata
+		BYTE *exif_metadata = ReadChunk(io, handle, &info->exif);
+		if(exif_metadata) {
+			// read the Exif raw data as a blob
+			jpeg_read_exif_profile_raw(dib, exif_metadata, info->exif.size);
+			// read and decode the Exif data
+			jpeg_read_exif_profile(dib, exif_metadata, info->exif.size);
+			free(exif_metadata);
+		}
 
 		return dib;
 
 	} catch(int) {
 		WebPDataClear(&webp_frame.bitstream);
+		if(dib) {
+			FreeImage_Unload(dib);
+		}
 		return NULL;
 	}
 }
@@ -571,7 +905,7 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 	try {
 
 		// get the MUX object
-		mux = (WebPMux*)data;
+		mux = ((WebPInfo*)data)->mux;
 		if(!mux) {
 			return FALSE;
 		}
@@ -684,7 +1018,7 @@ InitWEBP(Plugin *plugin, int format_id) {
 	plugin->regexpr_proc = RegExpr;
 	plugin->open_proc = Open;
 	plugin->close_proc = Close;
-	plugin->pagecount_proc = NULL;
+	plugin->pagecount_proc = PageCount;
 	plugin->pagecapability_proc = NULL;
 	plugin->load_proc = Load;
 	plugin->save_proc = Save;
@@ -26,6 +26,8 @@
 #include "FreeImage.h"
 #endif
 
+#include <stdio.h>
+
 // ----------------------------------------------------------
 
 FI_STRUCT (FIMEMORYHEADER) {
@@ -45,4 +47,63 @@ void SetDefaultIO(FreeImageIO *io);
 
 void SetMemoryIO(FreeImageIO *io);
 
+// ----------------------------------------------------------
+
+/**
+Buffered reader on top of a FreeImageIO handle.<br>
+Decoders that consume their input byte by byte (RLE streams and the like) 
+should go through this class instead of calling read_proc for each byte: 
+the data is fetched in large blocks and next_byte / peek are inlined.<br>
+The handle is read ahead, so its position is undefined while the reader is in use. 
+Call sync() before accessing the handle directly again.
+*/
+class BufferedReader {
+public:
+	/**
+	@param io FreeImage IO
+	@param handle FreeImage IO handle, reading starts at its current position
+	*/
+	BufferedReader(FreeImageIO *io, fi_handle handle);
+	~BufferedReader();
+
+	/// Returns the next byte, or EOF at the end of the stream
+	inline int next_byte() {
+		return ((m_pos < m_end) || refill()) ? m_buffer[m_pos++] : EOF;
+	}
+	/// Returns the next byte without consuming it, or EOF at the end of the stream
+	inline int peek() {
+		return ((m_pos < m_end) || refill()) ? m_buffer[m_pos] : EOF;
+	}
+	/// Reads up to count bytes into buffer, returns the number of bytes read
+	unsigned read(void *buffer, unsigned count);
+	/// Skips up to count bytes, returns the number of bytes skipped
+	unsigned skip(unsigned count);
+	/// Moves to an absolute stream position, keeping the buffered data when possible
+	void seek(long position);
+	/// Returns the stream position of the next byte
+	long tell() const {
+		return m_start + (long)m_pos;
+	}
+	/// Moves the underlying handle to tell()
+	void sync();
+
+private:
+	BOOL refill();
+
+	FreeImageIO *m_io;
+	fi_handle m_handle;
+	/// buffer, m_fallback if the allocation failed
+	BYTE *m_buffer;
+	unsigned m_size;
+	/// read position / valid bytes in m_buffer
+	unsigned m_pos;
+	unsigned m_end;
+	/// stream position of m_buffer[0]
+	long m_start;
+	BYTE m_fallback[256];
+
+	BufferedReader(const BufferedReader&);
+	BufferedReader& operator=(const BufferedReader&);
+};
+
 #endif // !FREEIMAGEIO_H
@@ -54,27 +54,69 @@ IEEE Transactions on Signal Processing, vol. 41, no. 2, pp. 834-848, February 19
 #define ROTATE_QUARTIC   4L	// Use B-splines of degree 4 (quartic interpolation)
 #define ROTATE_QUINTIC   5L	// Use B-splines of degree 5 (quintic interpolation)
 
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Samples of 4 lines, filtered at once
+
+/**
+One sample of each of 4 lines, so that the recursive filters 
+(which are sequential along a line) process 4 lines at a time.
+*/
+struct Samples4 {
+#ifdef FI_SSE2
+	__m128 v;
+
+	Samples4() {}
+	Samples4(__m128 a) : v(a) {}
+	Samples4(float s0, float s1, float s2, float s3) : v(_mm_setr_ps(s0, s1, s2, s3)) {}
+
+	static Samples4 Load(const float *p) { return Samples4(_mm_loadu_ps(p)); }
+	void Store(float *p) const { _mm_storeu_ps(p, v); }
+#else
+	float v[4];
+
+	Samples4() {}
+	Samples4(float s0, float s1, float s2, float s3) { v[0] = s0; v[1] = s1; v[2] = s2; v[3] = s3; }
+
+	static Samples4 Load(const float *p) { return Samples4(p[0], p[1], p[2], p[3]); }
+	void Store(float *p) const { memcpy(p, v, sizeof(v)); }
+#endif
+};
+
+#ifdef FI_SSE2
+static inline Samples4 operator+(const Samples4& a, const Samples4& b) { return Samples4(_mm_add_ps(a.v, b.v)); }
+static inline Samples4 operator-(const Samples4& a, const Samples4& b) { return Samples4(_mm_sub_ps(a.v, b.v)); }
+static inline Samples4 operator*(float a, const Samples4& b) { return Samples4(_mm_mul_ps(_mm_set1_ps(a), b.v)); }
+#else
+static inline Samples4 operator+(const Samples4& a, const Samples4& b) { return Samples4(a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3]); }
+static inline Samples4 operator-(const Samples4& a, const Samples4& b) { return Samples4(a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3]); }
+static inline Samples4 operator*(float a, const Samples4& b) { return Samples4(a * b.v[0], a * b.v[1], a * b.v[2], a * b.v[3]); }
+#endif // FI_SSE2
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Prototypes definition
 
-static void ConvertToInterpolationCoefficients(double *c, long DataLength, double *z, long NbPoles,	double Tolerance);
-static double InitialCausalCoefficient(double *c, long DataLength, double z, double Tolerance);
-static void GetColumn(double *Image, long Width, long x, double *Line, long Height);
-static void	GetRow(double *Image, long y, double *Line, long Width);
-static double InitialAntiCausalCoefficient(double *c, long DataLength, double z);
-static void	PutColumn(double *Image, long Width, long x, double *Line, long Height);
-static void	PutRow(double *Image, long y, double *Line, long Width);
-static bool SamplesToCoefficients(double *Image, long Width, long Height, long spline_degree);
-static double InterpolatedValue(double *Bcoeff, long Width, long Height, double x, double y, long spline_degree);
-
-static FIBITMAP * Rotate8Bit(FIBITMAP *dib, double angle, double x_shift, double y_shift, double x_origin, double y_origin, long spline_degree, BOOL use_mask);
+template <class T> static void ConvertToInterpolationCoefficients(T *c, long DataLength, double *z, long NbPoles, double Tolerance);
+template <class T> static T InitialCausalCoefficient(T *c, long DataLength, double z, double Tolerance);
+template <class T> static T InitialAntiCausalCoefficient(T *c, long DataLength, double z);
+static void GetColumn(float *Image, long Width, long x, float *Line, long Height);
+static void	GetRow(float *Image, long y, float *Line, long Width);
+static void	PutColumn(float *Image, long Width, long x, float *Line, long Height);
+static void	PutRow(float *Image, long y, float *Line, long Width);
+static void GetColumns(float *Image, long Width, long x, Samples4 *Line, long Height);
+static void	GetRows(float *Image, long y, Samples4 *Line, long Width);
+static void	PutColumns(float *Image, long Width, long x, Samples4 *Line, long Height);
+static void	PutRows(float *Image, long y, Samples4 *Line, long Width);
+static bool SamplesToCoefficients(float *Image, long Width, long Height, long spline_degree);
+static double InterpolatedValue(float *Bcoeff, long Width, long Height, double x, double y, long spline_degree);
+
+static bool RotateChannel(FIBITMAP *dib, FIBITMAP *dst, unsigned channel, float *ImageRasterArray, double angle, double x_shift, double y_shift, double x_origin, double y_origin, long spline_degree, BOOL use_mask);
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Coefficients routines
 
 /**
- ConvertToInterpolationCoefficients
+ ConvertToInterpolationCoefficients.<br>
+ T is float for a single line, or Samples4 for 4 lines filtered at once.
 
  @param c Input samples --> output coefficients
  @param DataLength Number of samples or coefficients
@@ -82,8 +124,8 @@ static FIBITMAP * Rotate8Bit(FIBITMAP *dib, double angle, double x_shift, double
  @param NbPoles Number of poles
  @param Tolerance Admissible relative error
 */
-static void 
-ConvertToInterpolationCoefficients(double *c, long DataLength, double *z, long NbPoles,	double Tolerance) {
+template <class T> static void 
+ConvertToInterpolationCoefficients(T *c, long DataLength, double *z, long NbPoles,	double Tolerance) {
 	double	Lambda = 1;
 	long	n, k;
 
@@ -96,22 +138,24 @@ ConvertToInterpolationCoefficients(double *c, long DataLength, double *z, long N
 		Lambda = Lambda * (1.0 - z[k]) * (1.0 - 1.0 / z[k]);
 	}
 	// apply the gain 
+	const float fLambda = (float)Lambda;
 	for (n = 0L; n < DataLength; n++) {
-		c[n] *= Lambda;
+		c[n] = fLambda * c[n];
 	}
 	// loop over all poles 
 	for (k = 0L; k < NbPoles; k++) {
+		const float zk = (float)z[k];
 		// causal initialization 
 		c[0] = InitialCausalCoefficient(c, DataLength, z[k], Tolerance);
 		// causal recursion 
 		for (n = 1L; n < DataLength; n++) {
-			c[n] += z[k] * c[n - 1L];
+			c[n] = c[n] + zk * c[n - 1L];
 		}
 		// anticausal initialization 
 		c[DataLength - 1L] = InitialAntiCausalCoefficient(c, DataLength, z[k]);
 		// anticausal recursion 
 		for (n = DataLength - 2L; 0 <= n; n--) {
-			c[n] = z[k] * (c[n + 1L] - c[n]);
+			c[n] = zk * (c[n + 1L] - c[n]);
 		}
 	}
 } 
@@ -125,9 +169,10 @@ ConvertToInterpolationCoefficients(double *c, long DataLength, double *z, long N
  @param Tolerance Admissible relative error
  @return
 */
-static double 
-InitialCausalCoefficient(double	*c, long DataLength, double	z, double Tolerance) {
-	double	Sum, zn, z2n, iz;
+template <class T> static T 
+InitialCausalCoefficient(T *c, long DataLength, double z, double Tolerance) {
+	T		Sum;
+	double	zn, z2n, iz;
 	long	n, Horizon;
 
 	// this initialization corresponds to mirror boundaries 
@@ -140,7 +185,7 @@ InitialCausalCoefficient(double	*c, long DataLength, double	z, double Tolerance)
 		zn = z;
 		Sum = c[0];
 		for (n = 1L; n < Horizon; n++) {
-			Sum += zn * c[n];
+			Sum = Sum + (float)zn * c[n];
 			zn *= z;
 		}
 		return(Sum);
@@ -150,17 +195,31 @@ InitialCausalCoefficient(double	*c, long DataLength, double	z, double Tolerance)
 		zn = z;
 		iz = 1.0 / z;
 		z2n = pow(z, (double)(DataLength - 1L));
-		Sum = c[0] + z2n * c[DataLength - 1L];
+		Sum = c[0] + (float)z2n * c[DataLength - 1L];
 		z2n *= z2n * iz;
 		for (n = 1L; n <= DataLength - 2L; n++) {
-			Sum += (zn + z2n) * c[n];
+			Sum = Sum + (float)(zn + z2n) * c[n];
 			zn *= z;
 			z2n *= iz;
 		}
-		return(Sum / (1.0 - zn * zn));
+		return((float)(1.0 / (1.0 - zn * zn)) * Sum);
 	}
 }
 
+/**
+ InitialAntiCausalCoefficient
+
+ @param c Coefficients
+ @param DataLength Number of samples or coefficients
+ @param z Actual pole
+ @return
+*/
+template <class T> static T 
+InitialAntiCausalCoefficient(T *c, long DataLength, double z) {
+	// this initialization corresponds to mirror boundaries
+	return((float)(z / (z * z - 1.0)) * ((float)z * c[DataLength - 2L] + c[DataLength - 1L]));
+}
+
 /**
  GetColumn
 
@@ -171,12 +230,12 @@ InitialCausalCoefficient(double	*c, long DataLength, double	z, double Tolerance)
  @param Height Length of the line
 */
 static void 
-GetColumn(double *Image, long Width, long x, double *Line, long Height) {
+GetColumn(float *Image, long Width, long x, float *Line, long Height) {
 	long y;
 
 	Image = Image + x;
 	for(y = 0L; y < Height; y++) {
-		Line[y] = (double)*Image;
+		Line[y] = *Image;
 		Image += Width;
 	}
 }
@@ -190,64 +249,129 @@ GetColumn(double *Image, long Width, long x, double *Line, long Height) {
  @param Width Length of the line
 */
 static void	
-GetRow(double *Image, long y, double *Line, long Width) {
-	long	x;
+GetRow(float *Image, long y, float *Line, long Width) {
+	memcpy(Line, Image + (y * Width), Width * sizeof(float));
+}
 
-	Image = Image + (y * Width);
-	for(x = 0L; x < Width; x++) {
-		Line[x] = (double)*Image++;
+/**
+ PutColumn
+
+ @param Image Output image array
+ @param Width Width of the image
+ @param x x coordinate of the selected line
+ @param Line Input linear array
+ @param Height Length of the line and height of the image
+*/
+static void	
+PutColumn(float *Image, long Width, long x, float *Line, long Height) {
+	long	y;
+
+	Image = Image + x;
+	for(y = 0L; y < Height; y++) {
+		*Image = Line[y];
+		Image += Width;
 	}
 }
 
 /**
- InitialAntiCausalCoefficient
+ PutRow
 
- @param c Coefficients
- @param DataLength Number of samples or coefficients
- @param z Actual pole
- @return
+ @param Image Output image array
+ @param y y coordinate of the selected line
+ @param Line Input linear array
+ @param Width length of the line and width of the image
 */
-static double 
-InitialAntiCausalCoefficient(double	*c, long DataLength, double	z) {
-	// this initialization corresponds to mirror boundaries
-	return((z / (z * z - 1.0)) * (z * c[DataLength - 2L] + c[DataLength - 1L]));
+static void	
+PutRow(float *Image, long y, float *Line, long Width) {
+	memcpy(Image + (y * Width), Line, Width * sizeof(float));
 }
 
 /**
- PutColumn
+ GetColumns<br>
+ Reads the 4 adjacent columns x .. x + 3, one Samples4 per row.
+
+ @param Image Input image array
+ @param Width Width of the image
+ @param x x coordinate of the first column
+ @param Line Output linear array
+ @param Height Length of the lines
+*/
+static void 
+GetColumns(float *Image, long Width, long x, Samples4 *Line, long Height) {
+	long y;
+
+	Image = Image + x;
+	for(y = 0L; y < Height; y++) {
+		Line[y] = Samples4::Load(Image);
+		Image += Width;
+	}
+}
+
+/**
+ GetRows<br>
+ Interleaves the 4 rows y .. y + 3, one Samples4 per column.
+
+ @param Image Input image array
+ @param y y coordinate of the first row
+ @param Line Output linear array
+ @param Width Length of the lines
+*/
+static void	
+GetRows(float *Image, long y, Samples4 *Line, long Width) {
+	long	x;
+
+	const float *Row0 = Image + (y * Width);
+	const float *Row1 = Row0 + Width;
+	const float *Row2 = Row1 + Width;
+	const float *Row3 = Row2 + Width;
+	for(x = 0L; x < Width; x++) {
+		Line[x] = Samples4(Row0[x], Row1[x], Row2[x], Row3[x]);
+	}
+}
+
+/**
+ PutColumns
 
  @param Image Output image array
  @param Width Width of the image
- @param x x coordinate of the selected line
+ @param x x coordinate of the first column
  @param Line Input linear array
- @param Height Length of the line and height of the image
+ @param Height Length of the lines and height of the image
 */
 static void	
-PutColumn(double *Image, long Width, long x, double *Line, long Height) {
+PutColumns(float *Image, long Width, long x, Samples4 *Line, long Height) {
 	long	y;
 
 	Image = Image + x;
 	for(y = 0L; y < Height; y++) {
-		*Image = (double)Line[y];
+		Line[y].Store(Image);
 		Image += Width;
 	}
 }
 
 /**
- PutRow
+ PutRows
 
  @param Image Output image array
- @param y y coordinate of the selected line
+ @param y y coordinate of the first row
  @param Line Input linear array
- @param Width length of the line and width of the image
+ @param Width length of the lines and width of the image
 */
 static void	
-PutRow(double *Image, long y, double *Line, long Width) {
+PutRows(float *Image, long y, Samples4 *Line, long Width) {
 	long	x;
 
-	Image = Image + (y * Width);
+	float *Row0 = Image + (y * Width);
+	float *Row1 = Row0 + Width;
+	float *Row2 = Row1 + Width;
+	float *Row3 = Row2 + Width;
 	for(x = 0L; x < Width; x++) {
-		*Image++ = (double)Line[x];
+		float s[4];
+		Line[x].Store(s);
+		Row0[x] = s[0];
+		Row1[x] = s[1];
+		Row2[x] = s[2];
+		Row3[x] = s[3];
 	}
 }
 
@@ -257,7 +381,9 @@ PutRow(double *Image, long y, double *Line, long Width) {
  This efficient procedure essentially relies on the three papers cited above; 
  data are processed in-place. 
  Even though this algorithm is robust with respect to quantization, 
- we advocate the use of a floating-point format for the data. 
+ we advocate the use of a floating-point format for the data. <br>
+ The recursive filters run on 4 rows (then 4 columns) at once, and groups 
+ of lines are processed in parallel (OpenMP). 
 
  @param Image Input / Output image (in-place processing)
  @param Width Width of the image
@@ -266,11 +392,9 @@ PutRow(double *Image, long y, double *Line, long Width) {
  @return Returns true if success, false otherwise
 */
 static bool	
-SamplesToCoefficients(double *Image, long Width, long Height, long spline_degree) {
-	double	*Line;
+SamplesToCoefficients(float *Image, long Width, long Height, long spline_degree) {
 	double	Pole[2];
 	long	NbPoles;
-	long	x, y;
 
 	// recover the poles from a lookup table
 	switch (spline_degree) {
@@ -301,33 +425,64 @@ SamplesToCoefficients(double *Image, long Width, long Height, long spline_degree
 
 	// convert the image samples into interpolation coefficients 
 
-	// in-place separable process, along x 
-	Line = (double *)malloc(Width * sizeof(double));
-	if (Line == NULL) {
-		// Row allocation failed
-		return false;
-	}
-	for (y = 0L; y < Height; y++) {
-		GetRow(Image, y, Line, Width);
-		ConvertToInterpolationCoefficients(Line, Width, Pole, NbPoles, DBL_EPSILON);
-		PutRow(Image, y, Line, Width);
-	}
-	free(Line);
+	const long Length = MAX(Width, Height);
+	bool bResult = true;
+
+#pragma omp parallel
+	{
+		// line buffers, 4 lines interleaved and a single one
+		Samples4 *Lines = (Samples4 *)FreeImage_Aligned_Malloc(Length * sizeof(Samples4), FIBITMAP_ALIGNMENT);
+		float *Line = (float *)malloc(Length * sizeof(float));
+		if (!Lines || !Line) {
+			// Line allocation failed
+			bResult = false;
+		}
 
-	// in-place separable process, along y 
-	Line = (double *)malloc(Height * sizeof(double));
-	if (Line == NULL) {
-		// Column allocation failed
-		return false;
-	}
-	for (x = 0L; x < Width; x++) {
-		GetColumn(Image, Width, x, Line, Height);
-		ConvertToInterpolationCoefficients(Line, Height, Pole, NbPoles, DBL_EPSILON);
-		PutColumn(Image, Width, x, Line, Height);
+		// in-place separable process, along x 
+#pragma omp for
+		for (long y = 0L; y < Height; y += 4) {
+			if (!Lines || !Line) {
+				continue;
+			}
+			if (y + 4 <= Height) {
+				GetRows(Image, y, Lines, Width);
+				ConvertToInterpolationCoefficients(Lines, Width, Pole, NbPoles, FLT_EPSILON);
+				PutRows(Image, y, Lines, Width);
+			} else {
+				for (long k = y; k < Height; k++) {
+					GetRow(Image, k, Line, Width);
+					ConvertToInterpolationCoefficients(Line, Width, Pole, NbPoles, FLT_EPSILON);
+					PutRow(Image, k, Line, Width);
+				}
+			}
+		}
+
+		// in-place separable process, along y 
+#pragma omp for
+		for (long x = 0L; x < Width; x += 4) {
+			if (!Lines || !Line) {
+				continue;
+			}
+			if (x + 4 <= Width) {
+				GetColumns(Image, Width, x, Lines, Height);
+				ConvertToInterpolationCoefficients(Lines, Height, Pole, NbPoles, FLT_EPSILON);
+				PutColumns(Image, Width, x, Lines, Height);
+			} else {
+				for (long k = x; k < Width; k++) {
+					GetColumn(Image, Width, k, Line, Height);
+					ConvertToInterpolationCoefficients(Line, Height, Pole, NbPoles, FLT_EPSILON);
+					PutColumn(Image, Width, k, Line, Height);
+				}
+			}
+		}
+
+		if (Lines) {
+			FreeImage_Aligned_Free(Lines);
+		}
+		free(Line);
 	}
-	free(Line);
 
-	return true;
+	return bResult;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -349,8 +504,8 @@ The model degree can be 2 (quadratic), 3 (cubic), 4 (quartic), or 5 (quintic).
 sampled at the location (x, y)
 */
 static double 
-InterpolatedValue(double *Bcoeff, long Width, long Height, double x, double y, long spline_degree) {
-	double	*p;
+InterpolatedValue(float *Bcoeff, long Width, long Height, double x, double y, long spline_degree) {
+	float	*p;
 	double	xWeight[6], yWeight[6];
 	double	interpolated;
 	double	w, w2, w4, t, t0, t1;
@@ -473,19 +628,25 @@ InterpolatedValue(double *Bcoeff, long Width, long Height, double x, double y, l
 			return 0;
 	}
 
-	// apply the mirror boundary conditions
-	for(k = 0; k <= spline_degree; k++) {
-		xIndex[k] = (Width == 1L) ? (0L) : ((xIndex[k] < 0L) ?
-			(-xIndex[k] - Width2 * ((-xIndex[k]) / Width2))
-			: (xIndex[k] - Width2 * (xIndex[k] / Width2)));
-		if (Width <= xIndex[k]) {
-			xIndex[k] = Width2 - xIndex[k];
+	// apply the mirror boundary conditions (only needed near the borders)
+	if((xIndex[0] < 0L) || (Width <= xIndex[spline_degree])) {
+		for(k = 0; k <= spline_degree; k++) {
+			xIndex[k] = (Width == 1L) ? (0L) : ((xIndex[k] < 0L) ?
+				(-xIndex[k] - Width2 * ((-xIndex[k]) / Width2))
+				: (xIndex[k] - Width2 * (xIndex[k] / Width2)));
+			if (Width <= xIndex[k]) {
+				xIndex[k] = Width2 - xIndex[k];
+			}
 		}
-		yIndex[k] = (Height == 1L) ? (0L) : ((yIndex[k] < 0L) ?
-			(-yIndex[k] - Height2 * ((-yIndex[k]) / Height2))
-			: (yIndex[k] - Height2 * (yIndex[k] / Height2)));
-		if (Height <= yIndex[k]) {
-			yIndex[k] = Height2 - yIndex[k];
+	}
+	if((yIndex[0] < 0L) || (Height <= yIndex[spline_degree])) {
+		for(k = 0; k <= spline_degree; k++) {
+			yIndex[k] = (Height == 1L) ? (0L) : ((yIndex[k] < 0L) ?
+				(-yIndex[k] - Height2 * ((-yIndex[k]) / Height2))
+				: (yIndex[k] - Height2 * (yIndex[k] / Height2)));
+			if (Height <= yIndex[k]) {
+				yIndex[k] = Height2 - yIndex[k];
+			}
 		}
 	}
 
@@ -508,9 +669,13 @@ InterpolatedValue(double *Bcoeff, long Width, long Height, double x, double y, l
 
 
 /** 
- Image translation and rotation using B-Splines.
+ Image translation and rotation using B-Splines, applied to one channel 
+ of an 8-, 24- or 32-bit image. Output rows are computed in parallel (OpenMP).
 
- @param dib Input 8-bit greyscale image
+ @param dib Input 8-bit greyscale, 24- or 32-bit image
+ @param dst Output image, same size and color depth as dib
+ @param channel Channel (byte within a pixel) to process
+ @param ImageRasterArray Working array of width * height coefficients
  @param angle Output image rotation in degree
  @param x_shift Output image horizontal shift
  @param y_shift Output image vertical shift
@@ -518,25 +683,19 @@ InterpolatedValue(double *Bcoeff, long Width, long Height, double x, double y, l
  @param y_origin Output origin of the y-axis
  @param spline_degree Output degree of the B-spline model
  @param use_mask Whether or not to mask the image
- @return Returns the translated & rotated dib if successful, returns NULL otherwise
+ @return Returns true if success, false otherwise
 */
-static FIBITMAP * 
-Rotate8Bit(FIBITMAP *dib, double angle, double x_shift, double y_shift, double x_origin, double y_origin, long spline_degree, BOOL use_mask) {
-	double	*ImageRasterArray;
-	double	p;
+static bool 
+RotateChannel(FIBITMAP *dib, FIBITMAP *dst, unsigned channel, float *ImageRasterArray, double angle, double x_shift, double y_shift, double x_origin, double y_origin, long spline_degree, BOOL use_mask) {
 	double	a11, a12, a21, a22;
-	double	x0, y0, x1, y1;
+	double	x0, y0;
 	long	x, y;
 	long	spline;
-	bool	bResult;
 
-	int bpp = FreeImage_GetBPP(dib);
-	if(bpp != 8) {
-		return NULL;
-	}
+	const unsigned nb_channels = FreeImage_GetBPP(dib) / 8;
 	
-	int width = FreeImage_GetWidth(dib);
-	int height = FreeImage_GetHeight(dib);
+	const long width = FreeImage_GetWidth(dib);
+	const long height = FreeImage_GetHeight(dib);
 	switch(spline_degree) {
 		case ROTATE_QUADRATIC:
 			spline = 2L;	// Use splines of degree 2 (quadratic interpolation)
@@ -554,39 +713,20 @@ Rotate8Bit(FIBITMAP *dib, double angle, double x_shift, double y_shift, double x
 			spline = 3L;
 	}
 
-	// allocate output image
-	FIBITMAP *dst = FreeImage_Allocate(width, height, bpp);
-	if(!dst)
-		return NULL;
-	// buid a grey scale palette
-	RGBQUAD *pal = FreeImage_GetPalette(dst);
-	for(int i = 0; i < 256; i++) {
-		pal[i].rgbRed = pal[i].rgbGreen = pal[i].rgbBlue = (BYTE)i;
-	}
-
-	// allocate a temporary array
-	ImageRasterArray = (double*)malloc(width * height * sizeof(double));
-	if(!ImageRasterArray) {
-		FreeImage_Unload(dst);
-		return NULL;
-	}
 	// copy data samples
 	for(y = 0; y < height; y++) {
-		double *pImage = &ImageRasterArray[y*width];
-		BYTE *src_bits = FreeImage_GetScanLine(dib, height-1-y);
+		float *pImage = &ImageRasterArray[y*width];
+		const BYTE *src_bits = FreeImage_GetScanLine(dib, height-1-y) + channel;
 
 		for(x = 0; x < width; x++) {
-			pImage[x] = (double)src_bits[x];
+			pImage[x] = (float)src_bits[x * nb_channels];
 		}
 	}
 
 	// convert between a representation based on image samples
 	// and a representation based on image B-spline coefficients
-	bResult = SamplesToCoefficients(ImageRasterArray, width, height, spline);
-	if(!bResult) {
-		FreeImage_Unload(dst);
-		free(ImageRasterArray);
-		return NULL;
+	if(!SamplesToCoefficients(ImageRasterArray, width, height, spline)) {
+		return false;
 	}
 
 	// prepare the geometry
@@ -601,35 +741,34 @@ Rotate8Bit(FIBITMAP *dib, double angle, double x_shift, double y_shift, double x
 	y_shift = y_origin - y0;
 
 	// visit all pixels of the output image and assign their value
-	for(y = 0; y < height; y++) {
-		BYTE *dst_bits = FreeImage_GetScanLine(dst, height-1-y);
+#pragma omp parallel for
+	for(long row = 0; row < height; row++) {
+		BYTE *dst_bits = FreeImage_GetScanLine(dst, height-1-row) + channel;
 		
-		x0 = a12 * (double)y + x_shift;
-		y0 = a22 * (double)y + y_shift;
+		const double xr = a12 * (double)row + x_shift;
+		const double yr = a22 * (double)row + y_shift;
 
-		for(x = 0; x < width; x++) {
-			x1 = x0 + a11 * (double)x;
-			y1 = y0 + a21 * (double)x;
+		for(long col = 0; col < width; col++) {
+			const double x1 = xr + a11 * (double)col;
+			const double y1 = yr + a21 * (double)col;
+			double p;
 			if(use_mask) {
 				if((x1 <= -0.5) || (((double)width - 0.5) <= x1) || (y1 <= -0.5) || (((double)height - 0.5) <= y1)) {
 					p = 0;
 				}
 				else {
-					p = (double)InterpolatedValue(ImageRasterArray, width, height, x1, y1, spline);
+					p = InterpolatedValue(ImageRasterArray, width, height, x1, y1, spline);
 				}
 			}
 			else {
-				p = (double)InterpolatedValue(ImageRasterArray, width, height, x1, y1, spline);
+				p = InterpolatedValue(ImageRasterArray, width, height, x1, y1, spline);
 			}
 			// clamp and convert to BYTE
-			dst_bits[x] = (BYTE)MIN(MAX((int)0, (int)(p + 0.5)), (int)255);
+			dst_bits[col * nb_channels] = (BYTE)MIN(MAX((int)0, (int)(p + 0.5)), (int)255);
 		}
 	}
 
-	// free working array and return
-	free(ImageRasterArray);
-
-	return dst;
+	return true;
 }
 
 /** 
@@ -647,83 +786,60 @@ Rotate8Bit(FIBITMAP *dib, double angle, double x_shift, double y_shift, double x
 FIBITMAP * DLL_CALLCONV 
 FreeImage_RotateEx(FIBITMAP *dib, double angle, double x_shift, double y_shift, double x_origin, double y_origin, BOOL use_mask) {
 
-	int x, y, bpp;
-	int channel, nb_channels;
-	BYTE *src_bits, *dst_bits;
-	FIBITMAP *src8 = NULL, *dst8 = NULL, *dst = NULL;
+	int bpp;
+	unsigned channel, nb_channels;
+	float *ImageRasterArray = NULL;
+	FIBITMAP *dst = NULL;
 
 	if(!FreeImage_HasPixels(dib)) return NULL;
 
 	try {
 
 		bpp = FreeImage_GetBPP(dib);
+		if((bpp != 8) && (bpp != 24) && (bpp != 32)) {
+			return NULL;
+		}
 
+		// allocate dst image
+		int width  = FreeImage_GetWidth(dib);
+		int height = FreeImage_GetHeight(dib);
 		if(bpp == 8) {
-			FIBITMAP *dst_8 = Rotate8Bit(dib, angle, x_shift, y_shift, x_origin, y_origin, ROTATE_CUBIC, use_mask);
-			if(dst_8) {
-				// copy metadata from src to dst
-				FreeImage_CloneMetadata(dst_8, dib);
-			}
-			return dst_8;
-		}
-		if((bpp == 24) || (bpp == 32)) {
-			// allocate dst image
-			int width  = FreeImage_GetWidth(dib);
-			int height = FreeImage_GetHeight(dib);
-			if( bpp == 24 ) {
-				dst = FreeImage_Allocate(width, height, bpp, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
-			} else {
-				dst = FreeImage_Allocate(width, height, bpp, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
+			dst = FreeImage_Allocate(width, height, bpp);
+			if(!dst) throw(1);
+			// buid a grey scale palette
+			RGBQUAD *pal = FreeImage_GetPalette(dst);
+			for(int i = 0; i < 256; i++) {
+				pal[i].rgbRed = pal[i].rgbGreen = pal[i].rgbBlue = (BYTE)i;
 			}
+		} else {
+			dst = FreeImage_Allocate(width, height, bpp, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
 			if(!dst) throw(1);
+		}
 
-			// allocate a temporary 8-bit dib (no need to build a palette)
-			src8 = FreeImage_Allocate(width, height, 8);
-			if(!src8) throw(1);
-
-			// process each channel separately
-			// -------------------------------
-			nb_channels = (bpp / 8);
-
-			for(channel = 0; channel < nb_channels; channel++) {
-				// extract channel from source dib
-				for(y = 0; y < height; y++) {
-					src_bits = FreeImage_GetScanLine(dib, y);
-					dst_bits = FreeImage_GetScanLine(src8, y);
-					for(x = 0; x < width; x++) {
-						dst_bits[x] = src_bits[channel];
-						src_bits += nb_channels;
-					}
-				}
+		// allocate a temporary array, shared by all channels
+		ImageRasterArray = (float*)malloc((size_t)width * height * sizeof(float));
+		if(!ImageRasterArray) throw(1);
 
-				// process channel
-				dst8 = Rotate8Bit(src8, angle, x_shift, y_shift, x_origin, y_origin, ROTATE_CUBIC, use_mask);
-				if(!dst8) throw(1);
-
-				// insert channel to destination dib
-				for(y = 0; y < height; y++) {
-					src_bits = FreeImage_GetScanLine(dst8, y);
-					dst_bits = FreeImage_GetScanLine(dst, y);
-					for(x = 0; x < width; x++) {
-						dst_bits[channel] = src_bits[x];
-						dst_bits += nb_channels;
-					}
-				}
+		// process each channel separately
+		// -------------------------------
+		nb_channels = (bpp / 8);
 
-				FreeImage_Unload(dst8);
+		for(channel = 0; channel < nb_channels; channel++) {
+			if(!RotateChannel(dib, dst, channel, ImageRasterArray, angle, x_shift, y_shift, x_origin, y_origin, ROTATE_CUBIC, use_mask)) {
+				throw(1);
 			}
+		}
 
-			FreeImage_Unload(src8);
+		free(ImageRasterArray);
+
+		// copy metadata from src to dst
+		FreeImage_CloneMetadata(dst, dib);
+		
+		return dst;
 
-			// copy metadata from src to dst
-			FreeImage_CloneMetadata(dst, dib);
-			
-			return dst;
-		}
 	} catch(int) {
-		if(src8) FreeImage_Unload(src8);
-		if(dst8) FreeImage_Unload(dst8);
-		if(dst)  FreeImage_Unload(dst);
+		if(ImageRasterArray) free(ImageRasterArray);
+		if(dst) FreeImage_Unload(dst);
 	}
 
 	return NULL;
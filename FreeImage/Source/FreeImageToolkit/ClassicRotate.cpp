@@ -41,111 +41,187 @@
 // --------------------------------------------------------------------------
 
 /**
-Skews a row horizontally (with filtered weights). 
-Limited to 45 degree skewing only. Filters two adjacent pixels.
-Parameter T can be BYTE, WORD of float. 
-@param src Pointer to source image to rotate
-@param dst Pointer to destination image
-@param row Row index
-@param iOffset Skew offset
-@param dWeight Relative weight of right pixel
-@param bkcolor Background color
+Converts a skew weight in [0 .. 1) to fixed point 1.15.
 */
-template <class T> void 
-HorizontalSkewT(FIBITMAP *src, FIBITMAP *dst, int row, int iOffset, double weight, const void *bkcolor = NULL) {
-	int iXPos;
+static inline int 
+SkewWeight(double weight) {
+	return MIN((int)(weight * 32768 + 0.5), 32767);
+}
 
-	const unsigned src_width  = FreeImage_GetWidth(src);
-	const unsigned dst_width  = FreeImage_GetWidth(dst);
+/**
+Blends two samples with a 1.15 fixed point weight: b + (a - b) * weight.
+The 8-bit version rounds exactly like the SSE2 code in BlendSamplesT.
+*/
+template <class T> static inline T 
+BlendSample(T a, T b, int weight);
 
-	T pxlSrc[4], pxlLeft[4], pxlOldLeft[4];	// 4 = 4*sizeof(T) max
-	
-	// background
-	const T pxlBlack[4] = {0, 0, 0, 0 };
-	const T *pxlBkg = static_cast<const T*>(bkcolor); // assume at least bytespp and 4*sizeof(T) max
-	if(!pxlBkg) {
-		// default background color is black
-		pxlBkg = pxlBlack;
-	}
+template <> inline BYTE 
+BlendSample<BYTE>(BYTE a, BYTE b, int weight) {
+	return (BYTE)(b + (((((a - b) * 128 * weight) >> 16) + 32) >> 6));
+}
 
-	// calculate the number of bytes per pixel
-	const unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
-	// calculate the number of samples per pixel
-	const unsigned samples = bytespp / sizeof(T);
+template <> inline WORD 
+BlendSample<WORD>(WORD a, WORD b, int weight) {
+	return (WORD)(b + (((a - b) * weight + 16384) >> 15));
+}
 
-	BYTE *src_bits = FreeImage_GetScanLine(src, row);
-	BYTE *dst_bits = FreeImage_GetScanLine(dst, row);
+template <> inline float 
+BlendSample<float>(float a, float b, int weight) {
+	return b + (a - b) * ((float)weight * (1.0F / 32768));
+}
 
-	// fill gap left of skew with background
-	if(bkcolor) {
-		for(int k = 0; k < iOffset; k++) {
-			memcpy(&dst_bits[k * bytespp], bkcolor, bytespp);
+/**
+Blends two runs of samples: dst[k] = b[k] + (a[k] - b[k]) * weight, with one 
+1.15 fixed point weight per sample, or the same one for all samples if 
+uniform is TRUE. 8-bit samples are blended 16 at a time with SSE2.
+*/
+template <class T> static void 
+BlendSamplesT(T *dst, const T *a, const T *b, const WORD *weights, BOOL uniform, unsigned count) {
+	unsigned k = 0;
+	if(uniform) {
+		const int weight = weights[0];
+		for(; k < count; k++) {
+			dst[k] = BlendSample<T>(a[k], b[k], weight);
 		}
-		AssignPixel((BYTE*)&pxlOldLeft[0], (BYTE*)bkcolor, bytespp);
 	} else {
-		if(iOffset > 0) {
-			memset(dst_bits, 0, iOffset * bytespp);
-		}		
-		memset(&pxlOldLeft[0], 0, bytespp);
-	}
-
-	for(unsigned i = 0; i < src_width; i++) {
-		// loop through row pixels
-		AssignPixel((BYTE*)&pxlSrc[0], (BYTE*)src_bits, bytespp);
-		// calculate weights
-		for(unsigned j = 0; j < samples; j++) {
-			pxlLeft[j] = static_cast<T>(pxlBkg[j] + (pxlSrc[j] - pxlBkg[j]) * weight + 0.5);
+		for(; k < count; k++) {
+			dst[k] = BlendSample<T>(a[k], b[k], weights[k]);
 		}
-		// check boundaries 
-		iXPos = i + iOffset;
-		if((iXPos >= 0) && (iXPos < (int)dst_width)) {
-			// update left over on source
-			for(unsigned j = 0; j < samples; j++) {
-				pxlSrc[j] = pxlSrc[j] - (pxlLeft[j] - pxlOldLeft[j]);
-			}
-			AssignPixel((BYTE*)&dst_bits[iXPos*bytespp], (BYTE*)&pxlSrc[0], bytespp);
+	}
+}
+
+#ifdef FI_SSE2
+
+/**
+Blends 8 samples widened to 16 bits, see BlendSample<BYTE>.
+*/
+static inline __m128i 
+BlendSSE2(__m128i a, __m128i b, __m128i weight) {
+	// (a - b) * 128 fits in 16 bits, the high half of the product keeps 6 fractional bits
+	const __m128i d = _mm_slli_epi16(_mm_sub_epi16(a, b), 7);
+	const __m128i r = _mm_srai_epi16(_mm_add_epi16(_mm_mulhi_epi16(d, weight), _mm_set1_epi16(32)), 6);
+	return _mm_add_epi16(b, r);
+}
+
+template <> void 
+BlendSamplesT<BYTE>(BYTE *dst, const BYTE *a, const BYTE *b, const WORD *weights, BOOL uniform, unsigned count) {
+	const __m128i zero = _mm_setzero_si128();
+
+	__m128i wlo = _mm_set1_epi16((short)weights[0]);
+	__m128i whi = wlo;
+
+	unsigned k = 0;
+	for(; k + 16 <= count; k += 16) {
+		if(!uniform) {
+			wlo = _mm_loadu_si128((const __m128i*)(weights + k));
+			whi = _mm_loadu_si128((const __m128i*)(weights + k + 8));
 		}
-		// save leftover for next pixel in scan
-		AssignPixel((BYTE*)&pxlOldLeft[0], (BYTE*)&pxlLeft[0], bytespp);
+		const __m128i va = _mm_loadu_si128((const __m128i*)(a + k));
+		const __m128i vb = _mm_loadu_si128((const __m128i*)(b + k));
+		const __m128i lo = BlendSSE2(_mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vb, zero), wlo);
+		const __m128i hi = BlendSSE2(_mm_unpackhi_epi8(va, zero), _mm_unpackhi_epi8(vb, zero), whi);
+		_mm_storeu_si128((__m128i*)(dst + k), _mm_packus_epi16(lo, hi));
+	}
+	for(; k < count; k++) {
+		dst[k] = BlendSample<BYTE>(a[k], b[k], weights[uniform ? 0 : k]);
+	}
+}
 
-		// next pixel in scan
-		src_bits += bytespp;
-	}			
+#endif // FI_SSE2
+
+/**
+Fills count pixels with the background color.
+*/
+static void 
+FillBackground(BYTE *bits, const BYTE *bkg, unsigned bytespp, unsigned count, BOOL black) {
+	if(black) {
+		memset(bits, 0, count * bytespp);
+	} else {
+		for(unsigned i = 0; i < count; i++) {
+			memcpy(bits + i * bytespp, bkg, bytespp);
+		}
+	}
+}
+
+/**
+Skews all rows horizontally (with filtered weights), in parallel (OpenMP). 
+Limited to 45 degree skewing only. Filters two adjacent pixels: 
+pixel x of row y is src(x - shift) * (1 - weight) + src(x - shift - 1) * weight, 
+with shift and weight the integer and fractional part of shifts[y]. 
+Parameter T can be BYTE, WORD of float. 
+@param src Pointer to source image to rotate
+@param dst Pointer to destination image, with as many rows as src
+@param shifts Skew offset for each row
+@param bkcolor Background color
+@return Returns FALSE if out of memory, TRUE otherwise
+*/
+template <class T> static BOOL 
+HorizontalSkewT(FIBITMAP *src, FIBITMAP *dst, const double *shifts, const void *bkcolor) {
+	static const BYTE black[16] = { 0 };
+
+	const int src_width  = (int)FreeImage_GetWidth(src);
+	const int dst_width  = (int)FreeImage_GetWidth(dst);
+	const int height     = (int)FreeImage_GetHeight(dst);
+
+	// calculate the number of bytes per pixel
+	const unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
+	// calculate the number of samples per pixel
+	const unsigned samples = bytespp / sizeof(T);
 
-	// go to rightmost point of skew
-	iXPos = src_width + iOffset; 
+	const BYTE *bkg = bkcolor ? static_cast<const BYTE*>(bkcolor) : black;
+	const BOOL is_black = !memcmp(bkg, black, bytespp);
 
-	if((iXPos >= 0) && (iXPos < (int)dst_width)) {
-		dst_bits = FreeImage_GetScanLine(dst, row) + iXPos * bytespp;
+	BOOL bOutOfMemory = FALSE;
 
-		// If still in image bounds, put leftovers there
-		AssignPixel((BYTE*)dst_bits, (BYTE*)&pxlOldLeft[0], bytespp);
+#pragma omp parallel
+	{
+		// source row with a background pixel at either end
+		BYTE *line = (BYTE*)malloc((src_width + 2) * bytespp);
+		if(!line) {
+			bOutOfMemory = TRUE;
+		}
 
-		// clear to the right of the skewed line with background
-		dst_bits += bytespp;
-		if(bkcolor) {
-			for(unsigned i = 0; i < dst_width - iXPos - 1; i++) {
-				memcpy(&dst_bits[i * bytespp], bkcolor, bytespp);
+#pragma omp for
+		for(int y = 0; y < height; y++) {
+			if(!line) {
+				continue;
 			}
-		} else {
-			memset(dst_bits, 0, bytespp * (dst_width - iXPos - 1));
+			const int shift = (int)floor(shifts[y]);
+			const WORD weight = (WORD)SkewWeight(shifts[y] - shift);
+
+			memcpy(line, bkg, bytespp);
+			memcpy(line + bytespp, FreeImage_GetScanLine(src, y), src_width * bytespp);
+			memcpy(line + (src_width + 1) * bytespp, bkg, bytespp);
+
+			// the src_width + 1 pixels of the skewed row go to shift .. shift + src_width
+			const int x0 = MIN(MAX(0, shift), dst_width);
+			const int x1 = MAX(x0, MIN(dst_width, shift + src_width + 1));
+
+			BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
+			FillBackground(dst_bits, bkg, bytespp, x0, is_black);
+			if(x1 > x0) {
+				const BYTE *a = line + (x0 - shift) * bytespp;
+				BlendSamplesT<T>((T*)(dst_bits + x0 * bytespp), (const T*)a, (const T*)(a + bytespp), &weight, TRUE, (x1 - x0) * samples);
+			}
+			FillBackground(dst_bits + x1 * bytespp, bkg, bytespp, dst_width - x1, is_black);
 		}
 
+		free(line);
 	}
+
+	return !bOutOfMemory;
 }
 
 /**
-Skews a row horizontally (with filtered weights). 
-Limited to 45 degree skewing only. Filters two adjacent pixels.
+Skews all rows horizontally (with filtered weights), see HorizontalSkewT.
 @param src Pointer to source image to rotate
 @param dst Pointer to destination image
-@param row Row index
-@param iOffset Skew offset
-@param dWeight Relative weight of right pixel
+@param shifts Skew offset for each row
 @param bkcolor Background color
+@return Returns FALSE if out of memory, TRUE otherwise
 */
-static void 
-HorizontalSkew(FIBITMAP *src, FIBITMAP *dst, int row, int iOffset, double dWeight, const void *bkcolor) {
+static BOOL 
+HorizontalSkew(FIBITMAP *src, FIBITMAP *dst, const double *shifts, const void *bkcolor) {
 	FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(src);
 
 	switch(image_type) {
@@ -154,137 +230,109 @@ HorizontalSkew(FIBITMAP *src, FIBITMAP *dst, int row, int iOffset, double dWeigh
 				case 8:
 				case 24:
 				case 32:
-					HorizontalSkewT<BYTE>(src, dst, row, iOffset, dWeight, bkcolor);
-				break;
+					return HorizontalSkewT<BYTE>(src, dst, shifts, bkcolor);
 			}
 			break;
 		case FIT_UINT16:
 		case FIT_RGB16:
 		case FIT_RGBA16:
-			HorizontalSkewT<WORD>(src, dst, row, iOffset, dWeight, bkcolor);
-			break;
+			return HorizontalSkewT<WORD>(src, dst, shifts, bkcolor);
 		case FIT_FLOAT:
 		case FIT_RGBF:
 		case FIT_RGBAF:
-			HorizontalSkewT<float>(src, dst, row, iOffset, dWeight, bkcolor);
-			break;
+			return HorizontalSkewT<float>(src, dst, shifts, bkcolor);
 	}
+	return TRUE;
 }
 
 /**
-Skews a column vertically (with filtered weights). 
-Limited to 45 degree skewing only. Filters two adjacent pixels.
+Skews all columns vertically (with filtered weights). 
+Limited to 45 degree skewing only. Filters two adjacent pixels: 
+pixel y of column x is src(y - shift) * (1 - weight) + src(y - shift - 1) * weight, 
+with shift and weight the integer and fractional part of shifts[x]. 
+The destination is written row by row, in parallel (OpenMP): neighbouring 
+columns with the same shift read from the same two source rows and are 
+blended as one run of samples. 
 Parameter T can be BYTE, WORD of float. 
 @param src Pointer to source image to rotate
-@param dst Pointer to destination image
-@param col Column index
-@param iOffset Skew offset
-@param dWeight Relative weight of upper pixel
+@param dst Pointer to destination image, with as many columns as src
+@param shifts Skew offset for each column
 @param bkcolor Background color
+@return Returns FALSE if out of memory, TRUE otherwise
 */
-template <class T> void 
-VerticalSkewT(FIBITMAP *src, FIBITMAP *dst, int col, int iOffset, double weight, const void *bkcolor = NULL) {
-	int iYPos;
+template <class T> static BOOL 
+VerticalSkewT(FIBITMAP *src, FIBITMAP *dst, const double *shifts, const void *bkcolor) {
+	static const BYTE black[16] = { 0 };
 
-	unsigned src_height = FreeImage_GetHeight(src);
-	unsigned dst_height = FreeImage_GetHeight(dst);
-
-	T pxlSrc[4], pxlLeft[4], pxlOldLeft[4];	// 4 = 4*sizeof(T) max
-
-	// background
-	const T pxlBlack[4] = {0, 0, 0, 0 };
-	const T *pxlBkg = static_cast<const T*>(bkcolor); // assume at least bytespp and 4*sizeof(T) max
-	if(!pxlBkg) {
-		// default background color is black
-		pxlBkg = pxlBlack;
-	}
+	const unsigned width  = FreeImage_GetWidth(dst);
+	const int src_height  = (int)FreeImage_GetHeight(src);
+	const int dst_height  = (int)FreeImage_GetHeight(dst);
 
 	// calculate the number of bytes per pixel
 	const unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
 	// calculate the number of samples per pixel
 	const unsigned samples = bytespp / sizeof(T);
 
-	const unsigned src_pitch = FreeImage_GetPitch(src);
-	const unsigned dst_pitch = FreeImage_GetPitch(dst);
-	const unsigned index = col * bytespp;
-
-	BYTE *src_bits = FreeImage_GetBits(src) + index;
-	BYTE *dst_bits = FreeImage_GetBits(dst) + index;
+	const BYTE *bkg = bkcolor ? static_cast<const BYTE*>(bkcolor) : black;
 
-	// fill gap above skew with background
-	if(bkcolor) {
-		for(int k = 0; k < iOffset; k++) {
-			memcpy(dst_bits, bkcolor, bytespp);
-			dst_bits += dst_pitch;
-		}
-		memcpy(&pxlOldLeft[0], bkcolor, bytespp);
-	} else {
-		for(int k = 0; k < iOffset; k++) {
-			memset(dst_bits, 0, bytespp);
-			dst_bits += dst_pitch;
-		}
-		memset(&pxlOldLeft[0], 0, bytespp);
+	int *offsets = (int*)malloc(width * sizeof(int));
+	WORD *weights = (WORD*)malloc(width * samples * sizeof(WORD));
+	BYTE *bkg_line = (BYTE*)malloc(width * bytespp);
+	if(!offsets || !weights || !bkg_line) {
+		free(offsets);
+		free(weights);
+		free(bkg_line);
+		return FALSE;
 	}
 
-	for(unsigned i = 0; i < src_height; i++) {
-		// loop through column pixels
-		AssignPixel((BYTE*)(&pxlSrc[0]), src_bits, bytespp);
-		// calculate weights
-		for(unsigned j = 0; j < samples; j++) {
-			pxlLeft[j] = static_cast<T>(pxlBkg[j] + (pxlSrc[j] - pxlBkg[j]) * weight + 0.5);
-		}
-		// check boundaries
-		iYPos = i + iOffset;
-		if((iYPos >= 0) && (iYPos < (int)dst_height)) {
-			// update left over on source
-			for(unsigned j = 0; j < samples; j++) {
-				pxlSrc[j] = pxlSrc[j] - (pxlLeft[j] - pxlOldLeft[j]);
-			}
-			dst_bits = FreeImage_GetScanLine(dst, iYPos) + index;
-			AssignPixel(dst_bits, (BYTE*)(&pxlSrc[0]), bytespp);
+	for(unsigned x = 0; x < width; x++) {
+		offsets[x] = (int)floor(shifts[x]);
+		const WORD weight = (WORD)SkewWeight(shifts[x] - offsets[x]);
+		for(unsigned k = 0; k < samples; k++) {
+			weights[x * samples + k] = weight;
 		}
-		// save leftover for next pixel in scan
-		AssignPixel((BYTE*)(&pxlOldLeft[0]), (BYTE*)(&pxlLeft[0]), bytespp);
-
-		// next pixel in scan
-		src_bits += src_pitch;
 	}
-	// go to bottom point of skew
-	iYPos = src_height + iOffset;
+	FillBackground(bkg_line, bkg, bytespp, width, FALSE);
+
+#pragma omp parallel for
+	for(int y = 0; y < dst_height; y++) {
+		BYTE *dst_bits = FreeImage_GetScanLine(dst, y);
+		for(unsigned x0 = 0; x0 < width; ) {
+			const int shift = offsets[x0];
+			unsigned x1 = x0 + 1;
+			while((x1 < width) && (offsets[x1] == shift)) {
+				x1++;
+			}
 
-	if((iYPos >= 0) && (iYPos < (int)dst_height)) {
-		dst_bits = FreeImage_GetScanLine(dst, iYPos) + index;
+			// source rows above and below the skewed position
+			const int ya = y - shift - 1;
+			const int yb = y - shift;
+			const BYTE *a = ((ya >= 0) && (ya < src_height)) ? FreeImage_GetScanLine(src, ya) : bkg_line;
+			const BYTE *b = ((yb >= 0) && (yb < src_height)) ? FreeImage_GetScanLine(src, yb) : bkg_line;
 
-		// if still in image bounds, put leftovers there				
-		AssignPixel((BYTE*)(dst_bits), (BYTE*)(&pxlOldLeft[0]), bytespp);
+			BlendSamplesT<T>((T*)(dst_bits + x0 * bytespp), (const T*)(a + x0 * bytespp), (const T*)(b + x0 * bytespp), weights + x0 * samples, FALSE, (x1 - x0) * samples);
 
-		// clear below skewed line with background
-		if(bkcolor) {
-			while(++iYPos < (int)dst_height) {					
-				dst_bits += dst_pitch;
-				AssignPixel((BYTE*)(dst_bits), (BYTE*)(bkcolor), bytespp);
-			}
-		} else {
-			while(++iYPos < (int)dst_height) {					
-				dst_bits += dst_pitch;
-				memset(dst_bits, 0, bytespp);
-			}
+			x0 = x1;
 		}
 	}
+
+	free(offsets);
+	free(weights);
+	free(bkg_line);
+
+	return TRUE;
 }
 
 /**
-Skews a column vertically (with filtered weights). 
-Limited to 45 degree skewing only. Filters two adjacent pixels.
+Skews all columns vertically (with filtered weights), see VerticalSkewT.
 @param src Pointer to source image to rotate
 @param dst Pointer to destination image
-@param col Column index
-@param iOffset Skew offset
-@param dWeight Relative weight of upper pixel
+@param shifts Skew offset for each column
 @param bkcolor Background color
+@return Returns FALSE if out of memory, TRUE otherwise
 */
-static void 
-VerticalSkew(FIBITMAP *src, FIBITMAP *dst, int col, int iOffset, double dWeight, const void *bkcolor) {
+static BOOL 
+VerticalSkew(FIBITMAP *src, FIBITMAP *dst, const double *shifts, const void *bkcolor) {
 	FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(src);
 
 	switch(image_type) {
@@ -293,23 +341,276 @@ VerticalSkew(FIBITMAP *src, FIBITMAP *dst, int col, int iOffset, double dWeight,
 				case 8:
 				case 24:
 				case 32:
-					VerticalSkewT<BYTE>(src, dst, col, iOffset, dWeight, bkcolor);
-					break;
+					return VerticalSkewT<BYTE>(src, dst, shifts, bkcolor);
 			}
 			break;
-			case FIT_UINT16:
-			case FIT_RGB16:
-			case FIT_RGBA16:
-				VerticalSkewT<WORD>(src, dst, col, iOffset, dWeight, bkcolor);
-				break;
-			case FIT_FLOAT:
-			case FIT_RGBF:
-			case FIT_RGBAF:
-				VerticalSkewT<float>(src, dst, col, iOffset, dWeight, bkcolor);
-				break;
+		case FIT_UINT16:
+		case FIT_RGB16:
+		case FIT_RGBA16:
+			return VerticalSkewT<WORD>(src, dst, shifts, bkcolor);
+		case FIT_FLOAT:
+		case FIT_RGBF:
+		case FIT_RGBAF:
+			return VerticalSkewT<float>(src, dst, shifts, bkcolor);
 	}
+	return TRUE;
 } 
 
+#ifdef FI_SSE2
+
+/**
+Interleaves the low or high halves of two vectors of SIZE byte elements.
+*/
+template <unsigned SIZE> static inline __m128i UnpackLo(__m128i a, __m128i b);
+template <unsigned SIZE> static inline __m128i UnpackHi(__m128i a, __m128i b);
+
+template <> inline __m128i UnpackLo<1>(__m128i a, __m128i b) { return _mm_unpacklo_epi8(a, b); }
+template <> inline __m128i UnpackHi<1>(__m128i a, __m128i b) { return _mm_unpackhi_epi8(a, b); }
+template <> inline __m128i UnpackLo<2>(__m128i a, __m128i b) { return _mm_unpacklo_epi16(a, b); }
+template <> inline __m128i UnpackHi<2>(__m128i a, __m128i b) { return _mm_unpackhi_epi16(a, b); }
+template <> inline __m128i UnpackLo<4>(__m128i a, __m128i b) { return _mm_unpacklo_epi32(a, b); }
+template <> inline __m128i UnpackHi<4>(__m128i a, __m128i b) { return _mm_unpackhi_epi32(a, b); }
+template <> inline __m128i UnpackLo<8>(__m128i a, __m128i b) { return _mm_unpacklo_epi64(a, b); }
+template <> inline __m128i UnpackHi<8>(__m128i a, __m128i b) { return _mm_unpackhi_epi64(a, b); }
+
+/**
+One stage of an in-register transpose: interleaves the vector pairs (2i, 2i+1) 
+at SIZE bytes, then goes on with twice the size until the elements are 8 bytes.
+*/
+template <unsigned N, unsigned SIZE> struct TransposeStage {
+	static inline void apply(__m128i *r) {
+		__m128i t[N];
+		for(unsigned i = 0; i < N / 2; i++) {
+			t[i] = UnpackLo<SIZE>(r[2 * i], r[2 * i + 1]);
+			t[i + N / 2] = UnpackHi<SIZE>(r[2 * i], r[2 * i + 1]);
+		}
+		for(unsigned i = 0; i < N; i++) {
+			r[i] = t[i];
+		}
+		TransposeStage<N, SIZE * 2>::apply(r);
+	}
+};
+
+template <unsigned N> struct TransposeStage<N, 16> {
+	static inline void apply(__m128i *) {
+	}
+};
+
+/**
+Reverses the lowest bits of an index (N is a power of two).
+*/
+template <unsigned N> static inline unsigned 
+ReverseBits(unsigned i) {
+	unsigned r = 0;
+	for(unsigned n = 1; n < N; n <<= 1) {
+		r = (r << 1) | (i & 1);
+		i >>= 1;
+	}
+	return r;
+}
+
+/**
+Rotates a block of N x N pixels of BYTESPP = 16 / N bytes in registers: 
+N source vectors are loaded, transposed, and stored as N destination vectors.
+@param dst Destination pixel at (x, y)
+@param dst_pitch Destination pitch
+@param src Source pixel for (x, y)
+@param xstep Source offset of the pixel for (x + 1, y)
+@param ystep Source offset of the pixel for (x, y + 1), BYTESPP or -BYTESPP
+*/
+template <unsigned BYTESPP> static inline void 
+RotateBlockSSE2(BYTE *dst, int dst_pitch, const BYTE *src, int xstep, int ystep) {
+	const unsigned N = 16 / BYTESPP;
+
+	// vector i holds the pixels for (x + i, y .. y + N - 1), backwards if ystep < 0
+	const BYTE *p = (ystep < 0) ? src + (int)(N - 1) * ystep : src;
+	__m128i r[N];
+	for(unsigned i = 0; i < N; i++) {
+		r[i] = _mm_loadu_si128((const __m128i*)(p + (int)i * xstep));
+	}
+
+	TransposeStage<N, BYTESPP>::apply(r);
+
+	// the stages leave lane j of the source vectors in r[reversed bits of j]
+	for(unsigned j = 0; j < N; j++) {
+		const unsigned y = (ystep < 0) ? N - 1 - j : j;
+		_mm_storeu_si128((__m128i*)(dst + y * dst_pitch), r[ReverseBits<N>(j)]);
+	}
+}
+
+/**
+Rotates whole rows of N x N vector blocks, see RotateBlockSSE2. 
+The pixels right of the last vector block are copied one by one.
+@return Returns the number of destination rows done
+*/
+template <unsigned BYTESPP> static unsigned 
+RotateVectorsSSE2(BYTE *dst, int dst_pitch, const BYTE *src, int xstep, int ystep, unsigned width, unsigned height) {
+	typedef FixedPixel<BYTESPP> P;
+
+	const unsigned N = 16 / BYTESPP;
+
+	unsigned y = 0;
+	for(; y + N <= height; y += N) {
+		BYTE *dst_bits = dst + y * dst_pitch;
+		const BYTE *src_bits = src + (int)y * ystep;
+		unsigned x = 0;
+		for(; x + N <= width; x += N) {
+			RotateBlockSSE2<BYTESPP>(dst_bits + x * BYTESPP, dst_pitch, src_bits + (int)x * xstep, xstep, ystep);
+		}
+		for(unsigned k = 0; k < N; k++) {
+			P *d = (P*)(dst_bits + k * dst_pitch);
+			const BYTE *s = src_bits + (int)k * ystep;
+			for(unsigned i = x; i < width; i++) {
+				d[i] = *(const P*)(s + (int)i * xstep);
+			}
+		}
+	}
+	return y;
+}
+
+#endif // FI_SSE2
+
+/**
+Rotates as many rows of a block as possible a vector block at a time. 
+Pixel sizes not dividing 16 are left to the caller.
+@return Returns the number of destination rows done
+*/
+template <unsigned BYTESPP> static inline unsigned 
+RotateVectors(BYTE *, int, const BYTE *, int, int, unsigned, unsigned) {
+	return 0;
+}
+
+#ifdef FI_SSE2
+
+template <> inline unsigned 
+RotateVectors<1>(BYTE *dst, int dst_pitch, const BYTE *src, int xstep, int ystep, unsigned width, unsigned height) {
+	return RotateVectorsSSE2<1>(dst, dst_pitch, src, xstep, ystep, width, height);
+}
+
+template <> inline unsigned 
+RotateVectors<2>(BYTE *dst, int dst_pitch, const BYTE *src, int xstep, int ystep, unsigned width, unsigned height) {
+	return RotateVectorsSSE2<2>(dst, dst_pitch, src, xstep, ystep, width, height);
+}
+
+template <> inline unsigned 
+RotateVectors<4>(BYTE *dst, int dst_pitch, const BYTE *src, int xstep, int ystep, unsigned width, unsigned height) {
+	return RotateVectorsSSE2<4>(dst, dst_pitch, src, xstep, ystep, width, height);
+}
+
+template <> inline unsigned 
+RotateVectors<8>(BYTE *dst, int dst_pitch, const BYTE *src, int xstep, int ystep, unsigned width, unsigned height) {
+	return RotateVectorsSSE2<8>(dst, dst_pitch, src, xstep, ystep, width, height);
+}
+
+#endif // FI_SSE2
+
+/**
+Rotates the pixels of a block into a block of the destination.
+@param dst Destination pixel at (0, 0) of the block
+@param dst_pitch Destination pitch
+@param src Source pixel for (0, 0)
+@param xstep Source offset of the pixel for (x + 1, y)
+@param ystep Source offset of the pixel for (x, y + 1)
+@param width Block width
+@param height Block height
+*/
+template <unsigned BYTESPP> static void 
+RotateBlockT(BYTE *dst, int dst_pitch, const BYTE *src, int xstep, int ystep, unsigned width, unsigned height) {
+	typedef FixedPixel<BYTESPP> P;
+
+	for(unsigned y = RotateVectors<BYTESPP>(dst, dst_pitch, src, xstep, ystep, width, height); y < height; y++) {
+		P *d = (P*)(dst + y * dst_pitch);
+		const BYTE *s = src + (int)y * ystep;
+		for(unsigned x = 0; x < width; x++) {
+			d[x] = *(const P*)s;
+			s += xstep;
+		}
+	}
+}
+
+/**
+Rotates an image by 90 or 270 degrees into a preallocated destination.
+The destination is split into RBLOCK x RBLOCK blocks, so that the source 
+columns read for a block stay in the cache. Rows of blocks are rotated in 
+parallel (OpenMP).
+@param src Source image
+@param dst Destination image, with width and height swapped
+@param rotate90 TRUE for 90 degrees, FALSE for 270 degrees
+*/
+template <unsigned BYTESPP> static void 
+RotateBlocksT(FIBITMAP *src, FIBITMAP *dst, BOOL rotate90) {
+	const int src_pitch  = (int)FreeImage_GetPitch(src);
+	const int dst_pitch  = (int)FreeImage_GetPitch(dst);
+	const unsigned dst_width  = FreeImage_GetWidth(dst);
+	const unsigned dst_height = FreeImage_GetHeight(dst);
+
+	const BYTE *bsrc = FreeImage_GetBits(src);
+	BYTE *bdest = FreeImage_GetBits(dst);
+
+	// dst(x, y) is the source pixel at origin + x * xstep + y * ystep
+	const BYTE *origin;
+	int xstep, ystep;
+	if(rotate90) {
+		// dst(x, y) = src(src_width - 1 - y, x)
+		origin = bsrc + (FreeImage_GetWidth(src) - 1) * BYTESPP;
+		xstep = src_pitch;
+		ystep = -(int)BYTESPP;
+	} else {
+		// dst(x, y) = src(y, src_height - 1 - x)
+		origin = bsrc + (size_t)(FreeImage_GetHeight(src) - 1) * src_pitch;
+		xstep = -src_pitch;
+		ystep = BYTESPP;
+	}
+
+	const int block_rows = (int)((dst_height + RBLOCK - 1) / RBLOCK);
+
+#pragma omp parallel for
+	for(int row = 0; row < block_rows; row++) {
+		const unsigned ys = row * RBLOCK;
+		const unsigned height = MIN(dst_height - ys, (unsigned)RBLOCK);
+		for(unsigned xs = 0; xs < dst_width; xs += RBLOCK) {
+			const unsigned width = MIN(dst_width - xs, (unsigned)RBLOCK);
+			RotateBlockT<BYTESPP>(
+				bdest + (size_t)ys * dst_pitch + xs * BYTESPP, dst_pitch,
+				origin + (ptrdiff_t)xs * xstep + (ptrdiff_t)ys * ystep, xstep, ystep,
+				width, height);
+		}
+	}
+}
+
+/**
+Rotates an image of 8 bits or more per pixel by 90 or 270 degrees, see RotateBlocksT.
+*/
+static void 
+RotateBlocks(FIBITMAP *src, FIBITMAP *dst, unsigned bytespp, BOOL rotate90) {
+	switch(bytespp) {
+		case 1:
+			RotateBlocksT<1>(src, dst, rotate90);
+			break;
+		case 2:
+			RotateBlocksT<2>(src, dst, rotate90);
+			break;
+		case 3:
+			RotateBlocksT<3>(src, dst, rotate90);
+			break;
+		case 4:
+			RotateBlocksT<4>(src, dst, rotate90);
+			break;
+		case 6:
+			RotateBlocksT<6>(src, dst, rotate90);
+			break;
+		case 8:
+			RotateBlocksT<8>(src, dst, rotate90);
+			break;
+		case 12:
+			RotateBlocksT<12>(src, dst, rotate90);
+			break;
+		case 16:
+			RotateBlocksT<16>(src, dst, rotate90);
+			break;
+	}
+}
+
 /**
 Rotates an image by 90 degrees (counter clockwise). 
 Precise rotation, no filters required.<br>
@@ -368,41 +669,7 @@ Rotate90(FIBITMAP *src) {
 				}
 			}
 			else if((bpp == 8) || (bpp == 24) || (bpp == 32)) {
-				// anything other than BW :
-				// This optimized version of rotation rotates image by smaller blocks. It is quite
-				// a bit faster than obvious algorithm, because it produces much less CPU cache misses.
-				// This optimization can be tuned by changing block size (RBLOCK). 96 is good value for current
-				// CPUs (tested on Athlon XP and Celeron D). Larger value (if CPU has enough cache) will increase
-				// speed somehow, but once you drop out of CPU's cache, things will slow down drastically.
-				// For older CPUs with less cache, lower value would yield better results.
-
-				BYTE *bsrc  = FreeImage_GetBits(src);  // source pixels
-				BYTE *bdest = FreeImage_GetBits(dst);  // destination pixels
-
-				// calculate the number of bytes per pixel (1 for 8-bit, 3 for 24-bit or 4 for 32-bit)
-				const unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
-				
-				// for all image blocks of RBLOCK*RBLOCK pixels
-				
-				// x-segment
-				for(unsigned xs = 0; xs < dst_width; xs += RBLOCK) {
-					// y-segment
-					for(unsigned ys = 0; ys < dst_height; ys += RBLOCK) {
-						for(unsigned y = ys; y < MIN(dst_height, ys + RBLOCK); y++) {    // do rotation
-							const unsigned y2 = dst_height - y - 1;
-							// point to src pixel at (y2, xs)
-							BYTE *src_bits = bsrc + (xs * src_pitch) + (y2 * bytespp);
-							// point to dst pixel at (xs, y)
-							BYTE *dst_bits = bdest + (y * dst_pitch) + (xs * bytespp);
-							for(unsigned x = xs; x < MIN(dst_width, xs + RBLOCK); x++) {
-								// dst.SetPixel(x, y, src.GetPixel(y2, x));
-								AssignPixel(dst_bits, src_bits, bytespp);
-								dst_bits += bytespp;
-								src_bits += src_pitch;
-							}
-						}
-					}
-				}
+				RotateBlocks(src, dst, FreeImage_GetLine(src) / FreeImage_GetWidth(src), TRUE);
 			}
 			break;
 		case FIT_UINT16:
@@ -411,24 +678,8 @@ Rotate90(FIBITMAP *src) {
 		case FIT_FLOAT:
 		case FIT_RGBF:
 		case FIT_RGBAF:
-		{
-			BYTE *bsrc  = FreeImage_GetBits(src);  // source pixels
-			BYTE *bdest = FreeImage_GetBits(dst);  // destination pixels
-
-			// calculate the number of bytes per pixel
-			const unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
-
-			for(unsigned y = 0; y < dst_height; y++) {
-				BYTE *src_bits = bsrc + (src_width - 1 - y) * bytespp;
-				BYTE *dst_bits = bdest + (y * dst_pitch);
-				for(unsigned x = 0; x < dst_width; x++) {
-					AssignPixel(dst_bits, src_bits, bytespp);
-					src_bits += src_pitch;
-					dst_bits += bytespp;
-				}
-			}
-		}
-		break;
+			RotateBlocks(src, dst, FreeImage_GetLine(src) / FreeImage_GetWidth(src), TRUE);
+			break;
 	}
 
 	return dst;
@@ -442,7 +693,7 @@ Precise rotation, no filters required.
 */
 static FIBITMAP* 
 Rotate180(FIBITMAP *src) {
-	int x, y, k, pos;
+	int k, pos;
 
 	const int bpp = FreeImage_GetBPP(src);
 
@@ -479,23 +730,10 @@ Rotate180(FIBITMAP *src) {
 		case FIT_FLOAT:
 		case FIT_RGBF:
 		case FIT_RGBAF:
-		{
-			 // Calculate the number of bytes per pixel
-			const int bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
-
-			for(y = 0; y < src_height; y++) {
-				BYTE *src_bits = FreeImage_GetScanLine(src, y);
-				BYTE *dst_bits = FreeImage_GetScanLine(dst, dst_height - y - 1) + (dst_width - 1) * bytespp;
-				for(x = 0; x < src_width; x++) {
-					// get pixel at (x, y)
-					// set pixel at (dst_width - x - 1, dst_height - y - 1)
-					AssignPixel(dst_bits, src_bits, bytespp);
-					src_bits += bytespp;
-					dst_bits -= bytespp;					
-				}				
-			}
-		}
-		break;
+			// copy, then mirror the lines of the copy into each other in place
+			memcpy(FreeImage_GetBits(dst), FreeImage_GetBits(src), (size_t)FreeImage_GetPitch(src) * src_height);
+			FreeImage_Rotate180(dst);
+			break;
 	}
 
 	return dst;
@@ -510,7 +748,7 @@ Code adapted from CxImage (http://www.xdp.it/cximage.htm)
 */
 static FIBITMAP* 
 Rotate270(FIBITMAP *src) {
-	int x2, dlineup;
+	int dlineup;
 
 	const unsigned bpp = FreeImage_GetBPP(src);
 
@@ -560,41 +798,7 @@ Rotate270(FIBITMAP *src) {
 				}
 			} 
 			else if((bpp == 8) || (bpp == 24) || (bpp == 32)) {
-				// anything other than BW :
-				// This optimized version of rotation rotates image by smaller blocks. It is quite
-				// a bit faster than obvious algorithm, because it produces much less CPU cache misses.
-				// This optimization can be tuned by changing block size (RBLOCK). 96 is good value for current
-				// CPUs (tested on Athlon XP and Celeron D). Larger value (if CPU has enough cache) will increase
-				// speed somehow, but once you drop out of CPU's cache, things will slow down drastically.
-				// For older CPUs with less cache, lower value would yield better results.
-
-				BYTE *bsrc  = FreeImage_GetBits(src);  // source pixels
-				BYTE *bdest = FreeImage_GetBits(dst);  // destination pixels
-
-				// Calculate the number of bytes per pixel (1 for 8-bit, 3 for 24-bit or 4 for 32-bit)
-				const unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
-
-				// for all image blocks of RBLOCK*RBLOCK pixels
-
-				// x-segment
-				for(unsigned xs = 0; xs < dst_width; xs += RBLOCK) {
-					// y-segment
-					for(unsigned ys = 0; ys < dst_height; ys += RBLOCK) {
-						for(unsigned x = xs; x < MIN(dst_width, xs + RBLOCK); x++) {    // do rotation
-							x2 = dst_width - x - 1;
-							// point to src pixel at (ys, x2)
-							BYTE *src_bits = bsrc + (x2 * src_pitch) + (ys * bytespp);
-							// point to dst pixel at (x, ys)
-							BYTE *dst_bits = bdest + (ys * dst_pitch) + (x * bytespp);
-							for(unsigned y = ys; y < MIN(dst_height, ys + RBLOCK); y++) {
-								// dst.SetPixel(x, y, src.GetPixel(y, x2));
-								AssignPixel(dst_bits, src_bits, bytespp);
-								src_bits += bytespp;
-								dst_bits += dst_pitch;
-							}
-						}
-					}
-				}
+				RotateBlocks(src, dst, FreeImage_GetLine(src) / FreeImage_GetWidth(src), FALSE);
 			}
 			break;
 		case FIT_UINT16:
@@ -603,24 +807,8 @@ Rotate270(FIBITMAP *src) {
 		case FIT_FLOAT:
 		case FIT_RGBF:
 		case FIT_RGBAF:
-		{
-			BYTE *bsrc  = FreeImage_GetBits(src);  // source pixels
-			BYTE *bdest = FreeImage_GetBits(dst);  // destination pixels
-
-			// calculate the number of bytes per pixel
-			const unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
-
-			for(unsigned y = 0; y < dst_height; y++) {
-				BYTE *src_bits = bsrc + (src_height - 1) * src_pitch + y * bytespp;
-				BYTE *dst_bits = bdest + (y * dst_pitch);
-				for(unsigned x = 0; x < dst_width; x++) {
-					AssignPixel(dst_bits, src_bits, bytespp);
-					src_bits -= src_pitch;
-					dst_bits += bytespp;
-				}
-			}
-		}
-		break;
+			RotateBlocks(src, dst, FreeImage_GetLine(src) / FreeImage_GetWidth(src), FALSE);
+			break;
 	}
 
 	return dst;
@@ -654,41 +842,54 @@ Rotate45(FIBITMAP *src, double dAngle, const void *bkcolor) {
 	const unsigned width_1  = src_width + unsigned((double)src_height * fabs(dTan) + 0.5);
 	const unsigned height_1 = src_height; 
 
+	// Calc 2nd shear (vertical) destination image dimensions
+	const unsigned width_2  = width_1;
+	unsigned height_2 = unsigned((double)src_width * fabs(dSinE) + (double)src_height * cos(dRadAngle) + 0.5) + 1;
+
+	// Calc 3rd shear (horizontal) destination image dimensions
+	const unsigned width_3  = unsigned(double(src_height) * fabs(dSinE) + double(src_width) * cos(dRadAngle) + 0.5) + 1;
+	const unsigned height_3 = height_2;
+
+	// Skew offsets of the rows or columns of each shear
+	double *shifts = (double*)malloc(MAX(MAX(height_1, width_2), height_3) * sizeof(double));
+	if(NULL == shifts) {
+		return NULL;
+	}
+
 	// Perform 1st shear (horizontal)
 	// ----------------------------------------------------------------------
 
 	// Allocate image for 1st shear
 	FIBITMAP *dst1 = FreeImage_AllocateT(image_type, width_1, height_1, bpp);
 	if(NULL == dst1) {
+		free(shifts);
 		return NULL;
 	}
 	
 	for(u = 0; u < height_1; u++) {  
-		double dShear;
-
 		if(dTan >= 0)	{
 			// Positive angle
-			dShear = (u + 0.5) * dTan;
+			shifts[u] = (u + 0.5) * dTan;
 		}
 		else {
 			// Negative angle
-			dShear = (double(u) - height_1 + 0.5) * dTan;
+			shifts[u] = (double(u) - height_1 + 0.5) * dTan;
 		}
-		int iShear = int(floor(dShear));
-		HorizontalSkew(src, dst1, u, iShear, dShear - double(iShear), bkcolor);
+	}
+	if(!HorizontalSkew(src, dst1, shifts, bkcolor)) {
+		FreeImage_Unload(dst1);
+		free(shifts);
+		return NULL;
 	}
 
 	// Perform 2nd shear  (vertical)
 	// ----------------------------------------------------------------------
 
-	// Calc 2nd shear (vertical) destination image dimensions
-	const unsigned width_2  = width_1;
-	unsigned height_2 = unsigned((double)src_width * fabs(dSinE) + (double)src_height * cos(dRadAngle) + 0.5) + 1;
-
 	// Allocate image for 2nd shear
 	FIBITMAP *dst2 = FreeImage_AllocateT(image_type, width_2, height_2, bpp);
 	if(NULL == dst2) {
 		FreeImage_Unload(dst1);
+		free(shifts);
 		return NULL;
 	}
 
@@ -703,9 +904,9 @@ Rotate45(FIBITMAP *src, double dAngle, const void *bkcolor) {
 	}
 
 	for(u = 0; u < width_2; u++, dOffset -= dSinE) {
-		int iShear = int(floor(dOffset));
-		VerticalSkew(dst1, dst2, u, iShear, dOffset - double(iShear), bkcolor);
+		shifts[u] = dOffset;
 	}
+	const BOOL bSkewed = VerticalSkew(dst1, dst2, shifts, bkcolor);
 
 	// Perform 3rd shear (horizontal)
 	// ----------------------------------------------------------------------
@@ -713,14 +914,11 @@ Rotate45(FIBITMAP *src, double dAngle, const void *bkcolor) {
 	// Free result of 1st shear
 	FreeImage_Unload(dst1);
 
-	// Calc 3rd shear (horizontal) destination image dimensions
-	const unsigned width_3  = unsigned(double(src_height) * fabs(dSinE) + double(src_width) * cos(dRadAngle) + 0.5) + 1;
-	const unsigned height_3 = height_2;
-
 	// Allocate image for 3rd shear
-	FIBITMAP *dst3 = FreeImage_AllocateT(image_type, width_3, height_3, bpp);
+	FIBITMAP *dst3 = bSkewed ? FreeImage_AllocateT(image_type, width_3, height_3, bpp) : NULL;
 	if(NULL == dst3) {
 		FreeImage_Unload(dst2);
+		free(shifts);
 		return NULL;
 	}
 
@@ -733,11 +931,15 @@ Rotate45(FIBITMAP *src, double dAngle, const void *bkcolor) {
 		dOffset = dTan * ( (src_width - 1.0) * -dSinE + (1.0 - height_3) );
 	}
 	for(u = 0; u < height_3; u++, dOffset += dTan) {
-		int iShear = int(floor(dOffset));
-		HorizontalSkew(dst2, dst3, u, iShear, dOffset - double(iShear), bkcolor);
+		shifts[u] = dOffset;
+	}
+	if(!HorizontalSkew(dst2, dst3, shifts, bkcolor)) {
+		FreeImage_Unload(dst3);
+		dst3 = NULL;
 	}
 	// Free result of 2nd shear    
 	FreeImage_Unload(dst2);
+	free(shifts);
 
 	// Return result of 3rd shear
 	return dst3;      
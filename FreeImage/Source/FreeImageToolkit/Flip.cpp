@@ -24,99 +24,241 @@
 #include "FreeImage.h"
 #include "Utilities.h"
 
+// ----------------------------------------------------------
+
+#ifdef FI_SSE2
+
 /**
-Flip the image horizontally along the vertical axis.
-@param src Input image to be processed.
-@return Returns TRUE if successful, FALSE otherwise.
+Reverses the order of the pixels in a vector of 16 / BYTESPP pixels.
 */
-BOOL DLL_CALLCONV 
-FreeImage_FlipHorizontal(FIBITMAP *src) {
-	if (!FreeImage_HasPixels(src)) return FALSE;
+template <unsigned BYTESPP> static inline __m128i
+ReverseVector(__m128i v);
+
+template <> inline __m128i
+ReverseVector<2>(__m128i v) {
+	v = _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+	v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+	return _mm_shufflehi_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+}
 
-	unsigned line   = FreeImage_GetLine(src);
-	unsigned width	= FreeImage_GetWidth(src);
-	unsigned height = FreeImage_GetHeight(src);
+template <> inline __m128i
+ReverseVector<1>(__m128i v) {
+	// reverse the words, then swap the bytes of each word
+	v = ReverseVector<2>(v);
+	return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
 
-	unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
+template <> inline __m128i
+ReverseVector<4>(__m128i v) {
+	return _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+}
 
-	// copy between aligned memories
-	BYTE *new_bits = (BYTE*)FreeImage_Aligned_Malloc(line * sizeof(BYTE), FIBITMAP_ALIGNMENT);
-	if (!new_bits) return FALSE;
+template <> inline __m128i
+ReverseVector<8>(__m128i v) {
+	return _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+}
 
-	// mirror the buffer
+/**
+Mirrors the outer vectors of two lines into each other, see MirrorLinesT.
+@return Returns the number of pixels done at either end
+*/
+template <unsigned BYTESPP> static unsigned 
+MirrorVectorsSSE2(BYTE *a, BYTE *b, unsigned width) {
+	const unsigned step = 16 / BYTESPP;
+
+	unsigned i = 0;
+	for(; 2 * (i + step) <= width; i += step) {
+		const unsigned j = width - i - step;
+		const __m128i al = _mm_loadu_si128((const __m128i*)(a + i * BYTESPP));
+		const __m128i ar = _mm_loadu_si128((const __m128i*)(a + j * BYTESPP));
+		const __m128i bl = _mm_loadu_si128((const __m128i*)(b + i * BYTESPP));
+		const __m128i br = _mm_loadu_si128((const __m128i*)(b + j * BYTESPP));
+		_mm_storeu_si128((__m128i*)(a + i * BYTESPP), ReverseVector<BYTESPP>(br));
+		_mm_storeu_si128((__m128i*)(a + j * BYTESPP), ReverseVector<BYTESPP>(bl));
+		_mm_storeu_si128((__m128i*)(b + i * BYTESPP), ReverseVector<BYTESPP>(ar));
+		_mm_storeu_si128((__m128i*)(b + j * BYTESPP), ReverseVector<BYTESPP>(al));
+	}
+	return i;
+}
 
-	for (unsigned y = 0; y < height; y++) {
-		BYTE *bits = FreeImage_GetScanLine(src, y);
-		memcpy(new_bits, bits, line);
-
-		switch (FreeImage_GetBPP(src)) {
-			case 1 :
-			{				
-				for(unsigned x = 0; x < width; x++) {
-					// get pixel at (x, y)
-					BOOL value = (new_bits[x >> 3] & (0x80 >> (x & 0x07))) != 0;
-					// set pixel at (new_x, y)
-					unsigned new_x = width - 1 - x;
-					value ? bits[new_x >> 3] |= (0x80 >> (new_x & 0x7)) : bits[new_x >> 3] &= (0xff7f >> (new_x & 0x7));
-				}
-			}
-			break;
+#endif // FI_SSE2
 
-			case 4 :
-			{
-				for(unsigned c = 0; c < line; c++) {
-					bits[c] = new_bits[line - c - 1];
+/**
+Mirrors as much of two lines as possible a vector at a time. 
+Pixel sizes not dividing 16 are left to the caller.
+@return Returns the number of pixels done at either end
+*/
+template <unsigned BYTESPP> static inline unsigned 
+MirrorVectors(BYTE *, BYTE *, unsigned) {
+	return 0;
+}
 
-					BYTE nibble = (bits[c] & 0xF0) >> 4;
+#ifdef FI_SSE2
 
-					bits[c] = bits[c] << 4;
-					bits[c] |= nibble;
-				}
-			}
-			break;
+template <> inline unsigned 
+MirrorVectors<1>(BYTE *a, BYTE *b, unsigned width) {
+	return MirrorVectorsSSE2<1>(a, b, width);
+}
 
-			case 8:
-			{				
-				BYTE *dst_data = (BYTE*) bits; 				
-				BYTE *src_data = (BYTE*) (new_bits + line - bytespp); 				
-				for(unsigned c = 0; c < width; c++) { 			
-					*dst_data++ = *src_data--;  
-				} 
-			}
-			break;
+template <> inline unsigned 
+MirrorVectors<2>(BYTE *a, BYTE *b, unsigned width) {
+	return MirrorVectorsSSE2<2>(a, b, width);
+}
 
-			case 16:
-			{				
-				WORD *dst_data = (WORD*) bits; 				
-				WORD *src_data = (WORD*) (new_bits + line - bytespp); 				
-				for(unsigned c = 0; c < width; c++) { 			
-					*dst_data++ = *src_data--;  
-				} 
-			}
-			break;
+template <> inline unsigned 
+MirrorVectors<4>(BYTE *a, BYTE *b, unsigned width) {
+	return MirrorVectorsSSE2<4>(a, b, width);
+}
+
+template <> inline unsigned 
+MirrorVectors<8>(BYTE *a, BYTE *b, unsigned width) {
+	return MirrorVectorsSSE2<8>(a, b, width);
+}
+
+#endif // FI_SSE2
+
+/**
+Mirrors two lines into each other: a becomes b read backwards and b becomes a 
+read backwards. With a == b, a single line is mirrored in place. 
+Works inwards from both ends, a vector at a time with SSE2 where the 
+pixel size allows.
+@param a First line
+@param b Second line, or the first one again
+@param width Line width in pixels
+*/
+template <unsigned BYTESPP> static void 
+MirrorLinesT(BYTE *a, BYTE *b, unsigned width) {
+	typedef FixedPixel<BYTESPP> P;
+
+	unsigned i = MirrorVectors<BYTESPP>(a, b, width);
+
+	P *pa = (P*)a;
+	P *pb = (P*)b;
+	for(; 2 * i + 1 <= width; i++) {
+		const unsigned j = width - 1 - i;
+		const P al = pa[i], ar = pa[j];
+		const P bl = pb[i], br = pb[j];
+		pa[i] = br;
+		pa[j] = bl;
+		pb[i] = ar;
+		pb[j] = al;
+	}
+}
 
-			case 24 :
-			case 32 :
-			case 48:
-			case 64:
-			case 96:
-			case 128:
-			{				
-				BYTE *dst_data = (BYTE*) bits; 				
-				BYTE *src_data = (BYTE*) (new_bits + line - bytespp); 				
-				for(unsigned c = 0; c < width; c++) { 		
-					for(unsigned k = 0; k < bytespp; k++) {
-						*dst_data++ = src_data[k];  
-					}
-					src_data -= bytespp;
-				} 
-			}
+/**
+Mirrors two lines of bytespp bytes per pixel into each other, see MirrorLinesT.
+*/
+static void 
+MirrorLines(BYTE *a, BYTE *b, unsigned width, unsigned bytespp) {
+	switch(bytespp) {
+		case 1:
+			MirrorLinesT<1>(a, b, width);
+			break;
+		case 2:
+			MirrorLinesT<2>(a, b, width);
+			break;
+		case 3:
+			MirrorLinesT<3>(a, b, width);
+			break;
+		case 4:
+			MirrorLinesT<4>(a, b, width);
 			break;
+		case 6:
+			MirrorLinesT<6>(a, b, width);
+			break;
+		case 8:
+			MirrorLinesT<8>(a, b, width);
+			break;
+		case 12:
+			MirrorLinesT<12>(a, b, width);
+			break;
+		case 16:
+			MirrorLinesT<16>(a, b, width);
+			break;
+	}
+}
+
+/**
+Mirrors a line of 1- or 4-bit pixels in place.
+@param bits Line to mirror
+@param tmp Scratch line of at least line bytes
+*/
+static void 
+MirrorPackedLine(BYTE *bits, BYTE *tmp, unsigned width, unsigned line, unsigned bpp) {
+	memcpy(tmp, bits, line);
+
+	if(bpp == 1) {
+		for(unsigned x = 0; x < width; x++) {
+			// get pixel at (x, y)
+			BOOL value = (tmp[x >> 3] & (0x80 >> (x & 0x07))) != 0;
+			// set pixel at (new_x, y)
+			unsigned new_x = width - 1 - x;
+			value ? bits[new_x >> 3] |= (0x80 >> (new_x & 0x7)) : bits[new_x >> 3] &= (0xff7f >> (new_x & 0x7));
+		}
+	} else {
+		for(unsigned c = 0; c < line; c++) {
+			bits[c] = tmp[line - c - 1];
+
+			BYTE nibble = (bits[c] & 0xF0) >> 4;
 
+			bits[c] = bits[c] << 4;
+			bits[c] |= nibble;
 		}
 	}
+}
+
+/**
+Swaps the contents of two lines.
+*/
+static void 
+SwapLines(BYTE *a, BYTE *b, unsigned size) {
+	BYTE tmp[256];
+	for(unsigned offset = 0; offset < size; offset += sizeof(tmp)) {
+		const unsigned count = MIN((unsigned)sizeof(tmp), size - offset);
+		memcpy(tmp, a + offset, count);
+		memcpy(a + offset, b + offset, count);
+		memcpy(b + offset, tmp, count);
+	}
+}
+
+// ----------------------------------------------------------
+
+/**
+Flip the image horizontally along the vertical axis.
+Lines are mirrored in place, in parallel (OpenMP).
+@param src Input image to be processed.
+@return Returns TRUE if successful, FALSE otherwise.
+*/
+BOOL DLL_CALLCONV 
+FreeImage_FlipHorizontal(FIBITMAP *src) {
+	if (!FreeImage_HasPixels(src)) return FALSE;
+
+	const unsigned line   = FreeImage_GetLine(src);
+	const unsigned width  = FreeImage_GetWidth(src);
+	const int height      = (int)FreeImage_GetHeight(src);
+	const unsigned bpp    = FreeImage_GetBPP(src);
 
-	FreeImage_Aligned_Free(new_bits);
+	if((bpp == 1) || (bpp == 4)) {
+		// copy between aligned memories
+		BYTE *new_bits = (BYTE*)FreeImage_Aligned_Malloc(line * sizeof(BYTE), FIBITMAP_ALIGNMENT);
+		if (!new_bits) return FALSE;
+
+		for (int y = 0; y < height; y++) {
+			MirrorPackedLine(FreeImage_GetScanLine(src, y), new_bits, width, line, bpp);
+		}
+
+		FreeImage_Aligned_Free(new_bits);
+
+		return TRUE;
+	}
+
+	const unsigned bytespp = line / width;
+
+#pragma omp parallel for
+	for (int y = 0; y < height; y++) {
+		BYTE *bits = FreeImage_GetScanLine(src, y);
+		MirrorLines(bits, bits, width, bytespp);
+	}
 
 	return TRUE;
 }
@@ -124,43 +266,53 @@ FreeImage_FlipHorizontal(FIBITMAP *src) {
 
 /**
 Flip the image vertically along the horizontal axis.
+Pairs of lines are swapped in place, in parallel (OpenMP).
 @param src Input image to be processed.
 @return Returns TRUE if successful, FALSE otherwise.
 */
 
 BOOL DLL_CALLCONV 
 FreeImage_FlipVertical(FIBITMAP *src) {
-	BYTE *From, *Mid;
-
 	if (!FreeImage_HasPixels(src)) return FALSE;
 
-	// swap the buffer
+	const unsigned pitch = FreeImage_GetPitch(src);
+	const int height     = (int)FreeImage_GetHeight(src);
 
-	unsigned pitch  = FreeImage_GetPitch(src);
-	unsigned height = FreeImage_GetHeight(src);
+	BYTE *bits = FreeImage_GetBits(src);
 
-	// copy between aligned memories
-	Mid = (BYTE*)FreeImage_Aligned_Malloc(pitch * sizeof(BYTE), FIBITMAP_ALIGNMENT);
-	if (!Mid) return FALSE;
+#pragma omp parallel for
+	for(int y = 0; y < height / 2; y++) {
+		SwapLines(bits + (size_t)y * pitch, bits + (size_t)(height - 1 - y) * pitch, pitch);
+	}
 
-	From = FreeImage_GetBits(src);
-	
-	unsigned line_s = 0;
-	unsigned line_t = (height-1) * pitch;
+	return TRUE;
+}
 
-	for(unsigned y = 0; y < height/2; y++) {
+/**
+Rotate the image by 180 degrees, in place.
+Unlike FreeImage_Rotate, no new image is allocated: pairs of lines are 
+mirrored into each other, in parallel (OpenMP).
+@param src Input image to be processed.
+@return Returns TRUE if successful, FALSE otherwise.
+*/
+BOOL DLL_CALLCONV 
+FreeImage_Rotate180(FIBITMAP *src) {
+	if (!FreeImage_HasPixels(src)) return FALSE;
 
-		memcpy(Mid, From + line_s, pitch);
-		memcpy(From + line_s, From + line_t, pitch);
-		memcpy(From + line_t, Mid, pitch);
+	const unsigned bpp = FreeImage_GetBPP(src);
+	if((bpp == 1) || (bpp == 4)) {
+		return FreeImage_FlipHorizontal(src) && FreeImage_FlipVertical(src);
+	}
 
-		line_s += pitch;
-		line_t -= pitch;
+	const unsigned width   = FreeImage_GetWidth(src);
+	const int height       = (int)FreeImage_GetHeight(src);
+	const unsigned bytespp = FreeImage_GetLine(src) / width;
 
+	// the middle line of an odd height is mirrored into itself
+#pragma omp parallel for
+	for(int y = 0; y < (height + 1) / 2; y++) {
+		MirrorLines(FreeImage_GetScanLine(src, y), FreeImage_GetScanLine(src, height - 1 - y), width, bytespp);
 	}
 
-	FreeImage_Aligned_Free(Mid);
-
 	return TRUE;
 }
-
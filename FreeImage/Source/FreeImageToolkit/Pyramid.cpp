@@ -0,0 +1,243 @@
+// ==========================================================
+// Image pyramid levels
+//
+// This file is part of the FastPreview modifications to FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#include "FreeImage.h"
+#include "Utilities.h"
+
+// ----------------------------------------------------------
+
+/**
+Averages four samples, rounding to nearest for integer samples.
+*/
+template <class T> static inline T
+Average4(T a, T b, T c, T d) {
+	return (T)(((unsigned)a + b + c + d + 2) >> 2);
+}
+
+template <> inline float
+Average4<float>(float a, float b, float c, float d) {
+	return (a + b + c + d) * 0.25F;
+}
+
+/**
+Halves a pair of lines, starting with destination pixel first. Each destination 
+pixel is the average of the 2x2 source pixels it covers; a source pixel at an 
+odd right edge is paired with itself.
+@param dst Destination line
+@param a First source line
+@param b Second source line, or a again at an odd top edge
+@param src_width Source width in pixels
+@param channels Samples per pixel
+@param first First destination pixel to compute
+*/
+template <class T> static void
+HalveSpanT(T *dst, const T *a, const T *b, unsigned src_width, unsigned channels, unsigned first) {
+	const unsigned dst_width = (src_width + 1) / 2;
+	for(unsigned x = first; x < dst_width; x++) {
+		const unsigned x0 = 2 * x * channels;
+		const unsigned x1 = (2 * x + 1 < src_width) ? x0 + channels : x0;
+		for(unsigned c = 0; c < channels; c++) {
+			dst[x * channels + c] = Average4<T>(a[x0 + c], a[x1 + c], b[x0 + c], b[x1 + c]);
+		}
+	}
+}
+
+/**
+Halves a pair of lines, see HalveSpanT.
+*/
+template <class T> static void
+HalveLineT(T *dst, const T *a, const T *b, unsigned src_width, unsigned channels) {
+	HalveSpanT<T>(dst, a, b, src_width, channels, 0);
+}
+
+#ifdef FI_SSE2
+
+/**
+Sums of horizontally adjacent 16-bit lanes, 1 channel: 8 sums of 16 lanes.
+*/
+static inline __m128i 
+PairSums1(__m128i lo, __m128i hi) {
+	const __m128i one = _mm_set1_epi16(1);
+	return _mm_packs_epi32(_mm_madd_epi16(lo, one), _mm_madd_epi16(hi, one));
+}
+
+/**
+Halves 8-bit lines with SSE2, the sums of four samples being exact in 16 bits. 
+Groups of 16 source samples are done in vectors; the remainder, and lines of 
+other pixel sizes, with the generic code.
+*/
+template <> void 
+HalveLineT<BYTE>(BYTE *dst, const BYTE *a, const BYTE *b, unsigned src_width, unsigned channels) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i two = _mm_set1_epi16(2);
+
+	unsigned x = 0;
+	switch(channels) {
+		case 1:
+			// 16 source pixels make 8 destination pixels
+			for(; 2 * x + 16 <= src_width; x += 8) {
+				const __m128i va = _mm_loadu_si128((const __m128i*)(a + 2 * x));
+				const __m128i vb = _mm_loadu_si128((const __m128i*)(b + 2 * x));
+				const __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vb, zero));
+				const __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(va, zero), _mm_unpackhi_epi8(vb, zero));
+				const __m128i sum = _mm_srli_epi16(_mm_add_epi16(PairSums1(lo, hi), two), 2);
+				_mm_storel_epi64((__m128i*)(dst + x), _mm_packus_epi16(sum, sum));
+			}
+			break;
+
+		case 3:
+			// 4 source pixels make 2 destination pixels; the vectors read 4 
+			// bytes past those, which must still be on the line
+			for(; 2 * x + 6 <= src_width; x += 2) {
+				const __m128i va = _mm_loadu_si128((const __m128i*)(a + 6 * x));
+				const __m128i vb = _mm_loadu_si128((const __m128i*)(b + 6 * x));
+				const __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vb, zero));
+				const __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(va, zero), _mm_unpackhi_epi8(vb, zero));
+				// lanes 0..2 hold pixel 0 + pixel 1 ...
+				const __m128i s01 = _mm_add_epi16(lo, _mm_srli_si128(lo, 6));
+				// ... and pixel 2 + pixel 3, moved to lanes 3..5
+				const __m128i p23 = _mm_or_si128(_mm_srli_si128(lo, 12), _mm_slli_si128(hi, 4));
+				const __m128i s23 = _mm_slli_si128(_mm_add_epi16(p23, _mm_srli_si128(p23, 6)), 6);
+				const __m128i mask = _mm_set_epi16(0, 0, 0, 0, 0, -1, -1, -1);
+				const __m128i sum = _mm_or_si128(_mm_and_si128(s01, mask), _mm_andnot_si128(mask, s23));
+				const __m128i v = _mm_srli_epi16(_mm_add_epi16(sum, two), 2);
+				const __m128i packed = _mm_packus_epi16(v, v);
+				*(DWORD*)(dst + 3 * x) = (DWORD)_mm_cvtsi128_si32(packed);
+				*(WORD*)(dst + 3 * x + 4) = (WORD)_mm_extract_epi16(packed, 2);
+			}
+			break;
+
+		case 4:
+			// 4 source pixels make 2 destination pixels
+			for(; 2 * x + 4 <= src_width; x += 2) {
+				const __m128i va = _mm_loadu_si128((const __m128i*)(a + 8 * x));
+				const __m128i vb = _mm_loadu_si128((const __m128i*)(b + 8 * x));
+				const __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vb, zero));
+				const __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(va, zero), _mm_unpackhi_epi8(vb, zero));
+				const __m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(lo, hi), _mm_unpackhi_epi64(lo, hi));
+				const __m128i v = _mm_srli_epi16(_mm_add_epi16(sum, two), 2);
+				_mm_storel_epi64((__m128i*)(dst + 4 * x), _mm_packus_epi16(v, v));
+			}
+			break;
+	}
+	HalveSpanT<BYTE>(dst, a, b, src_width, channels, x);
+}
+
+#endif // FI_SSE2
+
+/**
+Halves an image, see FreeImage_HalveSize.
+*/
+template <class T> static void
+HalveImageT(FIBITMAP *dst, FIBITMAP *src, unsigned channels) {
+	const unsigned src_width = FreeImage_GetWidth(src);
+	const unsigned src_height = FreeImage_GetHeight(src);
+	const int dst_height = (int)FreeImage_GetHeight(dst);
+
+#pragma omp parallel for
+	for(int y = 0; y < dst_height; y++) {
+		const unsigned y0 = 2 * y;
+		const unsigned y1 = (y0 + 1 < src_height) ? y0 + 1 : y0;
+		HalveLineT<T>(
+			(T*)FreeImage_GetScanLine(dst, y),
+			(const T*)FreeImage_GetScanLine(src, y0),
+			(const T*)FreeImage_GetScanLine(src, y1),
+			src_width, channels);
+	}
+}
+
+FIBITMAP * DLL_CALLCONV
+FreeImage_HalveSize(FIBITMAP *dib) {
+	if(!FreeImage_HasPixels(dib)) return NULL;
+
+	const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(dib);
+	const unsigned bpp = FreeImage_GetBPP(dib);
+
+	// bitmaps without samples to average are converted first, like FreeImage_Rescale does
+	FIBITMAP *src = dib;
+	if(image_type == FIT_BITMAP) {
+		const FREE_IMAGE_COLOR_TYPE color_type = FreeImage_GetColorType(dib);
+		const BOOL transparent = FreeImage_IsTransparent(dib);
+		if((bpp == 8) && (color_type == FIC_MINISBLACK) && !transparent) {
+			// already a greyscale
+		} else if(bpp < 24 && !transparent && ((color_type == FIC_MINISBLACK) || (color_type == FIC_MINISWHITE))) {
+			src = FreeImage_ConvertToGreyscale(dib);
+		} else if(bpp < 24) {
+			src = transparent ? FreeImage_ConvertTo32Bits(dib) : FreeImage_ConvertTo24Bits(dib);
+		}
+		if(!src) return NULL;
+	}
+
+	const unsigned src_width = FreeImage_GetWidth(src);
+	const unsigned src_height = FreeImage_GetHeight(src);
+	const unsigned dst_width = (src_width + 1) / 2;
+	const unsigned dst_height = (src_height + 1) / 2;
+	const unsigned src_bpp = FreeImage_GetBPP(src);
+
+	FIBITMAP *dst = NULL;
+	switch(image_type) {
+		case FIT_BITMAP:
+		case FIT_UINT16:
+		case FIT_RGB16:
+		case FIT_RGBA16:
+		case FIT_FLOAT:
+		case FIT_RGBF:
+		case FIT_RGBAF:
+			dst = FreeImage_AllocateT(image_type, dst_width, dst_height, src_bpp, 
+				FreeImage_GetRedMask(src), FreeImage_GetGreenMask(src), FreeImage_GetBlueMask(src));
+			break;
+
+		default:
+			// cannot average this kind of image
+			break;
+	}
+	if(!dst) {
+		if(src != dib) {
+			FreeImage_Unload(src);
+		}
+		return NULL;
+	}
+
+	switch(image_type) {
+		case FIT_BITMAP:
+			HalveImageT<BYTE>(dst, src, src_bpp / 8);
+			break;
+		case FIT_UINT16:
+		case FIT_RGB16:
+		case FIT_RGBA16:
+			HalveImageT<WORD>(dst, src, src_bpp / 16);
+			break;
+		default:
+			HalveImageT<float>(dst, src, src_bpp / 32);
+			break;
+	}
+
+	// FreeImage_AllocateT gave 8-bit images their greyscale palette; the 
+	// resolution halves, as the image covers the same area with half the pixels
+	FreeImage_SetDotsPerMeterX(dst, FreeImage_GetDotsPerMeterX(src) / 2);
+	FreeImage_SetDotsPerMeterY(dst, FreeImage_GetDotsPerMeterY(src) / 2);
+
+	if(src != dib) {
+		FreeImage_Unload(src);
+	}
+
+	// copy metadata from src to dst
+	FreeImage_CloneMetadata(dst, dib);
+
+	return dst;
+}
@@ -22,6 +22,29 @@
 
 #include "Resize.h"
 
+/**
+Creates the resampling filter for a FREE_IMAGE_FILTER
+@return Returns the filter, or NULL if out of memory
+*/
+static CGenericFilter *
+CreateFilter(FREE_IMAGE_FILTER filter) {
+	switch (filter) {
+		case FILTER_BOX:
+			return new(std::nothrow) CBoxFilter();
+		case FILTER_BICUBIC:
+			return new(std::nothrow) CBicubicFilter();
+		case FILTER_BILINEAR:
+			return new(std::nothrow) CBilinearFilter();
+		case FILTER_BSPLINE:
+			return new(std::nothrow) CBSplineFilter();
+		case FILTER_CATMULLROM:
+			return new(std::nothrow) CCatmullRomFilter();
+		case FILTER_LANCZOS3:
+			return new(std::nothrow) CLanczos3Filter();
+	}
+	return NULL;
+}
+
 FIBITMAP * DLL_CALLCONV 
 FreeImage_Rescale(FIBITMAP *src, int dst_width, int dst_height, FREE_IMAGE_FILTER filter) {
 	FIBITMAP *dst = NULL;
@@ -31,28 +54,39 @@ FreeImage_Rescale(FIBITMAP *src, int dst_width, int dst_height, FREE_IMAGE_FILTE
 	}
 
 	// select the filter
-	CGenericFilter *pFilter = NULL;
-	switch (filter) {
-		case FILTER_BOX:
-			pFilter = new(std::nothrow) CBoxFilter();
-			break;
-		case FILTER_BICUBIC:
-			pFilter = new(std::nothrow) CBicubicFilter();
-			break;
-		case FILTER_BILINEAR:
-			pFilter = new(std::nothrow) CBilinearFilter();
-			break;
-		case FILTER_BSPLINE:
-			pFilter = new(std::nothrow) CBSplineFilter();
-			break;
-		case FILTER_CATMULLROM:
-			pFilter = new(std::nothrow) CCatmullRomFilter();
-			break;
-		case FILTER_LANCZOS3:
-			pFilter = new(std::nothrow) CLanczos3Filter();
-			break;
+	CGenericFilter *pFilter = CreateFilter(filter);
+	if (!pFilter) {
+		return NULL;
 	}
 
+	CResizeEngine Engine(pFilter);
+
+	dst = Engine.scale(src, dst_width, dst_height, 0, 0,
+			FreeImage_GetWidth(src), FreeImage_GetHeight(src));
+
+	delete pFilter;
+
+	// copy metadata from src to dst
+	FreeImage_CloneMetadata(dst, src);
+	
+	return dst;
+}
+
+FIBITMAP * DLL_CALLCONV 
+FreeImage_RescaleWindow(FIBITMAP *src, int dst_width, int dst_height, int left, int top, int right, int bottom, FREE_IMAGE_FILTER filter) {
+	FIBITMAP *dst = NULL;
+
+	if (!FreeImage_HasPixels(src) || (dst_width <= 0) || (dst_height <= 0) || (FreeImage_GetWidth(src) <= 0) || (FreeImage_GetHeight(src) <= 0)) {
+		return NULL;
+	}
+
+	// the window must lie within the rescaled image
+	if ((left < 0) || (top < 0) || (right > dst_width) || (bottom > dst_height) || (left >= right) || (top >= bottom)) {
+		return NULL;
+	}
+
+	// select the filter
+	CGenericFilter *pFilter = CreateFilter(filter);
 	if (!pFilter) {
 		return NULL;
 	}
@@ -60,7 +94,8 @@ FreeImage_Rescale(FIBITMAP *src, int dst_width, int dst_height, FREE_IMAGE_FILTE
 	CResizeEngine Engine(pFilter);
 
 	dst = Engine.scale(src, dst_width, dst_height, 0, 0,
-			FreeImage_GetWidth(src), FreeImage_GetHeight(src));
+			FreeImage_GetWidth(src), FreeImage_GetHeight(src),
+			left, top, right, bottom);
 
 	delete pFilter;
 
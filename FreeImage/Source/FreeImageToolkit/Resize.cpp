@@ -138,7 +138,7 @@ GetRGBAPalette(FIBITMAP *dib, RGBQUAD * const buffer) {
 
 // --------------------------------------------------------------------------
 
-CWeightsTable::CWeightsTable(CGenericFilter *pFilter, unsigned uDstSize, unsigned uSrcSize) {
+CWeightsTable::CWeightsTable(CGenericFilter *pFilter, unsigned uDstSize, unsigned uSrcSize, unsigned uDstFirst, unsigned uDstCount) {
 	double dWidth;
 	double dFScale;
 	const double dFilterWidth = pFilter->GetWidth();
@@ -156,12 +156,17 @@ CWeightsTable::CWeightsTable(CGenericFilter *pFilter, unsigned uDstSize, unsigne
 		dFScale = 1.0; 
 	}
 
+	// equal sizes only happen when filtering a window of the line (see
+	// CResizeEngine::scale); the line is copied as it is then, since not
+	// all filters interpolate (e.g. B-spline would blur the line)
+	const BOOL bCopy = (uDstSize == uSrcSize);
+
 	// allocate a new line contributions structure
 	//
 	// window size is the number of sampled pixels
-	m_WindowSize = 2 * (int)ceil(dWidth) + 1; 
-	// length of dst line (no. of rows / cols) 
-	m_LineLength = uDstSize; 
+	m_WindowSize = bCopy ? 1 : 2 * (int)ceil(dWidth) + 1; 
+	// length of dst line window (no. of rows / cols) 
+	m_LineLength = uDstCount; 
 
 	 // allocate list of contributions 
 	m_WeightTable = (Contribution*)malloc(m_LineLength * sizeof(Contribution));
@@ -176,8 +181,15 @@ CWeightsTable::CWeightsTable(CGenericFilter *pFilter, unsigned uDstSize, unsigne
 	for(unsigned u = 0; u < m_LineLength; u++) {
 		// scan through line of contributions
 
+		if (bCopy) {
+			m_WeightTable[u].Left = uDstFirst + u;
+			m_WeightTable[u].Right = uDstFirst + u + 1;
+			m_WeightTable[u].Weights[0] = 1;
+			continue;
+		}
+
 		// inverse mapping (discrete dst 'u' to continous src 'dCenter')
-		const double dCenter = (double)u / dScale + dOffset;
+		const double dCenter = (double)(uDstFirst + u) / dScale + dOffset;
 
 		// find the significant edge points that affect the pixel
 		const int iLeft = MAX(0, (int)(dCenter - dWidth + 0.5));
@@ -227,9 +239,40 @@ CWeightsTable::~CWeightsTable() {
 	free(m_WeightTable);
 }
 
+void CWeightsTable::getSourceRange(unsigned &first, unsigned &last) const {
+	first = 0;
+	last = 0;
+	for(unsigned u = 0; u < m_LineLength; u++) {
+		if ((u == 0) || (m_WeightTable[u].Left < first)) {
+			first = m_WeightTable[u].Left;
+		}
+		if (m_WeightTable[u].Right > last) {
+			last = m_WeightTable[u].Right;
+		}
+	}
+}
+
+void CWeightsTable::setSourceOrigin(unsigned origin) {
+	for(unsigned u = 0; u < m_LineLength; u++) {
+		m_WeightTable[u].Left -= origin;
+		m_WeightTable[u].Right -= origin;
+	}
+}
+
 // --------------------------------------------------------------------------
 
-FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_height, unsigned src_left, unsigned src_top, unsigned src_width, unsigned src_height) {
+FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_height, unsigned src_left, unsigned src_top, unsigned src_width, unsigned src_height,
+								unsigned dst_left, unsigned dst_top, unsigned dst_right, unsigned dst_bottom) {
+
+	if ((dst_right == 0) || (dst_bottom == 0)) {
+		// the whole destination image
+		dst_left = dst_top = 0;
+		dst_right = dst_width;
+		dst_bottom = dst_height;
+	}
+	const BOOL bWindow = (dst_left != 0) || (dst_top != 0) || (dst_right != dst_width) || (dst_bottom != dst_height);
+	const unsigned win_width = dst_right - dst_left;
+	const unsigned win_height = dst_bottom - dst_top;
 
 	const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(src);
 	const unsigned src_bpp = FreeImage_GetBPP(src);
@@ -272,8 +315,11 @@ FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_h
 	if ((src_width == dst_width) && (src_height == dst_height)) {
 		FIBITMAP *out = src;
 		FIBITMAP *tmp = src;
-		if ((src_width != FreeImage_GetWidth(src)) || (src_height != FreeImage_GetHeight(src))) {
-			out = FreeImage_Copy(tmp, src_left, src_top, src_left + src_width, src_top + src_height);
+		if ((win_width != FreeImage_GetWidth(src)) || (win_height != FreeImage_GetHeight(src))) {
+			out = FreeImage_Copy(tmp, src_left + dst_left, src_top + dst_top, src_left + dst_right, src_top + dst_bottom);
+			if (!out) {
+				return NULL;
+			}
 			tmp = out;
 		}
 		if (src_bpp != dst_bpp) {
@@ -321,7 +367,7 @@ FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_h
 	}
 
 	// allocate the dst image
-	FIBITMAP *dst = FreeImage_AllocateT(image_type, dst_width, dst_height, dst_bpp, 0, 0, 0);
+	FIBITMAP *dst = FreeImage_AllocateT(image_type, win_width, win_height, dst_bpp, 0, 0, 0);
 	if (!dst) {
 		return NULL;
 	}
@@ -370,19 +416,39 @@ FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_h
 	}
 	*/
 
+	// A window of the destination is computed from the source rows
+	// and columns contributing to it only. Both passes always run then,
+	// so the pixel format of the result does not depend on the window.
+	// Windows are given top-down, while rows count from the bottom in
+	// FreeImage; so is the vertical weights table.
+	const BOOL bFilterX = bWindow || (src_width != dst_width);
+	const BOOL bFilterY = bWindow || (src_height != dst_height);
+
+	// allocate and calculate the contributions
+	CWeightsTable weightsX(m_pFilter, dst_width, src_width, dst_left, bFilterX ? win_width : 0);
+	CWeightsTable weightsY(m_pFilter, dst_height, src_height, dst_height - dst_bottom, bFilterY ? win_height : 0);
+
 	if (dst_width <= src_width) {
 		// xy filtering
 		// -------------
 
 		FIBITMAP *tmp = NULL;
 
-		if (src_width != dst_width) {
+		if (bFilterX) {
 			// source and destination widths are different so, we must
 			// filter horizontally
-			if (src_height != dst_height) {
+
+			// source rows contributing to the destination rows
+			unsigned first = 0, last = src_height;
+			if (bWindow) {
+				weightsY.getSourceRange(first, last);
+				weightsY.setSourceOrigin(first);
+			}
+
+			if (bFilterY) {
 				// source and destination heights are also different so, we need
 				// a temporary image
-				tmp = FreeImage_AllocateT(image_type, dst_width, src_height, dst_bpp, 0, 0, 0);
+				tmp = FreeImage_AllocateT(image_type, win_width, last - first, dst_bpp, 0, 0, 0);
 				if (!tmp) {
 					FreeImage_Unload(dst);
 					return NULL;
@@ -395,7 +461,7 @@ FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_h
 			}
 
 			// scale source image horizontally into temporary (or destination) image
-			horizontalFilter(src, src_height, src_width, src_offset_x, src_offset_y, src_pal, tmp, dst_width);
+			horizontalFilter(weightsX, src, last - first, src_offset_x, src_offset_y + first, src_pal, tmp, win_width);
 
 			// set x and y offsets to zero for the second filter method
 			// invocation (the temporary image only contains the portion of
@@ -415,10 +481,10 @@ FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_h
 			tmp = src;
 		}
 
-		if (src_height != dst_height) {
+		if (bFilterY) {
 			// source and destination heights are different so, scale
 			// temporary (or source) image vertically into destination image
-			verticalFilter(tmp, dst_width, src_height, src_offset_x, src_offset_y, src_pal, dst, dst_height);
+			verticalFilter(weightsY, tmp, win_width, src_offset_x, src_offset_y, src_pal, dst, win_height);
 		}
 
 		// free temporary image, if not pointing to either src or dst
@@ -442,13 +508,27 @@ FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_h
 
 		FIBITMAP *tmp = NULL;
 
-		if (src_height != dst_height) {
+		if (bFilterY) {
 			// source and destination heights are different so, we must
 			// filter vertically
-			if (src_width != dst_width) {
+
+			// source columns contributing to the destination columns
+			unsigned first = 0, last = src_width;
+			if (bWindow) {
+				weightsX.getSourceRange(first, last);
+				// columns of 1- and 4-bit images must start at a byte
+				if (src_bpp == 1) {
+					first &= ~7U;
+				} else if (src_bpp == 4) {
+					first &= ~1U;
+				}
+				weightsX.setSourceOrigin(first);
+			}
+
+			if (bFilterX) {
 				// source and destination widths are also different so, we need
 				// a temporary image
-				tmp = FreeImage_AllocateT(image_type, src_width, dst_height, dst_bpp, 0, 0, 0);
+				tmp = FreeImage_AllocateT(image_type, last - first, win_height, dst_bpp, 0, 0, 0);
 				if (!tmp) {
 					FreeImage_Unload(dst);
 					return NULL;
@@ -461,7 +541,7 @@ FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_h
 			}
 
 			// scale source image vertically into temporary (or destination) image
-			verticalFilter(src, src_width, src_height, src_offset_x, src_offset_y, src_pal, tmp, dst_height);
+			verticalFilter(weightsY, src, last - first, src_offset_x + first, src_offset_y, src_pal, tmp, win_height);
 
 			// set x and y offsets to zero for the second filter method
 			// invocation (the temporary image only contains the portion of
@@ -482,10 +562,10 @@ FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_h
 			tmp = src;
 		}
 
-		if (src_width != dst_width) {
+		if (bFilterX) {
 			// source and destination heights are different so, scale
 			// temporary (or source) image horizontally into destination image
-			horizontalFilter(tmp, dst_height, src_width, src_offset_x, src_offset_y, src_pal, dst, dst_width);
+			horizontalFilter(weightsX, tmp, win_height, src_offset_x, src_offset_y, src_pal, dst, win_width);
 		}
 
 		// free temporary image, if not pointing to either src or dst
@@ -497,10 +577,7 @@ FIBITMAP* CResizeEngine::scale(FIBITMAP *src, unsigned dst_width, unsigned dst_h
 	return dst;
 } 
 
-void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsigned src_width, unsigned src_offset_x, unsigned src_offset_y, const RGBQUAD *const src_pal, FIBITMAP *const dst, unsigned dst_width) {
-
-	// allocate and calculate the contributions
-	CWeightsTable weightsTable(m_pFilter, dst_width, src_width);
+void CResizeEngine::horizontalFilter(CWeightsTable &weightsTable, FIBITMAP *const src, unsigned height, unsigned src_offset_x, unsigned src_offset_y, const RGBQUAD *const src_pal, FIBITMAP *const dst, unsigned dst_width) {
 
 	// step through rows
 	switch(FreeImage_GetImageType(src)) {
@@ -1060,7 +1137,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 		case FIT_UINT16:
 		{
 			// Calculate the number of words per pixel (1 for 16-bit, 3 for 48-bit or 4 for 64-bit)
-			const unsigned wordspp = (FreeImage_GetLine(src) / src_width) / sizeof(WORD);
+			const unsigned wordspp = (FreeImage_GetLine(src) / FreeImage_GetWidth(src)) / sizeof(WORD);
 
 			for (unsigned y = 0; y < height; y++) {
 				// scale each row
@@ -1094,7 +1171,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 		case FIT_RGB16:
 		{
 			// Calculate the number of words per pixel (1 for 16-bit, 3 for 48-bit or 4 for 64-bit)
-			const unsigned wordspp = (FreeImage_GetLine(src) / src_width) / sizeof(WORD);
+			const unsigned wordspp = (FreeImage_GetLine(src) / FreeImage_GetWidth(src)) / sizeof(WORD);
 
 			for (unsigned y = 0; y < height; y++) {
 				// scale each row
@@ -1132,7 +1209,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 		case FIT_RGBA16:
 		{
 			// Calculate the number of words per pixel (1 for 16-bit, 3 for 48-bit or 4 for 64-bit)
-			const unsigned wordspp = (FreeImage_GetLine(src) / src_width) / sizeof(WORD);
+			const unsigned wordspp = (FreeImage_GetLine(src) / FreeImage_GetWidth(src)) / sizeof(WORD);
 
 			for (unsigned y = 0; y < height; y++) {
 				// scale each row
@@ -1174,7 +1251,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 		case FIT_RGBAF:
 		{
 			// Calculate the number of floats per pixel (1 for 32-bit, 3 for 96-bit or 4 for 128-bit)
-			const unsigned floatspp = (FreeImage_GetLine(src) / src_width) / sizeof(float);
+			const unsigned floatspp = (FreeImage_GetLine(src) / FreeImage_GetWidth(src)) / sizeof(float);
 
 			for(unsigned y = 0; y < height; y++) {
 				// scale each row
@@ -1212,10 +1289,7 @@ void CResizeEngine::horizontalFilter(FIBITMAP *const src, unsigned height, unsig
 }
 
 /// Performs vertical image filtering
-void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned src_height, unsigned src_offset_x, unsigned src_offset_y, const RGBQUAD *const src_pal, FIBITMAP *const dst, unsigned dst_height) {
-
-	// allocate and calculate the contributions
-	CWeightsTable weightsTable(m_pFilter, dst_height, src_height);
+void CResizeEngine::verticalFilter(CWeightsTable &weightsTable, FIBITMAP *const src, unsigned width, unsigned src_offset_x, unsigned src_offset_y, const RGBQUAD *const src_pal, FIBITMAP *const dst, unsigned dst_height) {
 
 	// step through columns
 	switch(FreeImage_GetImageType(src)) {
@@ -1817,7 +1891,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 		case FIT_UINT16:
 		{
 			// Calculate the number of words per pixel (1 for 16-bit, 3 for 48-bit or 4 for 64-bit)
-			const unsigned wordspp = (FreeImage_GetLine(src) / width) / sizeof(WORD);
+			const unsigned wordspp = (FreeImage_GetLine(src) / FreeImage_GetWidth(src)) / sizeof(WORD);
 
 			const unsigned dst_pitch = FreeImage_GetPitch(dst) / sizeof(WORD);
 			WORD *const dst_base = (WORD *)FreeImage_GetBits(dst);
@@ -1858,7 +1932,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 		case FIT_RGB16:
 		{
 			// Calculate the number of words per pixel (1 for 16-bit, 3 for 48-bit or 4 for 64-bit)
-			const unsigned wordspp = (FreeImage_GetLine(src) / width) / sizeof(WORD);
+			const unsigned wordspp = (FreeImage_GetLine(src) / FreeImage_GetWidth(src)) / sizeof(WORD);
 
 			const unsigned dst_pitch = FreeImage_GetPitch(dst) / sizeof(WORD);
 			WORD *const dst_base = (WORD *)FreeImage_GetBits(dst);
@@ -1904,7 +1978,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 		case FIT_RGBA16:
 		{
 			// Calculate the number of words per pixel (1 for 16-bit, 3 for 48-bit or 4 for 64-bit)
-			const unsigned wordspp = (FreeImage_GetLine(src) / width) / sizeof(WORD);
+			const unsigned wordspp = (FreeImage_GetLine(src) / FreeImage_GetWidth(src)) / sizeof(WORD);
 
 			const unsigned dst_pitch = FreeImage_GetPitch(dst) / sizeof(WORD);
 			WORD *const dst_base = (WORD *)FreeImage_GetBits(dst);
@@ -1954,7 +2028,7 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 		case FIT_RGBAF:
 		{
 			// Calculate the number of floats per pixel (1 for 32-bit, 3 for 96-bit or 4 for 128-bit)
-			const unsigned floatspp = (FreeImage_GetLine(src) / width) / sizeof(float);
+			const unsigned floatspp = (FreeImage_GetLine(src) / FreeImage_GetWidth(src)) / sizeof(float);
 
 			const unsigned dst_pitch = FreeImage_GetPitch(dst) / sizeof(float);
 			float *const dst_base = (float *)FreeImage_GetBits(dst);
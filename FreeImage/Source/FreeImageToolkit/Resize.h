@@ -60,8 +60,10 @@ public:
 	@param pFilter Filter used for upsampling or downsampling
 	@param uDstSize Length (in pixels) of the destination line buffer
 	@param uSrcSize Length (in pixels) of the source line buffer
+	@param uDstFirst First destination pixel to compute contributions for
+	@param uDstCount Number of destination pixels to compute contributions for
 	*/
-	CWeightsTable(CGenericFilter *pFilter, unsigned uDstSize, unsigned uSrcSize);
+	CWeightsTable(CGenericFilter *pFilter, unsigned uDstSize, unsigned uSrcSize, unsigned uDstFirst, unsigned uDstCount);
 
 	/**
 	Destructor<br>
@@ -93,6 +95,18 @@ public:
 	unsigned getRightBoundary(unsigned dst_pos) {
 		return m_WeightTable[dst_pos].Right;
 	}
+
+	/** Retrieve the range of source pixels contributing to any destination pixel
+	@param first Returns the first source pixel
+	@param last Returns the source pixel after the last one
+	*/
+	void getSourceRange(unsigned &first, unsigned &last) const;
+
+	/** Make the boundaries relative to a source line buffer, that starts
+	at the given source pixel
+	@param origin First source pixel in the source line buffer
+	*/
+	void setSourceOrigin(unsigned origin);
 };
 
 // ---------------------------------------------
@@ -147,6 +161,10 @@ public:
 	Currently, method scale is called with the actual size of the source
 	image. However, in a future version, we could provide a new function
 	called FreeImage_RescaleRect that rescales only part of an image. 
+	The last four parameters select a window of the destination image to
+	be computed, see FreeImage_RescaleWindow. Only the source pixels that
+	contribute to the window are filtered. With dst_right and dst_bottom
+	set to 0, the whole destination image is computed.
 
 	@param src Pointer to the source image
 	@param dst_width Destination image width
@@ -155,40 +173,45 @@ public:
 	@param src_top Top boundary of the source rectangle to be scaled
 	@param src_width Width of the source rectangle to be scaled
 	@param src_height Height of the source rectangle to be scaled
-	@return Returns the scaled image if successful, returns NULL otherwise
+	@param dst_left Left boundary of the destination window
+	@param dst_top Top boundary of the destination window
+	@param dst_right Right boundary (exclusive) of the destination window
+	@param dst_bottom Bottom boundary (exclusive) of the destination window
+	@return Returns the scaled image (or window of it) if successful, returns NULL otherwise
 	*/
-	FIBITMAP* scale(FIBITMAP *src, unsigned dst_width, unsigned dst_height, unsigned src_left, unsigned src_top, unsigned src_width, unsigned src_height);
+	FIBITMAP* scale(FIBITMAP *src, unsigned dst_width, unsigned dst_height, unsigned src_left, unsigned src_top, unsigned src_width, unsigned src_height,
+			unsigned dst_left = 0, unsigned dst_top = 0, unsigned dst_right = 0, unsigned dst_bottom = 0);
 
 private:
 
 	/**
 	Performs horizontal image filtering
 
+	@param weightsTable Contributions of the source columns to each destination column
 	@param src Source image
 	@param height Source / Destination image height
-	@param src_width Source image width
 	@param src_offset_x
 	@param src_offset_y
 	@param src_pal
 	@param dst Destination image
 	@param dst_width Destination image width
 	*/
-	void horizontalFilter(FIBITMAP * const src, const unsigned height, const unsigned src_width,
+	void horizontalFilter(CWeightsTable &weightsTable, FIBITMAP * const src, const unsigned height,
 			const unsigned src_offset_x, const unsigned src_offset_y, const RGBQUAD * const src_pal,
 			FIBITMAP * const dst, const unsigned dst_width);
 
 	/**
 	Performs vertical image filtering
+	@param weightsTable Contributions of the source rows to each destination row
 	@param src Source image
 	@param width Source / Destination image width
-	@param src_height Source image height
 	@param src_offset_x
 	@param src_offset_y
 	@param src_pal
 	@param dst Destination image
 	@param dst_height Destination image height
 	*/
-	void verticalFilter(FIBITMAP * const src, const unsigned width, const unsigned src_height,
+	void verticalFilter(CWeightsTable &weightsTable, FIBITMAP * const src, const unsigned width,
 			const unsigned src_offset_x, const unsigned src_offset_y, const RGBQUAD * const src_pal,
 			FIBITMAP * const dst, const unsigned dst_height);
 };
@@ -676,6 +676,10 @@ jinit_color_deconverter (j_decompress_ptr cinfo)
       break;
     case JCS_YCbCr:
       cconvert->pub.color_convert = ycc_rgb_convert;
+#ifdef JSIMD_SSE2_SUPPORTED
+      if (jsimd_can_sse2())
+	cconvert->pub.color_convert = jsimd_ycc_rgb_convert;
+#endif
       build_ycc_rgb_table(cinfo);
       break;
     case JCS_BG_YCC:
@@ -351,6 +351,30 @@ start_pass (j_decompress_ptr cinfo)
       break;
     }
   }
+
+#ifdef JSIMD_SSE2_SUPPORTED
+  /* Switch the integer IDCTs that have SSE2 versions (jdsimd.c) over
+   * wherever the multiplier table just built allows it.
+   */
+  for (ci = 0, compptr = cinfo->comp_info; ci < cinfo->num_components;
+       ci++, compptr++) {
+    method_ptr = idct->pub.inverse_DCT[ci];
+    if (method_ptr == jpeg_idct_islow)
+      method_ptr = jsimd_idct_islow;
+    else if (method_ptr == jpeg_idct_ifast)
+      method_ptr = jsimd_idct_ifast;
+#ifdef IDCT_SCALING_SUPPORTED
+    else if (method_ptr == jpeg_idct_16x16)
+      method_ptr = jsimd_idct_16x16;
+    else if (method_ptr == jpeg_idct_16x8)
+      method_ptr = jsimd_idct_16x8;
+#endif
+    else
+      continue;
+    if (jsimd_can_idct(compptr))
+      idct->pub.inverse_DCT[ci] = method_ptr;
+  }
+#endif
 }
 
 
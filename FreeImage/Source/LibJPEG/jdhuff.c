@@ -14,6 +14,12 @@
  * up to the start of the current MCU.  To do this, we copy state variables
  * into local working storage, and update them back to the permanent
  * storage only upon successful completion of an MCU.
+ *
+ * On machines with 64-bit words, sequential Huffman scans additionally use
+ * a fast path (decode_mcu_fast) that refills the bit buffer in bulk and
+ * decodes most run/size symbols together with their coefficient value in
+ * one table lookup.  It steps aside near markers and at the end of the
+ * source buffer, where the general code below takes over.
  */
 
 #define JPEG_INTERNALS
@@ -25,6 +31,18 @@
 
 #define HUFF_LOOKAHEAD	8	/* # of bits of lookahead */
 
+#if defined(_WIN64) || defined(__LP64__)
+#define HUFF_FAST_BITS	10	/* # of bits of combined lookahead */
+#endif
+
+#ifdef HUFF_FAST_BITS
+typedef struct {
+  INT16 value;			/* sign-extended coefficient value */
+  UINT8 nbits;			/* # bits of code plus value, or 0 */
+  UINT8 sym;			/* run/size symbol */
+} d_fast_entry;
+#endif
+
 typedef struct {
   /* Basic tables: (element [0] of each array is unused) */
   INT32 maxcode[18];		/* largest code of length k (-1 if none) */
@@ -45,6 +63,14 @@ typedef struct {
    */
   int look_nbits[1<<HUFF_LOOKAHEAD]; /* # bits, or 0 if too long */
   UINT8 look_sym[1<<HUFF_LOOKAHEAD]; /* symbol, or unused */
+
+#ifdef HUFF_FAST_BITS
+  /* Combined lookahead table for decode_mcu_fast: indexed by the next
+   * HUFF_FAST_BITS bits, it covers every code whose value bits fit into
+   * the same lookahead, so that both are consumed in one step.
+   */
+  d_fast_entry look_fast[1<<HUFF_FAST_BITS];
+#endif
 } d_derived_tbl;
 
 
@@ -66,14 +92,21 @@ typedef struct {
  * necessary.
  */
 
+#ifdef HUFF_FAST_BITS
+typedef size_t bit_buf_type;	/* type of bit-extraction buffer */
+#define BIT_BUF_SIZE  64	/* size of buffer in bits */
+#else
 typedef INT32 bit_buf_type;	/* type of bit-extraction buffer */
 #define BIT_BUF_SIZE  32	/* size of buffer in bits */
+#endif
 
 /* If long is > 32 bits on your machine, and shifting/masking longs is
  * reasonably fast, making bit_buf_type be long and setting BIT_BUF_SIZE
  * appropriately should be a win.  Unfortunately we can't define the size
  * with something like  #define BIT_BUF_SIZE (sizeof(bit_buf_type)*8)
  * because not all machines measure sizeof in 8-bit bytes.
+ * We use a size_t buffer on 64-bit Windows and LP64 machines, where the
+ * fast path depends on it.
  */
 
 typedef struct {		/* Bitreading state saved across MCUs */
@@ -424,6 +457,40 @@ jpeg_make_d_derived_tbl (j_decompress_ptr cinfo, boolean isDC, int tblno,
     }
   }
 
+#ifdef HUFF_FAST_BITS
+  /* Compute the combined lookahead table.  An entry is filled in only if
+   * the code and its value bits together are no more than HUFF_FAST_BITS
+   * long; the rest stay 0 and are decoded with the tables above.
+   */
+
+  MEMZERO(dtbl->look_fast, SIZEOF(dtbl->look_fast));
+
+  p = 0;
+  for (l = 1; l <= HUFF_FAST_BITS; l++) {
+    for (i = 1; i <= (int) htbl->bits[l]; i++, p++) {
+      int sym = htbl->huffval[p];
+      int s = isDC ? sym : sym & 15;
+      int val;
+
+      if (l + s > HUFF_FAST_BITS)
+	continue;
+      lookbits = huffcode[p] << (HUFF_FAST_BITS-l);
+      for (ctr = 0; ctr < (1 << (HUFF_FAST_BITS-l)); ctr++) {
+	/* The value bits follow the code; extend sign as in HUFF_EXTEND */
+	val = 0;
+	if (s) {
+	  val = ctr >> (HUFF_FAST_BITS-l-s);
+	  if (val < (1 << (s-1)))
+	    val -= (1 << s) - 1;
+	}
+	dtbl->look_fast[lookbits + ctr].value = (INT16) val;
+	dtbl->look_fast[lookbits + ctr].nbits = (UINT8) (l + s);
+	dtbl->look_fast[lookbits + ctr].sym = (UINT8) sym;
+      }
+    }
+  }
+#endif
+
   /* Validate symbols as being reasonable.
    * For AC tables, we make no check, but accept all byte values 0..255.
    * For DC tables, we require the symbols to be in range 0..15.
@@ -1190,6 +1257,192 @@ decode_mcu_sub (j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
 }
 
 
+#ifdef HUFF_FAST_BITS
+
+/*
+ * Fast path for decode_mcu.
+ *
+ * Between markers the compressed data is a plain byte stream, apart from
+ * stuffed zero bytes after 0xFF.  So when no marker is pending and the
+ * source buffer holds enough bytes, we can refill the 64-bit bit buffer
+ * four bytes at a time straight from the buffer and never need to check
+ * for a short buffer inside the inner loops.  Each symbol then has at
+ * least 32 bits available, which covers the longest code plus its value.
+ *
+ * We decline (return FALSE) without touching permanent state whenever we
+ * run into a marker, the end of the source buffer, or an invalid code.
+ * decode_mcu then decodes the same MCU again with the general code, which
+ * rewrites any coefficients already stored here with the same values and
+ * handles the special cases as before.
+ */
+
+#define HUFF_FAST_MIN_BYTES  64	/* # source bytes wanted per block */
+
+/* Load four bytes into get_buffer if less than 32 bits are left. */
+#define FILL_BIT_BUFFER_FAST \
+	{ if (bits_left < 32) {  \
+	    if (next_input_byte > fast_limit) return FALSE;  \
+	    GET_BYTE_FAST; GET_BYTE_FAST; GET_BYTE_FAST; GET_BYTE_FAST; } }
+
+#define GET_BYTE_FAST \
+	{ register int c = GETJOCTET(*next_input_byte++);  \
+	  if (c == 0xFF) {  \
+	    if (GETJOCTET(*next_input_byte) != 0) return FALSE;  \
+	    next_input_byte++;  \
+	  }  \
+	  get_buffer = (get_buffer << 8) | c;  \
+	  bits_left += 8; }
+
+/* Decode a run/size symbol (or DC size) whose value did not fit into the
+ * combined lookahead.  There are enough bits, so nothing can go short.
+ */
+#define HUFF_DECODE_FAST(result,htbl) \
+{ register int nb, look; \
+  look = PEEK_BITS(HUFF_LOOKAHEAD); \
+  if ((nb = htbl->look_nbits[look]) != 0) { \
+    DROP_BITS(nb); \
+    result = htbl->look_sym[look]; \
+  } else { \
+    register INT32 code; \
+    nb = HUFF_LOOKAHEAD+1; \
+    code = GET_BITS(nb); \
+    while (code > htbl->maxcode[nb]) { \
+      code = (code << 1) | GET_BITS(1); \
+      nb++; \
+    } \
+    if (nb > 16) return FALSE; \
+    result = htbl->pub->huffval[ (int) (code + htbl->valoffset[nb]) ]; \
+  } \
+}
+
+LOCAL(boolean)
+decode_mcu_fast (j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
+{
+  huff_entropy_ptr entropy = (huff_entropy_ptr) cinfo->entropy;
+  register bit_buf_type get_buffer;
+  register int bits_left;
+  register const JOCTET * next_input_byte;
+  const JOCTET * fast_limit;
+  int blkn;
+  savable_state state;
+
+  /* The last MCU of a restart interval would run into the RSTn marker
+   * on its final refill, so leave it to the general code right away.
+   */
+  if (cinfo->unread_marker != 0 ||
+      (cinfo->restart_interval && entropy->restarts_to_go == 1) ||
+      cinfo->src->bytes_in_buffer <
+      (size_t) HUFF_FAST_MIN_BYTES * (size_t) cinfo->blocks_in_MCU)
+    return FALSE;
+
+  /* Load up working state.  A refill reads at most 9 bytes. */
+  next_input_byte = cinfo->src->next_input_byte;
+  fast_limit = next_input_byte + (cinfo->src->bytes_in_buffer - 9);
+  get_buffer = entropy->bitstate.get_buffer;
+  bits_left = entropy->bitstate.bits_left;
+  ASSIGN_STATE(state, entropy->saved);
+
+  /* Outer loop handles each block in the MCU */
+
+  for (blkn = 0; blkn < cinfo->blocks_in_MCU; blkn++) {
+    JBLOCKROW block = MCU_data[blkn];
+    d_derived_tbl * htbl;
+    const d_fast_entry * fe;
+    register int s, k, r;
+    int coef_limit, ci;
+
+    /* Section F.2.2.1: decode the DC coefficient difference */
+    htbl = entropy->dc_cur_tbls[blkn];
+    FILL_BIT_BUFFER_FAST;
+    fe = &htbl->look_fast[PEEK_BITS(HUFF_FAST_BITS)];
+    if (fe->nbits) {
+      DROP_BITS(fe->nbits);
+      s = fe->value;
+    } else {
+      HUFF_DECODE_FAST(s, htbl);
+      if (s) {
+	r = GET_BITS(s);
+	s = HUFF_EXTEND(r, s);
+      }
+    }
+
+    htbl = entropy->ac_cur_tbls[blkn];
+    k = 1;
+    coef_limit = entropy->coef_limit[blkn];
+    if (coef_limit) {
+      /* Convert DC difference to actual value, update last_dc_val */
+      ci = cinfo->MCU_membership[blkn];
+      s += state.last_dc_val[ci];
+      state.last_dc_val[ci] = s;
+      /* Output the DC coefficient */
+      (*block)[0] = (JCOEF) s;
+
+      /* Section F.2.2.2: decode the AC coefficients */
+      for (; k < coef_limit; k++) {
+	FILL_BIT_BUFFER_FAST;
+	fe = &htbl->look_fast[PEEK_BITS(HUFF_FAST_BITS)];
+	if (fe->nbits) {
+	  DROP_BITS(fe->nbits);
+	  r = fe->sym;
+	  s = fe->value;
+	} else {
+	  HUFF_DECODE_FAST(r, htbl);
+	  if ((s = r & 15) != 0) {
+	    s = GET_BITS(s);
+	    s = HUFF_EXTEND(s, r & 15);
+	  }
+	}
+
+	if (r & 15) {
+	  k += r >> 4;
+	  (*block)[jpeg_natural_order[k]] = (JCOEF) s;
+	} else {
+	  if (r != 0xF0)
+	    goto EndOfBlock;
+	  k += 15;
+	}
+      }
+    }
+
+    /* Section F.2.2.2: decode the AC coefficients */
+    /* In this path we just discard the values */
+    for (; k < DCTSIZE2; k++) {
+      FILL_BIT_BUFFER_FAST;
+      fe = &htbl->look_fast[PEEK_BITS(HUFF_FAST_BITS)];
+      if (fe->nbits) {
+	DROP_BITS(fe->nbits);
+	r = fe->sym;
+      } else {
+	HUFF_DECODE_FAST(r, htbl);
+	DROP_BITS(r & 15);
+      }
+
+      if (r & 15) {
+	k += r >> 4;
+      } else {
+	if (r != 0xF0)
+	  break;
+	k += 15;
+      }
+    }
+
+    EndOfBlock: ;
+  }
+
+  /* Completed MCU, so update state */
+  cinfo->src->bytes_in_buffer -= (size_t) (next_input_byte -
+					   cinfo->src->next_input_byte);
+  cinfo->src->next_input_byte = next_input_byte;
+  entropy->bitstate.get_buffer = get_buffer;
+  entropy->bitstate.bits_left = bits_left;
+  ASSIGN_STATE(entropy->saved, state);
+
+  return TRUE;
+}
+
+#endif /* HUFF_FAST_BITS */
+
+
 /*
  * Decode one MCU's worth of Huffman-compressed coefficients,
  * full-size blocks.
@@ -1212,8 +1465,13 @@ decode_mcu (j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
 
   /* If we've run out of data, just leave the MCU set to zeroes.
    * This way, we return uniform gray for the remainder of the segment.
+   * Otherwise try the fast path first; if it declines, do it the hard way.
    */
+#ifdef HUFF_FAST_BITS
+  if (! entropy->insufficient_data && ! decode_mcu_fast(cinfo, MCU_data)) {
+#else
   if (! entropy->insufficient_data) {
+#endif
 
     /* Load up working state */
     BITREAD_LOAD_STATE(cinfo,entropy->bitstate);
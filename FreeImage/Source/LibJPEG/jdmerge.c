@@ -384,6 +384,10 @@ jinit_merged_upsampler (j_decompress_ptr cinfo)
   if (cinfo->max_v_samp_factor == 2) {
     upsample->pub.upsample = merged_2v_upsample;
     upsample->upmethod = h2v2_merged_upsample;
+#ifdef JSIMD_SSE2_SUPPORTED
+    if (jsimd_can_sse2())
+      upsample->upmethod = jsimd_h2v2_merged_upsample;
+#endif
     /* Allocate a spare row buffer */
     upsample->spare_row = (JSAMPROW)
       (*cinfo->mem->alloc_large) ((j_common_ptr) cinfo, JPOOL_IMAGE,
@@ -391,6 +395,10 @@ jinit_merged_upsampler (j_decompress_ptr cinfo)
   } else {
     upsample->pub.upsample = merged_1v_upsample;
     upsample->upmethod = h2v1_merged_upsample;
+#ifdef JSIMD_SSE2_SUPPORTED
+    if (jsimd_can_sse2())
+      upsample->upmethod = jsimd_h2v1_merged_upsample;
+#endif
     /* No spare row needed */
     upsample->spare_row = NULL;
   }
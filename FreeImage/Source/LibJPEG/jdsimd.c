@@ -0,0 +1,1007 @@
+/*
+ * jdsimd.c
+ *
+ * This file is part of the FastPreview modifications to the Independent
+ * JPEG Group's software.
+ * For conditions of distribution and use, see the accompanying README file.
+ *
+ * This file contains SSE2 versions of the decoder's hot loops:
+ * the 8x8 integer inverse DCTs (jidctint.c, jidctfst.c), the 16x16 and
+ * 16x8 ones that do fancy upsampling of h2v2 and h2v1 chroma (jidctint.c),
+ * YCbCr->RGB color conversion (jdcolor.c) and the merged
+ * upsampler/color converter (jdmerge.c).
+ *
+ * The routines produce exactly the same samples as the C code they replace.
+ * The inverse DCTs work in 16-bit lanes; the accurate ones check that
+ * their intermediate values fit and hand blocks that don't (which only
+ * corrupt data produces) to the C code.  jsimd_idct_ifast computes like
+ * jpeg_idct_ifast with a 16-bit DCTELEM, which jidctfst.c allows for 8-bit
+ * samples: it matches the C code for any block a JPEG encoder can produce,
+ * but may wrap differently on blocks of corrupt data.
+ * The caller modules pick these routines at initialization time when
+ * jsimd_can_sse2() reports a capable CPU.  Setting the environment
+ * variable JSIMD_FORCENONE to 1 keeps the C routines, for comparison.
+ */
+
+#define JPEG_INTERNALS
+#include "jinclude.h"
+#include "jpeglib.h"
+#include "jdct.h"		/* Private declarations for DCT subsystem */
+
+#ifdef JSIMD_SSE2_SUPPORTED
+
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__GNUC__)
+#include <cpuid.h>
+#endif
+
+#ifndef NO_GETENV
+#ifndef HAVE_STDLIB_H		/* <stdlib.h> should declare getenv() */
+extern char * getenv JPP((const char * name));
+#endif
+#endif
+
+#if DCTSIZE != 8
+  Sorry, this code only copes with 8x8 DCTs. /* deliberate syntax err */
+#endif
+
+
+/*
+ * Report whether the CPU supports SSE2 and the SIMD routines are wanted.
+ * The answer is cached.
+ */
+
+GLOBAL(boolean)
+jsimd_can_sse2 (void)
+{
+  static int checked = 0;
+  static int have_sse2 = 0;
+
+  if (! checked) {
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__x86_64__)
+    have_sse2 = 1;		/* part of the base instruction set */
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    have_sse2 = (info[3] >> 26) & 1;
+#elif defined(__GNUC__)
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+      have_sse2 = (edx >> 26) & 1;
+#endif
+#ifndef NO_GETENV
+    { char * env;
+
+      if ((env = getenv("JSIMD_FORCENONE")) != NULL && env[0] == '1' && env[1] == '\0')
+	have_sse2 = 0;
+    }
+#endif
+    checked = 1;
+  }
+  return have_sse2 ? TRUE : FALSE;
+}
+
+
+/*
+ * The SSE2 inverse DCTs keep the multipliers in 16-bit lanes.
+ * Report whether the component's table (built by jddctmgr.c for the
+ * current output pass) allows that.
+ */
+
+GLOBAL(boolean)
+jsimd_can_idct (jpeg_component_info * compptr)
+{
+  int * table = (int *) compptr->dct_table;
+  int i;
+
+  if (SIZEOF(ISLOW_MULT_TYPE) != SIZEOF(int) ||
+      SIZEOF(IFAST_MULT_TYPE) != SIZEOF(int))
+    return FALSE;
+  if (! jsimd_can_sse2())
+    return FALSE;
+  for (i = 0; i < DCTSIZE2; i++) {
+    if (table[i] < 0 || table[i] > 32767)
+      return FALSE;
+  }
+  return TRUE;
+}
+
+
+/**************** YCbCr -> RGB conversion ****************/
+
+
+/* The fixed-point constants are those of jdcolor.c and jdmerge.c;
+ * FIX() of jdct.h is replaced for this section.
+ */
+
+#undef FIX
+#define SCALEBITS	16
+#define ONE_HALF	((INT32) 1 << (SCALEBITS-1))
+#define FIX(x)		((INT32) ((x) * (1L<<SCALEBITS) + 0.5))
+
+
+/*
+ * Compute the chroma terms for 8 pixels.
+ * cbcr[0], cbcr[1] hold the centered Cb and Cr samples as 16-bit values;
+ * the red, green and blue terms are stored to rgb[0..2].
+ * These equal the Cr_r_tab, Cb_g_tab/Cr_g_tab and Cb_b_tab lookups:
+ * the products exceeding 16 bits are split into an integer part and a
+ * fraction that _mm_mulhi_epi16 can handle with the same rounding.
+ */
+
+LOCAL(void)
+ycc_chroma_sse2 (const __m128i * cbcr, __m128i * rgb)
+{
+  const __m128i one = _mm_set1_epi16(1);
+  const __m128i cb = cbcr[0];
+  const __m128i cr = cbcr[1];
+  const __m128i cb2 = _mm_add_epi16(cb, cb);
+  const __m128i cr2 = _mm_add_epi16(cr, cr);
+  /* Cb_g_tab + Cr_g_tab: -0.344136286 * Cb - 0.714136286 * Cr,
+   * computed as -0.344136286 * Cb + (1 - 0.714136286) * Cr - Cr.
+   */
+  const __m128i gk = _mm_setr_epi16(
+    (short) -FIX(0.344136286), (short) (FIX(1) - FIX(0.714136286)),
+    (short) -FIX(0.344136286), (short) (FIX(1) - FIX(0.714136286)),
+    (short) -FIX(0.344136286), (short) (FIX(1) - FIX(0.714136286)),
+    (short) -FIX(0.344136286), (short) (FIX(1) - FIX(0.714136286)));
+  const __m128i half = _mm_set1_epi32(ONE_HALF);
+  __m128i t, lo, hi;
+
+  /* Cr_r_tab: 1.402 * Cr = Cr + 0.402 * Cr */
+  t = _mm_mulhi_epi16(cr2, _mm_set1_epi16((short) (FIX(1.402) - FIX(1))));
+  rgb[0] = _mm_add_epi16(cr, _mm_srai_epi16(_mm_add_epi16(t, one), 1));
+
+  lo = _mm_madd_epi16(_mm_unpacklo_epi16(cb, cr), gk);
+  hi = _mm_madd_epi16(_mm_unpackhi_epi16(cb, cr), gk);
+  lo = _mm_srai_epi32(_mm_add_epi32(lo, half), SCALEBITS);
+  hi = _mm_srai_epi32(_mm_add_epi32(hi, half), SCALEBITS);
+  rgb[1] = _mm_sub_epi16(_mm_packs_epi32(lo, hi), cr);
+
+  /* Cb_b_tab: 1.772 * Cb = 2 * Cb - 0.228 * Cb */
+  t = _mm_mulhi_epi16(cb2, _mm_set1_epi16((short) (FIX(1.772) - FIX(2))));
+  rgb[2] = _mm_add_epi16(cb2, _mm_srai_epi16(_mm_add_epi16(t, one), 1));
+}
+
+
+/*
+ * Load 8 chroma samples and compute their terms.
+ */
+
+LOCAL(void)
+ycc_chroma8_sse2 (const JSAMPLE * cbptr, const JSAMPLE * crptr, __m128i * rgb)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i center = _mm_set1_epi16(CENTERJSAMPLE);
+  __m128i cbcr[2];
+
+  cbcr[0] = _mm_loadl_epi64((const __m128i *) cbptr);
+  cbcr[1] = _mm_loadl_epi64((const __m128i *) crptr);
+  cbcr[0] = _mm_sub_epi16(_mm_unpacklo_epi8(cbcr[0], zero), center);
+  cbcr[1] = _mm_sub_epi16(_mm_unpacklo_epi8(cbcr[1], zero), center);
+  ycc_chroma_sse2(cbcr, rgb);
+}
+
+
+/*
+ * Pack 4 pixels held as R,G,B,0 bytes into the low 12 bytes.
+ */
+
+LOCAL(__m128i)
+pack_rgb4_sse2 (__m128i p)
+{
+  const __m128i mask0 = _mm_set_epi32(0, 0x00FFFFFF, 0, 0x00FFFFFF);
+  const __m128i mask1 = _mm_set_epi32(0x0000FFFF, (int) 0xFF000000,
+				      0x0000FFFF, (int) 0xFF000000);
+
+  p = _mm_or_si128(_mm_and_si128(p, mask0),
+		   _mm_and_si128(_mm_srli_epi64(p, 8), mask1));
+  return _mm_or_si128(_mm_move_epi64(p),
+		      _mm_slli_si128(_mm_srli_si128(p, 8), 6));
+}
+
+
+/*
+ * Interleave 16 pixels from the R, G and B planes in rgb[0..2]
+ * and store them as 48 bytes.
+ */
+
+LOCAL(void)
+store_rgb16_sse2 (JSAMPROW outptr, const __m128i * rgb)
+{
+  const __m128i zero = _mm_setzero_si128();
+  __m128i rg, b0, p0, p1, p2, p3;
+
+  rg = _mm_unpacklo_epi8(rgb[0], rgb[1]);
+  b0 = _mm_unpacklo_epi8(rgb[2], zero);
+  p0 = pack_rgb4_sse2(_mm_unpacklo_epi16(rg, b0));
+  p1 = pack_rgb4_sse2(_mm_unpackhi_epi16(rg, b0));
+  rg = _mm_unpackhi_epi8(rgb[0], rgb[1]);
+  b0 = _mm_unpackhi_epi8(rgb[2], zero);
+  p2 = pack_rgb4_sse2(_mm_unpacklo_epi16(rg, b0));
+  p3 = pack_rgb4_sse2(_mm_unpackhi_epi16(rg, b0));
+
+  _mm_storeu_si128((__m128i *) outptr,
+		   _mm_or_si128(p0, _mm_slli_si128(p1, 12)));
+  _mm_storeu_si128((__m128i *) (outptr + 16),
+		   _mm_or_si128(_mm_srli_si128(p1, 4), _mm_slli_si128(p2, 8)));
+  _mm_storeu_si128((__m128i *) (outptr + 32),
+		   _mm_or_si128(_mm_srli_si128(p2, 8), _mm_slli_si128(p3, 4)));
+}
+
+
+/*
+ * Add the Y samples ylo/hi (16-bit) to the chroma terms of the matching
+ * pixels, range limit and store 16 pixels.
+ */
+
+LOCAL(void)
+emit_rgb16_sse2 (JSAMPROW outptr, __m128i ylo, __m128i yhi,
+		 const __m128i * clo, const __m128i * chi)
+{
+  __m128i rgb[3];
+  int i;
+
+  for (i = 0; i < 3; i++)
+    rgb[i] = _mm_packus_epi16(_mm_add_epi16(ylo, clo[i]),
+			      _mm_add_epi16(yhi, chi[i]));
+  store_rgb16_sse2(outptr, rgb);
+}
+
+
+/*
+ * Convert 16 pixels.
+ */
+
+LOCAL(void)
+ycc_rgb16_sse2 (const JSAMPLE * yptr, const JSAMPLE * cbptr,
+		const JSAMPLE * crptr, JSAMPROW outptr)
+{
+  const __m128i zero = _mm_setzero_si128();
+  __m128i y, clo[3], chi[3];
+
+  ycc_chroma8_sse2(cbptr, crptr, clo);
+  ycc_chroma8_sse2(cbptr + 8, crptr + 8, chi);
+  y = _mm_loadu_si128((const __m128i *) yptr);
+  emit_rgb16_sse2(outptr, _mm_unpacklo_epi8(y, zero),
+		  _mm_unpackhi_epi8(y, zero), clo, chi);
+}
+
+
+/*
+ * Replacement for ycc_rgb_convert (jdcolor.c) in the JCS_YCbCr case.
+ */
+
+GLOBAL(void)
+jsimd_ycc_rgb_convert (j_decompress_ptr cinfo,
+		       JSAMPIMAGE input_buf, JDIMENSION input_row,
+		       JSAMPARRAY output_buf, int num_rows)
+{
+  JSAMPROW outptr;
+  JSAMPROW inptr0, inptr1, inptr2;
+  JDIMENSION col, rest;
+  JDIMENSION num_cols = cinfo->output_width;
+  JSAMPLE y[16], cb[16], cr[16], rgb[16*3];
+
+  while (--num_rows >= 0) {
+    inptr0 = input_buf[0][input_row];
+    inptr1 = input_buf[1][input_row];
+    inptr2 = input_buf[2][input_row];
+    input_row++;
+    outptr = *output_buf++;
+    for (col = 0; num_cols - col >= 16; col += 16)
+      ycc_rgb16_sse2(inptr0 + col, inptr1 + col, inptr2 + col,
+		     outptr + col * RGB_PIXELSIZE);
+    if (col < num_cols) {
+      /* Run the last few pixels through a padded buffer */
+      rest = num_cols - col;
+      MEMZERO(y, SIZEOF(y));
+      MEMZERO(cb, SIZEOF(cb));
+      MEMZERO(cr, SIZEOF(cr));
+      MEMCOPY(y, inptr0 + col, rest * SIZEOF(JSAMPLE));
+      MEMCOPY(cb, inptr1 + col, rest * SIZEOF(JSAMPLE));
+      MEMCOPY(cr, inptr2 + col, rest * SIZEOF(JSAMPLE));
+      ycc_rgb16_sse2(y, cb, cr, rgb);
+      MEMCOPY(outptr + col * RGB_PIXELSIZE, rgb,
+	      rest * RGB_PIXELSIZE * SIZEOF(JSAMPLE));
+    }
+  }
+}
+
+
+/*
+ * Upsample and color convert 16 output pixels of one or two rows
+ * (h2v1 or h2v2) sharing the same 8 chroma samples.
+ */
+
+LOCAL(void)
+merged16_sse2 (const JSAMPLE * yptr0, const JSAMPLE * yptr1,
+	       const JSAMPLE * cbptr, const JSAMPLE * crptr,
+	       JSAMPROW outptr0, JSAMPROW outptr1)
+{
+  const __m128i zero = _mm_setzero_si128();
+  __m128i c[3], clo[3], chi[3], y;
+  int i;
+
+  ycc_chroma8_sse2(cbptr, crptr, c);
+  for (i = 0; i < 3; i++) {
+    clo[i] = _mm_unpacklo_epi16(c[i], c[i]);
+    chi[i] = _mm_unpackhi_epi16(c[i], c[i]);
+  }
+  y = _mm_loadu_si128((const __m128i *) yptr0);
+  emit_rgb16_sse2(outptr0, _mm_unpacklo_epi8(y, zero),
+		  _mm_unpackhi_epi8(y, zero), clo, chi);
+  if (yptr1 != NULL) {
+    y = _mm_loadu_si128((const __m128i *) yptr1);
+    emit_rgb16_sse2(outptr1, _mm_unpacklo_epi8(y, zero),
+		    _mm_unpackhi_epi8(y, zero), clo, chi);
+  }
+}
+
+
+/*
+ * Common body of the merged upsamplers; inptr01 is NULL for h2v1.
+ */
+
+LOCAL(void)
+merged_upsample_sse2 (j_decompress_ptr cinfo,
+		      JSAMPROW inptr00, JSAMPROW inptr01,
+		      JSAMPROW inptr1, JSAMPROW inptr2,
+		      JSAMPROW outptr0, JSAMPROW outptr1)
+{
+  JDIMENSION col, rest;
+  JDIMENSION num_cols = cinfo->output_width;
+  JSAMPLE y0[16], y1[16], cb[8], cr[8], rgb0[16*3], rgb1[16*3];
+
+  for (col = 0; num_cols - col >= 16; col += 16)
+    merged16_sse2(inptr00 + col, inptr01 != NULL ? inptr01 + col : NULL,
+		  inptr1 + col / 2, inptr2 + col / 2,
+		  outptr0 + col * RGB_PIXELSIZE,
+		  outptr1 != NULL ? outptr1 + col * RGB_PIXELSIZE : NULL);
+  if (col < num_cols) {
+    /* Run the last few pixels through a padded buffer.
+     * An odd last pixel uses the chroma sample of its own column pair,
+     * as in the C code.
+     */
+    rest = num_cols - col;
+    MEMZERO(y0, SIZEOF(y0));
+    MEMZERO(y1, SIZEOF(y1));
+    MEMZERO(cb, SIZEOF(cb));
+    MEMZERO(cr, SIZEOF(cr));
+    MEMCOPY(y0, inptr00 + col, rest * SIZEOF(JSAMPLE));
+    if (inptr01 != NULL)
+      MEMCOPY(y1, inptr01 + col, rest * SIZEOF(JSAMPLE));
+    MEMCOPY(cb, inptr1 + col / 2, ((rest + 1) / 2) * SIZEOF(JSAMPLE));
+    MEMCOPY(cr, inptr2 + col / 2, ((rest + 1) / 2) * SIZEOF(JSAMPLE));
+    merged16_sse2(y0, inptr01 != NULL ? y1 : NULL, cb, cr, rgb0, rgb1);
+    MEMCOPY(outptr0 + col * RGB_PIXELSIZE, rgb0,
+	    rest * RGB_PIXELSIZE * SIZEOF(JSAMPLE));
+    if (outptr1 != NULL)
+      MEMCOPY(outptr1 + col * RGB_PIXELSIZE, rgb1,
+	      rest * RGB_PIXELSIZE * SIZEOF(JSAMPLE));
+  }
+}
+
+
+/*
+ * Replacement for h2v1_merged_upsample (jdmerge.c).
+ */
+
+GLOBAL(void)
+jsimd_h2v1_merged_upsample (j_decompress_ptr cinfo,
+			    JSAMPIMAGE input_buf, JDIMENSION in_row_group_ctr,
+			    JSAMPARRAY output_buf)
+{
+  merged_upsample_sse2(cinfo, input_buf[0][in_row_group_ctr], NULL,
+		       input_buf[1][in_row_group_ctr],
+		       input_buf[2][in_row_group_ctr],
+		       output_buf[0], NULL);
+}
+
+
+/*
+ * Replacement for h2v2_merged_upsample (jdmerge.c).
+ */
+
+GLOBAL(void)
+jsimd_h2v2_merged_upsample (j_decompress_ptr cinfo,
+			    JSAMPIMAGE input_buf, JDIMENSION in_row_group_ctr,
+			    JSAMPARRAY output_buf)
+{
+  merged_upsample_sse2(cinfo, input_buf[0][in_row_group_ctr*2],
+		       input_buf[0][in_row_group_ctr*2 + 1],
+		       input_buf[1][in_row_group_ctr],
+		       input_buf[2][in_row_group_ctr],
+		       output_buf[0], output_buf[1]);
+}
+
+
+#undef FIX
+#define FIX(x)	((INT32) ((x) * CONST_SCALE + 0.5))
+
+
+/**************** Inverse DCT helpers ****************/
+
+
+/*
+ * Transpose 8 rows of 8 16-bit values in place.
+ */
+
+LOCAL(void)
+transpose8x8_sse2 (__m128i * r)
+{
+  __m128i a0, a1, a2, a3, a4, a5, a6, a7;
+  __m128i b0, b1, b2, b3, b4, b5, b6, b7;
+
+  a0 = _mm_unpacklo_epi16(r[0], r[1]);
+  a1 = _mm_unpackhi_epi16(r[0], r[1]);
+  a2 = _mm_unpacklo_epi16(r[2], r[3]);
+  a3 = _mm_unpackhi_epi16(r[2], r[3]);
+  a4 = _mm_unpacklo_epi16(r[4], r[5]);
+  a5 = _mm_unpackhi_epi16(r[4], r[5]);
+  a6 = _mm_unpacklo_epi16(r[6], r[7]);
+  a7 = _mm_unpackhi_epi16(r[6], r[7]);
+
+  b0 = _mm_unpacklo_epi32(a0, a2);
+  b1 = _mm_unpackhi_epi32(a0, a2);
+  b2 = _mm_unpacklo_epi32(a1, a3);
+  b3 = _mm_unpackhi_epi32(a1, a3);
+  b4 = _mm_unpacklo_epi32(a4, a6);
+  b5 = _mm_unpackhi_epi32(a4, a6);
+  b6 = _mm_unpacklo_epi32(a5, a7);
+  b7 = _mm_unpackhi_epi32(a5, a7);
+
+  r[0] = _mm_unpacklo_epi64(b0, b4);
+  r[1] = _mm_unpackhi_epi64(b0, b4);
+  r[2] = _mm_unpacklo_epi64(b1, b5);
+  r[3] = _mm_unpackhi_epi64(b1, b5);
+  r[4] = _mm_unpacklo_epi64(b2, b6);
+  r[5] = _mm_unpackhi_epi64(b2, b6);
+  r[6] = _mm_unpacklo_epi64(b3, b7);
+  r[7] = _mm_unpackhi_epi64(b3, b7);
+}
+
+
+/*
+ * Dequantize the coefficient block into 8 rows of 16-bit values.
+ * Returns a nonzero mask if a product does not fit in 16 bits.
+ */
+
+LOCAL(__m128i)
+dequantize_sse2 (JCOEFPTR coef_block, const int * table, __m128i * r)
+{
+  __m128i q, lo, hi, bad = _mm_setzero_si128();
+  int i;
+
+  for (i = 0; i < DCTSIZE; i++) {
+    q = _mm_packs_epi32(
+	  _mm_loadu_si128((const __m128i *) (table + i*DCTSIZE)),
+	  _mm_loadu_si128((const __m128i *) (table + i*DCTSIZE + 4)));
+    r[i] = _mm_loadu_si128((const __m128i *) (coef_block + i*DCTSIZE));
+    lo = _mm_mullo_epi16(r[i], q);
+    hi = _mm_mulhi_epi16(r[i], q);
+    bad = _mm_or_si128(bad, _mm_xor_si128(hi, _mm_srai_epi16(lo, 15)));
+    r[i] = lo;
+  }
+  return bad;
+}
+
+
+/*
+ * Range limit descaled outputs exactly like IDCT_range_limit()[x & RANGE_MASK].
+ * The table maps x & RANGE_MASK in 0..511 to x + CENTERJSAMPLE and
+ * 512..1023 to x - 1024 + CENTERJSAMPLE; the result still needs
+ * clamping to 0..MAXJSAMPLE, which _mm_packus_epi16 does.
+ */
+
+LOCAL(__m128i)
+range_limit_sse2 (__m128i x)
+{
+  const __m128i mask = _mm_set1_epi16(RANGE_MASK);
+  const __m128i flip = _mm_set1_epi16((RANGE_MASK+1) / 2);
+  const __m128i bias = _mm_set1_epi16((RANGE_MASK+1) / 2 - CENTERJSAMPLE);
+
+  return _mm_sub_epi16(_mm_xor_si128(_mm_and_si128(x, mask), flip), bias);
+}
+
+
+/*
+ * Range limit and store an 8x8 block of descaled outputs, one row each.
+ */
+
+LOCAL(void)
+store_block_sse2 (const __m128i * r, JSAMPARRAY output_buf,
+		  JDIMENSION output_col)
+{
+  __m128i v;
+  int i;
+
+  for (i = 0; i < DCTSIZE; i++) {
+    v = range_limit_sse2(r[i]);
+    _mm_storel_epi64((__m128i *) (output_buf[i] + output_col),
+		     _mm_packus_epi16(v, v));
+  }
+}
+
+
+/*
+ * Test a mask built by dequantize_sse2 or descale_pass1_sse2.
+ */
+
+LOCAL(boolean)
+all_zero_sse2 (__m128i bad)
+{
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(bad, _mm_setzero_si128())) == 0xFFFF;
+}
+
+
+/**************** Accurate integer inverse DCT ****************/
+
+
+/* Constants of jidctint.c (CONST_BITS = 13, PASS1_BITS = 2) */
+
+#define CONST_BITS  13
+#define PASS1_BITS  2
+
+#define FIX_0_298631336  ((INT32)  2446)	/* FIX(0.298631336) */
+#define FIX_0_390180644  ((INT32)  3196)	/* FIX(0.390180644) */
+#define FIX_0_541196100  ((INT32)  4433)	/* FIX(0.541196100) */
+#define FIX_0_765366865  ((INT32)  6270)	/* FIX(0.765366865) */
+#define FIX_0_899976223  ((INT32)  7373)	/* FIX(0.899976223) */
+#define FIX_1_175875602  ((INT32)  9633)	/* FIX(1.175875602) */
+#define FIX_1_501321110  ((INT32)  12299)	/* FIX(1.501321110) */
+#define FIX_1_847759065  ((INT32)  15137)	/* FIX(1.847759065) */
+#define FIX_1_961570560  ((INT32)  16069)	/* FIX(1.961570560) */
+#define FIX_2_053119869  ((INT32)  16819)	/* FIX(2.053119869) */
+#define FIX_2_562915447  ((INT32)  20995)	/* FIX(2.562915447) */
+#define FIX_3_072711026  ((INT32)  25172)	/* FIX(3.072711026) */
+
+/* A pair of multipliers for _mm_madd_epi16 */
+#define PW(a,b)  _mm_setr_epi16((short) (a), (short) (b), (short) (a), \
+				(short) (b), (short) (a), (short) (b), \
+				(short) (a), (short) (b))
+
+
+/*
+ * One dimensional 8-point IDCT of jpeg_idct_islow on 4 lanes.
+ * p[0..3] hold the interleaved input pairs (0,4), (2,6), (7,5) and (3,1);
+ * the rotations of the odd part are expanded into one multiplier per
+ * input so that each output is two _mm_madd_epi16 sums.
+ * out[0..7] receive the 32-bit outputs, not yet descaled.
+ */
+
+LOCAL(void)
+islow_half_sse2 (const __m128i * p, const __m128i * round, __m128i * out)
+{
+  __m128i tmp0, tmp1, tmp2, tmp3, tmp10, tmp11, tmp12, tmp13;
+
+  /* Even part */
+
+  tmp0 = _mm_add_epi32(_mm_madd_epi16(p[0], PW(1 << CONST_BITS,
+					       1 << CONST_BITS)), *round);
+  tmp1 = _mm_add_epi32(_mm_madd_epi16(p[0], PW(1 << CONST_BITS,
+					       -(1 << CONST_BITS))), *round);
+  tmp2 = _mm_madd_epi16(p[1], PW(FIX_0_541196100 + FIX_0_765366865,
+				 FIX_0_541196100));
+  tmp3 = _mm_madd_epi16(p[1], PW(FIX_0_541196100,
+				 FIX_0_541196100 - FIX_1_847759065));
+
+  tmp10 = _mm_add_epi32(tmp0, tmp2);
+  tmp13 = _mm_sub_epi32(tmp0, tmp2);
+  tmp11 = _mm_add_epi32(tmp1, tmp3);
+  tmp12 = _mm_sub_epi32(tmp1, tmp3);
+
+  /* Odd part; the inputs are y7, y5, y3, y1 */
+
+  tmp0 = _mm_add_epi32(
+    _mm_madd_epi16(p[2], PW(FIX_0_298631336 - FIX_0_899976223 -
+			    FIX_1_961570560 + FIX_1_175875602,
+			    FIX_1_175875602)),
+    _mm_madd_epi16(p[3], PW(FIX_1_175875602 - FIX_1_961570560,
+			    FIX_1_175875602 - FIX_0_899976223)));
+  tmp1 = _mm_add_epi32(
+    _mm_madd_epi16(p[2], PW(FIX_1_175875602,
+			    FIX_2_053119869 - FIX_2_562915447 -
+			    FIX_0_390180644 + FIX_1_175875602)),
+    _mm_madd_epi16(p[3], PW(FIX_1_175875602 - FIX_2_562915447,
+			    FIX_1_175875602 - FIX_0_390180644)));
+  tmp2 = _mm_add_epi32(
+    _mm_madd_epi16(p[2], PW(FIX_1_175875602 - FIX_1_961570560,
+			    FIX_1_175875602 - FIX_2_562915447)),
+    _mm_madd_epi16(p[3], PW(FIX_3_072711026 - FIX_2_562915447 -
+			    FIX_1_961570560 + FIX_1_175875602,
+			    FIX_1_175875602)));
+  tmp3 = _mm_add_epi32(
+    _mm_madd_epi16(p[2], PW(FIX_1_175875602 - FIX_0_899976223,
+			    FIX_1_175875602 - FIX_0_390180644)),
+    _mm_madd_epi16(p[3], PW(FIX_1_175875602,
+			    FIX_1_501321110 - FIX_0_899976223 -
+			    FIX_0_390180644 + FIX_1_175875602)));
+
+  /* Final output stage */
+
+  out[0] = _mm_add_epi32(tmp10, tmp3);
+  out[7] = _mm_sub_epi32(tmp10, tmp3);
+  out[1] = _mm_add_epi32(tmp11, tmp2);
+  out[6] = _mm_sub_epi32(tmp11, tmp2);
+  out[2] = _mm_add_epi32(tmp12, tmp1);
+  out[5] = _mm_sub_epi32(tmp12, tmp1);
+  out[3] = _mm_add_epi32(tmp13, tmp0);
+  out[4] = _mm_sub_epi32(tmp13, tmp0);
+}
+
+
+/*
+ * One dimensional IDCT on 8 lanes: r[k] holds input k of every lane.
+ * lo/hi receive the outputs of lanes 0-3 and 4-7.
+ */
+
+LOCAL(void)
+islow_1d_sse2 (const __m128i * r, __m128i round, __m128i * lo, __m128i * hi)
+{
+  __m128i p[4];
+
+  p[0] = _mm_unpacklo_epi16(r[0], r[4]);
+  p[1] = _mm_unpacklo_epi16(r[2], r[6]);
+  p[2] = _mm_unpacklo_epi16(r[7], r[5]);
+  p[3] = _mm_unpacklo_epi16(r[3], r[1]);
+  islow_half_sse2(p, &round, lo);
+  p[0] = _mm_unpackhi_epi16(r[0], r[4]);
+  p[1] = _mm_unpackhi_epi16(r[2], r[6]);
+  p[2] = _mm_unpackhi_epi16(r[7], r[5]);
+  p[3] = _mm_unpackhi_epi16(r[3], r[1]);
+  islow_half_sse2(p, &round, hi);
+}
+
+
+/*
+ * Descale the pass 1 outputs lo/hi[0..n-1] into the 16-bit work array r.
+ * The work array values must fit in 16 bits for pass 2; a saturated
+ * value means one doesn't, which is or'ed into the returned mask.
+ */
+
+LOCAL(__m128i)
+descale_pass1_sse2 (const __m128i * lo, const __m128i * hi, __m128i * r,
+		    int n, __m128i bad)
+{
+  __m128i vmax, vmin;
+  int i;
+
+  for (i = 0; i < n; i++)
+    r[i] = _mm_packs_epi32(_mm_srai_epi32(lo[i], CONST_BITS-PASS1_BITS),
+			   _mm_srai_epi32(hi[i], CONST_BITS-PASS1_BITS));
+  vmax = vmin = r[0];
+  for (i = 1; i < n; i++) {
+    vmax = _mm_max_epi16(vmax, r[i]);
+    vmin = _mm_min_epi16(vmin, r[i]);
+  }
+  bad = _mm_or_si128(bad, _mm_cmpeq_epi16(vmax, _mm_set1_epi16(32767)));
+  return _mm_or_si128(bad, _mm_cmpeq_epi16(vmin, _mm_set1_epi16(-32768)));
+}
+
+
+/*
+ * Replacement for jpeg_idct_islow (jidctint.c).
+ * The short-cuts for zero columns and rows there give the same results
+ * as the full calculation, so they are not needed here.
+ */
+
+GLOBAL(void)
+jsimd_idct_islow (j_decompress_ptr cinfo, jpeg_component_info * compptr,
+		  JCOEFPTR coef_block,
+		  JSAMPARRAY output_buf, JDIMENSION output_col)
+{
+  __m128i r[DCTSIZE], lo[DCTSIZE], hi[DCTSIZE];
+  __m128i bad;
+  int i;
+
+  bad = dequantize_sse2(coef_block, (const int *) compptr->dct_table, r);
+
+  /* Pass 1: process columns */
+  islow_1d_sse2(r, _mm_set1_epi32(1 << (CONST_BITS-PASS1_BITS-1)), lo, hi);
+  bad = descale_pass1_sse2(lo, hi, r, DCTSIZE, bad);
+  if (! all_zero_sse2(bad)) {
+    jpeg_idct_islow(cinfo, compptr, coef_block, output_buf, output_col);
+    return;
+  }
+
+  /* Pass 2: process rows; the fudge factor for the final descale is
+   * added with the DC term as in jidctint.c.
+   */
+  transpose8x8_sse2(r);
+  islow_1d_sse2(r, _mm_set1_epi32(1 << (CONST_BITS+PASS1_BITS+2)), lo, hi);
+  for (i = 0; i < DCTSIZE; i++)
+    r[i] = _mm_packs_epi32(_mm_srai_epi32(lo[i], CONST_BITS+PASS1_BITS+3),
+			   _mm_srai_epi32(hi[i], CONST_BITS+PASS1_BITS+3));
+  transpose8x8_sse2(r);
+  store_block_sse2(r, output_buf, output_col);
+}
+
+
+#ifdef IDCT_SCALING_SUPPORTED
+
+/*
+ * jpeg_idct_16x16 and jpeg_idct_16x8 (jidctint.c) produce the chroma of
+ * h2v2 and h2v1 images at full size when do_fancy_upsampling is set.
+ * Their 16-point kernel has the rotations expanded into one multiplier per
+ * input; each entry is the exact sum of the FIX() products applied to that
+ * input there.  Row k holds the pairs for (y0,y4) and (y2,y6) of the even
+ * part and (y1,y3), (y5,y7) of the odd part of outputs k and 15-k.
+ */
+
+#define PAIR(a,b)  ((INT32) (b) * 65536 + ((a) & 0xFFFF))
+
+static const INT32 idct16_mult[8][4] = {
+  { PAIR(8192,  10703), PAIR( 11363,   9632),
+    PAIR(11529, 11086), PAIR( 10217,   8956) },
+  { PAIR(8192,   4433), PAIR(  9633,  -2260),
+    PAIR(11086,  7350), PAIR(  1136,  -5461) },
+  { PAIR(8192,  -4433), PAIR(  6437, -11363),
+    PAIR(10217,  1136), PAIR( -8955, -11086) },
+  { PAIR(8192, -10703), PAIR(  2260,  -6436),
+    PAIR( 8956, -5461), PAIR(-11086,   1137) },
+  { PAIR(8192, -10703), PAIR( -2260,   6436),
+    PAIR( 7350,-10217), PAIR( -3363,  11529) },
+  { PAIR(8192,  -4433), PAIR( -6437,  11363),
+    PAIR( 5461,-11529), PAIR(  7349,   3363) },
+  { PAIR(8192,   4433), PAIR( -9633,   2260),
+    PAIR( 3363, -8955), PAIR( 11529, -10217) },
+  { PAIR(8192,  10703), PAIR(-11363,  -9632),
+    PAIR( 1136, -3363), PAIR(  5461,  -7350) }
+};
+
+
+/*
+ * One dimensional 16-point IDCT on 4 lanes; p[0..3] hold the interleaved
+ * input pairs in the order of idct16_mult.
+ */
+
+LOCAL(void)
+idct16_half_sse2 (const __m128i * p, const __m128i * round, __m128i * out)
+{
+  __m128i even, odd;
+  int k;
+
+  for (k = 0; k < 8; k++) {
+    even = _mm_add_epi32(
+      _mm_madd_epi16(p[0], _mm_set1_epi32(idct16_mult[k][0])),
+      _mm_madd_epi16(p[1], _mm_set1_epi32(idct16_mult[k][1])));
+    even = _mm_add_epi32(even, *round);
+    odd = _mm_add_epi32(
+      _mm_madd_epi16(p[2], _mm_set1_epi32(idct16_mult[k][2])),
+      _mm_madd_epi16(p[3], _mm_set1_epi32(idct16_mult[k][3])));
+    out[k] = _mm_add_epi32(even, odd);
+    out[15-k] = _mm_sub_epi32(even, odd);
+  }
+}
+
+
+/*
+ * One dimensional 16-point IDCT on 8 lanes: r[k] holds input k of every
+ * lane; lo/hi[0..15] receive the outputs of lanes 0-3 and 4-7.
+ */
+
+LOCAL(void)
+idct16_1d_sse2 (const __m128i * r, __m128i round, __m128i * lo, __m128i * hi)
+{
+  __m128i p[4];
+
+  p[0] = _mm_unpacklo_epi16(r[0], r[4]);
+  p[1] = _mm_unpacklo_epi16(r[2], r[6]);
+  p[2] = _mm_unpacklo_epi16(r[1], r[3]);
+  p[3] = _mm_unpacklo_epi16(r[5], r[7]);
+  idct16_half_sse2(p, &round, lo);
+  p[0] = _mm_unpackhi_epi16(r[0], r[4]);
+  p[1] = _mm_unpackhi_epi16(r[2], r[6]);
+  p[2] = _mm_unpackhi_epi16(r[1], r[3]);
+  p[3] = _mm_unpackhi_epi16(r[5], r[7]);
+  idct16_half_sse2(p, &round, hi);
+}
+
+
+/*
+ * Pass 2 of the 16-point IDCTs for 8 rows of the work array in r,
+ * storing 8 output rows of 16 samples.
+ */
+
+LOCAL(void)
+idct16_rows_sse2 (__m128i * r, JSAMPARRAY output_buf, JDIMENSION output_col)
+{
+  __m128i lo[16], hi[16], left[8], right[8];
+  int i;
+
+  transpose8x8_sse2(r);
+  idct16_1d_sse2(r, _mm_set1_epi32(1 << (CONST_BITS+PASS1_BITS+2)), lo, hi);
+  for (i = 0; i < 8; i++) {
+    left[i] = _mm_packs_epi32(_mm_srai_epi32(lo[i], CONST_BITS+PASS1_BITS+3),
+			      _mm_srai_epi32(hi[i], CONST_BITS+PASS1_BITS+3));
+    right[i] = _mm_packs_epi32(
+		 _mm_srai_epi32(lo[i+8], CONST_BITS+PASS1_BITS+3),
+		 _mm_srai_epi32(hi[i+8], CONST_BITS+PASS1_BITS+3));
+  }
+  transpose8x8_sse2(left);
+  transpose8x8_sse2(right);
+  for (i = 0; i < 8; i++)
+    _mm_storeu_si128((__m128i *) (output_buf[i] + output_col),
+		     _mm_packus_epi16(range_limit_sse2(left[i]),
+				      range_limit_sse2(right[i])));
+}
+
+
+/*
+ * Replacement for jpeg_idct_16x16 (jidctint.c).
+ */
+
+GLOBAL(void)
+jsimd_idct_16x16 (j_decompress_ptr cinfo, jpeg_component_info * compptr,
+		  JCOEFPTR coef_block,
+		  JSAMPARRAY output_buf, JDIMENSION output_col)
+{
+  __m128i r[16], lo[16], hi[16];
+  __m128i bad;
+
+  bad = dequantize_sse2(coef_block, (const int *) compptr->dct_table, r);
+
+  /* Pass 1: process columns, 16 outputs each */
+  idct16_1d_sse2(r, _mm_set1_epi32(1 << (CONST_BITS-PASS1_BITS-1)), lo, hi);
+  bad = descale_pass1_sse2(lo, hi, r, 16, bad);
+  if (! all_zero_sse2(bad)) {
+    jpeg_idct_16x16(cinfo, compptr, coef_block, output_buf, output_col);
+    return;
+  }
+
+  /* Pass 2: process 16 rows */
+  idct16_rows_sse2(r, output_buf, output_col);
+  idct16_rows_sse2(r + 8, output_buf + 8, output_col);
+}
+
+
+/*
+ * Replacement for jpeg_idct_16x8 (jidctint.c).
+ */
+
+GLOBAL(void)
+jsimd_idct_16x8 (j_decompress_ptr cinfo, jpeg_component_info * compptr,
+		 JCOEFPTR coef_block,
+		 JSAMPARRAY output_buf, JDIMENSION output_col)
+{
+  __m128i r[DCTSIZE], lo[DCTSIZE], hi[DCTSIZE];
+  __m128i bad;
+
+  bad = dequantize_sse2(coef_block, (const int *) compptr->dct_table, r);
+
+  /* Pass 1: process columns with the 8-point kernel */
+  islow_1d_sse2(r, _mm_set1_epi32(1 << (CONST_BITS-PASS1_BITS-1)), lo, hi);
+  bad = descale_pass1_sse2(lo, hi, r, DCTSIZE, bad);
+  if (! all_zero_sse2(bad)) {
+    jpeg_idct_16x8(cinfo, compptr, coef_block, output_buf, output_col);
+    return;
+  }
+
+  /* Pass 2: process 8 rows */
+  idct16_rows_sse2(r, output_buf, output_col);
+}
+
+#endif /* IDCT_SCALING_SUPPORTED */
+
+#undef CONST_BITS
+#undef PASS1_BITS
+#undef FIX_1_847759065
+
+
+/**************** Fast integer inverse DCT ****************/
+
+
+/* Constants of jidctfst.c (CONST_BITS = 8, PASS1_BITS = 2) */
+
+#define CONST_BITS  8
+#define PASS1_BITS  2
+
+#define FIX_1_082392200  ((INT32)  277)		/* FIX(1.082392200) */
+#define FIX_1_414213562  ((INT32)  362)		/* FIX(1.414213562) */
+#define FIX_1_847759065  ((INT32)  473)		/* FIX(1.847759065) */
+#define FIX_2_613125930  ((INT32)  669)		/* FIX(2.613125930) */
+
+
+/*
+ * MULTIPLY of jidctfst.c: bits 8..23 of the 32-bit product.
+ */
+
+LOCAL(__m128i)
+ifast_mul_sse2 (__m128i x, short k)
+{
+  const __m128i c = _mm_set1_epi16(k);
+
+  return _mm_or_si128(_mm_srli_epi16(_mm_mullo_epi16(x, c), CONST_BITS),
+		      _mm_slli_epi16(_mm_mulhi_epi16(x, c), 16-CONST_BITS));
+}
+
+
+/*
+ * One dimensional IDCT of jpeg_idct_ifast on 8 lanes, in place.
+ */
+
+LOCAL(void)
+ifast_1d_sse2 (__m128i * r)
+{
+  __m128i tmp0, tmp1, tmp2, tmp3, tmp4, tmp5, tmp6, tmp7;
+  __m128i tmp10, tmp11, tmp12, tmp13;
+  __m128i z5, z10, z11, z12, z13;
+
+  /* Even part */
+
+  tmp10 = _mm_add_epi16(r[0], r[4]);
+  tmp11 = _mm_sub_epi16(r[0], r[4]);
+  tmp13 = _mm_add_epi16(r[2], r[6]);
+  tmp12 = _mm_sub_epi16(ifast_mul_sse2(_mm_sub_epi16(r[2], r[6]),
+				       FIX_1_414213562), tmp13);
+
+  tmp0 = _mm_add_epi16(tmp10, tmp13);
+  tmp3 = _mm_sub_epi16(tmp10, tmp13);
+  tmp1 = _mm_add_epi16(tmp11, tmp12);
+  tmp2 = _mm_sub_epi16(tmp11, tmp12);
+
+  /* Odd part */
+
+  z13 = _mm_add_epi16(r[5], r[3]);
+  z10 = _mm_sub_epi16(r[5], r[3]);
+  z11 = _mm_add_epi16(r[1], r[7]);
+  z12 = _mm_sub_epi16(r[1], r[7]);
+
+  tmp7 = _mm_add_epi16(z11, z13);
+  tmp11 = ifast_mul_sse2(_mm_sub_epi16(z11, z13), FIX_1_414213562);
+
+  z5 = ifast_mul_sse2(_mm_add_epi16(z10, z12), FIX_1_847759065);
+  tmp10 = _mm_sub_epi16(ifast_mul_sse2(z12, FIX_1_082392200), z5);
+  tmp12 = _mm_add_epi16(ifast_mul_sse2(z10, -FIX_2_613125930), z5);
+
+  tmp6 = _mm_sub_epi16(tmp12, tmp7);
+  tmp5 = _mm_sub_epi16(tmp11, tmp6);
+  tmp4 = _mm_add_epi16(tmp10, tmp5);
+
+  r[0] = _mm_add_epi16(tmp0, tmp7);
+  r[7] = _mm_sub_epi16(tmp0, tmp7);
+  r[1] = _mm_add_epi16(tmp1, tmp6);
+  r[6] = _mm_sub_epi16(tmp1, tmp6);
+  r[2] = _mm_add_epi16(tmp2, tmp5);
+  r[5] = _mm_sub_epi16(tmp2, tmp5);
+  r[4] = _mm_add_epi16(tmp3, tmp4);
+  r[3] = _mm_sub_epi16(tmp3, tmp4);
+}
+
+
+/*
+ * Replacement for jpeg_idct_ifast (jidctfst.c).
+ * Blocks whose dequantized coefficients overflow 16 bits go to the C code.
+ */
+
+GLOBAL(void)
+jsimd_idct_ifast (j_decompress_ptr cinfo, jpeg_component_info * compptr,
+		  JCOEFPTR coef_block,
+		  JSAMPARRAY output_buf, JDIMENSION output_col)
+{
+  __m128i r[DCTSIZE];
+  __m128i bad;
+  int i;
+
+  bad = dequantize_sse2(coef_block, (const int *) compptr->dct_table, r);
+  if (! all_zero_sse2(bad)) {
+    jpeg_idct_ifast(cinfo, compptr, coef_block, output_buf, output_col);
+    return;
+  }
+
+  /* Pass 1: process columns */
+  ifast_1d_sse2(r);
+
+  /* Pass 2: process rows, descale by 2**(PASS1_BITS+3) */
+  transpose8x8_sse2(r);
+  ifast_1d_sse2(r);
+  for (i = 0; i < DCTSIZE; i++)
+    r[i] = _mm_srai_epi16(r[i], PASS1_BITS+3);
+  transpose8x8_sse2(r);
+  store_block_sse2(r, output_buf, output_col);
+}
+
+#endif /* JSIMD_SSE2_SUPPORTED */
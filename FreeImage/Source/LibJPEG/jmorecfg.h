@@ -439,4 +439,18 @@ typedef enum { FALSE = 0, TRUE = 1 } boolean;
 #endif
 #endif
 
+
+/* The decoder's inverse DCTs, YCbCr->RGB color conversion and merged
+ * upsampling have SSE2 versions in jdsimd.c, chosen at run time on CPUs
+ * that support them.  They handle 8-bit samples in R,G,B order only.
+ */
+
+#if BITS_IN_JSAMPLE == 8 && RGB_PIXELSIZE == 3 && \
+    RGB_RED == 0 && RGB_GREEN == 1 && RGB_BLUE == 2
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__x86_64__) || \
+    defined(__SSE2__) || (defined(_MSC_VER) && defined(_M_IX86))
+#define JSIMD_SSE2_SUPPORTED
+#endif
+#endif
+
 #endif /* JPEG_INTERNAL_OPTIONS */
@@ -333,6 +333,10 @@ struct jpeg_color_quantizer {
 #define jpeg_natural_order3	jZAG3Table
 #define jpeg_natural_order2	jZAG2Table
 #define jpeg_aritab		jAriTab
+#define jsimd_can_sse2		jSCanSSE2
+#define jsimd_ycc_rgb_convert	jSYCCRGB
+#define jsimd_h2v1_merged_upsample	jSH2V1Merged
+#define jsimd_h2v2_merged_upsample	jSH2V2Merged
 #endif /* NEED_SHORT_EXTERNAL_NAMES */
 
 
@@ -390,6 +394,19 @@ EXTERN(void) jinit_color_deconverter JPP((j_decompress_ptr cinfo));
 EXTERN(void) jinit_1pass_quantizer JPP((j_decompress_ptr cinfo));
 EXTERN(void) jinit_2pass_quantizer JPP((j_decompress_ptr cinfo));
 EXTERN(void) jinit_merged_upsampler JPP((j_decompress_ptr cinfo));
+/* SSE2 replacements in jdsimd.c */
+#ifdef JSIMD_SSE2_SUPPORTED
+EXTERN(boolean) jsimd_can_sse2 JPP((void));
+EXTERN(void) jsimd_ycc_rgb_convert
+    JPP((j_decompress_ptr cinfo, JSAMPIMAGE input_buf, JDIMENSION input_row,
+	 JSAMPARRAY output_buf, int num_rows));
+EXTERN(void) jsimd_h2v1_merged_upsample
+    JPP((j_decompress_ptr cinfo, JSAMPIMAGE input_buf,
+	 JDIMENSION in_row_group_ctr, JSAMPARRAY output_buf));
+EXTERN(void) jsimd_h2v2_merged_upsample
+    JPP((j_decompress_ptr cinfo, JSAMPIMAGE input_buf,
+	 JDIMENSION in_row_group_ctr, JSAMPARRAY output_buf));
+#endif
 /* Memory manager initialization */
 EXTERN(void) jinit_memory_mgr JPP((j_common_ptr cinfo));
 
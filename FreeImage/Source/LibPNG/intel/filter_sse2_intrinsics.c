@@ -0,0 +1,290 @@
+
+/* filter_sse2_intrinsics.c - SSE2 optimized filter functions
+ *
+ * This code is released under the libpng license.
+ * For conditions of distribution and use, see the disclaimer
+ * and license in png.h
+ *
+ * Row defilters for 3, 4, 6 and 8 byte pixels (8 and 16 bit RGB/RGBA).  The
+ * previous pixel is carried in a register, so every row is a single pass over
+ * memory.  While at least 8 bytes remain every pixel is loaded as a full 8
+ * byte word, but only its own bytes are stored: a wider store would overlap
+ * the load of the next pixel, which stalls store forwarding on every pixel.
+ * The last few pixels are loaded through 8 byte temporaries to avoid reading
+ * past the end of the row.
+ */
+
+#include "../pngpriv.h"
+
+#ifdef PNG_READ_SUPPORTED
+
+#if PNG_INTEL_SSE_OPT > 0
+
+#include <emmintrin.h>
+#if PNG_INTEL_SSSE3_IMPLEMENTATION > 0
+#  include <tmmintrin.h>
+#endif
+
+static __m128i
+load_pixel(png_const_bytep p, png_size_t bpp)
+{
+   png_byte tmp[8] = {0};
+   memcpy(tmp, p, bpp);
+   return _mm_loadl_epi64((const __m128i*)tmp);
+}
+
+/* Stores the low bpp bytes of v.  bpp is a constant once inlined, so this
+ * becomes one or two plain stores.
+ */
+static void
+store_pixel(png_bytep p, __m128i v, png_size_t bpp)
+{
+   png_uint_32 lo, hi;
+
+   if (bpp == 8)
+   {
+      _mm_storel_epi64((__m128i*)p, v);
+      return;
+   }
+
+   lo = (png_uint_32)_mm_cvtsi128_si32(v);
+   if (bpp == 4)
+      memcpy(p, &lo, 4);
+
+   else if (bpp == 3)
+   {
+      png_uint_16 lo16 = (png_uint_16)lo;
+      memcpy(p, &lo16, 2);
+      p[2] = (png_byte)(lo >> 16);
+   }
+
+   else /* bpp == 6 */
+   {
+      png_uint_16 hi16;
+      memcpy(p, &lo, 4);
+      hi = (png_uint_32)_mm_cvtsi128_si32(_mm_srli_si128(v, 4));
+      hi16 = (png_uint_16)hi;
+      memcpy(p + 4, &hi16, 2);
+   }
+}
+
+static void
+filter_sub(png_row_infop row_info, png_bytep row, png_size_t bpp)
+{
+   png_size_t rb = row_info->rowbytes;
+   __m128i d = _mm_setzero_si128();
+
+   while (rb >= 8)
+   {
+      d = _mm_add_epi8(_mm_loadl_epi64((const __m128i*)row), d);
+      store_pixel(row, d, bpp);
+      row += bpp;
+      rb -= bpp;
+   }
+
+   while (rb >= bpp)
+   {
+      d = _mm_add_epi8(load_pixel(row, bpp), d);
+      store_pixel(row, d, bpp);
+      row += bpp;
+      rb -= bpp;
+   }
+}
+
+static __m128i
+avg_pixel(__m128i a, __m128i b)
+{
+   /* PNG requires a truncating average, _mm_avg_epu8 rounds up; subtract the
+    * rounding bit again wherever a + b is odd.
+    */
+   const __m128i one = _mm_set1_epi8(1);
+   __m128i avg = _mm_avg_epu8(a, b);
+   return _mm_sub_epi8(avg, _mm_and_si128(_mm_xor_si128(a, b), one));
+}
+
+static void
+filter_avg(png_row_infop row_info, png_bytep row, png_const_bytep prev,
+   png_size_t bpp)
+{
+   png_size_t rb = row_info->rowbytes;
+   __m128i d = _mm_setzero_si128();
+
+   while (rb >= 8)
+   {
+      d = _mm_add_epi8(_mm_loadl_epi64((const __m128i*)row),
+         avg_pixel(d, _mm_loadl_epi64((const __m128i*)prev)));
+      store_pixel(row, d, bpp);
+      prev += bpp;
+      row += bpp;
+      rb -= bpp;
+   }
+
+   while (rb >= bpp)
+   {
+      d = _mm_add_epi8(load_pixel(row, bpp),
+         avg_pixel(d, load_pixel(prev, bpp)));
+      store_pixel(row, d, bpp);
+      prev += bpp;
+      row += bpp;
+      rb -= bpp;
+   }
+}
+
+static __m128i
+abs_i16(__m128i x, int ssse3)
+{
+#if PNG_INTEL_SSSE3_IMPLEMENTATION > 0
+   if (ssse3)
+      return _mm_abs_epi16(x);
+#endif
+   {
+      __m128i neg = _mm_cmplt_epi16(x, _mm_setzero_si128());
+      PNG_UNUSED(ssse3)
+      return _mm_sub_epi16(_mm_xor_si128(x, neg), neg);
+   }
+}
+
+static __m128i
+if_then_else(__m128i c, __m128i t, __m128i e)
+{
+   return _mm_or_si128(_mm_and_si128(c, t), _mm_andnot_si128(c, e));
+}
+
+/* a, b and c hold the left, above and upper left pixels zero extended to 16
+ * bits; returns the predictor in the same form.
+ */
+static __m128i
+paeth_pixel(__m128i a, __m128i b, __m128i c, int ssse3)
+{
+   __m128i pa, pb, pc, smallest;
+
+   /* pa = |p - a| = |b - c|, pb = |p - b| = |a - c|,
+    * pc = |p - c| = |a + b - 2c| = |pa + pb| (before taking abs)
+    */
+   pa = _mm_sub_epi16(b, c);
+   pb = _mm_sub_epi16(a, c);
+   pc = _mm_add_epi16(pa, pb);
+
+   pa = abs_i16(pa, ssse3);
+   pb = abs_i16(pb, ssse3);
+   pc = abs_i16(pc, ssse3);
+
+   smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+
+   /* Ties go to a, then b, then c, as in the scalar code. */
+   return if_then_else(_mm_cmpeq_epi16(smallest, pa), a,
+          if_then_else(_mm_cmpeq_epi16(smallest, pb), b, c));
+}
+
+static void
+filter_paeth(png_row_infop row_info, png_bytep row, png_const_bytep prev,
+   png_size_t bpp, int ssse3)
+{
+   png_size_t rb = row_info->rowbytes;
+   const __m128i zero = _mm_setzero_si128();
+   __m128i a, b = zero, c, d = zero;
+
+   /* The high byte of every lane is zero in both d and the predictor, so a
+    * bytewise add keeps d zero extended while wrapping the low byte mod 256.
+    */
+   while (rb >= 8)
+   {
+      c = b;
+      b = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)prev), zero);
+      a = d;
+      d = _mm_add_epi8(_mm_unpacklo_epi8(
+         _mm_loadl_epi64((const __m128i*)row), zero),
+         paeth_pixel(a, b, c, ssse3));
+      store_pixel(row, _mm_packus_epi16(d, d), bpp);
+      prev += bpp;
+      row += bpp;
+      rb -= bpp;
+   }
+
+   while (rb >= bpp)
+   {
+      c = b;
+      b = _mm_unpacklo_epi8(load_pixel(prev, bpp), zero);
+      a = d;
+      d = _mm_add_epi8(_mm_unpacklo_epi8(load_pixel(row, bpp), zero),
+         paeth_pixel(a, b, c, ssse3));
+      store_pixel(row, _mm_packus_epi16(d, d), bpp);
+      prev += bpp;
+      row += bpp;
+      rb -= bpp;
+   }
+}
+
+void
+png_read_filter_row_up_sse2(png_row_infop row_info, png_bytep row,
+   png_const_bytep prev)
+{
+   png_size_t rb = row_info->rowbytes;
+
+   while (rb >= 16)
+   {
+      __m128i r = _mm_loadu_si128((const __m128i*)row);
+      __m128i p = _mm_loadu_si128((const __m128i*)prev);
+      _mm_storeu_si128((__m128i*)row, _mm_add_epi8(r, p));
+      row += 16;
+      prev += 16;
+      rb -= 16;
+   }
+
+   while (rb > 0)
+   {
+      *row = (png_byte)(*row + *prev++);
+      row++;
+      rb--;
+   }
+}
+
+#define PNG_SSE2_FILTERS(bpp) \
+void \
+png_read_filter_row_sub##bpp##_sse2(png_row_infop row_info, png_bytep row, \
+   png_const_bytep prev) \
+{ \
+   PNG_UNUSED(prev) \
+   filter_sub(row_info, row, bpp); \
+} \
+\
+void \
+png_read_filter_row_avg##bpp##_sse2(png_row_infop row_info, png_bytep row, \
+   png_const_bytep prev) \
+{ \
+   filter_avg(row_info, row, prev, bpp); \
+} \
+\
+void \
+png_read_filter_row_paeth##bpp##_sse2(png_row_infop row_info, png_bytep row, \
+   png_const_bytep prev) \
+{ \
+   filter_paeth(row_info, row, prev, bpp, 0); \
+}
+
+PNG_SSE2_FILTERS(3)
+PNG_SSE2_FILTERS(4)
+PNG_SSE2_FILTERS(6)
+PNG_SSE2_FILTERS(8)
+
+#undef PNG_SSE2_FILTERS
+
+#if PNG_INTEL_SSSE3_IMPLEMENTATION > 0
+#define PNG_SSSE3_FILTERS(bpp) \
+void \
+png_read_filter_row_paeth##bpp##_ssse3(png_row_infop row_info, png_bytep row, \
+   png_const_bytep prev) \
+{ \
+   filter_paeth(row_info, row, prev, bpp, 1); \
+}
+
+PNG_SSSE3_FILTERS(3)
+PNG_SSSE3_FILTERS(4)
+PNG_SSSE3_FILTERS(6)
+PNG_SSSE3_FILTERS(8)
+
+#undef PNG_SSSE3_FILTERS
+#endif /* PNG_INTEL_SSSE3_IMPLEMENTATION > 0 */
+
+#endif /* PNG_INTEL_SSE_OPT > 0 */
+#endif /* READ */
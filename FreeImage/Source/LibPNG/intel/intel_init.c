@@ -0,0 +1,101 @@
+
+/* intel_init.c - SSE2 optimized filter functions
+ *
+ * This code is released under the libpng license.
+ * For conditions of distribution and use, see the disclaimer
+ * and license in png.h
+ */
+
+#include "../pngpriv.h"
+
+#ifdef PNG_READ_SUPPORTED
+
+#if PNG_INTEL_SSE_OPT > 0
+
+#ifdef _MSC_VER
+#  include <intrin.h>
+#elif defined(__GNUC__)
+#  include <cpuid.h>
+#endif
+
+/* CPUID leaf 1: EDX bit 26 is SSE2, ECX bit 9 is SSSE3. */
+static void
+png_cpu_features(int *sse2, int *ssse3)
+{
+   unsigned int ecx = 0, edx = 0;
+
+#if defined(_MSC_VER)
+   int info[4];
+   __cpuid(info, 1);
+   ecx = (unsigned int)info[2];
+   edx = (unsigned int)info[3];
+#elif defined(__GNUC__)
+   unsigned int eax, ebx;
+   if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) == 0)
+      ecx = edx = 0;
+#endif
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__x86_64__)
+   *sse2 = 1;
+#else
+   *sse2 = (edx >> 26) & 1;
+#endif
+   *ssse3 = *sse2 && ((ecx >> 9) & 1);
+}
+
+void
+png_init_filter_functions_sse2(png_structp pp, unsigned int bpp)
+{
+   static int checked = 0, have_sse2 = 0, have_ssse3 = 0;
+
+   /* The CPU will not change under us; a benign race on the first calls only
+    * ever writes the same values.
+    */
+   if (!checked)
+   {
+      png_cpu_features(&have_sse2, &have_ssse3);
+      checked = 1;
+   }
+
+   if (!have_sse2)
+      return;
+
+#if PNG_INTEL_SSSE3_IMPLEMENTATION == 0
+   PNG_UNUSED(have_ssse3)
+#endif
+
+   pp->read_filter[PNG_FILTER_VALUE_UP-1] = png_read_filter_row_up_sse2;
+
+   switch (bpp)
+   {
+#if PNG_INTEL_SSSE3_IMPLEMENTATION > 0
+#  define PNG_PAETH(n) (have_ssse3 ? png_read_filter_row_paeth##n##_ssse3 : \
+      png_read_filter_row_paeth##n##_sse2)
+#else
+#  define PNG_PAETH(n) png_read_filter_row_paeth##n##_sse2
+#endif
+#define PNG_SET_FILTERS(n) \
+   case n: \
+      pp->read_filter[PNG_FILTER_VALUE_SUB-1] = png_read_filter_row_sub##n##_sse2; \
+      pp->read_filter[PNG_FILTER_VALUE_AVG-1] = png_read_filter_row_avg##n##_sse2; \
+      pp->read_filter[PNG_FILTER_VALUE_PAETH-1] = PNG_PAETH(n); \
+      break;
+
+      PNG_SET_FILTERS(3)
+      PNG_SET_FILTERS(4)
+      PNG_SET_FILTERS(6)
+      PNG_SET_FILTERS(8)
+
+#undef PNG_SET_FILTERS
+#undef PNG_PAETH
+
+      default:
+         /* 1 and 2 byte pixels keep the generic code; the serial dependency
+          * on the previous byte leaves nothing to vectorize there.
+          */
+         break;
+   }
+}
+
+#endif /* PNG_INTEL_SSE_OPT > 0 */
+#endif /* READ */
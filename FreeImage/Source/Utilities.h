@@ -51,6 +51,12 @@
 #include <limits>
 #include <memory>
 
+// SSE2 code paths, for x64 and for x86 builds targeting SSE2
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FI_SSE2
+#endif
+
 // ==========================================================
 //   Bitmap palette and pixels alignment
 // ==========================================================
@@ -337,6 +343,14 @@ AssignPixel(BYTE* dst, const BYTE* src, unsigned bytesperpixel) {
 	}
 }
 
+/**
+A pixel of BYTESPP bytes, for templates that copy pixels of a size known 
+at compile time by plain assignment
+*/
+template <unsigned BYTESPP> struct FixedPixel {
+	BYTE bytes[BYTESPP];
+};
+
 /**
 Swap red and blue channels in a 24- or 32-bit dib. 
 @return Returns TRUE if successful, returns FALSE otherwise
@@ -366,11 +380,13 @@ RGBA to RGB conversion
 FIBITMAP* RemoveAlphaChannel(FIBITMAP* dib);
 
 /**
-Rotate a dib according to Exif info
-@param dib Input / Output dib to rotate
-@see Exif.cpp, PluginJPEG.cpp
+Keep the size of the image in the file when a plugin loads it smaller, 
+as the FIMD_COMMENTS tags "Original<format>Width" and "Original<format>Height"
+@param dib Loaded image
+@param format Format name in the tag keys, e.g. "JPEG"
+@see See definition in BitmapAccess.cpp
 */
-void RotateExif(FIBITMAP **dib);
+void StoreSizeInfo(FIBITMAP *dib, const char *format, int width, int height);
 
 
 // ==========================================================
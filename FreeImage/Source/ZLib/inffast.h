@@ -8,4 +8,28 @@
    subject to change. Applications should only use zlib.h.
  */
 
+/* On 64-bit x86 inflate_fast() keeps a 64-bit bit buffer that is refilled
+   with a single unaligned load, and copies matches in 8-byte chunks.  Both
+   need a little more slack in the input and output buffers than the classic
+   code, which is what INFLATE_FAST_MIN_HAVE and INFLATE_FAST_MIN_LEFT say.
+   Define NO_INFLATE_FAST_WIDE to get the classic code everywhere. */
+#if !defined(NO_INFLATE_FAST_WIDE) && !defined(ASMINF) && \
+    (defined(_M_X64) || defined(_M_AMD64) || defined(__x86_64__))
+#  define INFLATE_FAST_WIDE
+#endif
+
+#ifdef INFLATE_FAST_WIDE
+#  define INFLATE_FAST_CHUNK 8
+#  define INFLATE_FAST_MIN_HAVE 8
+#  define INFLATE_FAST_MIN_LEFT (258 + INFLATE_FAST_CHUNK)
+#  ifdef _MSC_VER
+     typedef unsigned __int64 ulg64;
+#  else
+     typedef unsigned long long ulg64;
+#  endif
+#else
+#  define INFLATE_FAST_MIN_HAVE 6
+#  define INFLATE_FAST_MIN_LEFT 258
+#endif
+
 void ZLIB_INTERNAL inflate_fast OF((z_streamp strm, unsigned start));
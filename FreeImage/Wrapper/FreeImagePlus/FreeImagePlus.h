@@ -222,6 +222,12 @@ public:
 		return _fmt.isValid();
 	}
 
+	/// Overrides the size, e.g. with the original size of an image scaled on load
+	void setSize(unsigned width, unsigned height) {
+		_width = width;
+		_height = height;
+	}
+
 	virtual unsigned getWidth() const {
 		return _width;
 	}
@@ -401,7 +407,11 @@ public:
 	bool load(const std::string& lpszPathName, int flag = 0);
 #endif
 	/**
-	UNICODE version of load (this function only works under WIN32 and does nothing on other OS)
+	UNICODE version of load (this function only works under WIN32 and does nothing on other OS).
+	Plugins supporting it (JPEG, WebP) scale the image down on load when the upper 16 bits of 
+	flag hold a requested size, PSD returns its embedded thumbnail when that is large enough 
+	and DDS the smallest mip level that is, ICO the best fitting icon; 
+	the original information still reports the original size then.
 	@see load
 	*/
 	bool load(const std::wstring& lpszPathName, int flag = 0);
@@ -974,6 +984,16 @@ public:
 	@see FreeImage_FlipVertical
 	*/
 	bool flipVertical();
+
+	/**
+	Rotate or flip the image the way FreeImage_JPEGTransform rotates or flips
+	the file it was loaded from, so that the file need not be loaded again.
+	The original size follows the new orientation.
+	@param operation Lossless transformation to mirror
+	@return Returns TRUE if successful, returns FALSE otherwise
+	@see FreeImage_JPEGTransform
+	*/
+	bool transform(FREE_IMAGE_JPEG_OPERATION operation);
 	//@}
 
 	/**@name Color manipulation routines */
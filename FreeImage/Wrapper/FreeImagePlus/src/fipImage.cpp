@@ -20,9 +20,31 @@
 // ==========================================================
 
 #include "FreeImagePlus.h"
+#include <stdlib.h>
 
 using namespace FreeImage;
 
+///////////////////////////////////////////////////////////////////   
+// Helpers
+
+/**
+Plugins scaling on load keep the original size as comments, e.g. OriginalJPEGWidth
+*/
+static bool
+getOriginalSize(FIBITMAP *dib, const Format &format, unsigned &width, unsigned &height) {
+	const std::string prefix = "Original" + format.getName();
+	FITAG *tag = NULL;
+	if(!FreeImage_GetMetadata(FIMD_COMMENTS, dib, (prefix + "Width").c_str(), &tag)) {
+		return false;
+	}
+	width = (unsigned)atoi((const char*)FreeImage_GetTagValue(tag));
+	if(!FreeImage_GetMetadata(FIMD_COMMENTS, dib, (prefix + "Height").c_str(), &tag)) {
+		return false;
+	}
+	height = (unsigned)atoi((const char*)FreeImage_GetTagValue(tag));
+	return width && height;
+}
+
 ///////////////////////////////////////////////////////////////////   
 // Protected functions
 
@@ -447,6 +469,10 @@ bool Image::load(const std::wstring& file, int flag) {
 	_format = loadingFormat;
 
 	_origInfo = StaticInformation(*this);
+	unsigned width, height;
+	if(getOriginalSize(_dib, _format, width, height)) {
+		_origInfo.setSize(width, height);
+	}
 
 	return true;
 }
@@ -860,6 +886,46 @@ bool Image::flipHorizontal() {
 	return false;
 }
 
+bool Image::transform(FREE_IMAGE_JPEG_OPERATION operation) {
+	if(!_dib) {
+		return false;
+	}
+
+	// rotation angles are counter-clockwise, FIJPEG_OP_ROTATE_xx are clockwise
+	bool bResult = false;
+	switch(operation) {
+		case FIJPEG_OP_NONE:
+			return true;
+		case FIJPEG_OP_FLIP_H:
+			return flipHorizontal();
+		case FIJPEG_OP_FLIP_V:
+			return flipVertical();
+		case FIJPEG_OP_ROTATE_180:
+			// in place
+			_bHasChanged = true;
+			return FreeImage_Rotate180(_dib) ? true : false;
+		case FIJPEG_OP_ROTATE_90:
+			bResult = rotate(-90);
+			break;
+		case FIJPEG_OP_ROTATE_270:
+			bResult = rotate(90);
+			break;
+		case FIJPEG_OP_TRANSPOSE:
+			bResult = rotate(-90) && flipHorizontal();
+			break;
+		case FIJPEG_OP_TRANSVERSE:
+			bResult = rotate(90) && flipHorizontal();
+			break;
+		default:
+			return false;
+	}
+
+	if(bResult) {
+		_origInfo.setSize(_origInfo.getHeight(), _origInfo.getWidth());
+	}
+	return bResult;
+}
+
 ///////////////////////////////////////////////////////////////////   
 // Color manipulation routines
 
@@ -0,0 +1,466 @@
+#include "Animation.h"
+
+#include <algorithm>
+#include <climits>
+
+#include "Exception.h"
+#include "Messages.h"
+#include "console.h"
+
+namespace {
+  // Memory the frame cache and the canvas snapshots may use, respectively
+  const size_t cacheBudget = 64 << 20;
+  const size_t checkpointBudget = 32 << 20;
+
+  // Minimal distance between two canvas snapshots
+  const unsigned minInterval = 16;
+
+  // Browsers treat very short delays as "as fast as possible" from a time
+  // when that meant roughly 10 fps; so do we.
+  const DWORD minDelay = 20;
+  const DWORD defaultDelay = 100;
+
+  // As stored by the GIF and WebP plugins
+  enum
+  {
+    DISPOSAL_UNSPECIFIED,
+    DISPOSAL_LEAVE,
+    DISPOSAL_BACKGROUND,
+    DISPOSAL_PREVIOUS
+  };
+
+  enum
+  {
+    BLEND_ALPHA,
+    BLEND_NONE
+  };
+
+  unsigned DLL_CALLCONV readProc(
+    void *buffer, unsigned size, unsigned count, fi_handle handle)
+  {
+    return (unsigned)fread(buffer, size, count, (FILE*)handle);
+  }
+
+  unsigned DLL_CALLCONV writeProc(
+    void *buffer, unsigned size, unsigned count, fi_handle handle)
+  {
+    return (unsigned)fwrite(buffer, size, count, (FILE*)handle);
+  }
+
+  int DLL_CALLCONV seekProc(fi_handle handle, long offset, int origin)
+  {
+    return fseek((FILE*)handle, offset, origin);
+  }
+
+  long DLL_CALLCONV tellProc(fi_handle handle)
+  {
+    return ftell((FILE*)handle);
+  }
+
+  bool getTag(FIBITMAP *dib, const char *key, DWORD &value)
+  {
+    FITAG *tag = nullptr;
+    if (!FreeImage_GetMetadata(FIMD_ANIMATION, dib, key, &tag) || !tag) {
+      return false;
+    }
+
+    const void *v = FreeImage_GetTagValue(tag);
+    switch (FreeImage_GetTagType(tag)) {
+    case FIDT_BYTE:
+      value = *reinterpret_cast<const BYTE*>(v);
+      return true;
+
+    case FIDT_SHORT:
+      value = *reinterpret_cast<const WORD*>(v);
+      return true;
+
+    case FIDT_LONG:
+      value = *reinterpret_cast<const DWORD*>(v);
+      return true;
+
+    default:
+      return false;
+    }
+  }
+
+  /// Scanlines are stored bottom-up; returns the pixel at left/top.
+  inline BYTE* pixelAt(FIBITMAP *dib, int left, int top)
+  {
+    return FreeImage_GetScanLine(dib, FreeImage_GetHeight(dib) - 1 - top) +
+      left * 4;
+  }
+
+  /// Draws width x height pixels of src onto dst at left/top (both 32bpp).
+  void blend(
+    FIBITMAP *dst, FIBITMAP *src, int left, int top, int width, int height,
+    bool alpha)
+  {
+    for (int y = 0; y < height; ++y) {
+      const BYTE *s = pixelAt(src, 0, y);
+      BYTE *d = pixelAt(dst, left, top + y);
+
+      if (!alpha) {
+        memcpy(d, s, width * 4);
+        continue;
+      }
+
+      for (int x = 0; x < width; ++x, s += 4, d += 4) {
+        const unsigned sa = s[FI_RGBA_ALPHA];
+        if (sa == 0xff) {
+          *reinterpret_cast<DWORD*>(d) = *reinterpret_cast<const DWORD*>(s);
+        }
+        else if (sa) {
+          // Non-premultiplied "over"
+          const unsigned da = d[FI_RGBA_ALPHA] * (0xff - sa) / 0xff;
+          const unsigned a = sa + da;
+          d[FI_RGBA_BLUE] = (BYTE)((s[FI_RGBA_BLUE] * sa + d[FI_RGBA_BLUE] * da) / a);
+          d[FI_RGBA_GREEN] = (BYTE)((s[FI_RGBA_GREEN] * sa + d[FI_RGBA_GREEN] * da) / a);
+          d[FI_RGBA_RED] = (BYTE)((s[FI_RGBA_RED] * sa + d[FI_RGBA_RED] * da) / a);
+          d[FI_RGBA_ALPHA] = (BYTE)a;
+        }
+      }
+    }
+  }
+
+  void clear(FIBITMAP *dib, int left, int top, int width, int height)
+  {
+    for (int y = 0; y < height; ++y) {
+      memset(pixelAt(dib, left, top + y), 0, width * 4);
+    }
+  }
+}
+
+std::unique_ptr<Animation> Animation::Open(
+  const std::wstring &file, FREE_IMAGE_FORMAT fif, HWND aOwner)
+{
+  std::unique_ptr<Animation> rv;
+
+  // Plugin ids are handed out in registration order, and not all plugins are
+  // registered, so the FIF_ constants cannot be trusted here.
+  if (fif != FreeImage_GetFIFFromFormat("GIF") &&
+    fif != FreeImage_GetFIFFromFormat("WEBP")) {
+    return rv;
+  }
+
+  FILE *handle = _wfopen(file.c_str(), L"rb");
+  if (!handle) {
+    return rv;
+  }
+
+  FreeImageIO io = { readProc, writeProc, seekProc, tellProc };
+  FIMULTIBITMAP *mbmp = FreeImage_OpenMultiBitmapFromHandle(
+    fif, &io, (fi_handle)handle, 0);
+  if (!mbmp || FreeImage_GetPageCount(mbmp) < 2) {
+    if (mbmp) {
+      FreeImage_CloseMultiBitmap(mbmp);
+    }
+    fclose(handle);
+    return rv;
+  }
+
+  try {
+    rv.reset(new Animation(handle, mbmp, aOwner));
+  }
+  catch (Exception &ex) {
+    ConWrite(ex.GetString());
+  }
+  return rv;
+}
+
+POINT Animation::GetPageOrigin(FIBITMAP *page)
+{
+  DWORD left = 0, top = 0;
+  getTag(page, "FrameLeft", left);
+  getTag(page, "FrameTop", top);
+  const POINT rv = { (LONG)left, (LONG)top };
+  return rv;
+}
+
+Animation::Animation(FILE *file, FIMULTIBITMAP *mbmp, HWND aOwner)
+  : Thread(),
+  file_(file),
+  mbmp_(mbmp),
+  hOwner_(aOwner),
+  hTerm_(nullptr), hWake_(nullptr),
+  width_(0), height_(0),
+  count_(FreeImage_GetPageCount(mbmp)),
+  loops_(0),
+  capacity_(0),
+  pos_(0),
+  waiting_(UINT_MAX),
+  canvas_(nullptr),
+  next_(0),
+  interval_(minInterval)
+{
+  // The destructor will not run if construction fails, so release what
+  // was handed to us here.
+  auto fail = [&]() {
+    if (hTerm_) {
+      CloseHandle(hTerm_);
+    }
+    if (hWake_) {
+      CloseHandle(hWake_);
+    }
+    FreeImage_CloseMultiBitmap(mbmp_);
+    fclose(file_);
+    throw Exception("Cannot set up animation");
+  };
+
+  // Logical screen and loop count live with the first page
+  FIBITMAP *first = FreeImage_LockPage(mbmp_, 0);
+  if (!first) {
+    fail();
+  }
+  DWORD v;
+  width_ = getTag(first, "LogicalWidth", v) ? v : FreeImage_GetWidth(first);
+  height_ = getTag(first, "LogicalHeight", v) ? v : FreeImage_GetHeight(first);
+  loops_ = getTag(first, "Loop", v) ? v : 0;
+  FreeImage_UnlockPage(mbmp_, first, FALSE);
+
+  canvas_ = FreeImage_Allocate(
+    width_, height_, 32, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
+  if (!canvas_) {
+    fail();
+  }
+  Reset();
+
+  const size_t frameSize = FreeImage_GetPitch(canvas_) * height_;
+  const size_t displaySize = ((width_ * 3 + 3) & ~3) * height_;
+  capacity_ = (unsigned)std::min<size_t>(
+    count_, std::max<size_t>(2, cacheBudget / displaySize));
+  const size_t snapshots = std::max<size_t>(1, checkpointBudget / frameSize);
+  interval_ = std::max<unsigned>(
+    minInterval, (unsigned)((count_ + snapshots - 1) / snapshots));
+
+  hTerm_ = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+  hWake_ = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+  if (!hTerm_ || !hWake_) {
+    FreeImage_Unload(canvas_);
+    fail();
+  }
+
+  ConWrite(L"Animation: " + itos(count_) + L" frames, caching " +
+    itos(capacity_) + L", snapshot every " + itos(interval_));
+  Run();
+}
+
+Animation::~Animation()
+{
+  SetEvent(hTerm_);
+  WaitForSingleObject(GetHandle(), INFINITE);
+
+  CloseHandle(hTerm_);
+  CloseHandle(hWake_);
+
+  cache_.clear();
+  for (auto &cp : checkpoints_) {
+    FreeImage_Unload(cp.second);
+  }
+  FreeImage_Unload(canvas_);
+
+  FreeImage_CloseMultiBitmap(mbmp_);
+  fclose(file_);
+}
+
+Animation::FramePtr Animation::GetFrame(unsigned index)
+{
+  FramePtr rv;
+  {
+    Locker l(this);
+    pos_ = index % count_;
+    Trim();
+
+    auto i = cache_.find(pos_);
+    if (i != cache_.end()) {
+      rv = i->second;
+    }
+    else {
+      waiting_ = pos_;
+    }
+  }
+
+  // Keep the worker busy filling the window ahead
+  SetEvent(hWake_);
+  return rv;
+}
+
+bool Animation::NextMissing(unsigned &index)
+{
+  Locker l(this);
+  for (unsigned i = 0; i < capacity_; ++i) {
+    index = (pos_ + i) % count_;
+    if (cache_.find(index) == cache_.end()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void Animation::Store(unsigned index, const FramePtr &frame)
+{
+  bool notify = false;
+  {
+    Locker l(this);
+    cache_[index] = frame;
+    Trim();
+    if (waiting_ == index) {
+      waiting_ = UINT_MAX;
+      notify = true;
+    }
+  }
+  if (notify) {
+    PostMessage(hOwner_, WM_ANIMATION, (WPARAM)index, 0);
+  }
+}
+
+void Animation::Trim()
+{
+  // Only the frames in the window ahead of the playback position are kept.
+  // The window wraps around, as playback will.
+  for (auto i = cache_.begin(); i != cache_.end();) {
+    const unsigned distance = (i->first + count_ - pos_) % count_;
+    if (distance >= capacity_) {
+      i = cache_.erase(i);
+    }
+    else {
+      ++i;
+    }
+  }
+}
+
+void Animation::Reset()
+{
+  clear(canvas_, 0, 0, width_, height_);
+  next_ = 0;
+}
+
+void Animation::Seek(unsigned index)
+{
+  // Resume from the last snapshot at or before index, unless the canvas is
+  // already between that snapshot and index.
+  auto cp = checkpoints_.upper_bound(index);
+  if (cp != checkpoints_.begin()) {
+    --cp;
+    if (next_ > index || next_ < cp->first) {
+      memcpy(
+        FreeImage_GetBits(canvas_),
+        FreeImage_GetBits(cp->second),
+        FreeImage_GetPitch(canvas_) * height_
+        );
+      next_ = cp->first;
+    }
+  }
+  else if (next_ > index) {
+    Reset();
+  }
+
+  while (next_ < index) {
+    Step(nullptr);
+  }
+}
+
+DWORD Animation::Step(FIBITMAP **display)
+{
+  DWORD delay = defaultDelay;
+  DWORD disposal = DISPOSAL_UNSPECIFIED;
+  DWORD blendMethod = BLEND_ALPHA;
+  DWORD left = 0, top = 0;
+  int width = 0, height = 0;
+  FIBITMAP *restore = nullptr;
+
+  FIBITMAP *page = FreeImage_LockPage(mbmp_, (int)next_);
+  if (page) {
+    getTag(page, "FrameLeft", left);
+    getTag(page, "FrameTop", top);
+    getTag(page, "FrameTime", delay);
+    getTag(page, "DisposalMethod", disposal);
+    getTag(page, "BlendMethod", blendMethod);
+
+    FIBITMAP *src = FreeImage_ConvertTo32Bits(page);
+    FreeImage_UnlockPage(mbmp_, page, FALSE);
+
+    if (src) {
+      // Clip the frame to the logical screen
+      if (left < width_ && top < height_) {
+        width = (int)std::min<unsigned>(FreeImage_GetWidth(src), width_ - left);
+        height = (int)std::min<unsigned>(FreeImage_GetHeight(src), height_ - top);
+      }
+      if (width > 0 && height > 0) {
+        if (disposal == DISPOSAL_PREVIOUS) {
+          restore = FreeImage_Copy(
+            canvas_, left, top, left + width, top + height);
+        }
+        blend(canvas_, src, left, top, width, height, blendMethod == BLEND_ALPHA);
+      }
+      FreeImage_Unload(src);
+    }
+  }
+
+  if (delay < minDelay) {
+    delay = defaultDelay;
+  }
+
+  if (display) {
+    *display = FreeImage_Composite(canvas_);
+  }
+
+  // Prepare the canvas for the next frame
+  if (width > 0 && height > 0) {
+    switch (disposal) {
+    case DISPOSAL_BACKGROUND:
+      clear(canvas_, left, top, width, height);
+      break;
+
+    case DISPOSAL_PREVIOUS:
+      if (restore) {
+        FreeImage_Paste(canvas_, restore, left, top, 256);
+      }
+      break;
+    }
+  }
+  if (restore) {
+    FreeImage_Unload(restore);
+  }
+
+  if (++next_ == count_) {
+    Reset();
+  }
+  else if (next_ % interval_ == 0 &&
+    checkpoints_.find(next_) == checkpoints_.end()) {
+    FIBITMAP *snapshot = FreeImage_Clone(canvas_);
+    if (snapshot) {
+      checkpoints_[next_] = snapshot;
+    }
+  }
+
+  return delay;
+}
+
+DWORD Animation::operator()()
+{
+  HANDLE handles[] = {hTerm_, hWake_};
+  for (;;) {
+    unsigned index;
+    while (NextMissing(index)) {
+      if (WaitForSingleObject(hTerm_, 0) == WAIT_OBJECT_0) {
+        return 0;
+      }
+
+      if (index != next_) {
+        Seek(index);
+      }
+      FIBITMAP *display = nullptr;
+      const DWORD delay = Step(&display);
+      if (!display) {
+        // Out of memory, most likely; try again once playback moved on
+        break;
+      }
+      Store(index, std::make_shared<Frame>(display, delay));
+    }
+
+    if (WaitForMultipleObjects(2, handles, FALSE, INFINITE) != WAIT_OBJECT_0 + 1) {
+      break;
+    }
+  }
+  return 0;
+}
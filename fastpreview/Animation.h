@@ -0,0 +1,144 @@
+#pragma once
+
+#include <windows.h>
+#include <stdio.h>
+#include <string>
+#include <memory>
+#include <map>
+
+#include "Thread.h"
+#include "FreeImage.h"
+
+/**
+ * Plays back animated GIF and WebP files.
+ *
+ * Frames are composed incrementally (disposal and blending applied) on a
+ * worker thread, which decodes ahead of the playback position into a bounded
+ * cache of display ready frames. Small animations end up fully cached, so
+ * loops cost nothing. For larger ones, snapshots of the canvas are kept every
+ * few frames, so a seek or a loop resumes composition at the closest snapshot
+ * instead of replaying everything from the first frame.
+ *
+ * The owner asks for frames with GetFrame(). When a frame is not ready yet,
+ * WM_ANIMATION is posted to the owner once it is, with the frame index as
+ * wparam.
+ */
+class Animation : public Thread
+{
+public:
+  class Frame
+  {
+  private:
+    FIBITMAP *dib_;
+    const DWORD delay_;
+
+    Frame(const Frame&) = delete;
+    Frame& operator=(const Frame&) = delete;
+
+  public:
+    Frame(FIBITMAP *dib, DWORD delay) : dib_(dib), delay_(delay)
+    {}
+
+    ~Frame()
+    {
+      FreeImage_Unload(dib_);
+    }
+
+    /// 24bpp, composed onto the same background as still images
+    FIBITMAP *GetBitmap() const
+    {
+      return dib_;
+    }
+
+    /// Display time in milliseconds
+    DWORD GetDelay() const
+    {
+      return delay_;
+    }
+  };
+
+  typedef std::shared_ptr<const Frame> FramePtr;
+
+private:
+  typedef std::map<unsigned, FramePtr> FrameCache;
+  typedef std::map<unsigned, FIBITMAP*> Checkpoints;
+
+  FILE *file_;
+  FIMULTIBITMAP *mbmp_;
+
+  const HWND hOwner_;
+  HANDLE hTerm_, hWake_;
+
+  unsigned width_, height_;
+  unsigned count_;
+  unsigned loops_;
+
+  // Shared with the owner, guarded by Locker
+  FrameCache cache_;
+  unsigned capacity_;
+  unsigned pos_;
+  unsigned waiting_;
+
+  // Worker thread only
+  FIBITMAP *canvas_;
+  unsigned next_;
+  Checkpoints checkpoints_;
+  unsigned interval_;
+
+  Animation(FILE *file, FIMULTIBITMAP *mbmp, HWND aOwner);
+
+  bool NextMissing(unsigned &index);
+  void Store(unsigned index, const FramePtr &frame);
+  void Trim();
+
+  void Seek(unsigned index);
+  DWORD Step(FIBITMAP **display);
+  void Reset();
+
+protected:
+  virtual DWORD operator()();
+
+public:
+  ~Animation();
+
+  /**
+   * Opens file for playback.
+   * Returns nothing if the format cannot animate or the file holds only a
+   * single frame.
+   */
+  static std::unique_ptr<Animation> Open(
+    const std::wstring &file, FREE_IMAGE_FORMAT fif, HWND aOwner);
+
+  /**
+   * Where page sits on the logical screen, for showing a page loaded on its
+   * own in place of the frame composed from it.
+   */
+  static POINT GetPageOrigin(FIBITMAP *page);
+
+  unsigned GetWidth() const
+  {
+    return width_;
+  }
+
+  unsigned GetHeight() const
+  {
+    return height_;
+  }
+
+  unsigned GetFrameCount() const
+  {
+    return count_;
+  }
+
+  /// Number of times to play the animation, 0 meaning forever
+  unsigned GetLoops() const
+  {
+    return loops_;
+  }
+
+  /**
+   * Returns the composed frame at index and moves the decode ahead window
+   * there. Returns an empty pointer if the frame is not ready yet.
+   */
+  FramePtr GetFrame(unsigned index);
+};
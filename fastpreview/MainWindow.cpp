@@ -6,6 +6,7 @@
 #include <windowsx.h>
 #include <shlwapi.h>
 #include <math.h>
+#include <climits>
 #include <sstream>
 
 #include "resource.h"
@@ -17,7 +18,9 @@
 
 /* timers */
 #define IDT_RELOAD   1
+#define IDT_ANIMATE  2
 #define IDT_AACCEPT  3
+#define IDT_PREFETCH 4
 
 /* status */
 #define IDC_STATUS 10
@@ -33,10 +36,73 @@ namespace {
   const std::wstring s_deleting = loadResourceString(IDS_DELETING);
   const std::wstring s_explorermenu = loadResourceString(IDS_EXPLORERMENU);
   const std::wstring s_loading = loadResourceString(IDS_LOADING);
-  const std::wstring s_resizing = loadResourceString(IDS_RESIZING);
   const std::wstring s_err_load = loadResourceString(IDS_ERR_LOAD);
   const std::wstring s_err_unsupported = loadResourceString(IDS_ERR_UNSUPPORTED);
 
+  // Memory rendered tiles may use
+  const size_t tileBudget = 96 << 20;
+
+  // Idle time before rendering ahead, and between tiles
+  const UINT prefetchDelay = 50;
+
+  /// A tile as a device dependent bitmap
+  class BitmapTile : public TileCache::Tile
+  {
+  private:
+    const HBITMAP bitmap_;
+    const size_t size_;
+
+  public:
+    BitmapTile(HBITMAP bitmap, size_t size) : bitmap_(bitmap), size_(size)
+    {}
+
+    ~BitmapTile()
+    {
+      DeleteObject(bitmap_);
+    }
+
+    HBITMAP GetBitmap() const
+    {
+      return bitmap_;
+    }
+
+    virtual size_t GetSize() const
+    {
+      return size_;
+    }
+  };
+
+  /**
+   * Converts images that are not standard bitmaps for display, the way
+   * WinImage::draw does. Tone mapping depends on the whole image, so this
+   * cannot be left to the tiles.
+   */
+  FIBITMAP* toStandardBitmap(FIBITMAP *dib)
+  {
+    switch (FreeImage_GetImageType(dib)) {
+    case FIT_RGBF:
+    case FIT_RGBAF:
+    case FIT_RGB16:
+      return FreeImage_ToneMapping(dib, FITMO_DRAGO03);
+
+    case FIT_RGBA16:
+      return FreeImage_ConvertTo32Bits(dib);
+
+    case FIT_COMPLEX: {
+      FIBITMAP *mag = FreeImage_GetComplexChannel(dib, FICC_MAG);
+      if (!mag) {
+        return nullptr;
+      }
+      FIBITMAP *rv = FreeImage_ConvertToStandardType(mag, TRUE);
+      FreeImage_Unload(mag);
+      return rv;
+    }
+
+    default:
+      return FreeImage_ConvertToStandardType(dib, TRUE);
+    }
+  }
+
   class __declspec(novtable) DisableRedraw
   {
   private:
@@ -97,22 +163,6 @@ namespace {
     }
 
   };
-
-  class __declspec(novtable) AutoToggle
-  {
-  private:
-    bool &ref_;
-
-  public:
-    explicit AutoToggle(bool& ref, bool initial) : ref_(ref)
-    {
-      ref_ = initial;
-    }
-    ~AutoToggle()
-    {
-      ref_ = !ref_;
-    }
-  };
 }
 
 
@@ -146,7 +196,16 @@ MainWindow::MainWindow(HINSTANCE aInstance, const std::wstring &aFile)
   best_(true),
   wheeling_(false),
   hmem_(nullptr),
+  htile_(nullptr),
+  tiles_(tileBudget),
+  prefetching_(false),
+  frameIndex_(0),
+  framePending_(UINT_MAX),
+  loopsPlayed_(0),
+  frameDue_(0),
+  paused_(false),
   inTransformation_(false),
+  transformFailed_(false),
   keyCtrl_(FALSE),
   keyShift_(FALSE),
   mbtnDown_(FALSE),
@@ -222,11 +281,15 @@ MainWindow::MainWindow(HINSTANCE aInstance, const std::wstring &aFile)
 MainWindow::~MainWindow(void)
 {
   KillTimer(hwnd_, IDT_RELOAD);
+  KillTimer(hwnd_, IDT_PREFETCH);
+  StopAnimation();
+  tiles_.Clear();
 
   DestroyWindow(hwnd_);
   UnregisterClass(_T("FPWND"), hinst_);
   DestroyMenu(hctx_);
   DeleteDC(hmem_);
+  DeleteDC(htile_);
 }
 
 LRESULT MainWindow::WindowProc(
@@ -297,6 +360,10 @@ LRESULT MainWindow::WindowProc(
 
     ONHANDLER(WM_WATCH, OnWatch);
 
+    ONHANDLER(WM_ANIMATION, OnAnimation);
+
+    ONHANDLER(WM_TRANSFORMED, OnTransformed);
+
   default:
     return ::DefWindowProc(hwnd_, msg, wparam, lparam);
   }
@@ -332,6 +399,7 @@ HANDLERIMPL(OnPaint)
   ConWrite(itos(sp_.x));
   ConWrite(itos(sp_.y));
   if (ps.rcPaint.right - ps.rcPaint.left && ps.rcPaint.bottom - ps.rcPaint.top) {
+    PaintCanvas(ps.rcPaint);
     BitBlt(
       ps.hdc,
       ps.rcPaint.left,
@@ -339,14 +407,20 @@ HANDLERIMPL(OnPaint)
       ps.rcPaint.right - ps.rcPaint.left,
       ps.rcPaint.bottom - ps.rcPaint.top,
       hmem_,
-      sp_.x + ps.rcPaint.left,
-      sp_.y + ps.rcPaint.top,
+      ps.rcPaint.left,
+      ps.rcPaint.top,
       SRCCOPY
       );
   }
 
   EndPaint(hwnd_, &ps);
 
+  // Render ahead once there is nothing else to do
+  if (!prefetching_ && img_.isValid() && !animation_) {
+    prefetching_ = true;
+    SetTimer(hwnd_, IDT_PREFETCH, prefetchDelay, nullptr);
+  }
+
   SendMessage(hstatus_, msg, wparam, lparam);
   return 0;
 }
@@ -504,6 +578,15 @@ HANDLERIMPL(OnChar)
     LoadFile();
     break;
 
+  case ' ':
+    TogglePause();
+    break;
+
+  case ',':
+  case '.':
+    StepFrame(wparam == '.' ? 1 : -1);
+    break;
+
   default:
     HANDLERPASS;
   }
@@ -661,8 +744,27 @@ HANDLERIMPL(OnScroll)
   v = min(si.nMax - (signed)si.nPage, v);
   ConWrite(L"adj:" + itos(v));
   SetScrollPos(hwnd_, SB, v, TRUE);
-  InvalidateRect(hwnd_, nullptr, FALSE);
+  const LONG delta = v - (vscroll ? sp_.y : sp_.x);
   vscroll ? sp_.y = v : sp_.x = v;
+  SetView();
+
+  if (statusShowing_) {
+    // Do not drag the status bar along
+    InvalidateRect(hwnd_, nullptr, FALSE);
+  }
+  else if (delta) {
+    // Only what scrolled into view needs painting
+    ScrollWindowEx(
+      hwnd_,
+      vscroll ? 0 : -delta,
+      vscroll ? -delta : 0,
+      nullptr,
+      nullptr,
+      nullptr,
+      nullptr,
+      SW_INVALIDATE
+      );
+  }
 
   return 0;
 }
@@ -860,7 +962,10 @@ HANDLERIMPL(OnWatch)
     break;
   default:
     try {
-      FileAttr(file_).getSize();
+      if (FileAttr(file_) == fileAttr_) {
+        // Our own transformation, already on screen
+        break;
+      }
     }
     catch (Exception) {
       ConWrite(L"RECV D2");
@@ -892,6 +997,17 @@ HANDLERIMPL(OnTimer)
     }
   }
     break;
+  case IDT_ANIMATE:
+    KillTimer(hwnd_, IDT_ANIMATE);
+    if (animation_) {
+      unsigned next = frameIndex_ + 1;
+      if (next == animation_->GetFrameCount()) {
+        next = 0;
+        ++loopsPlayed_;
+      }
+      ShowFrame(next);
+    }
+    break;
   case IDT_AACCEPT:
     KillTimer(hwnd_, IDT_AACCEPT);
     if (newAspect_ != aspect_) {
@@ -899,10 +1015,62 @@ HANDLERIMPL(OnTimer)
       DoDC();
     }
     break;
+  case IDT_PREFETCH:
+    // One tile at a time; timer messages only come when the queue is empty
+    if (!tiles_.Prefetch()) {
+      KillTimer(hwnd_, IDT_PREFETCH);
+      prefetching_ = false;
+    }
+    break;
+  }
+
+  return 0;
+}
+
+HANDLERIMPL(OnAnimation)
+{
+  // The frame we are waiting for got decoded
+  if (animation_ && (unsigned)wparam == framePending_) {
+    ShowFrame(framePending_);
+  }
+  return 0;
+}
+
+HANDLERIMPL(OnTransformed)
+{
+  if (!transformer_) {
+    // Left over from the previous file
+    return 0;
+  }
+  if (!wparam) {
+    transformFailed_ = true;
+  }
+  if (!transformer_->IsIdle()) {
+    return 0;
+  }
+
+  inTransformation_ = false;
+  if (transformFailed_) {
+    transformFailed_ = false;
+    std::wstringstream ss;
+    ss << L"Cannot transform " << file_;
+    Exception(ss.str()).show(hwnd_, L"Error transforming file.");
+
+    // Show the file as it is
+    LoadFile();
+    return 0;
   }
 
+  // The file now holds what is shown already
+  try {
+    fileAttr_ = FileAttr(file_);
+  }
+  catch (Exception) {
+    PostQuitMessage(0);
+  }
   return 0;
 }
+
 HANDLERIMPL(OnMoving)
 {
   WorkArea area(hwnd_);
@@ -964,11 +1132,11 @@ void MainWindow::PreAdjustWindow()
 
   if (best_ && img_.isValid()) {
     bestAspect_ = 1.0f;
-    if ((unsigned)img_.getWidth() > maxX) {
-      bestAspect_ = (float)maxX / (float)img_.getWidth();
+    if (ImageWidth() > maxX) {
+      bestAspect_ = (float)maxX / (float)ImageWidth();
     }
     if (Height() > maxY) {
-      bestAspect_ = (float)maxY / (float)img_.getHeight();
+      bestAspect_ = (float)maxY / (float)ImageHeight();
     }
   }
 
@@ -1049,36 +1217,15 @@ void MainWindow::LoadFile()
         if (hmem_ == INVALID_HANDLE_VALUE) {
           throw WindowsException();
         }
-        SelectObject(
-          hmem_,
-          GetStockObject(DEFAULT_GUI_FONT)
-          );
-
-        RECT  rc = {0, 0, (LONG)Width(), (LONG)Height()};
-        FillRect(
-          hmem_,
-          &rc,
-          (HBRUSH)(COLOR_BTNFACE + 1)
-          );
-        if (!DrawText(
-          hmem_,
-          s_err_load.c_str(),
-          -1,
-          &rc,
-          DT_SINGLELINE | DT_CENTER | DT_VCENTER
-          )) {
-          throw WindowsException();
-        }
 
         SetTitle();
       }
     CenterWindow();
   }
   else {
-    if (img_.getFormat() == FIF_BMP && img_.getBitsPerPixel() == 32) {
-      img_.convertTo24Bits();
-    }
+    animation_ = Animation::Open(file_, img_.getFormat(), hwnd_);
     DoDC();
+    StartAnimation();
   }
   SetStatus();
 }
@@ -1092,72 +1239,195 @@ void MainWindow::DoDC()
     PreAdjustWindow();
     SetTitle();
 
+    sp_.x = sp_.y = 0;
     CreateDC();
+  }
 
-    const UINT left = (dcDims_.x - Width()) / 2;
-    const UINT top = (dcDims_.y - Height()) / 2;
+  CenterWindow();
+}
 
-    float fasp = fabs(1.f - (best_ ? bestAspect_ : aspect_));
-    if (fasp < 1e-4) {
-      img_.draw(hmem_, Rect(left, top, left + Width(), top + Height()));
-      ConWrite(itos(Width()) + _T("-") + itos(clientWidth_));
-    }
-    else {
-      SetStatus(s_resizing.c_str());
-      const UINT w = Width();
-      const UINT h = Height();
-      try {
-        FreeImage::WinImage r(img_);
-        r.rescale(w, h, GetResampleMethod());
-        r.draw(hmem_, Rect(left, top, left + w, top + h));
-      }
-      catch (std::exception& ex) {
-        SetStatus(stringtools::convert(ex.what()));
-      }
+void MainWindow::SetView()
+{
+  const TileCache::Bounds view = {
+    (unsigned)sp_.x,
+    (unsigned)sp_.y,
+    (unsigned)sp_.x + canvasWidth_,
+    (unsigned)sp_.y + canvasHeight_
+  };
+  tiles_.SetView(view);
+}
 
-      SetStatus();
+std::unique_ptr<TileCache::Tile> MainWindow::RenderTile(
+  const TileCache::Bounds &bounds, FREE_IMAGE_FILTER filter)
+{
+  FIBITMAP *src = img_;
+  if (img_.getImageType() != FIT_BITMAP) {
+    if (!display_.isValid()) {
+      display_ = toStandardBitmap(img_);
+    }
+    src = display_;
+    if (!src) {
+      return nullptr;
     }
+  }
+  if (!pyramid_.GetBase()) {
+    pyramid_.Reset(src);
+  }
+  src = pyramid_.Select(Width(), Height());
+
+  // Unscaled, this is a plain copy
+  FreeImage::WinImage part;
+  part = FreeImage_RescaleWindow(
+    src, Width(), Height(),
+    bounds.left, bounds.top, bounds.right, bounds.bottom,
+    filter);
+  if (!part.isValid()) {
+    return nullptr;
+  }
 
-    SHFILEINFO shfi;
-    shfi.hIcon = 0;
-    shfi.iIcon = 0;
+  const LONG w = bounds.right - bounds.left;
+  const LONG h = bounds.bottom - bounds.top;
+  HBITMAP bitmap = CreateCompatibleBitmap(GetDC(hwnd_), w, h);
+  if (!bitmap) {
+    return nullptr;
+  }
+  Rect rc(w, h);
+  HGDIOBJ old = SelectObject(htile_, bitmap);
+  part.draw(htile_, rc);
+  SelectObject(htile_, old);
 
-    std::wstring e = file_.substr(0, file_.rfind('.') + 1);
-    e.append(stringtools::convert(img_.getOriginalInformation().getFormat().getFirstExtension()));
+  return std::make_unique<BitmapTile>(bitmap, (size_t)w * h * 4);
+}
 
-    UINT iconType = SHGFI_LARGEICON;
-    if (Width() < 160 || Height() < 160) {
-      iconType = SHGFI_SMALLICON;
-    }
+void MainWindow::PaintCanvas(const RECT &area)
+{
+  // Where the canvas is, in client coordinates
+  const POINT origin = {
+    ((LONG)dcDims_.x - (LONG)Width()) / 2 - sp_.x,
+    ((LONG)dcDims_.y - (LONG)Height()) / 2 - sp_.y
+  };
 
-    HIMAGELIST hImgList = (HIMAGELIST)SHGetFileInfo(
-      e.c_str(),
-      FILE_ATTRIBUTE_NORMAL,
-      &shfi,
-      sizeof(SHFILEINFO),
-      SHGFI_USEFILEATTRIBUTES | SHGFI_SYSICONINDEX | iconType
+  if (!img_.isValid()) {
+    FillRect(hmem_, &area, (HBRUSH)(COLOR_BTNFACE + 1));
+    RECT rc = {0, 0, (LONG)Width(), (LONG)Height()};
+    DrawText(
+      hmem_,
+      s_err_load.c_str(),
+      -1,
+      &rc,
+      DT_SINGLELINE | DT_CENTER | DT_VCENTER
       );
+    return;
+  }
 
-    if (hImgList != nullptr) {
-      if (iconType == SHGFI_SMALLICON) {
-        ImageList_Draw(hImgList, shfi.iIcon, hmem_, dcDims_.x - 5 - GetSystemMetrics(SM_CXSMICON), 5, ILD_TRANSPARENT);
-        //DrawIcon(hmem_, Width() - 5 - GetSystemMetrics(SM_CXICON), 5, shfi.hIcon);
-      }
-      else {
-        ImageList_Draw(hImgList, shfi.iIcon, hmem_, Width() - 10 - GetSystemMetrics(SM_CXICON), 10, ILD_TRANSPARENT);
-      }
-      if (shfi.hIcon != 0) {
-        DestroyIcon(shfi.hIcon);
-      }
+  FillRect(hmem_, &area, (HBRUSH)(COLOR_WINDOW + 1));
+
+  if (animation_) {
+    if (frame_) {
+      // GDI scaling keeps up with playback, the resampling filters do not
+      FIBITMAP *dib = frame_->GetBitmap();
+      SetStretchBltMode(hmem_, HALFTONE);
+      SetBrushOrgEx(hmem_, 0, 0, nullptr);
+      StretchDIBits(
+        hmem_,
+        origin.x, origin.y, Width(), Height(),
+        0, 0, FreeImage_GetWidth(dib), FreeImage_GetHeight(dib),
+        FreeImage_GetBits(dib),
+        FreeImage_GetInfo(dib),
+        DIB_RGB_COLORS,
+        SRCCOPY
+        );
     }
-    sp_.x = sp_.y = 0;
+    else {
+      // Frame 0 is still being composed on the worker. The page it is made
+      // from was loaded already, so show that where it goes on the screen.
+      const POINT at = Animation::GetPageOrigin(img_);
+      const float sx = (float)Width() / ImageWidth();
+      const float sy = (float)Height() / ImageHeight();
+      Rect rc(
+        origin.x + (LONG)(at.x * sx), origin.y + (LONG)(at.y * sy),
+        (LONG)(img_.getWidth() * sx), (LONG)(img_.getHeight() * sy),
+        true
+        );
+      img_.draw(hmem_, rc);
+    }
+  }
+  else {
+    const TileCache::Bounds bounds = {
+      (unsigned)max(area.left - origin.x, 0L),
+      (unsigned)max(area.top - origin.y, 0L),
+      (unsigned)max(area.right - origin.x, 0L),
+      (unsigned)max(area.bottom - origin.y, 0L)
+    };
+    tiles_.Cover(bounds, [&](const TileCache::Bounds &b, const TileCache::Tile &tile) {
+      HGDIOBJ old = SelectObject(
+        htile_, static_cast<const BitmapTile&>(tile).GetBitmap());
+      BitBlt(
+        hmem_,
+        origin.x + b.left,
+        origin.y + b.top,
+        b.right - b.left,
+        b.bottom - b.top,
+        htile_,
+        0,
+        0,
+        SRCCOPY
+        );
+      SelectObject(htile_, old);
+    });
   }
 
-  CenterWindow();
+  DrawFileIcon(area);
+}
+
+void MainWindow::DrawFileIcon(const RECT &area)
+{
+  UINT iconType = SHGFI_LARGEICON;
+  if (Width() < 160 || Height() < 160) {
+    iconType = SHGFI_SMALLICON;
+  }
+
+  // Top right corner of the canvas; most of the time, nothing to do
+  const bool smallIcon = iconType == SHGFI_SMALLICON;
+  const int cx = GetSystemMetrics(smallIcon ? SM_CXSMICON : SM_CXICON);
+  const int cy = GetSystemMetrics(smallIcon ? SM_CYSMICON : SM_CYICON);
+  const Rect rc = smallIcon ?
+    Rect(dcDims_.x - 5 - cx - sp_.x, 5 - sp_.y, cx, cy, true) :
+    Rect((LONG)Width() - 10 - cx - sp_.x, 10 - sp_.y, cx, cy, true);
+  RECT visible;
+  if (!IntersectRect(&visible, &rc, &area)) {
+    return;
+  }
+
+  SHFILEINFO shfi;
+  shfi.hIcon = 0;
+  shfi.iIcon = 0;
+
+  std::wstring e = file_.substr(0, file_.rfind('.') + 1);
+  e.append(stringtools::convert(img_.getOriginalInformation().getFormat().getFirstExtension()));
+
+  HIMAGELIST hImgList = (HIMAGELIST)SHGetFileInfo(
+    e.c_str(),
+    FILE_ATTRIBUTE_NORMAL,
+    &shfi,
+    sizeof(SHFILEINFO),
+    SHGFI_USEFILEATTRIBUTES | SHGFI_SYSICONINDEX | iconType
+    );
+
+  if (hImgList != nullptr) {
+    ImageList_Draw(hImgList, shfi.iIcon, hmem_, rc.left, rc.top, ILD_TRANSPARENT);
+    if (shfi.hIcon != 0) {
+      DestroyIcon(shfi.hIcon);
+    }
+  }
 }
 
 void MainWindow::FreeFile()
 {
+  StopAnimation();
+  tiles_.Clear();
+  pyramid_.Reset();
+  display_.clear();
   img_.clear();
 }
 
@@ -1168,20 +1438,34 @@ void MainWindow::CreateDC()
     hmem_ = nullptr;
   }
   hmem_ = CreateCompatibleDC(nullptr);
+  if (!htile_) {
+    htile_ = CreateCompatibleDC(nullptr);
+  }
 
-  const UINT width = max(Width(), (UINT)canvasWidth_);
-  const UINT height = max(Height(), (UINT)canvasHeight_);
-
-
-  DeleteObject(SelectObject(hmem_, CreateCompatibleBitmap(GetDC(hwnd_), width, height)));
+  // The canvas is painted from tiles of the scaled image, one screen at a
+  // time, through a back buffer the size of the client area
+  DeleteObject(SelectObject(hmem_, CreateCompatibleBitmap(GetDC(hwnd_), clientWidth_, clientHeight_)));
   SetBkMode(
     hmem_,
     TRANSPARENT
     );
-  const Rect r(0, 0, width, height);
-  FillRect(hmem_, &r, (HBRUSH)(COLOR_WINDOW + 1));
-  dcDims_.x = width;
-  dcDims_.y = height;
+  SelectObject(
+    hmem_,
+    GetStockObject(DEFAULT_GUI_FONT)
+    );
+  dcDims_.x = max(Width(), (UINT)canvasWidth_);
+  dcDims_.y = max(Height(), (UINT)canvasHeight_);
+
+  if (img_.isValid() && !animation_) {
+    const FREE_IMAGE_FILTER filter = GetResampleMethod();
+    tiles_.Reset(Width(), Height(), [this, filter](const TileCache::Bounds &b) {
+      return RenderTile(b, filter);
+    });
+  }
+  else {
+    tiles_.Clear();
+  }
+  SetView();
 }
 
 void MainWindow::ProcessPaint() const
@@ -1213,6 +1497,10 @@ void MainWindow::DeleteMe()
     nullptr
   };
 
+  // Let pending transformations finish first
+  transformer_.reset();
+  inTransformation_ = transformFailed_ = false;
+
   Thread::Locker l(watcher_.get());
   SHFileOperation(
     &op
@@ -1364,30 +1652,131 @@ void MainWindow::Transform(FREE_IMAGE_JPEG_OPERATION aTrans)
   }
 
   try {
-    AutoToggle a(inTransformation_, true);
-    Thread::Suspender wts(watcher_.get());
-
-    if (!FreeImage_JPEGTransform(
-      stringtools::WStringToString(file_).c_str(),
-      stringtools::WStringToString(file_).c_str(),
-      aTrans
-      )) {
-      std::wstringstream ss;
-      ss << L"Cannot transform " << file_;
-      throw Exception(ss.str());
+    if (!transformer_) {
+      transformer_.reset(new Transformer(file_, hwnd_));
     }
-    LoadFile();
+
+    // Rotate what is on screen right away, instead of reading the file back
+    // after the transformation. The file is rewritten in the background;
+    // until then, changes to it are our own.
+    inTransformation_ = true;
+    transformer_->Queue(aTrans);
+    pyramid_.Reset();
+    display_.clear();
+    if (!img_.transform(aTrans)) {
+      // Out of memory, most likely; reload once the file is done
+      transformFailed_ = true;
+      return;
+    }
+    DoDC();
   }
   catch (Exception &ex) {
     ex.show(hwnd_, L"Error transforming file.");
   }
 }
 
+void MainWindow::StartAnimation()
+{
+  if (!animation_) {
+    return;
+  }
+  loopsPlayed_ = 0;
+  paused_ = false;
+  frameDue_ = GetTickCount();
+  ShowFrame(0);
+}
+
+void MainWindow::StopAnimation()
+{
+  KillTimer(hwnd_, IDT_ANIMATE);
+  framePending_ = UINT_MAX;
+  frame_.reset();
+  animation_.reset();
+}
+
+void MainWindow::ShowFrame(unsigned index)
+{
+  auto frame = animation_->GetFrame(index);
+  if (!frame) {
+    // OnAnimation will be back once the frame is decoded
+    framePending_ = index;
+    return;
+  }
+
+  framePending_ = UINT_MAX;
+  frameIndex_ = index;
+  frame_ = frame;
+
+  InvalidateRect(hwnd_, nullptr, FALSE);
+
+  ScheduleFrame();
+}
+
+void MainWindow::ScheduleFrame()
+{
+  KillTimer(hwnd_, IDT_ANIMATE);
+  if (paused_ || !frame_) {
+    return;
+  }
+
+  const unsigned loops = animation_->GetLoops();
+  if (loops && frameIndex_ + 1 == animation_->GetFrameCount() &&
+    loopsPlayed_ + 1 >= loops) {
+    // Done; stay on the last frame
+    return;
+  }
+
+  // Frames are due relative to when the previous one was due, not when it
+  // actually got shown, so timer latency does not add up. Unless we fell
+  // behind by more than a whole frame, e.g. waiting for the decoder.
+  const DWORD now = GetTickCount();
+  const DWORD delay = frame_->GetDelay();
+  if ((LONG)(now - frameDue_) > (LONG)delay) {
+    frameDue_ = now;
+  }
+  frameDue_ += delay;
+
+  const LONG wait = (LONG)(frameDue_ - now);
+  SetTimer(hwnd_, IDT_ANIMATE, (UINT)max(wait, USER_TIMER_MINIMUM), nullptr);
+}
+
+void MainWindow::StepFrame(int delta)
+{
+  if (!animation_) {
+    return;
+  }
+  paused_ = true;
+  KillTimer(hwnd_, IDT_ANIMATE);
+
+  const unsigned count = animation_->GetFrameCount();
+  ShowFrame((frameIndex_ + count + delta) % count);
+}
+
+void MainWindow::TogglePause()
+{
+  if (!animation_) {
+    return;
+  }
+  paused_ = !paused_;
+  if (paused_) {
+    KillTimer(hwnd_, IDT_ANIMATE);
+    return;
+  }
+
+  // Resuming a finished animation plays it again
+  loopsPlayed_ = 0;
+  frameDue_ = GetTickCount();
+  ScheduleFrame();
+}
+
 void MainWindow::BrowseNew()
 {
   if (!openDlg->Execute(hwnd_, file_)) {
     return;
   }
+  transformer_.reset();
+  inTransformation_ = transformFailed_ = false;
+
   watcher_.reset();
   file_ = openDlg->getFileName();
   watcher_.reset(new WatcherThread(file_, hwnd_));
@@ -11,6 +11,10 @@
 #include "functions.h"
 #include "FileAttr.h"
 #include "FreeImagePlus.h"
+#include "Animation.h"
+#include "Transformer.h"
+#include "TileCache.h"
+#include "Pyramid.h"
 
 #define MESSAGEHANDLER(handler) \
   LRESULT __fastcall handler(UINT msg, WPARAM wparam, LPARAM lparam)
@@ -28,12 +32,25 @@ private:
   UINT canvasWidth_, canvasHeight_;
 
   HWND hwnd_, hstatus_;
-  HDC hmem_;
+  HDC hmem_, htile_;
   HMENU hctx_;
   bool statusShowing_;
 
   FreeImage::WinImage img_;
 
+  // What tiles are rendered from, if img_ is not a standard bitmap
+  FreeImage::Image display_;
+  // Reductions of what tiles are rendered from, for zooming out
+  Pyramid pyramid_;
+  TileCache tiles_;
+  bool prefetching_;
+
+  std::unique_ptr<Animation> animation_;
+  Animation::FramePtr frame_;
+  unsigned frameIndex_, framePending_, loopsPlayed_;
+  DWORD frameDue_;
+  bool paused_;
+
   std::unique_ptr<WatcherThread> watcher_;
   float aspect_, bestAspect_, newAspect_;
   bool best_, wheeling_;
@@ -41,7 +58,8 @@ private:
   POINT sp_;
   POINT dcDims_;
 
-  bool inTransformation_;
+  std::unique_ptr<Transformer> transformer_;
+  bool inTransformation_, transformFailed_;
   BOOL keyCtrl_, keyShift_;
   BOOL mbtnDown_;
 
@@ -69,6 +87,11 @@ private:
   void FreeFile();
   void CreateDC();
   void DoDC();
+  void SetView();
+  std::unique_ptr<TileCache::Tile> RenderTile(
+    const TileCache::Bounds &bounds, FREE_IMAGE_FILTER filter);
+  void PaintCanvas(const RECT &area);
+  void DrawFileIcon(const RECT &area);
   void ProcessPaint() const;
 
   void DeleteMe();
@@ -79,17 +102,36 @@ private:
 
   void SetTitle();
 
+  void StartAnimation();
+  void StopAnimation();
+  void ShowFrame(unsigned index);
+  void ScheduleFrame();
+  void StepFrame(int delta);
+  void TogglePause();
+
+  // Animations are shown on their logical screen, which may be larger than
+  // the first frame.
+  UINT ImageWidth() const
+  {
+    return animation_ ? animation_->GetWidth() : img_.getWidth();
+  }
+
+  UINT ImageHeight() const
+  {
+    return animation_ ? animation_->GetHeight() : img_.getHeight();
+  }
+
   UINT Width() const
   {
     return img_.isValid() ?
-      (UINT)((float)img_.getWidth() * (best_ ? bestAspect_ : aspect_)) :
+      (UINT)((float)ImageWidth() * (best_ ? bestAspect_ : aspect_)) :
       clientWidth_;
   }
 
   UINT Height() const
   {
     return img_.isValid() ?
-      (UINT)((float)img_.getHeight() * (best_ ? bestAspect_ : aspect_)) :
+      (UINT)((float)ImageHeight() * (best_ ? bestAspect_ : aspect_)) :
       clientHeight_;
   }
 
@@ -116,6 +158,8 @@ protected:
   MESSAGEHANDLER(OnCommand);
   MESSAGEHANDLER(OnSysCommand);
   MESSAGEHANDLER(OnWatch);
+  MESSAGEHANDLER(OnAnimation);
+  MESSAGEHANDLER(OnTransformed);
   MESSAGEHANDLER(OnTimer);
   MESSAGEHANDLER(OnMoving);
   MESSAGEHANDLER(OnSize);
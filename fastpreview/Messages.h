@@ -2,3 +2,5 @@
 #include <windows.h>
 
 #define WM_WATCH			WM_USER + 1
+#define WM_ANIMATION		WM_USER + 2
+#define WM_TRANSFORMED		WM_USER + 3
@@ -0,0 +1,34 @@
+#include "Pyramid.h"
+
+void Pyramid::Reset(FIBITMAP *base)
+{
+  for (auto level : levels_) {
+    FreeImage_Unload(level);
+  }
+  levels_.clear();
+  base_ = base;
+}
+
+FIBITMAP* Pyramid::Select(unsigned width, unsigned height)
+{
+  FIBITMAP *rv = base_;
+  if (!rv) {
+    return nullptr;
+  }
+
+  for (size_t i = 0;; ++i) {
+    const unsigned w = FreeImage_GetWidth(rv);
+    const unsigned h = FreeImage_GetHeight(rv);
+    if ((w + 1) / 2 < width || (h + 1) / 2 < height || w < 2 || h < 2) {
+      return rv;
+    }
+    if (i == levels_.size()) {
+      FIBITMAP *level = FreeImage_HalveSize(rv);
+      if (!level) {
+        return rv;
+      }
+      levels_.push_back(level);
+    }
+    rv = levels_[i];
+  }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vector>
+
+#include "FreeImage.h"
+
+/**
+ * Lazily built pyramid of an image: each level is the one before it at half
+ * the size, every pixel the average of the 2x2 it replaces.
+ *
+ * Shrinking the image resamples from the smallest level still at least as
+ * large as the result, so the filters see less than twice the pixels they
+ * produce, no matter how far out the view is zoomed. Levels are made the
+ * first time a zoom needs them and kept until the image changes.
+ */
+class Pyramid
+{
+private:
+  FIBITMAP *base_;
+
+  // Level 1 onwards; owned
+  std::vector<FIBITMAP*> levels_;
+
+  Pyramid(const Pyramid&) = delete;
+  Pyramid& operator=(const Pyramid&) = delete;
+
+public:
+  Pyramid() : base_(nullptr)
+  {}
+
+  ~Pyramid()
+  {
+    Reset();
+  }
+
+  /// Starts over with a new image, which stays owned by the caller
+  void Reset(FIBITMAP *base = nullptr);
+
+  FIBITMAP* GetBase() const
+  {
+    return base_;
+  }
+
+  /**
+   * Returns the level to scale to the given size from: the base for any
+   * enlargement, otherwise the smallest level not smaller than that.
+   * Levels that cannot be made are skipped, falling back to larger ones.
+   */
+  FIBITMAP* Select(unsigned width, unsigned height);
+};
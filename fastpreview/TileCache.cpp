@@ -0,0 +1,201 @@
+#include "TileCache.h"
+
+#include <algorithm>
+
+namespace {
+  /// Rows or columns of tiles rendered ahead of the view
+  const unsigned prefetchDepth = 2;
+
+  bool intersects(const TileCache::Bounds &a, const TileCache::Bounds &b)
+  {
+    return a.left < b.right && b.left < a.right &&
+      a.top < b.bottom && b.top < a.bottom;
+  }
+
+  int sign(unsigned a, unsigned b)
+  {
+    return a < b ? -1 : (a > b ? 1 : 0);
+  }
+}
+
+TileCache::TileCache(size_t budget)
+  : budget_(budget),
+  size_(0),
+  largest_(0)
+{
+  Clear();
+}
+
+void TileCache::Reset(unsigned width, unsigned height, const Renderer &renderer)
+{
+  index_.clear();
+  entries_.clear();
+  size_ = largest_ = 0;
+
+  width_ = width;
+  height_ = height;
+  offset_ = (tileSize - height % tileSize) % tileSize;
+  cols_ = (width + tileSize - 1) / tileSize;
+  rows_ = (height + offset_ + tileSize - 1) / tileSize;
+  renderer_ = renderer;
+
+  // Most images are looked at from the top down
+  view_.left = view_.top = view_.right = view_.bottom = 0;
+  dx_ = 0;
+  dy_ = 1;
+}
+
+TileCache::Bounds TileCache::GetBounds(unsigned col, unsigned row) const
+{
+  Bounds b;
+  b.left = col * tileSize;
+  b.right = std::min(b.left + tileSize, width_);
+  b.top = row ? row * tileSize - offset_ : 0;
+  b.bottom = std::min((row + 1) * tileSize - offset_, height_);
+  return b;
+}
+
+void TileCache::GetRange(
+  const Bounds &area,
+  unsigned &col0, unsigned &row0, unsigned &col1, unsigned &row1) const
+{
+  const unsigned right = std::min(area.right, width_);
+  const unsigned bottom = std::min(area.bottom, height_);
+  if (area.left >= right || area.top >= bottom) {
+    col0 = col1 = row0 = row1 = 0;
+    return;
+  }
+  col0 = area.left / tileSize;
+  col1 = (right + tileSize - 1) / tileSize;
+  row0 = (area.top + offset_) / tileSize;
+  row1 = (bottom + offset_ + tileSize - 1) / tileSize;
+}
+
+const TileCache::Tile* TileCache::Get(unsigned col, unsigned row)
+{
+  const unsigned key = Key(col, row);
+  auto i = index_.find(key);
+  if (i != index_.end()) {
+    entries_.splice(entries_.begin(), entries_, i->second);
+    return entries_.front().tile.get();
+  }
+
+  if (!renderer_) {
+    return nullptr;
+  }
+  Entry e = { col, row, renderer_(GetBounds(col, row)) };
+  if (!e.tile) {
+    return nullptr;
+  }
+  const size_t size = e.tile->GetSize();
+  size_ += size;
+  largest_ = std::max(largest_, size);
+  entries_.push_front(std::move(e));
+  index_[key] = entries_.begin();
+  return entries_.front().tile.get();
+}
+
+void TileCache::Trim(const Bounds &keep)
+{
+  for (auto i = entries_.end(); size_ > budget_ && i != entries_.begin();) {
+    --i;
+    if (intersects(GetBounds(i->col, i->row), keep)) {
+      continue;
+    }
+    size_ -= i->tile->GetSize();
+    index_.erase(Key(i->col, i->row));
+    i = entries_.erase(i);
+  }
+}
+
+void TileCache::SetView(const Bounds &view)
+{
+  Bounds v = view;
+  v.right = std::min(v.right, width_);
+  v.bottom = std::min(v.bottom, height_);
+
+  if (!view_.empty() && (v.left != view_.left || v.top != view_.top)) {
+    dx_ = sign(v.left, view_.left);
+    dy_ = sign(v.top, view_.top);
+  }
+  view_ = v;
+}
+
+void TileCache::Cover(const Bounds &area, const Painter &painter)
+{
+  unsigned col0, row0, col1, row1;
+  GetRange(area, col0, row0, col1, row1);
+  for (unsigned row = row0; row < row1; ++row) {
+    for (unsigned col = col0; col < col1; ++col) {
+      const Tile *tile = Get(col, row);
+      if (tile) {
+        painter(GetBounds(col, row), *tile);
+      }
+    }
+  }
+  Trim(view_);
+}
+
+bool TileCache::Prefetch()
+{
+  if (view_.empty() || !renderer_ || (!dx_ && !dy_)) {
+    return false;
+  }
+
+  unsigned col0, row0, col1, row1;
+  GetRange(view_, col0, row0, col1, row1);
+
+  // The view and the tiles ahead of it stay, as long as they fit
+  Bounds keep = view_;
+  const unsigned ahead = prefetchDepth * tileSize;
+  if (dx_ < 0) {
+    keep.left = keep.left > ahead ? keep.left - ahead : 0;
+  }
+  else if (dx_ > 0) {
+    keep.right += ahead;
+  }
+  if (dy_ < 0) {
+    keep.top = keep.top > ahead ? keep.top - ahead : 0;
+  }
+  else if (dy_ > 0) {
+    keep.bottom += ahead;
+  }
+  size_t kept = 0;
+  for (const auto &e : entries_) {
+    if (intersects(GetBounds(e.col, e.row), keep)) {
+      kept += e.tile->GetSize();
+    }
+  }
+  if (kept + largest_ > budget_) {
+    return false;
+  }
+
+  // Nearest first: the next row (column) along the view, then the one after
+  for (unsigned d = 1; d <= prefetchDepth; ++d) {
+    if (dy_) {
+      const unsigned row = dy_ > 0 ? row1 - 1 + d : row0 - d;
+      if (row < rows_) {
+        for (unsigned col = col0; col < col1; ++col) {
+          if (!index_.count(Key(col, row))) {
+            const bool rv = Get(col, row) != nullptr;
+            Trim(keep);
+            return rv;
+          }
+        }
+      }
+    }
+    if (dx_) {
+      const unsigned col = dx_ > 0 ? col1 - 1 + d : col0 - d;
+      if (col < cols_) {
+        for (unsigned row = row0; row < row1; ++row) {
+          if (!index_.count(Key(col, row))) {
+            const bool rv = Get(col, row) != nullptr;
+            Trim(keep);
+            return rv;
+          }
+        }
+      }
+    }
+  }
+  return false;
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <stddef.h>
+#include <functional>
+#include <list>
+#include <memory>
+#include <unordered_map>
+
+/**
+ * Renders the canvas, the scaled image, in tiles as they get exposed.
+ *
+ * The canvas is cut into square tiles of tileSize pixels. A tile is rendered
+ * the first time painting needs it and then kept, up to a memory budget,
+ * dropping the least recently used ones first. Tiles in view are never
+ * dropped.
+ *
+ * While idle, the owner may let the cache render ahead, one tile at a time:
+ * the tiles just outside the view, in the direction the view last moved to.
+ *
+ * The cache itself knows nothing about pixels or devices. The renderer
+ * passed to Reset() produces Tile objects holding whatever is needed to draw
+ * them later.
+ *
+ * The grid is aligned to the bottom edge of the canvas, the first row being
+ * the partial one. Patterns FreeImage lays out from the bottom line of a
+ * bitmap, like the checkerboard behind transparent images, so continue across
+ * tiles.
+ */
+class TileCache
+{
+public:
+  static const unsigned tileSize = 256;
+
+  /// Canvas area, in pixels, right and bottom exclusive
+  struct Bounds
+  {
+    unsigned left, top, right, bottom;
+
+    bool empty() const
+    {
+      return left >= right || top >= bottom;
+    }
+  };
+
+  class Tile
+  {
+  public:
+    virtual ~Tile()
+    {}
+
+    /// Memory used, in bytes
+    virtual size_t GetSize() const = 0;
+  };
+
+  /// Renders the given area; returns nothing if that failed
+  typedef std::function<std::unique_ptr<Tile>(const Bounds&)> Renderer;
+
+  /// Draws a rendered tile covering the given area
+  typedef std::function<void(const Bounds&, const Tile&)> Painter;
+
+private:
+  struct Entry
+  {
+    unsigned col, row;
+    std::unique_ptr<Tile> tile;
+  };
+  typedef std::list<Entry> Entries;
+
+  const size_t budget_;
+  size_t size_, largest_;
+
+  unsigned width_, height_;
+  unsigned cols_, rows_;
+  unsigned offset_;
+  Renderer renderer_;
+
+  // Most recently used first
+  Entries entries_;
+  std::unordered_map<unsigned, Entries::iterator> index_;
+
+  Bounds view_;
+  int dx_, dy_;
+
+  TileCache(const TileCache&) = delete;
+  TileCache& operator=(const TileCache&) = delete;
+
+  unsigned Key(unsigned col, unsigned row) const
+  {
+    return row * cols_ + col;
+  }
+
+  Bounds GetBounds(unsigned col, unsigned row) const;
+  void GetRange(
+    const Bounds &area,
+    unsigned &col0, unsigned &row0, unsigned &col1, unsigned &row1) const;
+
+  const Tile* Get(unsigned col, unsigned row);
+  void Trim(const Bounds &keep);
+
+public:
+  explicit TileCache(size_t budget);
+
+  /// Starts over with a new canvas
+  void Reset(unsigned width, unsigned height, const Renderer &renderer);
+
+  /// Drops all tiles and the canvas
+  void Clear()
+  {
+    Reset(0, 0, Renderer());
+  }
+
+  /// Sets the visible part of the canvas
+  void SetView(const Bounds &view);
+
+  /**
+   * Paints the tiles intersecting area, rendering missing ones first.
+   * Tiles that fail to render are skipped.
+   */
+  void Cover(const Bounds &area, const Painter &painter);
+
+  /**
+   * Renders one missing tile ahead of the view.
+   * Returns false once there is nothing left to do, for now.
+   */
+  bool Prefetch();
+
+  /// Memory used by the tiles, in bytes
+  size_t GetSize() const
+  {
+    return size_;
+  }
+};
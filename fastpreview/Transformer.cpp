@@ -0,0 +1,154 @@
+#include "Transformer.h"
+
+#include "Exception.h"
+#include "MemoryStream.h"
+#include "Messages.h"
+#include "console.h"
+#include "fileio.h"
+
+namespace {
+  /// Where an operation moves the pixel at x/y, relative to the center:
+  /// x' = xx * x + xy * y, y' = yx * x + yy * y
+  struct Mapping
+  {
+    int xx, xy, yx, yy;
+  };
+
+  // In FREE_IMAGE_JPEG_OPERATION order, y pointing down
+  const Mapping mappings[] = {
+    { 1, 0, 0, 1 },   // FIJPEG_OP_NONE
+    { -1, 0, 0, 1 },  // FIJPEG_OP_FLIP_H
+    { 1, 0, 0, -1 },  // FIJPEG_OP_FLIP_V
+    { 0, 1, 1, 0 },   // FIJPEG_OP_TRANSPOSE
+    { 0, -1, -1, 0 }, // FIJPEG_OP_TRANSVERSE
+    { 0, -1, 1, 0 },  // FIJPEG_OP_ROTATE_90
+    { -1, 0, 0, -1 }, // FIJPEG_OP_ROTATE_180
+    { 0, 1, -1, 0 }   // FIJPEG_OP_ROTATE_270
+  };
+
+  /// The single operation doing first, then second
+  FREE_IMAGE_JPEG_OPERATION combine(
+    FREE_IMAGE_JPEG_OPERATION first, FREE_IMAGE_JPEG_OPERATION second)
+  {
+    const Mapping &a = mappings[first];
+    const Mapping &b = mappings[second];
+    const Mapping m = {
+      b.xx * a.xx + b.xy * a.yx, b.xx * a.xy + b.xy * a.yy,
+      b.yx * a.xx + b.yy * a.yx, b.yx * a.xy + b.yy * a.yy
+    };
+    for (size_t i = 0; i < _countof(mappings); ++i) {
+      const Mapping &c = mappings[i];
+      if (c.xx == m.xx && c.xy == m.xy && c.yx == m.yx && c.yy == m.yy) {
+        return (FREE_IMAGE_JPEG_OPERATION)i;
+      }
+    }
+    return FIJPEG_OP_NONE;
+  }
+}
+
+Transformer::Transformer(const std::wstring &file, HWND aOwner)
+  : Thread(),
+  file_(file),
+  hOwner_(aOwner),
+  hTerm_(nullptr), hWake_(nullptr),
+  busy_(false)
+{
+  hTerm_ = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+  hWake_ = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+  if (!hTerm_ || !hWake_) {
+    if (hTerm_) {
+      CloseHandle(hTerm_);
+    }
+    if (hWake_) {
+      CloseHandle(hWake_);
+    }
+    throw Exception("Cannot set up transformation");
+  }
+  Run();
+}
+
+Transformer::~Transformer()
+{
+  SetEvent(hTerm_);
+  WaitForSingleObject(GetHandle(), INFINITE);
+
+  CloseHandle(hTerm_);
+  CloseHandle(hWake_);
+}
+
+void Transformer::Queue(FREE_IMAGE_JPEG_OPERATION operation)
+{
+  {
+    Locker l(this);
+    queue_.push_back(operation);
+  }
+  SetEvent(hWake_);
+}
+
+bool Transformer::IsIdle()
+{
+  Locker l(this);
+  return !busy_ && queue_.empty();
+}
+
+bool Transformer::Take(FREE_IMAGE_JPEG_OPERATION &operation)
+{
+  Locker l(this);
+  if (queue_.empty()) {
+    return false;
+  }
+  operation = FIJPEG_OP_NONE;
+  for (auto op : queue_) {
+    operation = combine(operation, op);
+  }
+  queue_.clear();
+  busy_ = true;
+  return true;
+}
+
+bool Transformer::Apply(FREE_IMAGE_JPEG_OPERATION operation) const
+{
+  if (operation == FIJPEG_OP_NONE) {
+    // Rotated back and forth before we got to it
+    return true;
+  }
+
+  std::vector<BYTE> data;
+  if (!fileio::read(file_, data) || data.empty()) {
+    return false;
+  }
+
+  MemoryStream src(FreeImage_OpenMemory(&data[0], (DWORD)data.size()));
+  MemoryStream dst(FreeImage_OpenMemory());
+  if (!src || !dst || !FreeImage_JPEGTransformCombinedFromMemory(
+    src, dst, operation, nullptr, nullptr, nullptr, nullptr, TRUE)) {
+    return false;
+  }
+  BYTE *out = nullptr;
+  DWORD size = 0;
+  return FreeImage_AcquireMemory(dst, &out, &size) && size &&
+    fileio::replace(file_, out, size);
+}
+
+DWORD Transformer::operator()()
+{
+  HANDLE handles[] = {hTerm_, hWake_};
+  for (bool running = true; running;) {
+    running = WaitForMultipleObjects(2, handles, FALSE, INFINITE) ==
+      WAIT_OBJECT_0 + 1;
+
+    // Even when asked to terminate: what was queued is still expected to
+    // end up in the file
+    FREE_IMAGE_JPEG_OPERATION operation;
+    while (Take(operation)) {
+      ConWrite(L"Transform: " + itos((int)operation));
+      const bool rv = Apply(operation);
+      {
+        Locker l(this);
+        busy_ = false;
+      }
+      PostMessage(hOwner_, WM_TRANSFORMED, (WPARAM)(rv ? TRUE : FALSE), 0);
+    }
+  }
+  return 0;
+}
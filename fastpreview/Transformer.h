@@ -0,0 +1,48 @@
+#pragma once
+
+#include <windows.h>
+#include <string>
+#include <vector>
+
+#include "Thread.h"
+#include "FreeImage.h"
+
+/**
+ * Applies lossless JPEG transformations to a file in the background.
+ *
+ * The viewer rotates or flips its decoded image right away and queues the
+ * same operation here. The worker thread reads the file into memory,
+ * rewrites it in the coefficient domain and replaces the file with the
+ * result. Operations queued while the worker is busy are combined into one,
+ * so a burst of rotations rewrites the file once.
+ *
+ * WM_TRANSFORMED is posted to the owner after each rewrite, with wparam set
+ * to TRUE on success. Pending operations are completed before the object
+ * goes away.
+ */
+class Transformer : public Thread
+{
+private:
+  const std::wstring file_;
+  const HWND hOwner_;
+  HANDLE hTerm_, hWake_;
+
+  // Shared with the owner, guarded by Locker
+  std::vector<FREE_IMAGE_JPEG_OPERATION> queue_;
+  bool busy_;
+
+  bool Take(FREE_IMAGE_JPEG_OPERATION &operation);
+  bool Apply(FREE_IMAGE_JPEG_OPERATION operation) const;
+
+protected:
+  virtual DWORD operator()();
+
+public:
+  Transformer(const std::wstring &file, HWND aOwner);
+  ~Transformer();
+
+  void Queue(FREE_IMAGE_JPEG_OPERATION operation);
+
+  /// Whether all queued operations made it to the file
+  bool IsIdle();
+};
@@ -0,0 +1,210 @@
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <time.h>
+#endif
+
+#include <algorithm>
+
+#include "Bench.h"
+
+namespace {
+  std::string Escape(const std::string &s)
+  {
+    std::string rv;
+    for (auto c : s) {
+      if (c == '"' || c == '\\') {
+        rv += '\\';
+        rv += c;
+      }
+      else if ((unsigned char)c < 0x20) {
+        char buf[8];
+        sprintf(buf, "\\u%04x", (unsigned)(unsigned char)c);
+        rv += buf;
+      }
+      else {
+        rv += c;
+      }
+    }
+    return rv;
+  }
+}
+
+Bench::Bench(const Options &options)
+  : options_(options)
+{}
+
+bool Bench::Wants(const std::string &suite, const std::string &name) const
+{
+  if (options_.only.empty()) {
+    return true;
+  }
+  const std::string full = suite + "/" + name;
+  for (const auto &prefix : options_.only) {
+    if (full.compare(0, prefix.size(), prefix) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool Bench::WantsGroup(const std::string &suite, const std::string &group) const
+{
+  if (options_.only.empty()) {
+    return true;
+  }
+  const std::string full = suite + "/" + group;
+  for (const auto &prefix : options_.only) {
+    const size_t common = std::min(full.size(), prefix.size());
+    if (full.compare(0, common, prefix, 0, common) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool Bench::Run(const Case &c, const std::function<bool()> &fn)
+{
+  if (!Wants(c.suite, c.name)) {
+    return true;
+  }
+
+  Result r(c);
+  r.ok = true;
+  r.best = 1e300;
+  double total = 0.0;
+  while (r.reps < options_.maxReps &&
+         (r.reps < options_.minReps || total < options_.minSeconds)) {
+    const double start = Now();
+    if (!fn()) {
+      r.ok = false;
+      break;
+    }
+    const double elapsed = Now() - start;
+    r.best = std::min(r.best, elapsed);
+    total += elapsed;
+    ++r.reps;
+  }
+  if (!r.reps) {
+    r.best = 0.0;
+  }
+  r.mean = r.reps ? total / r.reps : 0.0;
+  r.peakRSS = PeakRSS();
+  results_.push_back(r);
+
+  if (options_.verbose) {
+    char size[32] = "";
+    if (c.width) {
+      sprintf(size, "%ux%u", c.width, c.height);
+    }
+    if (!r.ok) {
+      printf("%-8s %-28s %11s  FAILED\n", c.suite.c_str(), c.name.c_str(), size);
+    }
+    else if (c.bytes && r.best > 0.0) {
+      printf("%-8s %-28s %11s %10.4f ms %9.1f MB/s\n", c.suite.c_str(), c.name.c_str(), size,
+        r.best * 1000.0, c.bytes / r.best / (1 << 20));
+    }
+    else {
+      printf("%-8s %-28s %11s %10.4f ms\n", c.suite.c_str(), c.name.c_str(), size, r.best * 1000.0);
+    }
+    fflush(stdout);
+  }
+  return r.ok;
+}
+
+void Bench::SetInfo(const std::string &name, const std::string &value)
+{
+  for (auto &i : info_) {
+    if (i.first == name) {
+      i.second = value;
+      return;
+    }
+  }
+  info_.push_back(std::make_pair(name, value));
+}
+
+bool Bench::Write(FILE *file) const
+{
+  fprintf(file, "{\n");
+  for (const auto &i : info_) {
+    fprintf(file, "  \"%s\": \"%s\",\n", Escape(i.first).c_str(), Escape(i.second).c_str());
+  }
+  fprintf(file, "  \"min_seconds\": %g,\n  \"min_reps\": %u,\n", options_.minSeconds, options_.minReps);
+  fprintf(file, "  \"cases\": [");
+  for (size_t i = 0; i < results_.size(); ++i) {
+    const Result &r = results_[i];
+    fprintf(file, "%s\n    {\"suite\": \"%s\", \"name\": \"%s\", \"format\": \"%s\"",
+      i ? "," : "", Escape(r.c.suite).c_str(), Escape(r.c.name).c_str(), Escape(r.c.format).c_str());
+    if (r.c.width) {
+      fprintf(file, ", \"width\": %u, \"height\": %u", r.c.width, r.c.height);
+    }
+    if (r.c.bpp) {
+      fprintf(file, ", \"bpp\": %u", r.c.bpp);
+    }
+    if (r.c.fileBytes) {
+      fprintf(file, ", \"file_bytes\": %llu", r.c.fileBytes);
+    }
+    if (r.c.bytes) {
+      fprintf(file, ", \"bytes\": %llu", r.c.bytes);
+    }
+    fprintf(file, ", \"ok\": %s, \"reps\": %u, \"best_ms\": %.4f, \"mean_ms\": %.4f",
+      r.ok ? "true" : "false", r.reps, r.best * 1000.0, r.mean * 1000.0);
+    if (r.ok && r.c.bytes && r.best > 0.0) {
+      fprintf(file, ", \"mb_per_s\": %.2f", r.c.bytes / r.best / (1 << 20));
+    }
+    fprintf(file, ", \"peak_rss_mb\": %.1f}", r.peakRSS);
+  }
+  fprintf(file, "\n  ],\n  \"failed\": %u,\n  \"peak_rss_mb\": %.1f\n}\n", GetFailed(), PeakRSS());
+  return !ferror(file);
+}
+
+unsigned Bench::GetFailed() const
+{
+  unsigned rv = 0;
+  for (const auto &r : results_) {
+    if (!r.ok) {
+      ++rv;
+    }
+  }
+  return rv;
+}
+
+double Bench::Now()
+{
+#ifdef _WIN32
+  static LARGE_INTEGER frequency;
+  if (!frequency.QuadPart) {
+    QueryPerformanceFrequency(&frequency);
+  }
+  LARGE_INTEGER now;
+  QueryPerformanceCounter(&now);
+  return (double)now.QuadPart / (double)frequency.QuadPart;
+#else
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec * 1e-9;
+#endif
+}
+
+double Bench::PeakRSS()
+{
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS pmc;
+  if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) {
+    return 0.0;
+  }
+  return pmc.PeakWorkingSetSize / (double)(1 << 20);
+#else
+  rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage)) {
+    return 0.0;
+  }
+#ifdef __APPLE__
+  return usage.ru_maxrss / (double)(1 << 20);
+#else
+  return usage.ru_maxrss / (double)(1 << 10);
+#endif
+#endif
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <stdio.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * Times benchmark cases and collects the results for writing them as JSON.
+ *
+ * A case is repeated until it ran both the minimum number of times and for
+ * the minimum total time. The fastest repetition is reported, as it is the
+ * one least disturbed by the rest of the system, along with the mean.
+ */
+class Bench
+{
+public:
+  struct Options
+  {
+    /// Minimum total time spent on one case, in seconds
+    double minSeconds;
+    /// Minimum number of repetitions of one case
+    unsigned minReps;
+    /// Maximum number of repetitions of one case
+    unsigned maxReps;
+    /// Run only the cases whose "suite/name" starts with one of these
+    std::vector<std::string> only;
+    /// Print every case to stdout as it completes
+    bool verbose;
+
+    Options() : minSeconds(0.5), minReps(3), maxReps(100), verbose(true) {}
+  };
+
+  /// Describes what a case works on; written along with its timings
+  struct Case
+  {
+    std::string suite;
+    std::string name;
+    /// Format of the input, a FreeImage format name or a pixel type
+    std::string format;
+    unsigned width;
+    unsigned height;
+    unsigned bpp;
+    /// Bytes processed by one repetition, the base of MB/s; 0 for none
+    unsigned long long bytes;
+    /// Size of the encoded input, if there is one
+    unsigned long long fileBytes;
+
+    Case(const std::string &suite, const std::string &name)
+      : suite(suite), name(name), width(0), height(0), bpp(0), bytes(0), fileBytes(0)
+    {}
+  };
+
+  explicit Bench(const Options &options);
+
+  /**
+   * Tells whether a case is selected by the options, so that unselected
+   * ones need not even be set up.
+   */
+  bool Wants(const std::string &suite, const std::string &name) const;
+
+  /**
+   * Tells whether any case with a name starting with group may be selected,
+   * for setting up what several cases share.
+   */
+  bool WantsGroup(const std::string &suite, const std::string &group) const;
+
+  /**
+   * Times fn, unless the case is not wanted. fn returns false when it
+   * failed, which ends the case and marks it as failed.
+   * @return false if fn failed
+   */
+  bool Run(const Case &c, const std::function<bool()> &fn);
+
+  /// Adds a name/value pair to the header of the results
+  void SetInfo(const std::string &name, const std::string &value);
+
+  /// Writes the results as a JSON document
+  bool Write(FILE *file) const;
+
+  size_t GetCount() const
+  {
+    return results_.size();
+  }
+  unsigned GetFailed() const;
+
+  /// A monotonic clock, in seconds
+  static double Now();
+  /// The peak resident set size of the process so far, in MB
+  static double PeakRSS();
+
+private:
+  struct Result
+  {
+    Case c;
+    unsigned reps;
+    double best;
+    double mean;
+    double peakRSS;
+    bool ok;
+
+    Result(const Case &c) : c(c), reps(0), best(0.0), mean(0.0), peakRSS(0.0), ok(false) {}
+  };
+
+  Options options_;
+  std::vector<std::pair<std::string, std::string> > info_;
+  std::vector<Result> results_;
+};
@@ -0,0 +1,93 @@
+#include <string.h>
+
+#include "Corpus.h"
+#include "Suites.h"
+
+namespace {
+  unsigned long long ImageBytes(FIBITMAP *dib)
+  {
+    return (unsigned long long)FreeImage_GetLine(dib) * FreeImage_GetHeight(dib);
+  }
+
+  FIBITMAP* LoadFile(FREE_IMAGE_FORMAT fif, const std::vector<BYTE> &file, int flags = 0)
+  {
+    Corpus::Stream stream(file);
+    return FreeImage_LoadFromHandle(fif, Corpus::GetIO(), (fi_handle)&stream, flags);
+  }
+
+  /**
+   * Times loading a file, checking the size of the result.
+   * bytes is set from a first, untimed load.
+   */
+  void RunLoad(Bench &bench, Bench::Case &c, FREE_IMAGE_FORMAT fif, const std::vector<BYTE> &file, int flags = 0)
+  {
+    const unsigned width = c.width, height = c.height;
+    auto load = [&]() -> bool {
+      FIBITMAP *dib = LoadFile(fif, file, flags);
+      const bool ok = dib && FreeImage_GetWidth(dib) == width && FreeImage_GetHeight(dib) == height;
+      if (ok && !c.bytes) {
+        c.bytes = ImageBytes(dib);
+      }
+      FreeImage_Unload(dib);
+      return ok;
+    };
+
+    c.fileBytes = file.size();
+    if (!load()) {
+      bench.Run(c, [] { return false; });
+      return;
+    }
+    bench.Run(c, load);
+  }
+}
+
+void Suites::Load(Bench &bench, const Settings &settings)
+{
+  std::vector<BYTE> file;
+  for (size_t s = 0; s < settings.sizes.size(); ++s) {
+    for (const auto &v : Corpus::GetVariants()) {
+      // formats of a fixed size only run once
+      if (!bench.Wants("load", v.name) || (v.fixedWidth && s)) {
+        continue;
+      }
+      Bench::Case c("load", v.name);
+      c.format = v.format;
+      c.width = v.fixedWidth ? v.fixedWidth : settings.sizes[s].width;
+      c.height = v.fixedWidth ? v.fixedHeight : settings.sizes[s].height;
+      c.bpp = v.bpp;
+      if (!Corpus::Encode(v, c.width, c.height, file)) {
+        bench.Run(c, [] { return false; });
+        continue;
+      }
+      RunLoad(bench, c, FreeImage_GetFIFFromFormat(v.format), file);
+    }
+  }
+}
+
+void Suites::Detect(Bench &bench, const Settings &settings)
+{
+  if (settings.sizes.empty()) {
+    return;
+  }
+  const Size &size = settings.sizes[0];
+  std::vector<BYTE> file;
+  for (const auto &v : Corpus::GetVariants()) {
+    if (!bench.Wants("detect", v.name)) {
+      continue;
+    }
+    Bench::Case c("detect", v.name);
+    c.format = v.format;
+    if (!Corpus::Encode(v, size.width, size.height, file)) {
+      bench.Run(c, [] { return false; });
+      continue;
+    }
+    c.fileBytes = file.size();
+    // PhotoCD and WBMP have no signature, so they go through every validator unrecognized
+    const bool signature = strcmp(v.format, "PCD") && strcmp(v.format, "WBMP");
+    const FREE_IMAGE_FORMAT expected = signature ? FreeImage_GetFIFFromFormat(v.format) : FIF_UNKNOWN;
+    bench.Run(c, [&] {
+      Corpus::Stream stream(file);
+      return FreeImage_GetFileTypeFromHandle(Corpus::GetIO(), (fi_handle)&stream, 0) == expected;
+    });
+  }
+}
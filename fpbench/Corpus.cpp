@@ -0,0 +1,1180 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "Corpus.h"
+
+namespace {
+  /// Mixes coordinates into 32 well distributed bits
+  unsigned Hash(unsigned x, unsigned y, unsigned z)
+  {
+    unsigned h = x * 0x9E3779B1u ^ (y + 0x7F4A7C15u) * 0x85EBCA77u ^ (z + 1) * 0xC2B2AE3Du;
+    h ^= h >> 15;
+    h *= 0x2C1B3C6Du;
+    h ^= h >> 12;
+    h *= 0x297A2D39u;
+    h ^= h >> 15;
+    return h;
+  }
+
+  /**
+   * The 16-bit value of channel c (red, green, blue, alpha) at x, y, with
+   * y counted from the top. The image is split into a grid of 8x6 cells;
+   * a quarter of them are flat and framed, the others carry gradients with
+   * a ripple and some noise.
+   */
+  unsigned Sample(unsigned x, unsigned y, unsigned c, unsigned width, unsigned height)
+  {
+    const unsigned cx = x * 8 / width, cy = y * 6 / height;
+    const unsigned cell = Hash(cx, cy, 99);
+    if (c == 3) {
+      // alpha: opaque, transparent and ramped cells
+      switch (cell >> 30) {
+      case 0:
+        return 0;
+      case 1:
+        return (x * 0xFFFFu) / width;
+      default:
+        return 0xFFFF;
+      }
+    }
+    if ((cell & 3) == 0) {
+      const unsigned left = cx * width / 8, top = cy * height / 6;
+      if (x - left < 2 || y - top < 2) {
+        return 0x2020;
+      }
+      return ((cell >> (8 + c * 8)) & 0xFF) * 0x101;
+    }
+
+    unsigned v;
+    switch (c) {
+    case 0:
+      v = (x * 0xFFFFu) / width;
+      break;
+    case 1:
+      v = (y * 0xFFFFu) / height;
+      break;
+    default:
+      v = ((x + y) * 0xFFFFu) / (width + height);
+      break;
+    }
+    const unsigned period = 97 + c * 31;
+    const unsigned t = (x + 2 * y + c * 17) % (2 * period);
+    const unsigned ripple = (t < period ? t : 2 * period - t) * 0x3FFF / period;
+    v = v * 3 / 4 + ripple + (Hash(x, y, c) & 0x1FF);
+    return v > 0x100 ? std::min(v - 0x100, 0xFFFFu) : 0;
+  }
+
+  unsigned Luma16(unsigned x, unsigned y, unsigned width, unsigned height)
+  {
+    return (Sample(x, y, 0, width, height) * 19595 +
+            Sample(x, y, 1, width, height) * 38470 +
+            Sample(x, y, 2, width, height) * 7471) >> 16;
+  }
+
+  void SetGreyPalette(FIBITMAP *dib)
+  {
+    RGBQUAD *pal = FreeImage_GetPalette(dib);
+    const unsigned colors = FreeImage_GetColorsUsed(dib);
+    for (unsigned i = 0; i < colors; ++i) {
+      pal[i].rgbRed = pal[i].rgbGreen = pal[i].rgbBlue = (BYTE)(i * 255 / (colors - 1));
+      pal[i].rgbReserved = 0;
+    }
+  }
+
+  FIBITMAP* MakeRGB(unsigned width, unsigned height, unsigned bpp)
+  {
+    FIBITMAP *dib = FreeImage_Allocate(width, height, bpp);
+    if (!dib) {
+      return nullptr;
+    }
+    const unsigned step = bpp / 8;
+    for (unsigned y = 0; y < height; ++y) {
+      BYTE *bits = FreeImage_GetScanLine(dib, height - 1 - y);
+      for (unsigned x = 0; x < width; ++x, bits += step) {
+        bits[FI_RGBA_RED] = (BYTE)(Sample(x, y, 0, width, height) >> 8);
+        bits[FI_RGBA_GREEN] = (BYTE)(Sample(x, y, 1, width, height) >> 8);
+        bits[FI_RGBA_BLUE] = (BYTE)(Sample(x, y, 2, width, height) >> 8);
+        if (step == 4) {
+          bits[FI_RGBA_ALPHA] = (BYTE)(Sample(x, y, 3, width, height) >> 8);
+        }
+      }
+    }
+    return dib;
+  }
+
+  FIBITMAP* MakeGrey(unsigned width, unsigned height, unsigned bpp)
+  {
+    static const unsigned bayer[16] = { 0, 8, 2, 10, 12, 4, 14, 6, 3, 11, 1, 9, 15, 7, 13, 5 };
+
+    FIBITMAP *dib = FreeImage_Allocate(width, height, bpp);
+    if (!dib) {
+      return nullptr;
+    }
+    SetGreyPalette(dib);
+    for (unsigned y = 0; y < height; ++y) {
+      BYTE *bits = FreeImage_GetScanLine(dib, height - 1 - y);
+      memset(bits, 0, FreeImage_GetLine(dib));
+      for (unsigned x = 0; x < width; ++x) {
+        const unsigned l = Luma16(x, y, width, height) >> 8;
+        switch (bpp) {
+        case 1:
+          if (l > bayer[(y & 3) * 4 + (x & 3)] * 16 + 8) {
+            bits[x >> 3] |= 0x80 >> (x & 7);
+          }
+          break;
+        case 4:
+          bits[x >> 1] |= (BYTE)((x & 1) ? l >> 4 : l & 0xF0);
+          break;
+        default:
+          bits[x] = (BYTE)l;
+          break;
+        }
+      }
+    }
+    return dib;
+  }
+
+  template <class T>
+  FIBITMAP* MakeHigh(FREE_IMAGE_TYPE type, unsigned width, unsigned height, unsigned channels, T (*convert)(unsigned, unsigned))
+  {
+    FIBITMAP *dib = FreeImage_AllocateT(type, width, height);
+    if (!dib) {
+      return nullptr;
+    }
+    for (unsigned y = 0; y < height; ++y) {
+      T *bits = (T*)FreeImage_GetScanLine(dib, height - 1 - y);
+      for (unsigned x = 0; x < width; ++x) {
+        if (channels == 1) {
+          *bits++ = convert(Luma16(x, y, width, height), 0);
+          continue;
+        }
+        for (unsigned c = 0; c < channels; ++c) {
+          *bits++ = convert(Sample(x, y, c, width, height), c);
+        }
+      }
+    }
+    return dib;
+  }
+
+  WORD ToWord(unsigned v, unsigned)
+  {
+    return (WORD)v;
+  }
+
+  float ToFloat(unsigned v, unsigned c)
+  {
+    // colors range up to 2.0, as HDR images go beyond 1.0; alpha stays within 1.0
+    return c == 3 ? v / 65535.0f : v / 32768.0f;
+  }
+
+  /// Little helpers appending binary data
+  class Writer
+  {
+  public:
+    explicit Writer(std::vector<BYTE> &out) : out_(out) {}
+
+    void u8(unsigned v)
+    {
+      out_.push_back((BYTE)v);
+    }
+    void le16(unsigned v)
+    {
+      u8(v);
+      u8(v >> 8);
+    }
+    void le32(unsigned v)
+    {
+      le16(v);
+      le16(v >> 16);
+    }
+    void be16(unsigned v)
+    {
+      u8(v >> 8);
+      u8(v);
+    }
+    void be32(unsigned v)
+    {
+      be16(v >> 16);
+      be16(v);
+    }
+    void zero(size_t count)
+    {
+      out_.insert(out_.end(), count, 0);
+    }
+    void bytes(const BYTE *data, size_t count)
+    {
+      out_.insert(out_.end(), data, data + count);
+    }
+    void text(const char *s)
+    {
+      bytes((const BYTE*)s, strlen(s));
+    }
+    size_t pos() const
+    {
+      return out_.size();
+    }
+    void patchBE16(size_t at, unsigned v)
+    {
+      out_[at] = (BYTE)(v >> 8);
+      out_[at + 1] = (BYTE)v;
+    }
+    void patchBE32(size_t at, unsigned v)
+    {
+      patchBE16(at, v >> 16);
+      patchBE16(at + 2, v);
+    }
+    void patchLE32(size_t at, unsigned v)
+    {
+      for (unsigned i = 0; i < 4; ++i) {
+        out_[at + i] = (BYTE)(v >> (i * 8));
+      }
+    }
+
+  private:
+    std::vector<BYTE> &out_;
+  };
+
+  /// Top-down access to the rows of a bitmap
+  inline BYTE* Row(FIBITMAP *dib, unsigned y)
+  {
+    return FreeImage_GetScanLine(dib, FreeImage_GetHeight(dib) - 1 - y);
+  }
+
+  void PcxRle(const BYTE *src, unsigned n, Writer &w)
+  {
+    for (unsigned i = 0; i < n;) {
+      unsigned run = 1;
+      while (i + run < n && run < 63 && src[i + run] == src[i]) {
+        ++run;
+      }
+      if (run > 1 || (src[i] & 0xC0) == 0xC0) {
+        w.u8(0xC0 | run);
+      }
+      w.u8(src[i]);
+      i += run;
+    }
+  }
+
+  /// PackBits as used by PSD and TIFF: runs of up to 128 repeated or literal bytes
+  void PackBits(const BYTE *src, unsigned n, Writer &w)
+  {
+    for (unsigned i = 0; i < n;) {
+      unsigned run = 1;
+      while (i + run < n && run < 128 && src[i + run] == src[i]) {
+        ++run;
+      }
+      if (run >= 3) {
+        w.u8(257 - run);
+        w.u8(src[i]);
+        i += run;
+        continue;
+      }
+      const unsigned start = i;
+      while (i < n && i - start < 128 &&
+             !(i + 2 < n && src[i] == src[i + 1] && src[i] == src[i + 2])) {
+        ++i;
+      }
+      w.u8(i - start - 1);
+      w.bytes(src + start, i - start);
+    }
+  }
+
+  /// SGI RLE: a count with the high bit set precedes literals, otherwise a repeated byte
+  void SgiRle(const BYTE *src, unsigned n, Writer &w)
+  {
+    for (unsigned i = 0; i < n;) {
+      unsigned run = 1;
+      while (i + run < n && run < 127 && src[i + run] == src[i]) {
+        ++run;
+      }
+      if (run >= 3) {
+        w.u8(run);
+        w.u8(src[i]);
+        i += run;
+        continue;
+      }
+      const unsigned start = i;
+      while (i < n && i - start < 127 &&
+             !(i + 2 < n && src[i] == src[i + 1] && src[i] == src[i + 2])) {
+        ++i;
+      }
+      w.u8(0x80 | (i - start));
+      w.bytes(src + start, i - start);
+    }
+    w.u8(0);
+  }
+
+  /**
+   * BMP RLE4 of a row of 4-bit pixels, one per byte: runs of a repeated
+   * pixel, absolute runs of at least three others padded to a word, and
+   * the end of line escape
+   */
+  void BmpRle4(const BYTE *src, unsigned n, Writer &w)
+  {
+    for (unsigned i = 0; i < n;) {
+      unsigned run = 1;
+      while (i + run < n && run < 255 && src[i + run] == src[i]) {
+        ++run;
+      }
+      if (run >= 4) {
+        w.u8(run);
+        w.u8(src[i] << 4 | src[i]);
+        i += run;
+        continue;
+      }
+      const unsigned start = i;
+      while (i < n && i - start < 255 &&
+             !(i + 3 < n && src[i] == src[i + 1] && src[i] == src[i + 2] && src[i] == src[i + 3])) {
+        ++i;
+      }
+      const unsigned count = i - start;
+      if (count < 3) {
+        // too short for absolute mode, which needs three; two pixels alternate in a run
+        w.u8(count);
+        w.u8(src[start] << 4 | (count > 1 ? src[start + 1] : 0));
+        continue;
+      }
+      w.u8(0);
+      w.u8(count);
+      for (unsigned k = 0; k < count; k += 2) {
+        w.u8(src[start + k] << 4 | (k + 1 < count ? src[start + k + 1] : 0));
+      }
+      if (((count + 1) / 2) & 1) {
+        w.u8(0);
+      }
+    }
+    w.u8(0);
+    w.u8(0);
+  }
+
+  /// Byte offsets of red, green, blue and alpha in a FIT_BITMAP pixel
+  const unsigned channelOffset[4] = { FI_RGBA_RED, FI_RGBA_GREEN, FI_RGBA_BLUE, FI_RGBA_ALPHA };
+
+  /// Fetches the 4x4 block at bx, by as RGBA, repeating the edge pixels past the image
+  void GetBlock(FIBITMAP *dib, unsigned bx, unsigned by, BYTE px[16][4])
+  {
+    const unsigned width = FreeImage_GetWidth(dib), height = FreeImage_GetHeight(dib);
+    const unsigned step = FreeImage_GetBPP(dib) / 8;
+    for (unsigned i = 0; i < 16; ++i) {
+      const unsigned x = std::min(bx * 4 + (i & 3), width - 1);
+      const unsigned y = std::min(by * 4 + (i >> 2), height - 1);
+      const BYTE *p = Row(dib, y) + x * step;
+      for (unsigned c = 0; c < 3; ++c) {
+        px[i][c] = p[channelOffset[c]];
+      }
+      px[i][3] = step == 4 ? p[FI_RGBA_ALPHA] : 0xFF;
+    }
+  }
+
+  unsigned To565(const BYTE *p)
+  {
+    return ((p[0] >> 3) << 11) | ((p[1] >> 2) << 5) | (p[2] >> 3);
+  }
+
+  void From565(unsigned c, int rgb[3])
+  {
+    rgb[0] = ((c >> 11) & 31) * 255 / 31;
+    rgb[1] = ((c >> 5) & 63) * 255 / 63;
+    rgb[2] = (c & 31) * 255 / 31;
+  }
+
+  /// BC1 color block: the darkest and brightest pixels as endpoints, four colors
+  void ColorBlock(const BYTE px[16][4], Writer &w)
+  {
+    unsigned lo = 0, hi = 0;
+    int lmin = 1 << 30, lmax = -1;
+    for (unsigned i = 0; i < 16; ++i) {
+      const int l = px[i][0] * 2 + px[i][1] * 4 + px[i][2];
+      if (l < lmin) {
+        lmin = l;
+        lo = i;
+      }
+      if (l > lmax) {
+        lmax = l;
+        hi = i;
+      }
+    }
+    unsigned c0 = To565(px[hi]), c1 = To565(px[lo]);
+    if (c0 < c1) {
+      std::swap(c0, c1);
+    }
+    w.le16(c0);
+    w.le16(c1);
+    if (c0 == c1) {
+      w.le32(0);
+      return;
+    }
+
+    static const unsigned order[4] = { 1, 3, 2, 0 };
+    int e0[3], e1[3];
+    From565(c0, e0);
+    From565(c1, e1);
+    int axis[3], len = 0;
+    for (unsigned c = 0; c < 3; ++c) {
+      axis[c] = e0[c] - e1[c];
+      len += axis[c] * axis[c];
+    }
+    unsigned indices = 0;
+    for (unsigned i = 0; i < 16; ++i) {
+      int d = 0;
+      for (unsigned c = 0; c < 3; ++c) {
+        d += (px[i][c] - e1[c]) * axis[c];
+      }
+      const int q = std::max(0, std::min(3, (d * 3 + len / 2) / len));
+      indices |= order[q] << (i * 2);
+    }
+    w.le32(indices);
+  }
+
+  /// BC3 alpha and BC4/BC5 channel block: eight values between the extremes
+  void ValueBlock(const BYTE px[16][4], unsigned c, Writer &w)
+  {
+    unsigned v0 = 0, v1 = 255;
+    for (unsigned i = 0; i < 16; ++i) {
+      v0 = std::max(v0, (unsigned)px[i][c]);
+      v1 = std::min(v1, (unsigned)px[i][c]);
+    }
+    w.u8(v0);
+    w.u8(v1);
+    unsigned long long indices = 0;
+    if (v0 != v1) {
+      for (unsigned i = 0; i < 16; ++i) {
+        const unsigned q = ((px[i][c] - v1) * 7 + (v0 - v1) / 2) / (v0 - v1);
+        const unsigned index = q == 7 ? 0 : q == 0 ? 1 : 8 - q;
+        indices |= (unsigned long long)index << (i * 3);
+      }
+    }
+    for (unsigned i = 0; i < 6; ++i) {
+      w.u8((unsigned)(indices >> (i * 8)));
+    }
+  }
+
+  /// BC2 alpha block: four bits per pixel
+  void ExplicitAlphaBlock(const BYTE px[16][4], Writer &w)
+  {
+    for (unsigned i = 0; i < 16; i += 2) {
+      w.u8((px[i][3] >> 4) | (px[i + 1][3] & 0xF0));
+    }
+  }
+
+  /// Appends bits to a 128-bit BC7 block, least significant bit first
+  class BitWriter
+  {
+  public:
+    BitWriter() : pos_(0)
+    {
+      memset(block_, 0, sizeof(block_));
+    }
+
+    void put(unsigned value, unsigned bits)
+    {
+      for (unsigned i = 0; i < bits; ++i, ++pos_) {
+        block_[pos_ >> 3] |= ((value >> i) & 1) << (pos_ & 7);
+      }
+    }
+
+    const BYTE* data() const
+    {
+      return block_;
+    }
+
+  private:
+    BYTE block_[16];
+    unsigned pos_;
+  };
+
+  /**
+   * BC7 mode 6 block: one subset, 7-bit RGBA endpoints with a P-bit each
+   * and 4-bit indices, the endpoints picked like in ColorBlock.
+   */
+  void Bc7Block(const BYTE px[16][4], Writer &w)
+  {
+    unsigned lo = 0, hi = 0;
+    int lmin = 1 << 30, lmax = -1;
+    for (unsigned i = 0; i < 16; ++i) {
+      const int l = px[i][0] * 2 + px[i][1] * 4 + px[i][2] + px[i][3] * 2;
+      if (l < lmin) {
+        lmin = l;
+        lo = i;
+      }
+      if (l > lmax) {
+        lmax = l;
+        hi = i;
+      }
+    }
+
+    // quantize to 7 bits plus a P-bit shared by the channels of an endpoint
+    unsigned q[2][4], p[2];
+    int e[2][4];
+    const BYTE *ends[2] = { px[lo], px[hi] };
+    for (unsigned n = 0; n < 2; ++n) {
+      unsigned odd = 0;
+      for (unsigned c = 0; c < 4; ++c) {
+        odd += ends[n][c] & 1;
+      }
+      p[n] = odd >= 2;
+      for (unsigned c = 0; c < 4; ++c) {
+        q[n][c] = std::min(127u, (ends[n][c] + 1 - p[n]) >> 1);
+        e[n][c] = (int)(q[n][c] << 1 | p[n]);
+      }
+    }
+
+    int axis[4], len = 0;
+    for (unsigned c = 0; c < 4; ++c) {
+      axis[c] = e[1][c] - e[0][c];
+      len += axis[c] * axis[c];
+    }
+    unsigned indices[16];
+    for (unsigned i = 0; i < 16; ++i) {
+      int d = 0;
+      for (unsigned c = 0; c < 4; ++c) {
+        d += (px[i][c] - e[0][c]) * axis[c];
+      }
+      indices[i] = len ? (unsigned)std::max(0, std::min(15, (d * 15 + len / 2) / len)) : 0;
+    }
+    // the index of the first texel is stored without its top bit
+    const bool swap = indices[0] >= 8;
+
+    BitWriter bits;
+    bits.put(1 << 6, 7);
+    for (unsigned c = 0; c < 4; ++c) {
+      bits.put(q[swap][c], 7);
+      bits.put(q[!swap][c], 7);
+    }
+    bits.put(p[swap], 1);
+    bits.put(p[!swap], 1);
+    for (unsigned i = 0; i < 16; ++i) {
+      bits.put(swap ? 15 - indices[i] : indices[i], i ? 4 : 3);
+    }
+    w.bytes(bits.data(), 16);
+  }
+
+  unsigned FourCC(char a, char b, char c, char d)
+  {
+    return (BYTE)a | ((BYTE)b << 8) | ((BYTE)c << 16) | ((unsigned)(BYTE)d << 24);
+  }
+
+  const std::vector<Corpus::Variant> variants = {
+    { "bmp-1", "BMP", FIT_BITMAP, 1, false, 0, nullptr, 0, 0 },
+    { "bmp-8pal", "BMP", FIT_BITMAP, 8, true, 0, nullptr, 0, 0 },
+    { "bmp-4rle", "BMP", FIT_BITMAP, 4, false, 0, Corpus::EmitBMP, 0, 0 },
+    { "bmp-8rle", "BMP", FIT_BITMAP, 8, true, BMP_SAVE_RLE, nullptr, 0, 0 },
+    { "bmp-16", "BMP", FIT_BITMAP, 16, false, 0, nullptr, 0, 0 },
+    { "bmp-24", "BMP", FIT_BITMAP, 24, false, 0, nullptr, 0, 0 },
+    { "bmp-32", "BMP", FIT_BITMAP, 32, false, 0, nullptr, 0, 0 },
+    { "ico-32", "ICO", FIT_BITMAP, 32, false, 0, nullptr, 32, 32 },
+    { "ico-256", "ICO", FIT_BITMAP, 32, false, 0, nullptr, 256, 256 },
+    { "jpeg-grey", "JPEG", FIT_BITMAP, 8, false, JPEG_QUALITYGOOD, nullptr, 0, 0 },
+    { "jpeg-420", "JPEG", FIT_BITMAP, 24, false, JPEG_QUALITYGOOD | JPEG_SUBSAMPLING_420, nullptr, 0, 0 },
+    { "jpeg-444", "JPEG", FIT_BITMAP, 24, false, JPEG_QUALITYGOOD | JPEG_SUBSAMPLING_444, nullptr, 0, 0 },
+    { "jpeg-progressive", "JPEG", FIT_BITMAP, 24, false, JPEG_QUALITYGOOD | JPEG_PROGRESSIVE, nullptr, 0, 0 },
+    { "pcd", "PCD", FIT_BITMAP, 24, false, 0, Corpus::EmitPCD, 768, 512 },
+    { "pcx-1", "PCX", FIT_BITMAP, 1, false, 0, Corpus::EmitPCX, 0, 0 },
+    { "pcx-8pal", "PCX", FIT_BITMAP, 8, true, 0, Corpus::EmitPCX, 0, 0 },
+    { "pcx-24", "PCX", FIT_BITMAP, 24, false, 0, Corpus::EmitPCX, 0, 0 },
+    { "png-1", "PNG", FIT_BITMAP, 1, false, 0, nullptr, 0, 0 },
+    { "png-8pal", "PNG", FIT_BITMAP, 8, true, 0, nullptr, 0, 0 },
+    { "png-grey", "PNG", FIT_BITMAP, 8, false, 0, nullptr, 0, 0 },
+    { "png-rgb8", "PNG", FIT_BITMAP, 24, false, 0, nullptr, 0, 0 },
+    { "png-rgba8", "PNG", FIT_BITMAP, 32, false, 0, nullptr, 0, 0 },
+    { "png-grey16", "PNG", FIT_UINT16, 16, false, 0, nullptr, 0, 0 },
+    { "png-rgb16", "PNG", FIT_RGB16, 48, false, 0, nullptr, 0, 0 },
+    { "png-rgba16", "PNG", FIT_RGBA16, 64, false, 0, nullptr, 0, 0 },
+    { "tiff-1-g4", "TIFF", FIT_BITMAP, 1, false, TIFF_CCITTFAX4, nullptr, 0, 0 },
+    { "tiff-8pal-packbits", "TIFF", FIT_BITMAP, 8, true, TIFF_PACKBITS, nullptr, 0, 0 },
+    { "tiff-rgb8-lzw", "TIFF", FIT_BITMAP, 24, false, TIFF_LZW, nullptr, 0, 0 },
+    { "tiff-rgb8-deflate", "TIFF", FIT_BITMAP, 24, false, TIFF_DEFLATE, nullptr, 0, 0 },
+    { "tiff-rgb8-jpeg", "TIFF", FIT_BITMAP, 24, false, TIFF_JPEG, nullptr, 0, 0 },
+    { "tiff-rgba8", "TIFF", FIT_BITMAP, 32, false, TIFF_NONE, nullptr, 0, 0 },
+    { "tiff-rgb16", "TIFF", FIT_RGB16, 48, false, TIFF_LZW, nullptr, 0, 0 },
+    { "tiff-float", "TIFF", FIT_FLOAT, 32, false, TIFF_NONE, nullptr, 0, 0 },
+    { "tiff-rgbf", "TIFF", FIT_RGBF, 96, false, TIFF_NONE, nullptr, 0, 0 },
+    { "wbmp", "WBMP", FIT_BITMAP, 1, false, 0, nullptr, 0, 0 },
+    { "psd-grey-rle", "PSD", FIT_BITMAP, 8, false, 1, Corpus::EmitPSD, 0, 0 },
+    { "psd-rgb8-rle", "PSD", FIT_BITMAP, 24, false, 1, Corpus::EmitPSD, 0, 0 },
+    { "psd-rgba8", "PSD", FIT_BITMAP, 32, false, 0, Corpus::EmitPSD, 0, 0 },
+    { "psd-rgb16", "PSD", FIT_RGB16, 48, false, 0, Corpus::EmitPSD, 0, 0 },
+    { "xbm", "XBM", FIT_BITMAP, 1, false, 0, Corpus::EmitXBM, 0, 0 },
+    { "dds-rgb8", "DDS", FIT_BITMAP, 24, false, 0, Corpus::EmitDDS, 0, 0 },
+    { "dds-rgba8", "DDS", FIT_BITMAP, 32, false, 0, Corpus::EmitDDS, 0, 0 },
+    { "dds-bc1", "DDS", FIT_BITMAP, 24, false, 1, Corpus::EmitDDS, 0, 0 },
+    { "dds-bc2", "DDS", FIT_BITMAP, 32, false, 2, Corpus::EmitDDS, 0, 0 },
+    { "dds-bc3", "DDS", FIT_BITMAP, 32, false, 3, Corpus::EmitDDS, 0, 0 },
+    { "dds-bc4", "DDS", FIT_BITMAP, 24, false, 4, Corpus::EmitDDS, 0, 0 },
+    { "dds-bc5", "DDS", FIT_BITMAP, 24, false, 5, Corpus::EmitDDS, 0, 0 },
+    { "dds-bc7", "DDS", FIT_BITMAP, 32, false, 7, Corpus::EmitDDS, 0, 0 },
+    { "gif", "GIF", FIT_BITMAP, 8, true, 0, nullptr, 0, 0 },
+    { "hdr", "HDR", FIT_RGBF, 96, false, 0, nullptr, 0, 0 },
+    { "sgi-grey", "SGI", FIT_BITMAP, 8, false, 0, Corpus::EmitSGI, 0, 0 },
+    { "sgi-rgb8-rle", "SGI", FIT_BITMAP, 24, false, 1, Corpus::EmitSGI, 0, 0 },
+    { "sgi-rgba8-rle", "SGI", FIT_BITMAP, 32, false, 1, Corpus::EmitSGI, 0, 0 },
+    { "pfm-float", "PFM", FIT_FLOAT, 32, false, 0, nullptr, 0, 0 },
+    { "pfm-rgbf", "PFM", FIT_RGBF, 96, false, 0, nullptr, 0, 0 },
+    { "webp-lossy", "WebP", FIT_BITMAP, 24, false, 0, nullptr, 0, 0 },
+    { "webp-lossy-alpha", "WebP", FIT_BITMAP, 32, false, 0, nullptr, 0, 0 },
+    { "webp-lossless", "WebP", FIT_BITMAP, 24, false, WEBP_LOSSLESS, nullptr, 0, 0 },
+  };
+
+  unsigned DLL_CALLCONV ReadProc(void *buffer, unsigned size, unsigned count, fi_handle handle)
+  {
+    Corpus::Stream *s = (Corpus::Stream*)handle;
+    if (!size || s->pos >= s->size) {
+      return 0;
+    }
+    const size_t items = std::min((size_t)count, (s->size - s->pos) / size);
+    memcpy(buffer, s->data + s->pos, items * size);
+    s->pos += items * size;
+    return (unsigned)items;
+  }
+
+  unsigned DLL_CALLCONV WriteProc(void *buffer, unsigned size, unsigned count, fi_handle handle)
+  {
+    return 0;
+  }
+
+  int DLL_CALLCONV SeekProc(fi_handle handle, long offset, int origin)
+  {
+    Corpus::Stream *s = (Corpus::Stream*)handle;
+    long long pos = offset;
+    if (origin == SEEK_CUR) {
+      pos += s->pos;
+    }
+    else if (origin == SEEK_END) {
+      pos += s->size;
+    }
+    if (pos < 0) {
+      return -1;
+    }
+    s->pos = (size_t)pos;
+    return 0;
+  }
+
+  long DLL_CALLCONV TellProc(fi_handle handle)
+  {
+    return (long)((Corpus::Stream*)handle)->pos;
+  }
+}
+
+FIBITMAP* Corpus::MakeImage(FREE_IMAGE_TYPE type, unsigned bpp, unsigned width, unsigned height, bool palette)
+{
+  if (!width || !height) {
+    return nullptr;
+  }
+  switch (type) {
+  case FIT_BITMAP:
+    switch (bpp) {
+    case 1:
+    case 4:
+      return MakeGrey(width, height, bpp);
+    case 8:
+      if (palette) {
+        FIBITMAP *rgb = MakeRGB(width, height, 24);
+        FIBITMAP *dib = rgb ? FreeImage_ColorQuantizeEx(rgb, FIQ_WUQUANT, 256) : nullptr;
+        FreeImage_Unload(rgb);
+        return dib;
+      }
+      return MakeGrey(width, height, bpp);
+    case 16: {
+      FIBITMAP *rgb = MakeRGB(width, height, 24);
+      FIBITMAP *dib = rgb ? FreeImage_ConvertTo16Bits565(rgb) : nullptr;
+      FreeImage_Unload(rgb);
+      return dib;
+    }
+    case 24:
+    case 32:
+      return MakeRGB(width, height, bpp);
+    default:
+      return nullptr;
+    }
+  case FIT_UINT16:
+    return MakeHigh<WORD>(type, width, height, 1, ToWord);
+  case FIT_RGB16:
+    return MakeHigh<WORD>(type, width, height, 3, ToWord);
+  case FIT_RGBA16:
+    return MakeHigh<WORD>(type, width, height, 4, ToWord);
+  case FIT_FLOAT:
+    return MakeHigh<float>(type, width, height, 1, ToFloat);
+  case FIT_RGBF:
+    return MakeHigh<float>(type, width, height, 3, ToFloat);
+  case FIT_RGBAF:
+    return MakeHigh<float>(type, width, height, 4, ToFloat);
+  default:
+    return nullptr;
+  }
+}
+
+bool Corpus::EmitBMP(FIBITMAP *dib, int option, std::vector<BYTE> &out)
+{
+  const unsigned width = FreeImage_GetWidth(dib), height = FreeImage_GetHeight(dib);
+  if (FreeImage_GetImageType(dib) != FIT_BITMAP || FreeImage_GetBPP(dib) != 4) {
+    return false;
+  }
+  const unsigned offset = 14 + 40 + 16 * 4;
+
+  Writer w(out);
+  w.text("BM");
+  // file size, patched below
+  w.le32(0);
+  w.le32(0);
+  w.le32(offset);
+  w.le32(40);
+  w.le32(width);
+  w.le32(height);
+  w.le16(1);
+  w.le16(4);
+  // BI_RLE4, the size of the data, patched below
+  w.le32(2);
+  w.le32(0);
+  w.le32(2835);
+  w.le32(2835);
+  w.le32(16);
+  w.le32(0);
+  const RGBQUAD *pal = FreeImage_GetPalette(dib);
+  for (unsigned i = 0; i < 16; ++i) {
+    w.u8(pal[i].rgbBlue);
+    w.u8(pal[i].rgbGreen);
+    w.u8(pal[i].rgbRed);
+    w.u8(0);
+  }
+
+  // bottom-up, like the scanlines
+  std::vector<BYTE> line(width);
+  for (unsigned y = 0; y < height; ++y) {
+    const BYTE *bits = FreeImage_GetScanLine(dib, y);
+    for (unsigned x = 0; x < width; ++x) {
+      line[x] = x & 1 ? bits[x / 2] & 0x0F : bits[x / 2] >> 4;
+    }
+    BmpRle4(&line[0], width, w);
+  }
+  w.u8(0);
+  w.u8(1);
+
+  w.patchLE32(2, (unsigned)w.pos());
+  w.patchLE32(34, (unsigned)w.pos() - offset);
+  return true;
+}
+
+bool Corpus::EmitPCD(FIBITMAP *dib, int option, std::vector<BYTE> &out)
+{
+  const unsigned width = 768, height = 512;
+  if (FreeImage_GetWidth(dib) != width || FreeImage_GetHeight(dib) != height || FreeImage_GetBPP(dib) != 24) {
+    return false;
+  }
+  // the base image follows 192 KB of header and smaller images
+  out.assign(0x30000, 0);
+  // rows run top-down
+  out[72] = 8;
+
+  std::vector<BYTE> ycc(width * 3);
+  for (unsigned y = 0; y < height; y += 2) {
+    BYTE *luma[2] = { &ycc[0], &ycc[width] };
+    BYTE *chroma = &ycc[2 * width];
+    int cb[width / 2] = { 0 }, cr[width / 2] = { 0 };
+    for (unsigned i = 0; i < 2; ++i) {
+      const BYTE *p = Row(dib, y + i);
+      for (unsigned x = 0; x < width; ++x, p += 3) {
+        const int r = p[FI_RGBA_RED], g = p[FI_RGBA_GREEN], b = p[FI_RGBA_BLUE];
+        const int l = (r * 77 + g * 150 + b * 29) >> 8;
+        // inverse of the plugin's YUV2RGB, roughly
+        luma[i][x] = (BYTE)(l * 182 >> 8);
+        cb[x / 2] += b - l;
+        cr[x / 2] += r - l;
+      }
+    }
+    for (unsigned x = 0; x < width / 2; ++x) {
+      chroma[x] = (BYTE)std::max(0, std::min(255, 156 + cb[x] * 126 / 1024));
+      chroma[width / 2 + x] = (BYTE)std::max(0, std::min(255, 137 + cr[x] * 194 / 1024));
+    }
+    out.insert(out.end(), ycc.begin(), ycc.end());
+  }
+  return true;
+}
+
+bool Corpus::EmitPCX(FIBITMAP *dib, int option, std::vector<BYTE> &out)
+{
+  const unsigned width = FreeImage_GetWidth(dib), height = FreeImage_GetHeight(dib);
+  const unsigned bpp = FreeImage_GetBPP(dib);
+  if (FreeImage_GetImageType(dib) != FIT_BITMAP || (bpp != 1 && bpp != 8 && bpp != 24) ||
+      width > 0xFFFF || height > 0xFFFF) {
+    return false;
+  }
+  const unsigned planes = bpp == 24 ? 3 : 1;
+  const unsigned planeBpp = bpp == 1 ? 1 : 8;
+  const unsigned bytesPerLine = (((width * planeBpp + 7) / 8) + 1) & ~1u;
+
+  Writer w(out);
+  w.u8(0x0A);
+  w.u8(5);
+  w.u8(1);
+  w.u8(planeBpp);
+  w.le16(0);
+  w.le16(0);
+  w.le16(width - 1);
+  w.le16(height - 1);
+  w.le16(72);
+  w.le16(72);
+  w.zero(48 + 1);
+  w.u8(planes);
+  w.le16(bytesPerLine);
+  w.le16(1);
+  w.zero(2 + 2 + 54);
+
+  std::vector<BYTE> plane(bytesPerLine);
+  for (unsigned y = 0; y < height; ++y) {
+    const BYTE *bits = Row(dib, y);
+    for (unsigned p = 0; p < planes; ++p) {
+      if (planes == 3) {
+        for (unsigned x = 0; x < width; ++x) {
+          plane[x] = bits[x * 3 + channelOffset[p]];
+        }
+      }
+      else {
+        memcpy(&plane[0], bits, FreeImage_GetLine(dib));
+      }
+      PcxRle(&plane[0], bytesPerLine, w);
+    }
+  }
+
+  if (bpp == 8) {
+    const RGBQUAD *pal = FreeImage_GetPalette(dib);
+    w.u8(0x0C);
+    for (unsigned i = 0; i < 256; ++i) {
+      w.u8(pal[i].rgbRed);
+      w.u8(pal[i].rgbGreen);
+      w.u8(pal[i].rgbBlue);
+    }
+  }
+  return true;
+}
+
+bool Corpus::EmitPSD(FIBITMAP *dib, int option, std::vector<BYTE> &out)
+{
+  const unsigned width = FreeImage_GetWidth(dib), height = FreeImage_GetHeight(dib);
+  unsigned channels, depth;
+  switch (FreeImage_GetImageType(dib)) {
+  case FIT_BITMAP:
+    if (FreeImage_GetBPP(dib) == 8 && FreeImage_GetColorType(dib) == FIC_MINISBLACK) {
+      channels = 1;
+    }
+    else if (FreeImage_GetBPP(dib) == 24 || FreeImage_GetBPP(dib) == 32) {
+      channels = FreeImage_GetBPP(dib) / 8;
+    }
+    else {
+      return false;
+    }
+    depth = 8;
+    break;
+  case FIT_RGB16:
+    channels = 3;
+    depth = 16;
+    break;
+  case FIT_RGBA16:
+    channels = 4;
+    depth = 16;
+    break;
+  default:
+    return false;
+  }
+  const bool rle = option == 1 && depth == 8;
+
+  Writer w(out);
+  w.text("8BPS");
+  w.be16(1);
+  w.zero(6);
+  w.be16(channels);
+  w.be32(height);
+  w.be32(width);
+  w.be16(depth);
+  w.be16(channels == 1 ? 1 : 3);
+  // no color mode data, image resources or layers
+  w.be32(0);
+  w.be32(0);
+  w.be32(0);
+  w.be16(rle ? 1 : 0);
+
+  const size_t counts = w.pos();
+  if (rle) {
+    w.zero(channels * height * 2);
+  }
+
+  const unsigned step = FreeImage_GetBPP(dib) / depth;
+  std::vector<BYTE> line(width * depth / 8);
+  for (unsigned c = 0; c < channels; ++c) {
+    for (unsigned y = 0; y < height; ++y) {
+      const BYTE *bits = Row(dib, y);
+      if (depth == 16) {
+        const WORD *words = (const WORD*)bits;
+        for (unsigned x = 0; x < width; ++x) {
+          const WORD v = words[x * step + c];
+          line[x * 2] = (BYTE)(v >> 8);
+          line[x * 2 + 1] = (BYTE)v;
+        }
+      }
+      else {
+        const unsigned offset = channels == 1 ? 0 : channelOffset[c];
+        for (unsigned x = 0; x < width; ++x) {
+          line[x] = bits[x * step + offset];
+        }
+      }
+      if (rle) {
+        const size_t start = w.pos();
+        PackBits(&line[0], width, w);
+        w.patchBE16(counts + (c * height + y) * 2, (unsigned)(w.pos() - start));
+      }
+      else {
+        w.bytes(&line[0], line.size());
+      }
+    }
+  }
+  return true;
+}
+
+bool Corpus::EmitXBM(FIBITMAP *dib, int option, std::vector<BYTE> &out)
+{
+  if (FreeImage_GetImageType(dib) != FIT_BITMAP || FreeImage_GetBPP(dib) != 1) {
+    return false;
+  }
+  const unsigned width = FreeImage_GetWidth(dib), height = FreeImage_GetHeight(dib);
+  const unsigned line = (width + 7) / 8;
+
+  Writer w(out);
+  char buf[128];
+  sprintf(buf, "#define fpbench_width %u\n#define fpbench_height %u\n", width, height);
+  w.text(buf);
+  w.text("static char fpbench_bits[] = {\n");
+  unsigned column = 0;
+  for (unsigned y = 0; y < height; ++y) {
+    const BYTE *bits = Row(dib, y);
+    for (unsigned x = 0; x < line; ++x) {
+      // set bits are black, and the leftmost pixel is the lowest bit
+      unsigned v = (BYTE)~bits[x], r = 0;
+      for (unsigned b = 0; b < 8; ++b) {
+        r |= ((v >> b) & 1) << (7 - b);
+      }
+      const bool last = y + 1 == height && x + 1 == line;
+      sprintf(buf, "0x%02x%s", r, last ? "};\n" : ++column % 12 ? ", " : ",\n");
+      w.text(buf);
+    }
+  }
+  return true;
+}
+
+bool Corpus::EmitDDS(FIBITMAP *dib, int option, std::vector<BYTE> &out)
+{
+  const unsigned width = FreeImage_GetWidth(dib), height = FreeImage_GetHeight(dib);
+  const unsigned bpp = FreeImage_GetBPP(dib);
+  if (FreeImage_GetImageType(dib) != FIT_BITMAP || (bpp != 24 && bpp != 32)) {
+    return false;
+  }
+  unsigned fourCC;
+  switch (option) {
+  case 0:
+    fourCC = 0;
+    break;
+  case 1:
+    fourCC = FourCC('D', 'X', 'T', '1');
+    break;
+  case 2:
+    fourCC = FourCC('D', 'X', 'T', '3');
+    break;
+  case 3:
+    fourCC = FourCC('D', 'X', 'T', '5');
+    break;
+  case 4:
+    fourCC = FourCC('A', 'T', 'I', '1');
+    break;
+  case 5:
+    fourCC = FourCC('A', 'T', 'I', '2');
+    break;
+  case 7:
+    // BC7 only has a DXGI format, in the DX10 extended header
+    fourCC = FourCC('D', 'X', '1', '0');
+    break;
+  default:
+    return false;
+  }
+  const unsigned blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+  const unsigned blockBytes = option == 1 || option == 4 ? 8 : 16;
+
+  Writer w(out);
+  w.text("DDS ");
+  w.le32(124);
+  // caps, height, width, pixel format and either pitch or linear size
+  w.le32(0x1007 | (fourCC ? 0x80000 : 0x8));
+  w.le32(height);
+  w.le32(width);
+  w.le32(fourCC ? blocksX * blocksY * blockBytes : FreeImage_GetLine(dib));
+  w.le32(0);
+  w.le32(0);
+  w.zero(11 * 4);
+  // pixel format
+  w.le32(32);
+  if (fourCC) {
+    w.le32(0x4);
+    w.le32(fourCC);
+    w.zero(5 * 4);
+  }
+  else {
+    w.le32(bpp == 32 ? 0x41 : 0x40);
+    w.le32(0);
+    w.le32(bpp);
+    w.le32(0xFF0000);
+    w.le32(0xFF00);
+    w.le32(0xFF);
+    w.le32(bpp == 32 ? 0xFF000000 : 0);
+  }
+  // caps: texture
+  w.le32(0x1000);
+  w.zero(3 * 4);
+  w.le32(0);
+  if (option == 7) {
+    // DXGI_FORMAT_BC7_UNORM, a 2D texture, one array element
+    w.le32(98);
+    w.le32(3);
+    w.le32(0);
+    w.le32(1);
+    w.le32(0);
+  }
+
+  if (!fourCC) {
+    for (unsigned y = 0; y < height; ++y) {
+      w.bytes(Row(dib, y), FreeImage_GetLine(dib));
+    }
+    return true;
+  }
+
+  BYTE px[16][4];
+  for (unsigned by = 0; by < blocksY; ++by) {
+    for (unsigned bx = 0; bx < blocksX; ++bx) {
+      GetBlock(dib, bx, by, px);
+      switch (option) {
+      case 2:
+        ExplicitAlphaBlock(px, w);
+        ColorBlock(px, w);
+        break;
+      case 3:
+        ValueBlock(px, 3, w);
+        ColorBlock(px, w);
+        break;
+      case 4:
+        ValueBlock(px, 0, w);
+        break;
+      case 5:
+        ValueBlock(px, 0, w);
+        ValueBlock(px, 1, w);
+        break;
+      case 7:
+        Bc7Block(px, w);
+        break;
+      default:
+        ColorBlock(px, w);
+        break;
+      }
+    }
+  }
+  return true;
+}
+
+bool Corpus::EmitSGI(FIBITMAP *dib, int option, std::vector<BYTE> &out)
+{
+  const unsigned width = FreeImage_GetWidth(dib), height = FreeImage_GetHeight(dib);
+  const unsigned bpp = FreeImage_GetBPP(dib);
+  if (FreeImage_GetImageType(dib) != FIT_BITMAP || (bpp != 8 && bpp != 24 && bpp != 32) ||
+      width > 0xFFFF || height > 0xFFFF) {
+    return false;
+  }
+  const unsigned zsize = bpp / 8;
+  const bool rle = option == 1;
+
+  Writer w(out);
+  w.be16(474);
+  w.u8(rle ? 1 : 0);
+  w.u8(1);
+  w.be16(zsize == 1 ? 2 : 3);
+  w.be16(width);
+  w.be16(height);
+  w.be16(zsize);
+  w.be32(0);
+  w.be32(255);
+  w.zero(4 + 80);
+  w.be32(0);
+  w.zero(404);
+
+  const size_t table = w.pos();
+  if (rle) {
+    w.zero(height * zsize * 4 * 2);
+  }
+
+  // rows run bottom-up, one channel after the other
+  std::vector<BYTE> line(width);
+  for (unsigned z = 0; z < zsize; ++z) {
+    const unsigned offset = zsize == 1 ? 0 : channelOffset[z];
+    for (unsigned y = 0; y < height; ++y) {
+      const BYTE *bits = FreeImage_GetScanLine(dib, y);
+      for (unsigned x = 0; x < width; ++x) {
+        line[x] = bits[x * zsize + offset];
+      }
+      if (rle) {
+        const size_t start = w.pos();
+        SgiRle(&line[0], width, w);
+        const size_t index = z * height + y;
+        w.patchBE32(table + index * 4, (unsigned)start);
+        w.patchBE32(table + (height * zsize + index) * 4, (unsigned)(w.pos() - start));
+      }
+      else {
+        w.bytes(&line[0], width);
+      }
+    }
+  }
+  return true;
+}
+
+const std::vector<Corpus::Variant>& Corpus::GetVariants()
+{
+  return variants;
+}
+
+bool Corpus::Encode(const Variant &variant, unsigned width, unsigned height, std::vector<BYTE> &out)
+{
+  if (variant.fixedWidth) {
+    width = variant.fixedWidth;
+    height = variant.fixedHeight;
+  }
+  FIBITMAP *dib = MakeImage(variant.type, variant.bpp, width, height, variant.palette);
+  if (!dib) {
+    return false;
+  }
+  const bool rv = Encode(dib, FreeImage_GetFIFFromFormat(variant.format), variant.option, variant.emit, out);
+  FreeImage_Unload(dib);
+  return rv;
+}
+
+bool Corpus::Encode(FIBITMAP *dib, FREE_IMAGE_FORMAT fif, int option, Emitter emit, std::vector<BYTE> &out)
+{
+  out.clear();
+  if (emit) {
+    return emit(dib, option, out) && !out.empty();
+  }
+
+  FIMEMORY *mem = FreeImage_OpenMemory();
+  if (!mem) {
+    return false;
+  }
+  BYTE *data = nullptr;
+  DWORD size = 0;
+  const bool rv = FreeImage_SaveToMemory(fif, dib, mem, option) &&
+                  FreeImage_AcquireMemory(mem, &data, &size) && size;
+  if (rv) {
+    out.assign(data, data + size);
+  }
+  FreeImage_CloseMemory(mem);
+  return rv;
+}
+
+FreeImageIO* Corpus::GetIO()
+{
+  static FreeImageIO io = { ReadProc, WriteProc, SeekProc, TellProc };
+  return &io;
+}
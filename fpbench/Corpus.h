@@ -0,0 +1,102 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "FreeImage.h"
+
+/**
+ * The synthetic corpus the benchmarks decode.
+ *
+ * Images are generated rather than shipped, so that any size can be asked
+ * for and the results compare between machines. The content is computed
+ * with integer arithmetic only, so the same arguments give the same pixels
+ * everywhere. Formats FreeImage has a writer for are encoded by FreeImage,
+ * the others are emitted here byte by byte.
+ */
+namespace Corpus
+{
+  /**
+   * Creates an image of smooth gradients, flat areas with sharp edges and a
+   * little noise, much like a mix of a photo and a screenshot, so codecs
+   * neither compress it to nothing nor fall back to storing it.
+   * @param type FIT_BITMAP, FIT_UINT16, FIT_RGB16, FIT_RGBA16, FIT_FLOAT,
+   * FIT_RGBF or FIT_RGBAF
+   * @param bpp Bit depth of FIT_BITMAP images: 1, 4, 8, 16 (565), 24 or 32
+   * @param palette Quantize an 8-bit image to a color palette instead of
+   * making it greyscale
+   * @return The image, or nullptr for an unsupported combination
+   */
+  FIBITMAP* MakeImage(FREE_IMAGE_TYPE type, unsigned bpp, unsigned width, unsigned height, bool palette = false);
+
+  /// Writes an image in a format FreeImage cannot save itself
+  typedef bool (*Emitter)(FIBITMAP *dib, int option, std::vector<BYTE> &out);
+
+  /// RLE4 compressed BMP of a 4-bit image, which FreeImage only reads
+  bool EmitBMP(FIBITMAP *dib, int option, std::vector<BYTE> &out);
+  /// Kodak PhotoCD base image; dib must be 768x512 and 24-bit
+  bool EmitPCD(FIBITMAP *dib, int option, std::vector<BYTE> &out);
+  /// RLE compressed PCX of a 1, 8 or 24-bit image
+  bool EmitPCX(FIBITMAP *dib, int option, std::vector<BYTE> &out);
+  /// Photoshop image of a greyscale, 24, 32-bit, RGB16 or RGBA16 image; option 1 is PackBits
+  bool EmitPSD(FIBITMAP *dib, int option, std::vector<BYTE> &out);
+  /// X11 bitmap of a 1-bit image
+  bool EmitXBM(FIBITMAP *dib, int option, std::vector<BYTE> &out);
+  /**
+   * DirectDraw surface of a 24 or 32-bit image; option is the block
+   * compression: 0 for none, 1 to 5 for BC1 (DXT1) to BC5, 7 for BC7
+   */
+  bool EmitDDS(FIBITMAP *dib, int option, std::vector<BYTE> &out);
+  /// SGI image of a greyscale, 24 or 32-bit image; option 1 is RLE
+  bool EmitSGI(FIBITMAP *dib, int option, std::vector<BYTE> &out);
+
+  /// One kind of file in the corpus
+  struct Variant
+  {
+    /// Name of the case, e.g. "png-rgba16"
+    const char *name;
+    /// Name of the plugin, as the FIF_ constants do not match the plugins enabled here
+    const char *format;
+    /// Image to generate, see MakeImage
+    FREE_IMAGE_TYPE type;
+    unsigned bpp;
+    bool palette;
+    /// Save flags for FreeImage, or the option of the emitter
+    int option;
+    /// Writes the file, nullptr for FreeImage_SaveToMemory
+    Emitter emit;
+    /// Size the format is limited to, 0 for any
+    unsigned fixedWidth;
+    unsigned fixedHeight;
+  };
+
+  /// The variants, covering every plugin enabled in Plugin.cpp
+  const std::vector<Variant>& GetVariants();
+
+  /**
+   * Generates and encodes a variant.
+   * @param width Size to generate, unless the variant has a fixed one
+   */
+  bool Encode(const Variant &variant, unsigned width, unsigned height, std::vector<BYTE> &out);
+
+  /// Encodes an image, with FreeImage or an emitter
+  bool Encode(FIBITMAP *dib, FREE_IMAGE_FORMAT fif, int option, Emitter emit, std::vector<BYTE> &out);
+
+  /**
+   * A read-only stream over a corpus file, handed to FreeImage as fi_handle
+   * along with GetIO()
+   */
+  struct Stream
+  {
+    const BYTE *data;
+    size_t size;
+    size_t pos;
+
+    explicit Stream(const std::vector<BYTE> &file)
+      : data(file.empty() ? nullptr : &file[0]), size(file.size()), pos(0)
+    {}
+  };
+
+  /// The callbacks reading a Stream
+  FreeImageIO* GetIO();
+}
@@ -0,0 +1,111 @@
+#include <string>
+
+#include "Corpus.h"
+#include "Suites.h"
+
+namespace {
+  struct Compression
+  {
+    const char *name;
+    /// Option of Corpus::EmitDDS
+    int option;
+  };
+
+  const Compression compressions[] = {
+    { "bc1", 1 },
+    { "bc2", 2 },
+    { "bc3", 3 },
+    { "bc4", 4 },
+    { "bc5", 5 },
+    { "bc7", 7 },
+  };
+
+  /// Textures are square powers of two
+  const unsigned textureSizes[] = { 4096, 8192 };
+  const unsigned quickSizes[] = { 1024, 2048 };
+
+  /// Size of the DDS header of a BC7 file, up to the blocks
+  const size_t bc7Header = 4 + 124 + 20;
+
+  /**
+   * Replaces the blocks of a BC7 file by ones using every mode in equal
+   * shares, the other bits random. Encoders mix the modes, but ours only
+   * uses mode 6; the cost of decoding differs a lot between modes.
+   */
+  void MixBc7Modes(std::vector<BYTE> &file)
+  {
+    unsigned state = 0x2545F491u;
+    for (size_t pos = bc7Header, i = 0; pos + 16 <= file.size(); pos += 16, ++i) {
+      for (size_t b = 0; b < 16; ++b) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        file[pos + b] = (BYTE)(state >> 24);
+      }
+      const unsigned mode = (unsigned)(i % 8);
+      file[pos] = (BYTE)((file[pos] << (mode + 1)) | (1 << mode));
+    }
+  }
+
+  FIBITMAP* LoadFile(FREE_IMAGE_FORMAT fif, const std::vector<BYTE> &file)
+  {
+    Corpus::Stream stream(file);
+    return FreeImage_LoadFromHandle(fif, Corpus::GetIO(), (fi_handle)&stream, 0);
+  }
+
+  void RunLoad(Bench &bench, Bench::Case &c, FREE_IMAGE_FORMAT fif, const std::vector<BYTE> &file, bool encoded)
+  {
+    c.fileBytes = file.size();
+    bench.Run(c, [&] {
+      FIBITMAP *dib = encoded ? LoadFile(fif, file) : nullptr;
+      const bool ok = dib && FreeImage_GetWidth(dib) == c.width && FreeImage_GetHeight(dib) == c.height;
+      FreeImage_Unload(dib);
+      return ok;
+    });
+  }
+}
+
+void Suites::Dds(Bench &bench, const Settings &settings)
+{
+  const FREE_IMAGE_FORMAT fif = FreeImage_GetFIFFromFormat("DDS");
+  const unsigned *sizes = settings.quick ? quickSizes : textureSizes;
+  std::vector<BYTE> file;
+  for (unsigned s = 0; s < 2; ++s) {
+    const unsigned size = sizes[s];
+    FIBITMAP *src = nullptr;
+    for (const auto &compression : compressions) {
+      if (!bench.WantsGroup("dds", compression.name)) {
+        continue;
+      }
+      if (!src) {
+        src = Corpus::MakeImage(FIT_BITMAP, 32, size, size);
+      }
+      const bool encoded = src && Corpus::Encode(src, fif, compression.option, Corpus::EmitDDS, file);
+
+      // decoded to 32-bit, whatever the compression
+      Bench::Case c("dds", compression.name);
+      c.format = "DDS";
+      c.width = size;
+      c.height = size;
+      c.bpp = 32;
+      c.bytes = (unsigned long long)size * size * 4;
+      if (bench.Wants(c.suite, c.name)) {
+        RunLoad(bench, c, fif, file, encoded);
+      }
+
+      if (compression.option == 7) {
+        Bench::Case m("dds", "bc7-modes");
+        m.format = "DDS";
+        m.width = size;
+        m.height = size;
+        m.bpp = 32;
+        m.bytes = c.bytes;
+        if (bench.Wants(m.suite, m.name)) {
+          MixBc7Modes(file);
+          RunLoad(bench, m, fif, file, encoded);
+        }
+      }
+    }
+    FreeImage_Unload(src);
+  }
+}
@@ -0,0 +1,352 @@
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "Corpus.h"
+#include "Suites.h"
+
+namespace {
+  /// GIF codes are 12 bits at most
+  const int maxCode = 4096;
+
+  /**
+   * The LZW decoder of PluginGIF before it was made table driven: a
+   * std::string per code, every new one a copy of its prefix plus a byte,
+   * and a code that does not fit the output pushed back into the bit buffer
+   */
+  class OldDecoder
+  {
+  public:
+    explicit OldDecoder(int minCodeSize)
+      : done_(false), minCodeSize_(minCodeSize), partial_(0), partialSize_(0), bufferSize_(0), bufferPos_(0)
+    {
+      clearCode_ = 1 << minCodeSize_;
+      if (clearCode_ > maxCode) {
+        clearCode_ = maxCode;
+      }
+      endCode_ = clearCode_ + 1;
+      Clear();
+    }
+
+    BYTE* FillInputBuffer(int len)
+    {
+      buffer_.resize(len);
+      bufferSize_ = len;
+      bufferPos_ = 0;
+      return &buffer_[0];
+    }
+
+    bool Decompress(BYTE *buf, int *len)
+    {
+      if (bufferSize_ == 0 || done_) {
+        return false;
+      }
+
+      BYTE *bufpos = buf;
+      for (; bufferPos_ < bufferSize_; bufferPos_++) {
+        partial_ |= (int)buffer_[bufferPos_] << partialSize_;
+        partialSize_ += 8;
+        while (partialSize_ >= codeSize_) {
+          const int code = partial_ & codeMask_;
+          partial_ >>= codeSize_;
+          partialSize_ -= codeSize_;
+
+          if (code > nextCode_ || code == endCode_) {
+            done_ = true;
+            *len = (int)(bufpos - buf);
+            return true;
+          }
+          if (code == clearCode_) {
+            Clear();
+            continue;
+          }
+
+          if (oldCode_ != maxCode && nextCode_ < maxCode) {
+            strings_[nextCode_] = strings_[oldCode_] + strings_[code == nextCode_ ? oldCode_ : code][0];
+          }
+
+          if ((int)strings_[code].size() > *len - (bufpos - buf)) {
+            partial_ <<= codeSize_;
+            partialSize_ += codeSize_;
+            partial_ |= code;
+            bufferPos_++;
+            *len = (int)(bufpos - buf);
+            return true;
+          }
+
+          memcpy(bufpos, strings_[code].data(), strings_[code].size());
+          bufpos += strings_[code].size();
+
+          if (oldCode_ != maxCode && nextCode_ < maxCode) {
+            if (++nextCode_ < maxCode) {
+              if ((nextCode_ & codeMask_) == 0) {
+                codeSize_++;
+                codeMask_ |= nextCode_;
+              }
+            }
+          }
+
+          oldCode_ = code;
+        }
+      }
+
+      bufferSize_ = 0;
+      *len = (int)(bufpos - buf);
+      return true;
+    }
+
+    void Done()
+    {
+      done_ = true;
+    }
+
+  private:
+    bool done_;
+    int minCodeSize_, clearCode_, endCode_, nextCode_;
+    int codeSize_, codeMask_, oldCode_;
+    int partial_, partialSize_;
+    std::string strings_[maxCode];
+    std::vector<BYTE> buffer_;
+    int bufferSize_, bufferPos_;
+
+    void Clear()
+    {
+      for (int i = 0; i < clearCode_; i++) {
+        strings_[i].resize(1);
+        strings_[i][0] = (char)i;
+      }
+      nextCode_ = endCode_ + 1;
+      codeSize_ = minCodeSize_ + 1;
+      codeMask_ = (1 << codeSize_) - 1;
+      oldCode_ = maxCode;
+    }
+  };
+
+  const int interlaceOffset[4] = { 0, 4, 2, 1 };
+  const int interlaceIncrement[4] = { 8, 8, 4, 2 };
+
+  /// Skips sub-blocks up to and including the terminator
+  void SkipBlocks(FreeImageIO *io, fi_handle handle)
+  {
+    BYTE b = 0;
+    while (io->read_proc(&b, 1, 1, handle) == 1 && b) {
+      io->seek_proc(handle, b, SEEK_CUR);
+    }
+  }
+
+  /**
+   * Loads the first image of a GIF the way PluginGIF did with the old
+   * decoder: through a 4 KB buffer, every pixel packed into its line one by one
+   */
+  FIBITMAP* LoadOld(FreeImageIO *io, fi_handle handle)
+  {
+    BYTE header[13];
+    if (io->read_proc(header, sizeof(header), 1, handle) != 1) {
+      return nullptr;
+    }
+    if (header[10] & 0x80) {
+      io->seek_proc(handle, 3 * (2 << (header[10] & 0x07)), SEEK_CUR);
+    }
+
+    BYTE b = 0;
+    while (io->read_proc(&b, 1, 1, handle) == 1 && b == 0x21) {
+      io->read_proc(&b, 1, 1, handle);
+      SkipBlocks(io, handle);
+    }
+    BYTE descriptor[9];
+    if (b != 0x2C || io->read_proc(descriptor, sizeof(descriptor), 1, handle) != 1) {
+      return nullptr;
+    }
+    const int width = descriptor[4] | descriptor[5] << 8;
+    const int height = descriptor[6] | descriptor[7] << 8;
+    const BYTE packed = descriptor[8];
+    const bool interlaced = (packed & 0x40) != 0;
+    int bpp = 1;
+    if (packed & 0x80) {
+      const int colors = 2 << (packed & 0x07);
+      bpp = colors > 16 ? 8 : colors > 2 ? 4 : 1;
+    }
+
+    FIBITMAP *dib = FreeImage_Allocate(width, height, bpp);
+    if (!dib) {
+      return nullptr;
+    }
+    if (packed & 0x80) {
+      RGBQUAD *pal = FreeImage_GetPalette(dib);
+      for (int i = 0; i < (2 << (packed & 0x07)); i++) {
+        io->read_proc(&pal[i].rgbRed, 1, 1, handle);
+        io->read_proc(&pal[i].rgbGreen, 1, 1, handle);
+        io->read_proc(&pal[i].rgbBlue, 1, 1, handle);
+      }
+    }
+
+    io->read_proc(&b, 1, 1, handle);
+    OldDecoder decoder(b);
+
+    int x = 0, xpos = 0, y = 0, shift = 8 - bpp, mask = (1 << bpp) - 1, interlacepass = 0;
+    BYTE *scanline = FreeImage_GetScanLine(dib, height - 1);
+    BYTE buf[4096];
+    io->read_proc(&b, 1, 1, handle);
+    while (b) {
+      io->read_proc(decoder.FillInputBuffer(b), b, 1, handle);
+      int size = sizeof(buf);
+      while (decoder.Decompress(buf, &size)) {
+        for (int i = 0; i < size; i++) {
+          scanline[xpos] |= (buf[i] & mask) << shift;
+          if (shift > 0) {
+            shift -= bpp;
+          }
+          else {
+            xpos++;
+            shift = 8 - bpp;
+          }
+          if (++x >= width) {
+            if (interlaced) {
+              y += interlaceIncrement[interlacepass];
+              if (y >= height && ++interlacepass < 4) {
+                y = interlaceOffset[interlacepass];
+              }
+            }
+            else {
+              y++;
+            }
+            if (y >= height) {
+              decoder.Done();
+              break;
+            }
+            x = xpos = 0;
+            shift = 8 - bpp;
+            scanline = FreeImage_GetScanLine(dib, height - y - 1);
+          }
+        }
+        size = sizeof(buf);
+      }
+      io->read_proc(&b, 1, 1, handle);
+    }
+    return dib;
+  }
+
+  struct GifCase
+  {
+    const char *name;
+    unsigned bpp;
+    bool interlaced;
+  };
+
+  const GifCase gifCases[] = {
+    { "random8", 8, false },
+    { "random8-interlaced", 8, true },
+    { "random4", 4, false },
+    { "random4-interlaced", 4, true },
+  };
+
+  const unsigned gifSize = 4096;
+  const unsigned quickSize = 1024;
+
+  /**
+   * Creates an image of noise, which LZW cannot compress: the string table
+   * fills up with short strings and is cleared over and over, the worst case
+   * for a decoder
+   */
+  FIBITMAP* MakeNoise(unsigned bpp, unsigned size, bool interlaced)
+  {
+    FIBITMAP *dib = FreeImage_Allocate(size, size, bpp);
+    if (!dib) {
+      return nullptr;
+    }
+    unsigned state = 0x2545F491u;
+    for (unsigned y = 0; y < size; ++y) {
+      BYTE *line = FreeImage_GetScanLine(dib, y);
+      for (unsigned x = 0; x < FreeImage_GetLine(dib); ++x) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        line[x] = (BYTE)(state >> 24);
+      }
+    }
+    RGBQUAD *pal = FreeImage_GetPalette(dib);
+    for (unsigned i = 0; i < FreeImage_GetColorsUsed(dib); ++i) {
+      pal[i].rgbRed = (BYTE)(i * 37);
+      pal[i].rgbGreen = (BYTE)(i * 101);
+      pal[i].rgbBlue = (BYTE)(i * 181);
+    }
+    if (interlaced) {
+      // PluginGIF writes the lines interlaced when the tag says so
+      FITAG *tag = FreeImage_CreateTag();
+      const BYTE one = 1;
+      FreeImage_SetTagKey(tag, "Interlaced");
+      FreeImage_SetTagType(tag, FIDT_BYTE);
+      FreeImage_SetTagCount(tag, 1);
+      FreeImage_SetTagLength(tag, 1);
+      FreeImage_SetTagValue(tag, &one);
+      FreeImage_SetMetadata(FIMD_ANIMATION, dib, "Interlaced", tag);
+      FreeImage_DeleteTag(tag);
+    }
+    return dib;
+  }
+
+  bool SamePixels(FIBITMAP *a, FIBITMAP *b)
+  {
+    if (!a || !b || FreeImage_GetBPP(a) != FreeImage_GetBPP(b) ||
+      FreeImage_GetWidth(a) != FreeImage_GetWidth(b) || FreeImage_GetHeight(a) != FreeImage_GetHeight(b)) {
+      return false;
+    }
+    for (unsigned y = 0; y < FreeImage_GetHeight(a); ++y) {
+      if (memcmp(FreeImage_GetScanLine(a, y), FreeImage_GetScanLine(b, y), FreeImage_GetLine(a))) {
+        return false;
+      }
+    }
+    return true;
+  }
+}
+
+void Suites::Gif(Bench &bench, const Settings &settings)
+{
+  const FREE_IMAGE_FORMAT fif = FreeImage_GetFIFFromFormat("GIF");
+  const unsigned size = settings.quick ? quickSize : gifSize;
+  std::vector<BYTE> file;
+  for (const auto &g : gifCases) {
+    if (!bench.WantsGroup("gif", g.name)) {
+      continue;
+    }
+    FIBITMAP *src = MakeNoise(g.bpp, size, g.interlaced);
+    bool encoded = src && Corpus::Encode(src, fif, 0, nullptr, file);
+
+    // both decoders have to give the pixels that were saved
+    if (encoded) {
+      Corpus::Stream stream(file);
+      FIBITMAP *dib = LoadOld(Corpus::GetIO(), (fi_handle)&stream);
+      encoded = SamePixels(dib, src);
+      FreeImage_Unload(dib);
+      stream.pos = 0;
+      dib = FreeImage_LoadFromHandle(fif, Corpus::GetIO(), (fi_handle)&stream, 0);
+      encoded = encoded && SamePixels(dib, src);
+      FreeImage_Unload(dib);
+    }
+    FreeImage_Unload(src);
+
+    // "old" is the std::string decoder, "new" the loader as it is now
+    const char *const decoders[] = { "old", "new" };
+    for (unsigned n = 0; n < 2; ++n) {
+      Bench::Case c("gif", std::string(g.name) + "-" + decoders[n]);
+      c.format = "GIF";
+      c.width = size;
+      c.height = size;
+      c.bpp = g.bpp;
+      c.bytes = (unsigned long long)size * size;
+      c.fileBytes = file.size();
+      bench.Run(c, [&] {
+        if (!encoded) {
+          return false;
+        }
+        Corpus::Stream stream(file);
+        FIBITMAP *dib = n ? FreeImage_LoadFromHandle(fif, Corpus::GetIO(), (fi_handle)&stream, 0)
+          : LoadOld(Corpus::GetIO(), (fi_handle)&stream);
+        const bool ok = dib != nullptr;
+        FreeImage_Unload(dib);
+        return ok;
+      });
+    }
+  }
+}
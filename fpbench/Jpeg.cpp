@@ -0,0 +1,190 @@
+#include <setjmp.h>
+
+#include <string>
+
+#include "Corpus.h"
+#include "Suites.h"
+
+extern "C" {
+#define XMD_H
+#undef FAR
+#include "LibJPEG/jinclude.h"
+#include "LibJPEG/jpeglib.h"
+}
+
+namespace {
+  struct Subsampling
+  {
+    const char *name;
+    int flags;
+  };
+
+  const Subsampling subsamplings[] = {
+    { "420", JPEG_SUBSAMPLING_420 },
+    { "422", JPEG_SUBSAMPLING_422 },
+    { "444", JPEG_SUBSAMPLING_444 },
+  };
+
+  /// Cameras save at about this quality
+  const int cameraQuality = 92;
+
+  enum Stage
+  {
+    /// jpeg_read_coefficients: entropy decoding only
+    COEFFICIENTS,
+    /// JDCT_IFAST and merged upsampling, as FreeImage loads by default
+    FAST,
+    /// JDCT_ISLOW and fancy upsampling, as FreeImage loads with JPEG_ACCURATE
+    ACCURATE
+  };
+
+  struct Stages
+  {
+    const char *name;
+    Stage stage;
+  };
+
+  const Stages stages[] = {
+    { "coefficients", COEFFICIENTS },
+    { "fast", FAST },
+    { "accurate", ACCURATE },
+  };
+
+  /**
+   * Adds sensor-like grain to a 24-bit image. Camera files spend several
+   * bits per pixel on it, which the smooth corpus images would not.
+   */
+  void AddGrain(FIBITMAP *dib)
+  {
+    unsigned state = 0x9E3779B9u;
+    const unsigned width = FreeImage_GetWidth(dib), height = FreeImage_GetHeight(dib);
+    for (unsigned y = 0; y < height; ++y) {
+      BYTE *p = FreeImage_GetScanLine(dib, y);
+      for (unsigned x = 0; x < width * 3; ++x) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        const int v = p[x] + (int)(state >> 27) - 16;
+        p[x] = (BYTE)(v < 0 ? 0 : v > 255 ? 255 : v);
+      }
+    }
+  }
+
+  struct ErrorManager
+  {
+    jpeg_error_mgr pub;
+    jmp_buf jump;
+  };
+
+  void ErrorExit(j_common_ptr cinfo)
+  {
+    longjmp(((ErrorManager*)cinfo->err)->jump, 1);
+  }
+
+  void OutputMessage(j_common_ptr cinfo)
+  {}
+
+  /// Decodes a JPEG with libjpeg alone, up to the stage, into rows of the buffer
+  bool ReadJPEG(const std::vector<BYTE> &file, Stage stage, std::vector<BYTE> &pixels, std::vector<JSAMPROW> &rows)
+  {
+    jpeg_decompress_struct cinfo;
+    ErrorManager err;
+    cinfo.err = jpeg_std_error(&err.pub);
+    err.pub.error_exit = ErrorExit;
+    err.pub.output_message = OutputMessage;
+    if (setjmp(err.jump)) {
+      jpeg_destroy_decompress(&cinfo);
+      return false;
+    }
+
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, (unsigned char*)&file[0], (unsigned long)file.size());
+    jpeg_read_header(&cinfo, TRUE);
+    if (stage == COEFFICIENTS) {
+      jpeg_read_coefficients(&cinfo);
+    }
+    else {
+      cinfo.dct_method = stage == FAST ? JDCT_IFAST : JDCT_ISLOW;
+      cinfo.do_fancy_upsampling = stage == FAST ? FALSE : TRUE;
+      jpeg_start_decompress(&cinfo);
+      const size_t rowBytes = (size_t)cinfo.output_width * cinfo.output_components;
+      if (pixels.size() != rowBytes * cinfo.output_height) {
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+      }
+      rows.resize(cinfo.output_height);
+      for (JDIMENSION y = 0; y < cinfo.output_height; ++y) {
+        rows[y] = &pixels[y * rowBytes];
+      }
+      while (cinfo.output_scanline < cinfo.output_height) {
+        jpeg_read_scanlines(&cinfo, &rows[cinfo.output_scanline], cinfo.output_height - cinfo.output_scanline);
+      }
+    }
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    return true;
+  }
+
+  FIBITMAP* LoadFile(FREE_IMAGE_FORMAT fif, const std::vector<BYTE> &file, int flags)
+  {
+    Corpus::Stream stream(file);
+    return FreeImage_LoadFromHandle(fif, Corpus::GetIO(), (fi_handle)&stream, flags);
+  }
+}
+
+void Suites::Jpeg(Bench &bench, const Settings &settings)
+{
+  const FREE_IMAGE_FORMAT fif = FreeImage_GetFIFFromFormat("JPEG");
+  std::vector<BYTE> file, pixels;
+  std::vector<JSAMPROW> rows;
+  for (const auto &size : settings.sizes) {
+    FIBITMAP *src = nullptr;
+    for (const auto &s : subsamplings) {
+      if (!bench.WantsGroup("jpeg", s.name)) {
+        continue;
+      }
+      if (!src) {
+        src = Corpus::MakeImage(FIT_BITMAP, 24, size.width, size.height);
+        if (src) {
+          AddGrain(src);
+        }
+      }
+      const bool encoded = src && Corpus::Encode(src, fif, cameraQuality | s.flags, nullptr, file);
+      pixels.resize((size_t)size.width * size.height * 3);
+
+      const int loadFlags[] = { JPEG_DEFAULT, JPEG_ACCURATE };
+      const char *const loadNames[] = { "load", "load-accurate" };
+      for (unsigned l = 0; l < 2; ++l) {
+        Bench::Case c("jpeg", std::string(s.name) + "-" + loadNames[l]);
+        c.format = "JPEG";
+        c.width = size.width;
+        c.height = size.height;
+        c.bpp = 24;
+        c.bytes = pixels.size();
+        c.fileBytes = file.size();
+        bench.Run(c, [&] {
+          FIBITMAP *dib = encoded ? LoadFile(fif, file, loadFlags[l]) : nullptr;
+          const bool ok = dib && FreeImage_GetWidth(dib) == size.width && FreeImage_GetHeight(dib) == size.height;
+          FreeImage_Unload(dib);
+          return ok;
+        });
+      }
+
+      // the share of the decode the SIMD routines cannot touch shows in
+      // "coefficients"
+      for (const auto &st : stages) {
+        Bench::Case c("jpeg", std::string(s.name) + "-" + st.name);
+        c.format = "JPEG";
+        c.width = size.width;
+        c.height = size.height;
+        c.bpp = 24;
+        c.bytes = pixels.size();
+        c.fileBytes = file.size();
+        bench.Run(c, [&] {
+          return encoded && ReadJPEG(file, st.stage, pixels, rows);
+        });
+      }
+    }
+    FreeImage_Unload(src);
+  }
+}
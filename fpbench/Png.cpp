@@ -0,0 +1,250 @@
+#include <setjmp.h>
+#include <string.h>
+
+#include <string>
+
+#include "Corpus.h"
+#include "Suites.h"
+
+#undef PNG_Z_DEFAULT_COMPRESSION // already used in LibPNG/pnglibconf.h
+
+#include "LibPNG/png.h"
+#include "ZLib/zlib.h"
+
+namespace {
+  struct PixelType
+  {
+    const char *name;
+    FREE_IMAGE_TYPE type;
+    unsigned bpp;
+    int colorType;
+    int bitDepth;
+  };
+
+  const PixelType pngTypes[] = {
+    { "rgb8", FIT_BITMAP, 24, PNG_COLOR_TYPE_RGB, 8 },
+    { "rgba8", FIT_BITMAP, 32, PNG_COLOR_TYPE_RGB_ALPHA, 8 },
+    { "rgba16", FIT_RGBA16, 64, PNG_COLOR_TYPE_RGB_ALPHA, 16 },
+  };
+
+  struct Filter
+  {
+    const char *name;
+    int mask;
+  };
+
+  // every row uses the same filter, so the cost of each defilter shows
+  // against "none"
+  const Filter filters[] = {
+    { "none", PNG_FILTER_NONE },
+    { "sub", PNG_FILTER_SUB },
+    { "up", PNG_FILTER_UP },
+    { "avg", PNG_FILTER_AVG },
+    { "paeth", PNG_FILTER_PAETH },
+  };
+
+  void PNGAPI WriteData(png_structp png, png_bytep data, png_size_t length)
+  {
+    std::vector<BYTE> *out = (std::vector<BYTE>*)png_get_io_ptr(png);
+    out->insert(out->end(), data, data + length);
+  }
+
+  void PNGAPI Flush(png_structp png)
+  {}
+
+  void PNGAPI ReadData(png_structp png, png_bytep data, png_size_t length)
+  {
+    Corpus::Stream *s = (Corpus::Stream*)png_get_io_ptr(png);
+    if (s->size - s->pos < length) {
+      png_error(png, "Read past the end of the file");
+    }
+    memcpy(data, s->data + s->pos, length);
+    s->pos += length;
+  }
+
+  /**
+   * Writes a PNG with libpng, using one filter for all rows. FreeImage
+   * always lets libpng choose the filter per row.
+   */
+  bool WritePNG(FIBITMAP *dib, const PixelType &t, int filter, std::vector<BYTE> &out)
+  {
+    out.clear();
+    png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+    png_infop info = png ? png_create_info_struct(png) : nullptr;
+    if (!info) {
+      png_destroy_write_struct(&png, nullptr);
+      return false;
+    }
+    if (setjmp(png_jmpbuf(png))) {
+      png_destroy_write_struct(&png, &info);
+      return false;
+    }
+
+    const unsigned width = FreeImage_GetWidth(dib), height = FreeImage_GetHeight(dib);
+    png_set_write_fn(png, &out, WriteData, Flush);
+    png_set_IHDR(png, info, width, height, t.bitDepth, t.colorType,
+      PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
+    png_set_filter(png, PNG_FILTER_TYPE_BASE, filter);
+    png_write_info(png, info);
+#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
+    if (t.bitDepth == 8) {
+      png_set_bgr(png);
+    }
+#endif
+#ifndef FREEIMAGE_BIGENDIAN
+    if (t.bitDepth == 16) {
+      png_set_swap(png);
+    }
+#endif
+    for (unsigned y = 0; y < height; ++y) {
+      png_write_row(png, FreeImage_GetScanLine(dib, height - 1 - y));
+    }
+    png_write_end(png, info);
+    png_destroy_write_struct(&png, &info);
+    return true;
+  }
+
+  /// Decodes a PNG with libpng alone, into rows of the buffer
+  bool ReadPNG(const std::vector<BYTE> &file, std::vector<BYTE> &pixels)
+  {
+    Corpus::Stream stream(file);
+    png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+    png_infop info = png ? png_create_info_struct(png) : nullptr;
+    if (!info) {
+      png_destroy_read_struct(&png, nullptr, nullptr);
+      return false;
+    }
+    if (setjmp(png_jmpbuf(png))) {
+      png_destroy_read_struct(&png, &info, nullptr);
+      return false;
+    }
+
+    png_set_read_fn(png, &stream, ReadData);
+    png_read_info(png, info);
+    const png_uint_32 height = png_get_image_height(png, info);
+    const png_size_t rowBytes = png_get_rowbytes(png, info);
+    if (pixels.size() != rowBytes * height) {
+      png_error(png, "Unexpected image size");
+    }
+    for (png_uint_32 y = 0; y < height; ++y) {
+      png_read_row(png, &pixels[y * rowBytes], nullptr);
+    }
+    png_read_end(png, nullptr);
+    png_destroy_read_struct(&png, &info, nullptr);
+    return true;
+  }
+
+  unsigned ReadBE32(const BYTE *p)
+  {
+    return (unsigned)p[0] << 24 | (unsigned)p[1] << 16 | (unsigned)p[2] << 8 | p[3];
+  }
+
+  /// Collects the zlib stream of the IDAT chunks
+  bool GetIDAT(const std::vector<BYTE> &file, std::vector<BYTE> &idat)
+  {
+    idat.clear();
+    size_t pos = 8;
+    while (pos + 12 <= file.size()) {
+      const size_t length = ReadBE32(&file[pos]);
+      if (length > file.size() - pos - 12) {
+        return false;
+      }
+      if (!memcmp(&file[pos + 4], "IDAT", 4)) {
+        idat.insert(idat.end(), file.begin() + pos + 8, file.begin() + pos + 8 + length);
+      }
+      pos += length + 12;
+    }
+    return !idat.empty();
+  }
+
+  /// Inflates the IDAT stream, which has to fill the buffer exactly
+  bool Inflate(const std::vector<BYTE> &idat, std::vector<BYTE> &raw)
+  {
+    z_stream z;
+    memset(&z, 0, sizeof(z));
+    if (inflateInit(&z) != Z_OK) {
+      return false;
+    }
+    z.next_in = (Bytef*)&idat[0];
+    z.avail_in = (uInt)idat.size();
+    z.next_out = &raw[0];
+    z.avail_out = (uInt)raw.size();
+    const int rv = inflate(&z, Z_FINISH);
+    const bool ok = rv == Z_STREAM_END && z.total_out == raw.size();
+    inflateEnd(&z);
+    return ok;
+  }
+
+  FIBITMAP* LoadFile(FREE_IMAGE_FORMAT fif, const std::vector<BYTE> &file)
+  {
+    Corpus::Stream stream(file);
+    return FreeImage_LoadFromHandle(fif, Corpus::GetIO(), (fi_handle)&stream, 0);
+  }
+}
+
+void Suites::Png(Bench &bench, const Settings &settings)
+{
+  const FREE_IMAGE_FORMAT fif = FreeImage_GetFIFFromFormat("PNG");
+  std::vector<BYTE> file, idat, pixels;
+  for (const auto &size : settings.sizes) {
+    for (const auto &t : pngTypes) {
+      if (!bench.WantsGroup("png", t.name)) {
+        continue;
+      }
+      FIBITMAP *src = Corpus::MakeImage(t.type, t.bpp, size.width, size.height);
+      const size_t rowBytes = (size_t)size.width * t.bpp / 8;
+
+      Bench::Case c("png", std::string(t.name) + "-load");
+      c.format = "PNG";
+      c.width = size.width;
+      c.height = size.height;
+      c.bpp = t.bpp;
+      c.bytes = (unsigned long long)rowBytes * size.height;
+      if (bench.Wants(c.suite, c.name)) {
+        const bool encoded = src && Corpus::Encode(src, fif, 0, nullptr, file);
+        c.fileBytes = file.size();
+        bench.Run(c, [&] {
+          FIBITMAP *dib = encoded ? LoadFile(fif, file) : nullptr;
+          const bool ok = dib && FreeImage_GetWidth(dib) == size.width && FreeImage_GetHeight(dib) == size.height;
+          FreeImage_Unload(dib);
+          return ok;
+        });
+      }
+
+      pixels.resize(rowBytes * size.height);
+      for (const auto &f : filters) {
+        if (!bench.WantsGroup("png", std::string(t.name) + "-" + f.name)) {
+          continue;
+        }
+        const bool encoded = src && WritePNG(src, t, f.mask, file);
+
+        Bench::Case c("png", std::string(t.name) + "-" + f.name);
+        c.format = "PNG";
+        c.width = size.width;
+        c.height = size.height;
+        c.bpp = t.bpp;
+        c.bytes = pixels.size();
+        c.fileBytes = file.size();
+        bench.Run(c, [&] {
+          return encoded && ReadPNG(file, pixels);
+        });
+
+        // the inflate share of the decode above; bytes are the filtered
+        // rows, one filter byte longer than the pixels
+        Bench::Case z("png", std::string(t.name) + "-" + f.name + "-inflate");
+        z.format = "zlib";
+        z.width = size.width;
+        z.height = size.height;
+        z.bpp = t.bpp;
+        z.bytes = (rowBytes + 1) * size.height;
+        std::vector<BYTE> raw(bench.Wants(z.suite, z.name) ? (size_t)z.bytes : 0);
+        const bool found = encoded && GetIDAT(file, idat);
+        z.fileBytes = idat.size();
+        bench.Run(z, [&] {
+          return found && Inflate(idat, raw);
+        });
+      }
+      FreeImage_Unload(src);
+    }
+  }
+}
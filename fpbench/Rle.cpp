@@ -0,0 +1,381 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+
+#include "FreeImageIO.h"
+#include "Corpus.h"
+#include "Suites.h"
+
+namespace {
+  /// One read_proc call per byte, as the SGI and BMP loaders read before the BufferedReader
+  class ReadProcBytes
+  {
+  public:
+    ReadProcBytes(FreeImageIO *io, fi_handle handle) : io_(io), handle_(handle) {}
+
+    int next_byte()
+    {
+      BYTE b;
+      return io_->read_proc(&b, 1, 1, handle_) == 1 ? b : EOF;
+    }
+
+    void seek(long position)
+    {
+      io_->seek_proc(handle_, position, SEEK_SET);
+    }
+
+  private:
+    FreeImageIO *io_;
+    fi_handle handle_;
+  };
+
+  /// A 2 KB window refilled by read_proc, as the PCX loader read before the BufferedReader
+  class WindowBytes
+  {
+  public:
+    WindowBytes(FreeImageIO *io, fi_handle handle) : io_(io), handle_(handle), pos_(0), end_(0) {}
+
+    int next_byte()
+    {
+      if (pos_ == end_) {
+        end_ = io_->read_proc(buffer_, 1, sizeof(buffer_), handle_);
+        pos_ = 0;
+        if (!end_) {
+          return EOF;
+        }
+      }
+      return buffer_[pos_++];
+    }
+
+    void seek(long position)
+    {
+      io_->seek_proc(handle_, position, SEEK_SET);
+      pos_ = end_ = 0;
+    }
+
+  private:
+    FreeImageIO *io_;
+    fi_handle handle_;
+    BYTE buffer_[2048];
+    unsigned pos_;
+    unsigned end_;
+  };
+
+  enum Format
+  {
+    SGI,
+    PCX,
+    BMP_RLE8,
+    BMP_RLE4
+  };
+
+  /// Where the RLE data of a file is and what it decodes to, one byte per sample
+  struct Layout
+  {
+    unsigned width;
+    unsigned height;
+    unsigned channels;
+    /// Start of the data
+    long data;
+    /// PCX: bytes of all planes of a line
+    unsigned lineBytes;
+    /// SGI: start of every row, channel by channel
+    std::vector<long> rows;
+  };
+
+  unsigned LE(const std::vector<BYTE> &file, size_t at, unsigned bytes)
+  {
+    unsigned v = 0;
+    for (unsigned i = bytes; i--;) {
+      v = v << 8 | file[at + i];
+    }
+    return v;
+  }
+
+  unsigned BE(const std::vector<BYTE> &file, size_t at, unsigned bytes)
+  {
+    unsigned v = 0;
+    for (unsigned i = 0; i < bytes; ++i) {
+      v = v << 8 | file[at + i];
+    }
+    return v;
+  }
+
+  Layout GetLayout(Format format, const std::vector<BYTE> &file)
+  {
+    Layout l;
+    switch (format) {
+    case SGI:
+      l.width = BE(file, 6, 2);
+      l.height = BE(file, 8, 2);
+      l.channels = BE(file, 10, 2);
+      l.data = 512;
+      l.lineBytes = 0;
+      for (unsigned i = 0; i < l.height * l.channels; ++i) {
+        l.rows.push_back((long)BE(file, 512 + i * 4, 4));
+      }
+      break;
+    case PCX:
+      l.width = LE(file, 8, 2) - LE(file, 4, 2) + 1;
+      l.height = LE(file, 10, 2) - LE(file, 6, 2) + 1;
+      l.channels = file[65];
+      l.data = 128;
+      l.lineBytes = LE(file, 66, 2) * l.channels;
+      break;
+    default:
+      l.width = LE(file, 18, 4);
+      l.height = LE(file, 22, 4);
+      l.channels = 1;
+      l.data = (long)LE(file, 10, 4);
+      l.lineBytes = 0;
+      break;
+    }
+    return l;
+  }
+
+  /// SGI RLE, every row starting from its offset
+  template <class Bytes> bool DecodeSGI(Bytes &in, const Layout &l, BYTE *out)
+  {
+    for (unsigned c = 0; c < l.channels; ++c) {
+      for (unsigned y = 0; y < l.height; ++y) {
+        in.seek(l.rows[c * l.height + y]);
+        BYTE *p = out + (size_t)y * l.width * l.channels + c;
+        for (unsigned x = 0; x < l.width;) {
+          const int code = in.next_byte();
+          unsigned count = code & 0x7F;
+          if (code == EOF || !count || count > l.width - x) {
+            return false;
+          }
+          if (code & 0x80) {
+            for (x += count; count--; p += l.channels) {
+              const int v = in.next_byte();
+              if (v == EOF) {
+                return false;
+              }
+              *p = (BYTE)v;
+            }
+          }
+          else {
+            const int v = in.next_byte();
+            if (v == EOF) {
+              return false;
+            }
+            for (x += count; count--; p += l.channels) {
+              *p = (BYTE)v;
+            }
+          }
+        }
+      }
+    }
+    return true;
+  }
+
+  /// PCX RLE, planes one after another in every line
+  template <class Bytes> bool DecodePCX(Bytes &in, const Layout &l, BYTE *out)
+  {
+    for (unsigned y = 0; y < l.height; ++y) {
+      BYTE *p = out + (size_t)y * l.lineBytes;
+      for (unsigned x = 0; x < l.lineBytes;) {
+        int v = in.next_byte();
+        unsigned count = 1;
+        if (v != EOF && (v & 0xC0) == 0xC0) {
+          count = v & 0x3F;
+          v = in.next_byte();
+        }
+        if (v == EOF) {
+          return false;
+        }
+        count = count < l.lineBytes - x ? count : l.lineBytes - x;
+        memset(p + x, v, count);
+        x += count;
+      }
+    }
+    return true;
+  }
+
+  /// BMP RLE8 or RLE4 into one byte per pixel, bottom-up
+  template <class Bytes> bool DecodeBMP(Bytes &in, const Layout &l, bool rle4, BYTE *out)
+  {
+    BYTE *q = out;
+    BYTE *const end = out + (size_t)l.width * l.height;
+    unsigned line = 0;
+    while (q < end) {
+      int count = in.next_byte(), v = in.next_byte();
+      if (count == EOF || v == EOF) {
+        return false;
+      }
+      if (count) {
+        count = count < end - q ? count : (int)(end - q);
+        for (int i = 0; i < count; ++i) {
+          *q++ = (BYTE)(!rle4 ? v : i & 1 ? v & 0x0F : v >> 4);
+        }
+        continue;
+      }
+      switch (v) {
+      case 0:
+        q = out + (size_t)++line * l.width;
+        break;
+      case 1:
+        return true;
+      case 2:
+        {
+          const int dx = in.next_byte(), dy = in.next_byte();
+          if (dx == EOF || dy == EOF) {
+            return false;
+          }
+          line += dy;
+          q += dy * l.width + dx;
+        }
+        break;
+      default:
+        {
+          count = v < end - q ? v : (int)(end - q);
+          const int bytes = rle4 ? (v + 1) / 2 : v;
+          int b = 0;
+          for (int i = 0; i < bytes; ++i) {
+            b = in.next_byte();
+            if (b == EOF) {
+              return false;
+            }
+            if (rle4) {
+              if (2 * i < count) {
+                *q++ = (BYTE)(b >> 4);
+              }
+              if (2 * i + 1 < count) {
+                *q++ = (BYTE)(b & 0x0F);
+              }
+            }
+            else if (i < count) {
+              *q++ = (BYTE)b;
+            }
+          }
+          // absolute runs are padded to a word
+          if (bytes & 1) {
+            in.next_byte();
+          }
+        }
+        break;
+      }
+    }
+    return true;
+  }
+
+  template <class Bytes> bool Decode(Format format, Bytes &in, const Layout &l, BYTE *out)
+  {
+    switch (format) {
+    case SGI:
+      return DecodeSGI(in, l, out);
+    case PCX:
+      return DecodePCX(in, l, out);
+    default:
+      return DecodeBMP(in, l, format == BMP_RLE4, out);
+    }
+  }
+
+  struct RleCase
+  {
+    /// Name of the case and of the corpus variant
+    const char *name;
+    Format format;
+  };
+
+  const RleCase rleCases[] = {
+    { "sgi-rgb8-rle", SGI },
+    { "pcx-24", PCX },
+    { "bmp-8rle", BMP_RLE8 },
+    { "bmp-4rle", BMP_RLE4 },
+  };
+
+  const Corpus::Variant* FindVariant(const char *name)
+  {
+    for (const auto &v : Corpus::GetVariants()) {
+      if (!strcmp(v.name, name)) {
+        return &v;
+      }
+    }
+    return nullptr;
+  }
+
+  /// The files are read from disk, as the cost of read_proc is what changed
+  const char tempName[] = "fpbench-rle.tmp";
+}
+
+void Suites::Rle(Bench &bench, const Settings &settings)
+{
+  FreeImageIO io;
+  SetDefaultIO(&io);
+  std::vector<BYTE> file, decoded;
+  for (const auto &size : settings.sizes) {
+    for (const auto &r : rleCases) {
+      const Corpus::Variant *variant = FindVariant(r.name);
+      if (!bench.WantsGroup("rle", r.name) || !variant) {
+        continue;
+      }
+      FILE *fp = nullptr;
+      Layout l = Layout();
+      if (Corpus::Encode(*variant, size.width, size.height, file)) {
+        l = GetLayout(r.format, file);
+        fp = fopen(tempName, "w+b");
+        if (fp && fwrite(&file[0], 1, file.size(), fp) != file.size()) {
+          fclose(fp);
+          fp = nullptr;
+        }
+      }
+      decoded.resize((size_t)l.width * l.height * l.channels);
+      const fi_handle handle = (fi_handle)fp;
+
+      // "old" reads the way the loaders did before the BufferedReader
+      const char *const readers[] = { "old", "new" };
+      for (unsigned n = 0; n < 2; ++n) {
+        Bench::Case c("rle", std::string(r.name) + "-" + readers[n]);
+        c.format = variant->format;
+        c.width = size.width;
+        c.height = size.height;
+        c.bpp = variant->bpp;
+        c.bytes = decoded.size();
+        c.fileBytes = file.size();
+        bench.Run(c, [&]() -> bool {
+          if (!fp) {
+            return false;
+          }
+          io.seek_proc(handle, l.data, SEEK_SET);
+          if (n) {
+            BufferedReader reader(&io, handle);
+            return Decode(r.format, reader, l, &decoded[0]);
+          }
+          if (r.format == PCX) {
+            WindowBytes window(&io, handle);
+            return Decode(r.format, window, l, &decoded[0]);
+          }
+          ReadProcBytes bytes(&io, handle);
+          return Decode(r.format, bytes, l, &decoded[0]);
+        });
+      }
+
+      Bench::Case c("rle", std::string(r.name) + "-load");
+      c.format = variant->format;
+      c.width = size.width;
+      c.height = size.height;
+      c.bpp = variant->bpp;
+      c.bytes = decoded.size();
+      c.fileBytes = file.size();
+      const FREE_IMAGE_FORMAT fif = FreeImage_GetFIFFromFormat(variant->format);
+      bench.Run(c, [&] {
+        if (!fp) {
+          return false;
+        }
+        io.seek_proc(handle, 0, SEEK_SET);
+        FIBITMAP *dib = FreeImage_LoadFromHandle(fif, &io, handle, 0);
+        const bool ok = dib && FreeImage_GetWidth(dib) == l.width && FreeImage_GetHeight(dib) == l.height;
+        FreeImage_Unload(dib);
+        return ok;
+      });
+
+      if (fp) {
+        fclose(fp);
+        remove(tempName);
+      }
+    }
+  }
+}
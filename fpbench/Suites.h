@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vector>
+
+#include "Bench.h"
+
+/**
+ * The benchmark suites. Each generates its own input for the sizes in the
+ * settings and runs its cases through the Bench, which skips the ones not
+ * selected.
+ */
+namespace Suites
+{
+  struct Size
+  {
+    unsigned width;
+    unsigned height;
+  };
+
+  struct Settings
+  {
+    /// Image sizes to run the size dependent cases at
+    std::vector<Size> sizes;
+    /// Run fewer variations of the cases
+    bool quick;
+
+    Settings() : quick(false) {}
+  };
+
+  /// FreeImage_LoadFromHandle of every corpus variant; MB/s of decoded pixels
+  void Load(Bench &bench, const Settings &settings);
+  /// FreeImage_GetFileTypeFromHandle of every corpus variant
+  void Detect(Bench &bench, const Settings &settings);
+  /// FreeImage_Rescale per pixel type and filter; MB/s of source pixels
+  void Rescale(Bench &bench, const Settings &settings);
+  /// Conversions between pixel types and bit depths; MB/s of source pixels
+  void Convert(Bench &bench, const Settings &settings);
+  /**
+   * PNG decoding split up: FreeImage_LoadFromHandle, libpng alone per row
+   * filter, and the zlib inflate share of it; MB/s of decoded pixels.
+   * Building FreeImage with PNG_INTEL_SSE_OPT=0 and NO_INFLATE_FAST_WIDE
+   * gives the generic code to compare against.
+   */
+  void Png(Bench &bench, const Settings &settings);
+  /**
+   * GIF decoding of 8 and 4-bit noise, plain and interlaced, 4096 pixels
+   * square (1024 with quick) whatever the sizes in the settings: the LZW
+   * decoder with a std::string per code as PluginGIF had it ("old") against
+   * FreeImage_LoadFromHandle ("new"); MB/s of decoded pixels, a byte each
+   */
+  void Gif(Bench &bench, const Settings &settings);
+  /**
+   * DDS block decoding, BC1 to BC5 and BC7, of 4096 and 8192 pixel square
+   * textures whatever the sizes in the settings; MB/s of decoded pixels
+   */
+  void Dds(Bench &bench, const Settings &settings);
+  /**
+   * Decoding of camera-like JPEGs, 4:2:0, 4:2:2 and 4:4:4 at quality 92:
+   * FreeImage_LoadFromHandle fast and accurate, and libjpeg alone up to the
+   * coefficients, fast and accurate; MB/s of decoded pixels. Setting
+   * JSIMD_FORCENONE=1 makes libjpeg use its C routines instead of SSE2.
+   */
+  void Jpeg(Bench &bench, const Settings &settings);
+  /**
+   * SGI, PCX and BMP RLE decoding from a file on disk, reading it byte by
+   * byte the way the loaders did before the BufferedReader ("old") and
+   * through it ("new"), next to FreeImage_LoadFromHandle; MB/s of decoded
+   * samples
+   */
+  void Rle(Bench &bench, const Settings &settings);
+  /**
+   * Zooming out: FreeImage_HalveSize per pixel type, next to the same loops
+   * without SSE2 for 8-bit samples ("scalar"); and painting the tiles of a
+   * 1920x1080 view at 50% to 8% the way the viewer does, from the image
+   * ("base"), from the pyramid level ("pyramid") and making that level
+   * first ("first"); MB/s of source pixels, of painted pixels for the view
+   */
+  void Zoom(Bench &bench, const Settings &settings);
+}
@@ -0,0 +1,165 @@
+#include <string>
+
+#include "Corpus.h"
+#include "Suites.h"
+
+namespace {
+  struct PixelType
+  {
+    const char *name;
+    FREE_IMAGE_TYPE type;
+    unsigned bpp;
+    bool palette;
+  };
+
+  const PixelType rescaleTypes[] = {
+    { "grey8", FIT_BITMAP, 8, false },
+    { "rgb8", FIT_BITMAP, 24, false },
+    { "rgba8", FIT_BITMAP, 32, false },
+    { "grey16", FIT_UINT16, 16, false },
+    { "rgb16", FIT_RGB16, 48, false },
+    { "rgba16", FIT_RGBA16, 64, false },
+    { "float", FIT_FLOAT, 32, false },
+    { "rgbf", FIT_RGBF, 96, false },
+    { "rgbaf", FIT_RGBAF, 128, false },
+  };
+
+  struct Filter
+  {
+    const char *name;
+    FREE_IMAGE_FILTER filter;
+  };
+
+  const Filter filters[] = {
+    { "box", FILTER_BOX },
+    { "bilinear", FILTER_BILINEAR },
+    { "bicubic", FILTER_BICUBIC },
+    { "bspline", FILTER_BSPLINE },
+    { "catmullrom", FILTER_CATMULLROM },
+    { "lanczos3", FILTER_LANCZOS3 },
+  };
+
+  struct Scale
+  {
+    const char *name;
+    unsigned num;
+    unsigned den;
+  };
+
+  const Scale scales[] = {
+    { "half", 1, 2 },
+    { "up", 3, 2 },
+  };
+
+  typedef FIBITMAP* (DLL_CALLCONV *Conversion)(FIBITMAP *dib);
+
+  struct ConvertCase
+  {
+    const char *name;
+    PixelType from;
+    Conversion convert;
+  };
+
+  FIBITMAP* DLL_CALLCONV ToStandard(FIBITMAP *dib)
+  {
+    return FreeImage_ConvertToStandardType(dib);
+  }
+
+  FIBITMAP* DLL_CALLCONV Drago(FIBITMAP *dib)
+  {
+    return FreeImage_ToneMapping(dib, FITMO_DRAGO03);
+  }
+
+  FIBITMAP* DLL_CALLCONV Reinhard(FIBITMAP *dib)
+  {
+    return FreeImage_ToneMapping(dib, FITMO_REINHARD05);
+  }
+
+  const ConvertCase conversions[] = {
+    { "1-to-grey8", { "1", FIT_BITMAP, 1, false }, FreeImage_ConvertTo8Bits },
+    { "4-to-rgb8", { "4", FIT_BITMAP, 4, false }, FreeImage_ConvertTo24Bits },
+    { "pal8-to-rgb8", { "pal8", FIT_BITMAP, 8, true }, FreeImage_ConvertTo24Bits },
+    { "pal8-to-rgba8", { "pal8", FIT_BITMAP, 8, true }, FreeImage_ConvertTo32Bits },
+    { "grey8-to-rgba8", { "grey8", FIT_BITMAP, 8, false }, FreeImage_ConvertTo32Bits },
+    { "565-to-rgb8", { "565", FIT_BITMAP, 16, false }, FreeImage_ConvertTo24Bits },
+    { "rgb8-to-565", { "rgb8", FIT_BITMAP, 24, false }, FreeImage_ConvertTo16Bits565 },
+    { "rgb8-to-grey8", { "rgb8", FIT_BITMAP, 24, false }, FreeImage_ConvertToGreyscale },
+    { "rgb8-to-rgba8", { "rgb8", FIT_BITMAP, 24, false }, FreeImage_ConvertTo32Bits },
+    { "rgba8-to-rgb8", { "rgba8", FIT_BITMAP, 32, false }, FreeImage_ConvertTo24Bits },
+    { "rgb8-to-rgb16", { "rgb8", FIT_BITMAP, 24, false }, FreeImage_ConvertToRGB16 },
+    { "rgb8-to-rgbf", { "rgb8", FIT_BITMAP, 24, false }, FreeImage_ConvertToRGBF },
+    { "rgb8-to-float", { "rgb8", FIT_BITMAP, 24, false }, FreeImage_ConvertToFloat },
+    { "grey16-to-grey8", { "grey16", FIT_UINT16, 16, false }, ToStandard },
+    { "rgb16-to-rgb8", { "rgb16", FIT_RGB16, 48, false }, FreeImage_ConvertTo24Bits },
+    { "rgba16-to-rgba8", { "rgba16", FIT_RGBA16, 64, false }, FreeImage_ConvertTo32Bits },
+    { "float-to-grey8", { "float", FIT_FLOAT, 32, false }, ToStandard },
+    { "rgb16-to-rgbf", { "rgb16", FIT_RGB16, 48, false }, FreeImage_ConvertToRGBF },
+    { "rgbaf-to-rgbf", { "rgbaf", FIT_RGBAF, 128, false }, FreeImage_ConvertToRGBF },
+    { "rgbf-drago03", { "rgbf", FIT_RGBF, 96, false }, Drago },
+    { "rgbf-reinhard05", { "rgbf", FIT_RGBF, 96, false }, Reinhard },
+  };
+
+  unsigned long long ImageBytes(FIBITMAP *dib)
+  {
+    return (unsigned long long)FreeImage_GetLine(dib) * FreeImage_GetHeight(dib);
+  }
+}
+
+void Suites::Rescale(Bench &bench, const Settings &settings)
+{
+  for (const auto &size : settings.sizes) {
+    for (const auto &t : rescaleTypes) {
+      if (!bench.WantsGroup("rescale", t.name)) {
+        continue;
+      }
+      FIBITMAP *src = Corpus::MakeImage(t.type, t.bpp, size.width, size.height, t.palette);
+      for (const auto &s : scales) {
+        if (settings.quick && s.num > s.den) {
+          continue;
+        }
+        const int width = (int)(size.width * s.num / s.den), height = (int)(size.height * s.num / s.den);
+        for (const auto &f : filters) {
+          Bench::Case c("rescale", std::string(t.name) + "-" + f.name + "-" + s.name);
+          c.format = t.name;
+          c.width = size.width;
+          c.height = size.height;
+          c.bpp = t.bpp;
+          c.bytes = src ? ImageBytes(src) : 0;
+          bench.Run(c, [&] {
+            FIBITMAP *dst = src ? FreeImage_Rescale(src, width, height, f.filter) : nullptr;
+            const bool ok = dst != nullptr;
+            FreeImage_Unload(dst);
+            return ok;
+          });
+        }
+      }
+      FreeImage_Unload(src);
+    }
+  }
+}
+
+void Suites::Convert(Bench &bench, const Settings &settings)
+{
+  for (const auto &size : settings.sizes) {
+    for (const auto &conversion : conversions) {
+      if (!bench.Wants("convert", conversion.name)) {
+        continue;
+      }
+      const PixelType &t = conversion.from;
+      FIBITMAP *src = Corpus::MakeImage(t.type, t.bpp, size.width, size.height, t.palette);
+      Bench::Case c("convert", conversion.name);
+      c.format = t.name;
+      c.width = size.width;
+      c.height = size.height;
+      c.bpp = t.bpp;
+      c.bytes = src ? ImageBytes(src) : 0;
+      bench.Run(c, [&] {
+        FIBITMAP *dst = src ? conversion.convert(src) : nullptr;
+        const bool ok = dst != nullptr;
+        FreeImage_Unload(dst);
+        return ok;
+      });
+      FreeImage_Unload(src);
+    }
+  }
+}
@@ -0,0 +1,180 @@
+#include <string>
+
+#include "../fastpreview/Pyramid.h"
+#include "Corpus.h"
+#include "Suites.h"
+
+namespace {
+  struct PixelType
+  {
+    const char *name;
+    FREE_IMAGE_TYPE type;
+    unsigned bpp;
+  };
+
+  const PixelType halveTypes[] = {
+    { "grey8", FIT_BITMAP, 8 },
+    { "rgb8", FIT_BITMAP, 24 },
+    { "rgba8", FIT_BITMAP, 32 },
+    { "grey16", FIT_UINT16, 16 },
+    { "rgb16", FIT_RGB16, 48 },
+    { "rgba16", FIT_RGBA16, 64 },
+    { "float", FIT_FLOAT, 32 },
+    { "rgbf", FIT_RGBF, 96 },
+    { "rgbaf", FIT_RGBAF, 128 },
+  };
+
+  /// What the viewer renders tiles from, after toStandardBitmap
+  const PixelType zoomTypes[] = {
+    { "rgb8", FIT_BITMAP, 24 },
+    { "rgba8", FIT_BITMAP, 32 },
+  };
+
+  /**
+   * Zoom levels, in percent. At 50% the pyramid level is the canvas itself,
+   * which leaves a plain copy; the others are filtered from the level above.
+   */
+  const unsigned zooms[] = { 50, 35, 20, 8 };
+
+  /// The tile size of fastpreview's TileCache, and the view painted
+  const unsigned tileSize = 256;
+  const unsigned viewWidth = 1920, viewHeight = 1080;
+
+  /**
+   * FreeImage_HalveSize of an 8-bit per sample bitmap without the SSE2 code:
+   * the same loops and the same threads, so that the difference is the
+   * vectors alone
+   */
+  FIBITMAP* HalveScalar(FIBITMAP *src)
+  {
+    const unsigned channels = FreeImage_GetBPP(src) / 8;
+    const unsigned srcWidth = FreeImage_GetWidth(src), srcHeight = FreeImage_GetHeight(src);
+    const unsigned dstWidth = (srcWidth + 1) / 2;
+    const int dstHeight = (int)(srcHeight + 1) / 2;
+    FIBITMAP *dst = FreeImage_Allocate(dstWidth, dstHeight, FreeImage_GetBPP(src));
+    if (!dst) {
+      return nullptr;
+    }
+#pragma omp parallel for
+    for (int y = 0; y < dstHeight; ++y) {
+      BYTE *d = FreeImage_GetScanLine(dst, y);
+      const BYTE *a = FreeImage_GetScanLine(src, 2 * y);
+      const BYTE *b = FreeImage_GetScanLine(src, 2 * y + 1 < (int)srcHeight ? 2 * y + 1 : 2 * y);
+      for (unsigned x = 0; x < dstWidth; ++x) {
+        const unsigned x0 = 2 * x * channels;
+        const unsigned x1 = 2 * x + 1 < srcWidth ? x0 + channels : x0;
+        for (unsigned c = 0; c < channels; ++c) {
+          d[x * channels + c] = (BYTE)((a[x0 + c] + a[x1 + c] + b[x0 + c] + b[x1 + c] + 2) >> 2);
+        }
+      }
+    }
+    return dst;
+  }
+
+  /**
+   * Renders the tiles of the view at the top left of the canvas the way
+   * MainWindow::RenderTile does, from src scaled to the canvas size
+   */
+  bool RenderView(FIBITMAP *src, unsigned canvasWidth, unsigned canvasHeight)
+  {
+    const unsigned right = canvasWidth < viewWidth ? canvasWidth : viewWidth;
+    const unsigned bottom = canvasHeight < viewHeight ? canvasHeight : viewHeight;
+    for (unsigned top = 0; top < bottom; top += tileSize) {
+      for (unsigned left = 0; left < right; left += tileSize) {
+        FIBITMAP *part = FreeImage_RescaleWindow(src, canvasWidth, canvasHeight,
+          left, top, left + tileSize < right ? left + tileSize : right, top + tileSize < bottom ? top + tileSize : bottom,
+          FILTER_LANCZOS3);
+        if (!part) {
+          return false;
+        }
+        FreeImage_Unload(part);
+      }
+    }
+    return true;
+  }
+
+  unsigned long long ImageBytes(FIBITMAP *dib)
+  {
+    return (unsigned long long)FreeImage_GetLine(dib) * FreeImage_GetHeight(dib);
+  }
+}
+
+void Suites::Zoom(Bench &bench, const Settings &settings)
+{
+  for (const auto &size : settings.sizes) {
+    for (const auto &t : halveTypes) {
+      if (!bench.WantsGroup("zoom", std::string("halve-") + t.name)) {
+        continue;
+      }
+      FIBITMAP *src = Corpus::MakeImage(t.type, t.bpp, size.width, size.height);
+      Bench::Case c("zoom", std::string("halve-") + t.name);
+      c.format = t.name;
+      c.width = size.width;
+      c.height = size.height;
+      c.bpp = t.bpp;
+      c.bytes = src ? ImageBytes(src) : 0;
+      bench.Run(c, [&] {
+        FIBITMAP *dst = src ? FreeImage_HalveSize(src) : nullptr;
+        const bool ok = dst != nullptr;
+        FreeImage_Unload(dst);
+        return ok;
+      });
+      if (t.type == FIT_BITMAP) {
+        c.name += "-scalar";
+        bench.Run(c, [&] {
+          FIBITMAP *dst = src ? HalveScalar(src) : nullptr;
+          const bool ok = dst != nullptr;
+          FreeImage_Unload(dst);
+          return ok;
+        });
+      }
+      FreeImage_Unload(src);
+    }
+
+    for (const auto &t : zoomTypes) {
+      if (!bench.WantsGroup("zoom", std::string("view-") + t.name)) {
+        continue;
+      }
+      FIBITMAP *src = Corpus::MakeImage(t.type, t.bpp, size.width, size.height);
+      for (const auto zoom : zooms) {
+        if (settings.quick && zoom != 35) {
+          continue;
+        }
+        const unsigned width = size.width * zoom / 100, height = size.height * zoom / 100;
+        if (!width || !height) {
+          continue;
+        }
+        const std::string name = std::string("view-") + t.name + "-" + std::to_string(zoom);
+        Bench::Case c("zoom", name + "-base");
+        c.format = t.name;
+        c.width = size.width;
+        c.height = size.height;
+        c.bpp = t.bpp;
+        c.bytes = (unsigned long long)(width < viewWidth ? width : viewWidth) *
+          (height < viewHeight ? height : viewHeight) * (t.bpp / 8);
+        bench.Run(c, [&] {
+          return src && RenderView(src, width, height);
+        });
+
+        // the levels kept from a previous paint
+        Pyramid kept;
+        kept.Reset(src);
+        c.name = name + "-pyramid";
+        bench.Run(c, [&] {
+          FIBITMAP *level = kept.Select(width, height);
+          return level && RenderView(level, width, height);
+        });
+
+        // the first paint at this zoom, making the levels
+        c.name = name + "-first";
+        bench.Run(c, [&] {
+          Pyramid pyramid;
+          pyramid.Reset(src);
+          FIBITMAP *level = pyramid.Select(width, height);
+          return level && RenderView(level, width, height);
+        });
+      }
+      FreeImage_Unload(src);
+    }
+  }
+}
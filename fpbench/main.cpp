@@ -0,0 +1,198 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "FreeImage.h"
+#include "Bench.h"
+#include "Suites.h"
+
+namespace {
+  const char usage[] =
+    "Headless benchmark of decoding and processing images with FreeImage.\n"
+    "\n"
+    "fpbench [options] [suite...]\n"
+    "\n"
+    "Suites, all of them by default:\n"
+    "  load      FreeImage_LoadFromHandle of every corpus file, MB/s of decoded pixels\n"
+    "  detect    FreeImage_GetFileTypeFromHandle of every corpus file\n"
+    "  rescale   FreeImage_Rescale per pixel type and filter, MB/s of source pixels\n"
+    "  convert   Bit depth and pixel type conversions, MB/s of source pixels\n"
+    "  png       PNG decoding of RGB8, RGBA8 and RGBA16 per row filter, with\n"
+    "            the inflate share of it, MB/s of decoded pixels\n"
+    "  gif       GIF decoding of 8 and 4-bit noise, plain and interlaced, 4096\n"
+    "            pixels square (1024 with -quick), with the old and the new LZW\n"
+    "            decoder, MB/s of decoded pixels\n"
+    "  dds       DDS BC1-BC5 and BC7 decoding of 4096 and 8192 pixel square\n"
+    "            textures (1024 and 2048 with -quick), MB/s of decoded pixels\n"
+    "  jpeg      JPEG decoding of 4:2:0, 4:2:2 and 4:4:4 files, up to the DCT\n"
+    "            coefficients, fast and accurate, MB/s of decoded pixels\n"
+    "  rle       SGI, PCX and BMP RLE4/RLE8 decoding from disk with the old and\n"
+    "            the buffered reader, MB/s of decoded samples\n"
+    "  zoom      FreeImage_HalveSize per pixel type, with and without SSE2, and\n"
+    "            painting a view in tiles zoomed out, from the image and from the\n"
+    "            pyramid, MB/s of source and of painted pixels\n"
+    "\n"
+    "  -o FILE       Write the results as JSON to FILE, fpbench.json by default,\n"
+    "                - for stdout\n"
+    "  -size WxH     Run at this image size; may be repeated.\n"
+    "                640x480, 1920x1080 and 4000x3000 by default\n"
+    "  -quick        Smaller sizes, shorter runs and fewer variations\n"
+    "  -only PREFIX  Run the cases whose suite/name starts with PREFIX;\n"
+    "                may be repeated\n"
+    "  -time S       Minimum seconds spent on a case, 0.5 by default\n"
+    "  -reps N       Minimum repetitions of a case, 3 by default\n"
+    "  -q            Do not print the cases as they complete\n"
+    "\n"
+    "The corpus is generated on every run, identically on every machine.\n"
+    "Cases report the fastest repetition, and the peak RSS of the process\n"
+    "after them.\n";
+
+  struct Suite
+  {
+    const char *name;
+    void (*run)(Bench &bench, const Suites::Settings &settings);
+  };
+
+  const Suite suites[] = {
+    { "load", Suites::Load },
+    { "detect", Suites::Detect },
+    { "rescale", Suites::Rescale },
+    { "convert", Suites::Convert },
+    { "png", Suites::Png },
+    { "gif", Suites::Gif },
+    { "dds", Suites::Dds },
+    { "jpeg", Suites::Jpeg },
+    { "rle", Suites::Rle },
+    { "zoom", Suites::Zoom },
+  };
+
+  int fail(const char *message, const char *arg = "")
+  {
+    fprintf(stderr, message, arg);
+    fprintf(stderr, "\n\n%s", usage);
+    return 2;
+  }
+
+  void DLL_CALLCONV OutputMessage(FREE_IMAGE_FORMAT fif, const char *message)
+  {
+    const char *format = fif != FIF_UNKNOWN ? FreeImage_GetFormatFromFIF(fif) : nullptr;
+    fprintf(stderr, "%s: %s\n", format ? format : "FreeImage", message);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  Bench::Options options;
+  Suites::Settings settings;
+  std::vector<std::string> selected;
+  std::string output = "fpbench.json";
+  bool haveTime = false;
+
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg.empty()) {
+      continue;
+    }
+    if (arg[0] != '-') {
+      bool known = false;
+      for (const auto &suite : suites) {
+        known |= arg == suite.name;
+      }
+      if (!known) {
+        return fail("Unknown suite: %s", arg.c_str());
+      }
+      selected.push_back(arg);
+    }
+    else if (arg == "-o" && i + 1 < argc) {
+      output = argv[++i];
+    }
+    else if (arg == "-size" && i + 1 < argc) {
+      Suites::Size size;
+      if (sscanf(argv[++i], "%ux%u", &size.width, &size.height) != 2 || !size.width || !size.height) {
+        return fail("Bad size: %s", argv[i]);
+      }
+      settings.sizes.push_back(size);
+    }
+    else if (arg == "-quick") {
+      settings.quick = true;
+    }
+    else if (arg == "-only" && i + 1 < argc) {
+      options.only.push_back(argv[++i]);
+    }
+    else if (arg == "-time" && i + 1 < argc) {
+      options.minSeconds = atof(argv[++i]);
+      haveTime = true;
+    }
+    else if (arg == "-reps" && i + 1 < argc) {
+      options.minReps = (unsigned)atoi(argv[++i]);
+    }
+    else if (arg == "-q") {
+      options.verbose = false;
+    }
+    else if (arg == "-h" || arg == "-?" || arg == "--help") {
+      fputs(usage, stdout);
+      return 0;
+    }
+    else {
+      return fail("Unknown option: %s", arg.c_str());
+    }
+  }
+  if (settings.sizes.empty()) {
+    if (settings.quick) {
+      const Suites::Size sizes[] = { { 320, 240 }, { 1024, 768 } };
+      settings.sizes.assign(sizes, sizes + 2);
+    }
+    else {
+      const Suites::Size sizes[] = { { 640, 480 }, { 1920, 1080 }, { 4000, 3000 } };
+      settings.sizes.assign(sizes, sizes + 3);
+    }
+  }
+  if (output == "-") {
+    options.verbose = false;
+  }
+  if (settings.quick && !haveTime) {
+    options.minSeconds = 0.1;
+  }
+
+#ifdef FREEIMAGE_LIB
+  FreeImage_Initialise(FALSE);
+#endif
+  FreeImage_SetOutputMessage(OutputMessage);
+
+  Bench bench(options);
+  bench.SetInfo("benchmark", "fpbench");
+  bench.SetInfo("freeimage", FreeImage_GetVersion());
+  bench.SetInfo("platform", sizeof(void*) == 8 ? "x64" : "x86");
+
+  for (const auto &suite : suites) {
+    bool run = selected.empty();
+    for (const auto &s : selected) {
+      run |= s == suite.name;
+    }
+    if (run && bench.WantsGroup(suite.name, "")) {
+      suite.run(bench, settings);
+    }
+  }
+
+  FILE *file = output == "-" ? stdout : fopen(output.c_str(), "w");
+  const bool written = file && bench.Write(file);
+  if (file && file != stdout) {
+    fclose(file);
+  }
+  if (!written) {
+    fprintf(stderr, "Cannot write %s\n", output.c_str());
+  }
+  if (options.verbose) {
+    printf("%u cases, %u failed, peak RSS %.1f MB\n",
+      (unsigned)bench.GetCount(), bench.GetFailed(), Bench::PeakRSS());
+  }
+
+#ifdef FREEIMAGE_LIB
+  FreeImage_DeInitialise();
+#endif
+
+  return !written || bench.GetFailed() ? 1 : 0;
+}
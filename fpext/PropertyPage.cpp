@@ -36,7 +36,7 @@ PropertyPage::PropertyPage(
   ShellExt *ext, const std::wstring& aFile, UINT& ref)
   : file_(aFile), hwnd_(nullptr), hlist_(nullptr), ext_(ext)
 {
-  if (!img_.load(file_) || !img_.makeThumbnail(96, 96)) {
+  if (!img_.load(file_, 96 << 16) || !img_.makeThumbnail(96, 96)) {
     throw std::wstring(L"failed to load image");
   }
 
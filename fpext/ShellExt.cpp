@@ -320,7 +320,8 @@ IFACEMETHODIMP ShellExt::QueryContextMenu(
     return MAKE_HRESULT(SEVERITY_SUCCESS, FACILITY_NULL, 0);
   }
 
-  if (!image_.load(path_)) {
+  // Let plugins that can (JPEG, WebP, PSD, DDS, ICO) scale down while decoding
+  if (!image_.load(path_, (int)max(width_, height_) << 16)) {
     return MAKE_HRESULT(SEVERITY_SUCCESS, FACILITY_NULL, 0);
   }
   info_ = FreeImage::StaticInformation(image_.getOriginalInformation());
@@ -564,14 +565,14 @@ IFACEMETHODIMP ShellExt::GetThumbnail(
     dump(L"GetThumbnail - ft is %d", ft);
 
     dump(L"GetThumbnail - Reading from stream");
-    img = FreeImage_LoadFromHandle(ft, &io, stream_.get());
+    img = FreeImage_LoadFromHandle(ft, &io, stream_.get(), (int)cx << 16);
     if (!img.isValid()) {
       dump(L"GetThumbnail - Failed to read from stream");
       return E_INVALIDARG;
     }
     dump(L"GetThumbnail - Read from stream");
   }
-  else if (!img.load(path_)) {
+  else if (!img.load(path_, (int)cx << 16)) {
     dump(L"GetThumbnail - Fail");
     return E_INVALIDARG;
   }
@@ -0,0 +1,25 @@
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "Tests.h"
+
+void Checks::Begin(const char *test)
+{
+  test_ = test;
+}
+
+bool Checks::Check(bool ok, const char *format, ...)
+{
+  ++count_;
+  if (ok) {
+    return true;
+  }
+  ++failed_;
+  printf("FAILED %s: ", test_.c_str());
+  va_list args;
+  va_start(args, format);
+  vprintf(format, args);
+  va_end(args);
+  printf("\n");
+  return false;
+}
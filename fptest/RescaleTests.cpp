@@ -0,0 +1,172 @@
+#include <string.h>
+
+#include "FreeImage.h"
+#include "Tests.h"
+
+namespace {
+  struct PixelType
+  {
+    const char *name;
+    FREE_IMAGE_TYPE type;
+    unsigned bpp;
+    /// Give a palettized image random colors rather than greys
+    bool colors;
+  };
+
+  const PixelType pixelTypes[] = {
+    { "1-bit", FIT_BITMAP, 1, false },
+    { "4-bit", FIT_BITMAP, 4, true },
+    { "8-bit grey", FIT_BITMAP, 8, false },
+    { "8-bit palette", FIT_BITMAP, 8, true },
+    { "16-bit 565", FIT_BITMAP, 16, false },
+    { "24-bit", FIT_BITMAP, 24, false },
+    { "32-bit", FIT_BITMAP, 32, false },
+    { "uint16", FIT_UINT16, 16, false },
+    { "rgb16", FIT_RGB16, 48, false },
+    { "rgba16", FIT_RGBA16, 64, false },
+    { "float", FIT_FLOAT, 32, false },
+    { "rgbf", FIT_RGBF, 96, false },
+    { "rgbaf", FIT_RGBAF, 128, false },
+  };
+
+  struct Filter
+  {
+    const char *name;
+    FREE_IMAGE_FILTER filter;
+  };
+
+  const Filter filters[] = {
+    { "box", FILTER_BOX },
+    { "bilinear", FILTER_BILINEAR },
+    { "bspline", FILTER_BSPLINE },
+    { "bicubic", FILTER_BICUBIC },
+    { "catmullrom", FILTER_CATMULLROM },
+    { "lanczos3", FILTER_LANCZOS3 },
+  };
+
+  /// Down, up and mixed scaling of the 97x61 source
+  const int scales[][2] = { { 40, 25 }, { 250, 173 }, { 150, 30 }, { 97, 61 } };
+
+  class Random
+  {
+    unsigned state_;
+
+  public:
+    Random() : state_(0x2545F491u) {}
+
+    unsigned Next()
+    {
+      state_ ^= state_ << 13;
+      state_ ^= state_ >> 17;
+      state_ ^= state_ << 5;
+      return state_;
+    }
+  };
+
+  /// Creates an image of noise, which leaves no pixel of the result untested
+  FIBITMAP* MakeImage(const PixelType &t, unsigned width, unsigned height)
+  {
+    FIBITMAP *dib = t.bpp == 16 && t.type == FIT_BITMAP
+      ? FreeImage_AllocateT(t.type, width, height, 16, FI16_565_RED_MASK, FI16_565_GREEN_MASK, FI16_565_BLUE_MASK)
+      : FreeImage_AllocateT(t.type, width, height, t.bpp);
+    if (!dib) {
+      return nullptr;
+    }
+    Random random;
+    const bool floats = t.type == FIT_FLOAT || t.type == FIT_RGBF || t.type == FIT_RGBAF;
+    for (unsigned y = 0; y < height; ++y) {
+      BYTE *line = FreeImage_GetScanLine(dib, y);
+      if (floats) {
+        float *f = (float*)line;
+        for (unsigned x = 0; x < width * t.bpp / 32; ++x) {
+          f[x] = (random.Next() >> 8) / 16777216.0f;
+        }
+      }
+      else {
+        for (unsigned x = 0; x < FreeImage_GetLine(dib); ++x) {
+          line[x] = (BYTE)(random.Next() >> 24);
+        }
+      }
+    }
+    RGBQUAD *palette = FreeImage_GetPalette(dib);
+    if (palette && t.colors) {
+      for (unsigned i = 0; i < FreeImage_GetColorsUsed(dib); ++i) {
+        const unsigned c = random.Next();
+        palette[i].rgbRed = (BYTE)c;
+        palette[i].rgbGreen = (BYTE)(c >> 8);
+        palette[i].rgbBlue = (BYTE)(c >> 16);
+      }
+    }
+    return dib;
+  }
+
+  /// Compares an image with the area of another one, left, top being from the top
+  bool SameAs(FIBITMAP *dib, FIBITMAP *whole, int left, int top)
+  {
+    if (FreeImage_GetImageType(dib) != FreeImage_GetImageType(whole) || FreeImage_GetBPP(dib) != FreeImage_GetBPP(whole)) {
+      return false;
+    }
+    const unsigned bpp = FreeImage_GetBPP(dib);
+    const unsigned width = FreeImage_GetWidth(dib), height = FreeImage_GetHeight(dib);
+    const unsigned wholeHeight = FreeImage_GetHeight(whole);
+    for (unsigned y = 0; y < height; ++y) {
+      const BYTE *a = FreeImage_GetScanLine(dib, height - 1 - y);
+      const BYTE *b = FreeImage_GetScanLine(whole, wholeHeight - 1 - (top + y));
+      // results are 8 bits per pixel and up
+      if (memcmp(a, b + left * bpp / 8, width * bpp / 8)) {
+        return false;
+      }
+    }
+    return true;
+  }
+}
+
+void Tests::RescaleWindow(Checks &checks)
+{
+  checks.Begin("rescale window");
+  const unsigned width = 97, height = 61;
+  for (const auto &t : pixelTypes) {
+    FIBITMAP *src = MakeImage(t, width, height);
+    if (!checks.Check(src != nullptr, "%s: cannot allocate", t.name)) {
+      continue;
+    }
+    for (const auto &f : filters) {
+      for (const auto &scale : scales) {
+        const int w = scale[0], h = scale[1];
+        FIBITMAP *whole = FreeImage_Rescale(src, w, h, f.filter);
+        if (!checks.Check(whole != nullptr, "%s %s %dx%d: FreeImage_Rescale failed", t.name, f.name, w, h)) {
+          continue;
+        }
+        // whole, single pixels at the corners, edges, inside, thin strips
+        const int windows[][4] = {
+          { 0, 0, w, h },
+          { 0, 0, 1, 1 },
+          { w - 1, h - 1, w, h },
+          { 0, h / 3, w / 2, h },
+          { w / 4, 0, w, h / 2 },
+          { w / 5, h / 4, w / 5 + 13 < w ? w / 5 + 13 : w, h / 4 + 7 < h ? h / 4 + 7 : h },
+          { 0, h / 2, w, h / 2 + 1 },
+          { w / 2, 0, w / 2 + 1, h },
+        };
+        for (const auto &win : windows) {
+          FIBITMAP *part = FreeImage_RescaleWindow(src, w, h, win[0], win[1], win[2], win[3], f.filter);
+          const bool ok = part &&
+            (int)FreeImage_GetWidth(part) == win[2] - win[0] && (int)FreeImage_GetHeight(part) == win[3] - win[1] &&
+            SameAs(part, whole, win[0], win[1]);
+          checks.Check(ok, "%s %s %dx%d: window %d,%d-%d,%d %s", t.name, f.name, w, h,
+            win[0], win[1], win[2], win[3], part ? "differs from the crop" : "failed");
+          FreeImage_Unload(part);
+        }
+        FreeImage_Unload(whole);
+      }
+    }
+
+    // windows outside the rescaled image are refused
+    FIBITMAP *outside = FreeImage_RescaleWindow(src, 40, 25, 30, 20, 41, 25, FILTER_BOX);
+    FIBITMAP *empty = FreeImage_RescaleWindow(src, 40, 25, 10, 10, 10, 20, FILTER_BOX);
+    checks.Check(!outside && !empty, "%s: a window outside the image was accepted", t.name);
+    FreeImage_Unload(outside);
+    FreeImage_Unload(empty);
+    FreeImage_Unload(src);
+  }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+
+/**
+ * Counts the checks of a test run and prints the failed ones as they happen,
+ * under the name of the test they belong to.
+ */
+class Checks
+{
+  std::string test_;
+  unsigned count_, failed_;
+
+public:
+  Checks() : count_(0), failed_(0) {}
+
+  /// Names the test the following checks belong to
+  void Begin(const char *test);
+
+  /// Records one check; prints the message, printf style, if it failed
+  bool Check(bool ok, const char *format, ...);
+
+  unsigned GetCount() const
+  {
+    return count_;
+  }
+
+  unsigned GetFailed() const
+  {
+    return failed_;
+  }
+};
+
+/**
+ * The tests. Each runs its own cases, without any input files or windows.
+ */
+namespace Tests
+{
+  /// Rendering, eviction and prefetching of fastpreview's TileCache
+  void Tiles(Checks &checks);
+  /**
+   * FreeImage_RescaleWindow against a crop of FreeImage_Rescale, which it
+   * has to match byte for byte, for every pixel type and filter
+   */
+  void RescaleWindow(Checks &checks);
+}
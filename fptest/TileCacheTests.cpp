@@ -0,0 +1,302 @@
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "../fastpreview/TileCache.h"
+#include "Tests.h"
+
+namespace {
+  typedef TileCache::Bounds Bounds;
+
+  const unsigned T = TileCache::tileSize;
+
+  /// Memory a fake tile claims to use: 32-bit pixels
+  size_t Bytes(const Bounds &b)
+  {
+    return (size_t)(b.right - b.left) * (b.bottom - b.top) * 4;
+  }
+
+  const size_t fullTile = (size_t)T * T * 4;
+
+  class FakeTile : public TileCache::Tile
+  {
+  public:
+    const Bounds bounds;
+
+    explicit FakeTile(const Bounds &b) : bounds(b) {}
+
+    size_t GetSize() const override
+    {
+      return Bytes(bounds);
+    }
+  };
+
+  /// Renders fake tiles, keeping track of what it was asked for
+  class Renderer
+  {
+  public:
+    std::vector<Bounds> rendered;
+    /// Tiles whose top left corner is here fail to render
+    unsigned failLeft, failTop;
+
+    Renderer() : failLeft(~0u), failTop(~0u) {}
+
+    TileCache::Renderer Get()
+    {
+      return [this](const Bounds &b) -> std::unique_ptr<TileCache::Tile> {
+        rendered.push_back(b);
+        if (b.left == failLeft && b.top == failTop) {
+          return nullptr;
+        }
+        return std::unique_ptr<TileCache::Tile>(new FakeTile(b));
+      };
+    }
+  };
+
+  Bounds Make(unsigned left, unsigned top, unsigned right, unsigned bottom)
+  {
+    Bounds b = { left, top, right, bottom };
+    return b;
+  }
+
+  /// Shows the view and paints it, as the window does
+  void Show(TileCache &cache, const Bounds &view, unsigned *painted = nullptr)
+  {
+    unsigned count = 0;
+    cache.SetView(view);
+    cache.Cover(view, [&](const Bounds&, const TileCache::Tile&) { ++count; });
+    if (painted) {
+      *painted = count;
+    }
+  }
+
+  /// Prefetches until the cache has nothing left to do; returns the tiles rendered
+  std::vector<Bounds> PrefetchAll(TileCache &cache, Renderer &r)
+  {
+    const size_t before = r.rendered.size();
+    for (unsigned i = 0; i < 1000 && cache.Prefetch(); ++i) {
+    }
+    return std::vector<Bounds>(r.rendered.begin() + before, r.rendered.end());
+  }
+
+  void Grid(Checks &checks)
+  {
+    checks.Begin("grid");
+    const unsigned sizes[][2] = { { 1000, 700 }, { 512, 512 }, { 1, 1 }, { 257, 255 } };
+    for (const auto &size : sizes) {
+      const unsigned w = size[0], h = size[1];
+      TileCache cache(~(size_t)0);
+      Renderer r;
+      cache.Reset(w, h, r.Get());
+
+      std::vector<unsigned char> covered((size_t)w * h);
+      bool sameBounds = true, aligned = true;
+      cache.SetView(Make(0, 0, w, h));
+      cache.Cover(Make(0, 0, w, h), [&](const Bounds &b, const TileCache::Tile &tile) {
+        sameBounds &= !memcmp(&b, &static_cast<const FakeTile&>(tile).bounds, sizeof(b));
+        // the grid is aligned to the bottom edge
+        aligned &= b.bottom == h || (h - b.bottom) % T == 0;
+        for (unsigned y = b.top; y < b.bottom; ++y) {
+          for (unsigned x = b.left; x < b.right; ++x) {
+            ++covered[(size_t)y * w + x];
+          }
+        }
+      });
+      const unsigned expected = ((w + T - 1) / T) * ((h + T - 1) / T);
+      checks.Check(r.rendered.size() == expected, "%ux%u: %u tiles rendered, expected %u", w, h, (unsigned)r.rendered.size(), expected);
+      unsigned wrong = 0;
+      for (const auto c : covered) {
+        wrong += c != 1;
+      }
+      checks.Check(!wrong, "%ux%u: %u pixels not painted exactly once", w, h, wrong);
+      checks.Check(sameBounds, "%ux%u: a tile was painted at other bounds than rendered", w, h);
+      checks.Check(aligned, "%ux%u: the grid is not aligned to the bottom edge", w, h);
+
+      r.rendered.clear();
+      unsigned painted;
+      Show(cache, Make(0, 0, w, h), &painted);
+      checks.Check(r.rendered.empty() && painted == expected, "%ux%u: cached tiles rendered again", w, h);
+
+      // areas beyond the canvas paint nothing
+      Show(cache, Make(w, h, w + 100, h + 100), &painted);
+      checks.Check(!painted, "%ux%u: painted outside the canvas", w, h);
+    }
+  }
+
+  void Budget(Checks &checks)
+  {
+    checks.Begin("budget");
+    const size_t budget = 6 * fullTile;
+    TileCache cache(budget);
+    Renderer r;
+    cache.Reset(4096, 4096, r.Get());
+
+    // pan across the canvas; the view takes up to 4 tiles
+    size_t largest = 0;
+    for (unsigned y = 0; y + T <= 4096; y += 300) {
+      for (unsigned x = 0; x + T <= 4096; x += 100) {
+        Show(cache, Make(x, y, x + T, y + T));
+        largest = std::max(largest, cache.GetSize());
+      }
+    }
+    checks.Check(largest <= budget, "%u bytes used, budget %u", (unsigned)largest, (unsigned)budget);
+
+    // least recently used first: A B C, touch A, D drops B
+    TileCache lru(3 * fullTile);
+    Renderer r2;
+    lru.Reset(4096, 4096, r2.Get());
+    const Bounds a = Make(0, 0, T, T), b = Make(T, 0, 2 * T, T), c = Make(2 * T, 0, 3 * T, T), d = Make(3 * T, 0, 4 * T, T);
+    Show(lru, a);
+    Show(lru, b);
+    Show(lru, c);
+    Show(lru, a);
+    checks.Check(r2.rendered.size() == 3, "a tile in the cache was rendered again");
+    Show(lru, d);
+    checks.Check(lru.GetSize() == 3 * fullTile, "%u bytes used after dropping a tile", (unsigned)lru.GetSize());
+    r2.rendered.clear();
+    Show(lru, a);
+    checks.Check(r2.rendered.empty(), "a recently used tile was dropped");
+    Show(lru, b);
+    checks.Check(r2.rendered.size() == 1, "the least recently used tile was kept");
+  }
+
+  void KeepView(Checks &checks)
+  {
+    checks.Begin("keep view");
+    TileCache cache(1);
+    Renderer r;
+    cache.Reset(4096, 4096, r.Get());
+
+    // 600x600 from 100,100 takes 3x3 tiles, far beyond the budget
+    Show(cache, Make(100, 100, 700, 700));
+    checks.Check(r.rendered.size() == 9, "%u tiles rendered for the view", (unsigned)r.rendered.size());
+    checks.Check(cache.GetSize() == 9 * fullTile, "tiles in view were dropped");
+    r.rendered.clear();
+    Show(cache, Make(100, 100, 700, 700));
+    checks.Check(r.rendered.empty(), "%u tiles in view rendered again", (unsigned)r.rendered.size());
+
+    // a tile to the right: one new column, the left one goes
+    Show(cache, Make(100 + T, 100, 700 + T, 700));
+    checks.Check(r.rendered.size() == 3, "%u tiles rendered after moving a tile", (unsigned)r.rendered.size());
+    checks.Check(cache.GetSize() == 9 * fullTile, "%u bytes used after moving, expected the view only", (unsigned)cache.GetSize());
+  }
+
+  /// Checks the prefetched tiles lie within depth rows (columns) beyond the view in the given direction
+  void CheckAhead(Checks &checks, const char *what, const std::vector<Bounds> &tiles, const Bounds &view, int dx, int dy, unsigned expected)
+  {
+    checks.Check(tiles.size() == expected, "%s: %u tiles prefetched, expected %u", what, (unsigned)tiles.size(), expected);
+    for (const auto &b : tiles) {
+      bool ok;
+      if (dy > 0) {
+        ok = b.top >= view.bottom && b.top < view.bottom + 2 * T && b.left < view.right && b.right > view.left;
+      }
+      else if (dy < 0) {
+        ok = b.bottom <= view.top && b.bottom + 2 * T > view.top && b.left < view.right && b.right > view.left;
+      }
+      else if (dx > 0) {
+        ok = b.left >= view.right && b.left < view.right + 2 * T && b.top < view.bottom && b.bottom > view.top;
+      }
+      else {
+        ok = b.right <= view.left && b.right + 2 * T > view.left && b.top < view.bottom && b.bottom > view.top;
+      }
+      if (!checks.Check(ok, "%s: prefetched %u,%u-%u,%u off the direction", what, b.left, b.top, b.right, b.bottom)) {
+        break;
+      }
+    }
+    // nearest first
+    for (size_t i = 1; i < tiles.size(); ++i) {
+      const int d0 = dy ? dy * (int)tiles[i - 1].top : dx * (int)tiles[i - 1].left;
+      const int d1 = dy ? dy * (int)tiles[i].top : dx * (int)tiles[i].left;
+      if (!checks.Check(d0 <= d1, "%s: a farther tile was prefetched first", what)) {
+        break;
+      }
+    }
+  }
+
+  void Prefetch(Checks &checks)
+  {
+    checks.Begin("prefetch");
+    TileCache cache(~(size_t)0);
+    Renderer r;
+    cache.Reset(4096, 4096, r.Get());
+
+    // before any scrolling, ahead is down
+    Bounds view = Make(4 * T, 4 * T, 6 * T, 6 * T);
+    Show(cache, view);
+    CheckAhead(checks, "initial", PrefetchAll(cache, r), view, 0, 1, 4);
+
+    view = Make(4 * T, 4 * T - 10, 6 * T, 6 * T - 10);
+    Show(cache, view);
+    CheckAhead(checks, "up", PrefetchAll(cache, r), view, 0, -1, 4);
+
+    view = Make(4 * T - 10, 4 * T - 10, 6 * T - 10, 6 * T - 10);
+    Show(cache, view);
+    CheckAhead(checks, "left", PrefetchAll(cache, r), view, -1, 0, 6);
+
+    view = Make(4 * T + 10, 4 * T - 10, 6 * T + 10, 6 * T - 10);
+    Show(cache, view);
+    CheckAhead(checks, "right", PrefetchAll(cache, r), view, 1, 0, 6);
+
+    // nothing beyond the canvas
+    view = Make(4096 - 2 * T, 4096 - 2 * T, 4096, 4096);
+    Show(cache, Make(4096 - 2 * T, 4096 - 2 * T - 10, 4096, 4096 - 10));
+    Show(cache, view);
+    const std::vector<Bounds> edge = PrefetchAll(cache, r);
+    checks.Check(edge.empty(), "%u tiles prefetched beyond the bottom edge", (unsigned)edge.size());
+
+    // a tile that fails to render stops prefetching without being painted
+    TileCache failing(~(size_t)0);
+    Renderer f;
+    f.failLeft = 4 * T;
+    f.failTop = 6 * T;
+    failing.Reset(4096, 4096, f.Get());
+    view = Make(4 * T, 4 * T, 6 * T, 6 * T);
+    Show(failing, view);
+    checks.Check(!failing.Prefetch(), "prefetching a failing tile succeeded");
+    checks.Check(failing.GetSize() == 4 * fullTile, "a failed tile takes memory");
+  }
+
+  void TinyBudget(Checks &checks)
+  {
+    checks.Begin("tiny budget");
+    const Bounds view = Make(4 * T, 4 * T, 6 * T, 6 * T);
+
+    // the view fills the budget: nothing to prefetch
+    TileCache full(4 * fullTile);
+    Renderer r;
+    full.Reset(4096, 4096, r.Get());
+    Show(full, view);
+    r.rendered.clear();
+    checks.Check(!full.Prefetch() && r.rendered.empty(), "prefetched with the budget used up");
+
+    // room for one more tile
+    TileCache one(5 * fullTile);
+    Renderer r1;
+    one.Reset(4096, 4096, r1.Get());
+    Show(one, view);
+    r1.rendered.clear();
+    const std::vector<Bounds> tiles = PrefetchAll(one, r1);
+    checks.Check(tiles.size() == 1, "%u tiles prefetched with room for one", (unsigned)tiles.size());
+    checks.Check(one.GetSize() <= 5 * fullTile, "%u bytes used, over the budget", (unsigned)one.GetSize());
+
+    // prefetching never pushes out the view
+    TileCache none(1);
+    Renderer r0;
+    none.Reset(4096, 4096, r0.Get());
+    Show(none, view);
+    r0.rendered.clear();
+    checks.Check(!none.Prefetch() && r0.rendered.empty(), "prefetched with a budget below the view");
+    Show(none, view);
+    checks.Check(r0.rendered.empty(), "tiles in view were dropped by prefetching");
+  }
+}
+
+void Tests::Tiles(Checks &checks)
+{
+  Grid(checks);
+  Budget(checks);
+  KeepView(checks);
+  Prefetch(checks);
+  TinyBudget(checks);
+}
@@ -0,0 +1,74 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "FreeImage.h"
+#include "Tests.h"
+
+namespace {
+  const char usage[] =
+    "Headless tests of the parts of fastpreview that need no window.\n"
+    "\n"
+    "fptest [test...]\n"
+    "\n"
+    "Tests, all of them by default:\n"
+    "  tiles     TileCache: every tile rendered, the LRU within its budget,\n"
+    "            tiles in view kept, prefetching ahead of the scrolling\n"
+    "  rescale   FreeImage_RescaleWindow matching a crop of FreeImage_Rescale\n"
+    "            byte for byte, per pixel type and filter\n"
+    "\n"
+    "Failed checks are printed; the exit code is 1 if there were any.\n";
+
+  struct Test
+  {
+    const char *name;
+    void (*run)(Checks &checks);
+  };
+
+  const Test tests[] = {
+    { "tiles", Tests::Tiles },
+    { "rescale", Tests::RescaleWindow },
+  };
+
+  void DLL_CALLCONV OutputMessage(FREE_IMAGE_FORMAT fif, const char *message)
+  {
+    const char *format = fif != FIF_UNKNOWN ? FreeImage_GetFormatFromFIF(fif) : nullptr;
+    fprintf(stderr, "%s: %s\n", format ? format : "FreeImage", message);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  for (int i = 1; i < argc; ++i) {
+    bool known = false;
+    for (const auto &test : tests) {
+      known |= !strcmp(argv[i], test.name);
+    }
+    if (!known) {
+      fprintf(stderr, "Unknown test: %s\n\n%s", argv[i], usage);
+      return 2;
+    }
+  }
+
+#ifdef FREEIMAGE_LIB
+  FreeImage_Initialise(FALSE);
+#endif
+  FreeImage_SetOutputMessage(OutputMessage);
+
+  Checks checks;
+  for (const auto &test : tests) {
+    bool run = argc < 2;
+    for (int i = 1; i < argc; ++i) {
+      run |= !strcmp(argv[i], test.name);
+    }
+    if (run) {
+      test.run(checks);
+    }
+  }
+  printf("%u checks, %u failed\n", checks.GetCount(), checks.GetFailed());
+
+#ifdef FREEIMAGE_LIB
+  FreeImage_DeInitialise();
+#endif
+
+  return checks.GetFailed() ? 1 : 0;
+}
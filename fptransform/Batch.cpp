@@ -0,0 +1,242 @@
+#include "Batch.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "MemoryStream.h"
+#include "exif.h"
+#include "fileio.h"
+
+namespace {
+  /// Operation that makes an image with the given Exif orientation upright
+  const FREE_IMAGE_JPEG_OPERATION uprights[] = {
+    FIJPEG_OP_NONE,       // not set
+    FIJPEG_OP_NONE,       // 1: top-left
+    FIJPEG_OP_FLIP_H,     // 2: top-right
+    FIJPEG_OP_ROTATE_180, // 3: bottom-right
+    FIJPEG_OP_FLIP_V,     // 4: bottom-left
+    FIJPEG_OP_TRANSPOSE,  // 5: left-top
+    FIJPEG_OP_ROTATE_90,  // 6: right-top
+    FIJPEG_OP_TRANSVERSE, // 7: right-bottom
+    FIJPEG_OP_ROTATE_270  // 8: left-bottom
+  };
+
+  const wchar_t *extensions[] = {
+    L".jpg", L".jpeg", L".jpe", L".jfif", nullptr
+  };
+
+  bool isJPEG(const std::wstring &file)
+  {
+    const size_t dot = file.rfind('.');
+    if (dot == std::wstring::npos) {
+      return false;
+    }
+    for (const wchar_t **e = extensions; *e; ++e) {
+      if (!_wcsicmp(file.c_str() + dot, *e)) {
+        return true;
+      }
+    }
+    return false;
+  }
+}
+
+Batch::Batch(const Options &options)
+  : options_(options),
+  next_(0),
+  bytes_(0)
+{}
+
+bool Batch::Add(const std::wstring &path)
+{
+  const DWORD attr = GetFileAttributes(path.c_str());
+  if (attr == INVALID_FILE_ATTRIBUTES) {
+    return false;
+  }
+  if (!(attr & FILE_ATTRIBUTE_DIRECTORY)) {
+    files_.push_back(path);
+    return true;
+  }
+
+  std::wstring dir = path;
+  if (dir.back() != '\\' && dir.back() != '/') {
+    dir.push_back('\\');
+  }
+  WIN32_FIND_DATA fd;
+  HANDLE find = FindFirstFile((dir + L"*").c_str(), &fd);
+  if (find == INVALID_HANDLE_VALUE) {
+    return true;
+  }
+  std::vector<std::wstring> subdirs;
+  do {
+    const std::wstring name = fd.cFileName;
+    if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+      if (name != L"." && name != L"..") {
+        subdirs.push_back(dir + name);
+      }
+    }
+    else if (isJPEG(name)) {
+      files_.push_back(dir + name);
+    }
+  } while (FindNextFile(find, &fd));
+  FindClose(find);
+
+  for (const auto &subdir : subdirs) {
+    Add(subdir);
+  }
+  return true;
+}
+
+bool Batch::AddList(const std::wstring &list, std::vector<std::wstring> &missing)
+{
+  std::vector<BYTE> data;
+  if (!fileio::read(list, data)) {
+    return false;
+  }
+  if (data.empty()) {
+    return true;
+  }
+
+  // UTF-8, with or without signature
+  const char *text = (const char*)&data[0];
+  int length = (int)data.size();
+  if (length >= 3 && !memcmp(text, "\xEF\xBB\xBF", 3)) {
+    text += 3;
+    length -= 3;
+  }
+  std::wstring lines(length, L'\0');
+  if (length) {
+    lines.resize(MultiByteToWideChar(CP_UTF8, 0, text, length, &lines[0], length));
+  }
+
+  for (size_t pos = 0; pos < lines.size();) {
+    size_t end = lines.find('\n', pos);
+    if (end == std::wstring::npos) {
+      end = lines.size();
+    }
+    std::wstring line = lines.substr(pos, end - pos);
+    pos = end + 1;
+
+    const size_t first = line.find_first_not_of(L" \t\r");
+    if (first == std::wstring::npos) {
+      continue;
+    }
+    line = line.substr(first, line.find_last_not_of(L" \t\r") + 1 - first);
+    if (!Add(line)) {
+      missing.push_back(line);
+    }
+  }
+  return true;
+}
+
+Batch::Status Batch::Process(const std::wstring &file)
+{
+  std::vector<BYTE> data;
+  if (!fileio::read(file, data) || data.empty()) {
+    return STATUS_FAILED;
+  }
+  InterlockedExchangeAdd64(&bytes_, (LONGLONG)data.size());
+
+  FREE_IMAGE_JPEG_OPERATION operation = options_.operation;
+  if (options_.autoOrient) {
+    const unsigned orientation = exif::orientation(&data[0], data.size());
+    operation = orientation < _countof(uprights) ?
+      uprights[orientation] :
+      FIJPEG_OP_NONE;
+  }
+  if (operation == FIJPEG_OP_NONE && !options_.crop) {
+    return STATUS_UNCHANGED;
+  }
+
+  int left = options_.left, top = options_.top;
+  int right = options_.right, bottom = options_.bottom;
+  const bool crop = options_.crop;
+
+  MemoryStream src(FreeImage_OpenMemory(&data[0], (DWORD)data.size()));
+  MemoryStream dst(FreeImage_OpenMemory());
+  if (!src || !dst || !FreeImage_JPEGTransformCombinedFromMemory(
+    src, dst, operation,
+    crop ? &left : nullptr, crop ? &top : nullptr,
+    crop ? &right : nullptr, crop ? &bottom : nullptr,
+    options_.perfect ? TRUE : FALSE)) {
+    return STATUS_FAILED;
+  }
+  BYTE *out = nullptr;
+  DWORD size = 0;
+  if (!FreeImage_AcquireMemory(dst, &out, &size) || !size) {
+    return STATUS_FAILED;
+  }
+
+  if (options_.autoOrient) {
+    // The markers were copied as they are; the result is upright now
+    exif::setOrientation(out, size, 1);
+  }
+
+  return fileio::replace(file, out, size) ? STATUS_CHANGED : STATUS_FAILED;
+}
+
+DWORD WINAPI Batch::WorkerProc(LPVOID data)
+{
+  reinterpret_cast<Batch*>(data)->Work();
+  return 0;
+}
+
+void Batch::Work()
+{
+  const LONG count = (LONG)files_.size();
+  for (LONG index; (index = InterlockedIncrement(&next_) - 1) < count;) {
+    status_[index] = Process(files_[index]);
+  }
+}
+
+Batch::Result Batch::Run()
+{
+  status_.assign(files_.size(), STATUS_PENDING);
+  next_ = 0;
+  bytes_ = 0;
+
+  unsigned threads = options_.threads;
+  if (!threads) {
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    threads = si.dwNumberOfProcessors;
+  }
+  threads = (unsigned)std::max<size_t>(
+    1, std::min<size_t>(threads, files_.size()));
+
+  LARGE_INTEGER frequency, start, end;
+  QueryPerformanceFrequency(&frequency);
+  QueryPerformanceCounter(&start);
+
+  // The calling thread is one of the workers
+  std::vector<HANDLE> workers;
+  for (unsigned i = 1; i < threads; ++i) {
+    HANDLE h = CreateThread(nullptr, 0, WorkerProc, this, 0, nullptr);
+    if (h) {
+      workers.push_back(h);
+    }
+  }
+  Work();
+  for (auto h : workers) {
+    WaitForSingleObject(h, INFINITE);
+    CloseHandle(h);
+  }
+
+  QueryPerformanceCounter(&end);
+
+  Result rv = { 0, 0, 0, (unsigned __int64)bytes_, 0.0 };
+  rv.seconds = (double)(end.QuadPart - start.QuadPart) / frequency.QuadPart;
+  for (auto s : status_) {
+    switch (s) {
+    case STATUS_CHANGED:
+      ++rv.changed;
+      break;
+    case STATUS_UNCHANGED:
+      ++rv.unchanged;
+      break;
+    default:
+      ++rv.failed;
+      break;
+    }
+  }
+  return rv;
+}
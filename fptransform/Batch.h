@@ -0,0 +1,108 @@
+#pragma once
+
+#include <windows.h>
+#include <string>
+#include <vector>
+
+#include "FreeImage.h"
+
+/**
+ * Lossless JPEG transformations over many files.
+ *
+ * Files are handed out to a pool of worker threads, one at a time. Each
+ * worker reads a file into memory, transforms it in the coefficient domain
+ * and swaps the result in for the original, so an interrupted run leaves
+ * every file either untouched or done.
+ *
+ * With autoOrient, the operation for each file is taken from its Exif
+ * orientation, and the orientation tag of the result is reset to 1
+ * ("top-left"), so viewers do not rotate it a second time. Files that are
+ * upright already are left alone.
+ */
+class Batch
+{
+public:
+  struct Options
+  {
+    FREE_IMAGE_JPEG_OPERATION operation;
+    bool autoOrient;
+
+    /// Crop rectangle in transformed coordinates, see
+    /// FreeImage_JPEGTransformCombined
+    bool crop;
+    int left, top, right, bottom;
+
+    /// Fail on images whose size is not a multiple of the MCU size, instead
+    /// of trimming the partial edge blocks
+    bool perfect;
+
+    /// Worker threads, 0 for one per processor
+    unsigned threads;
+
+    Options()
+      : operation(FIJPEG_OP_NONE),
+      autoOrient(false),
+      crop(false),
+      left(0), top(0), right(0), bottom(0),
+      perfect(true),
+      threads(0)
+    {}
+  };
+
+  enum Status
+  {
+    STATUS_PENDING,
+    STATUS_CHANGED,
+    STATUS_UNCHANGED,
+    STATUS_FAILED
+  };
+
+  struct Result
+  {
+    unsigned changed, unchanged, failed;
+    unsigned __int64 bytes;
+    double seconds;
+  };
+
+private:
+  const Options options_;
+  std::vector<std::wstring> files_;
+  std::vector<Status> status_;
+
+  volatile LONG next_;
+  volatile LONGLONG bytes_;
+
+  static DWORD WINAPI WorkerProc(LPVOID data);
+  void Work();
+  Status Process(const std::wstring &file);
+
+public:
+  explicit Batch(const Options &options);
+
+  /// Adds a file, or the JPEG files in a directory and its subdirectories
+  bool Add(const std::wstring &path);
+
+  /**
+   * Adds the files and directories listed in a UTF-8 text file, one per
+   * line. Entries that do not exist are passed back in missing.
+   */
+  bool AddList(const std::wstring &list, std::vector<std::wstring> &missing);
+
+  size_t GetCount() const
+  {
+    return files_.size();
+  }
+
+  const std::wstring& GetFile(size_t index) const
+  {
+    return files_[index];
+  }
+
+  Status GetStatus(size_t index) const
+  {
+    return status_[index];
+  }
+
+  /// Transforms all files added so far
+  Result Run();
+};
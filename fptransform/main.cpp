@@ -0,0 +1,153 @@
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <string>
+#include <vector>
+
+#include "Batch.h"
+
+namespace {
+  const wchar_t usage[] =
+    L"Lossless JPEG transformation of many files at once.\n"
+    L"\n"
+    L"fptransform [options] <file|directory|@list>...\n"
+    L"\n"
+    L"  -r90, -r180, -r270   Rotate clockwise\n"
+    L"  -fh, -fv             Flip horizontally/vertically\n"
+    L"  -transpose           Transpose across the upper-left to lower-right axis\n"
+    L"  -transverse          Transpose across the upper-right to lower-left axis\n"
+    L"  -auto                Make upright according to the Exif orientation,\n"
+    L"                       and reset the orientation\n"
+    L"  -crop L,T,R,B        Crop to the rectangle, in transformed coordinates\n"
+    L"  -trim                Drop partial edge blocks instead of failing\n"
+    L"  -j N                 Number of worker threads, one per processor by default\n"
+    L"\n"
+    L"Directories are searched for JPEG files recursively, @list names a UTF-8\n"
+    L"text file listing files and directories, one per line. Files are\n"
+    L"replaced in place.\n";
+
+  struct Operation
+  {
+    const wchar_t *name;
+    FREE_IMAGE_JPEG_OPERATION operation;
+  };
+
+  const Operation operations[] = {
+    { L"-r90", FIJPEG_OP_ROTATE_90 },
+    { L"-r180", FIJPEG_OP_ROTATE_180 },
+    { L"-r270", FIJPEG_OP_ROTATE_270 },
+    { L"-fh", FIJPEG_OP_FLIP_H },
+    { L"-fv", FIJPEG_OP_FLIP_V },
+    { L"-transpose", FIJPEG_OP_TRANSPOSE },
+    { L"-transverse", FIJPEG_OP_TRANSVERSE },
+    { nullptr, FIJPEG_OP_NONE }
+  };
+
+  int fail(const wchar_t *message, const wchar_t *arg = L"")
+  {
+    fwprintf(stderr, message, arg);
+    fwprintf(stderr, L"\n\n%s", usage);
+    return 2;
+  }
+}
+
+int wmain(int argc, wchar_t **argv)
+{
+  Batch::Options options;
+  std::vector<std::wstring> paths;
+  bool haveOperation = false;
+
+  for (int i = 1; i < argc; ++i) {
+    const std::wstring arg = argv[i];
+    if (arg.empty()) {
+      continue;
+    }
+    if (arg[0] != '-') {
+      paths.push_back(arg);
+      continue;
+    }
+
+    const Operation *op = operations;
+    while (op->name && arg != op->name) {
+      ++op;
+    }
+    if (op->name || arg == L"-auto") {
+      if (haveOperation) {
+        return fail(L"Only one of the transformations may be given");
+      }
+      haveOperation = true;
+      options.operation = op->operation;
+      options.autoOrient = !op->name;
+    }
+    else if (arg == L"-crop" && i + 1 < argc) {
+      if (swscanf_s(argv[++i], L"%d,%d,%d,%d",
+        &options.left, &options.top, &options.right, &options.bottom) != 4) {
+        return fail(L"Bad crop rectangle: %s", argv[i]);
+      }
+      options.crop = true;
+    }
+    else if (arg == L"-trim") {
+      options.perfect = false;
+    }
+    else if (arg == L"-j" && i + 1 < argc) {
+      options.threads = (unsigned)_wtoi(argv[++i]);
+    }
+    else if (arg == L"-h" || arg == L"-?" || arg == L"--help") {
+      fwprintf(stdout, L"%s", usage);
+      return 0;
+    }
+    else {
+      return fail(L"Unknown option: %s", arg.c_str());
+    }
+  }
+  if (!haveOperation && !options.crop) {
+    return fail(L"No transformation given");
+  }
+  if (paths.empty()) {
+    return fail(L"No files given");
+  }
+
+#ifdef FREEIMAGE_LIB
+  FreeImage_Initialise(TRUE);
+#endif
+
+  Batch batch(options);
+  for (const auto &path : paths) {
+    if (path[0] == '@') {
+      std::vector<std::wstring> missing;
+      if (!batch.AddList(path.substr(1), missing)) {
+        fwprintf(stderr, L"Cannot read list %s\n", path.c_str() + 1);
+      }
+      for (const auto &m : missing) {
+        fwprintf(stderr, L"Cannot find %s\n", m.c_str());
+      }
+    }
+    else if (!batch.Add(path)) {
+      fwprintf(stderr, L"Cannot find %s\n", path.c_str());
+    }
+  }
+
+  const Batch::Result result = batch.Run();
+
+  for (size_t i = 0; i < batch.GetCount(); ++i) {
+    if (batch.GetStatus(i) == Batch::STATUS_FAILED) {
+      fwprintf(stderr, L"Failed: %s\n", batch.GetFile(i).c_str());
+    }
+  }
+
+  const double seconds = result.seconds > 0.0 ? result.seconds : 1e-6;
+  fwprintf(
+    stdout,
+    L"%u files: %u transformed, %u unchanged, %u failed\n"
+    L"%.2f s, %.1f files/s, %.1f MB/s\n",
+    (unsigned)batch.GetCount(), result.changed, result.unchanged, result.failed,
+    result.seconds, batch.GetCount() / seconds,
+    result.bytes / seconds / (1 << 20));
+
+#ifdef FREEIMAGE_LIB
+  FreeImage_DeInitialise();
+#endif
+
+  return result.failed ? 1 : 0;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "FreeImage.h"
+
+/// Owns a FreeImage memory stream, closing it when going out of scope
+class MemoryStream
+{
+private:
+  FIMEMORY *stream_;
+
+  MemoryStream(const MemoryStream&) = delete;
+  MemoryStream& operator=(const MemoryStream&) = delete;
+
+public:
+  explicit MemoryStream(FIMEMORY *stream) : stream_(stream)
+  {}
+
+  ~MemoryStream()
+  {
+    if (stream_) {
+      FreeImage_CloseMemory(stream_);
+    }
+  }
+
+  operator FIMEMORY*() const
+  {
+    return stream_;
+  }
+};
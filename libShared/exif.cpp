@@ -0,0 +1,114 @@
+#include "exif.h"
+
+#include <cstring>
+
+namespace {
+  inline unsigned get16(const BYTE *p, bool motorola)
+  {
+    return motorola ? (p[0] << 8) | p[1] : (p[1] << 8) | p[0];
+  }
+
+  inline unsigned get32(const BYTE *p, bool motorola)
+  {
+    return motorola ?
+      ((unsigned)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3] :
+      ((unsigned)p[3] << 24) | (p[2] << 16) | (p[1] << 8) | p[0];
+  }
+
+  inline void put16(BYTE *p, unsigned value, bool motorola)
+  {
+    p[motorola ? 0 : 1] = (BYTE)(value >> 8);
+    p[motorola ? 1 : 0] = (BYTE)value;
+  }
+
+  /**
+   * Locates the value of the orientation tag in IFD0 of the Exif segment.
+   * Returns nullptr if there is none.
+   */
+  const BYTE* findOrientation(const BYTE *data, size_t size, bool &motorola)
+  {
+    if (size < 4 || data[0] != 0xFF || data[1] != 0xD8) {
+      return nullptr;
+    }
+
+    // Metadata segments all come before the first scan
+    for (size_t pos = 2; pos + 4 <= size;) {
+      if (data[pos] != 0xFF) {
+        return nullptr;
+      }
+      const BYTE marker = data[pos + 1];
+      if (marker == 0xFF) {
+        // Fill byte
+        ++pos;
+        continue;
+      }
+      if (marker == 0xDA || marker == 0xD9) {
+        return nullptr;
+      }
+      const size_t length = (data[pos + 2] << 8) | data[pos + 3];
+      if (length < 2 || pos + 2 + length > size) {
+        return nullptr;
+      }
+      const BYTE *segment = data + pos + 4;
+      const size_t segmentSize = length - 2;
+      pos += 2 + length;
+
+      if (marker != 0xE1 || segmentSize < 6 + 8 ||
+        memcmp(segment, "Exif\0\0", 6)) {
+        continue;
+      }
+
+      const BYTE *tiff = segment + 6;
+      const size_t tiffSize = segmentSize - 6;
+      if (tiff[0] == 'I' && tiff[1] == 'I') {
+        motorola = false;
+      }
+      else if (tiff[0] == 'M' && tiff[1] == 'M') {
+        motorola = true;
+      }
+      else {
+        return nullptr;
+      }
+      const size_t ifd = get32(tiff + 4, motorola);
+      if (ifd < 8 || ifd + 2 > tiffSize) {
+        return nullptr;
+      }
+      const unsigned count = get16(tiff + ifd, motorola);
+      for (unsigned i = 0; i < count; ++i) {
+        const size_t entry = ifd + 2 + 12 * i;
+        if (entry + 12 > tiffSize) {
+          break;
+        }
+        // TAG_ORIENTATION, a single SHORT
+        if (get16(tiff + entry, motorola) == 0x0112 &&
+          get16(tiff + entry + 2, motorola) == 3 &&
+          get32(tiff + entry + 4, motorola) == 1) {
+          return tiff + entry + 8;
+        }
+      }
+      return nullptr;
+    }
+    return nullptr;
+  }
+}
+
+namespace exif {
+
+  unsigned orientation(const BYTE *data, size_t size)
+  {
+    bool motorola = false;
+    const BYTE *value = findOrientation(data, size, motorola);
+    return value ? get16(value, motorola) : 0;
+  }
+
+  bool setOrientation(BYTE *data, size_t size, unsigned orientation)
+  {
+    bool motorola = false;
+    BYTE *value = const_cast<BYTE*>(findOrientation(data, size, motorola));
+    if (!value) {
+      return false;
+    }
+    put16(value, orientation, motorola);
+    return true;
+  }
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <windows.h>
+
+namespace exif {
+
+  /**
+   * Returns the orientation tag in IFD0 of the Exif segment of a JPEG file
+   * in memory, as stored, or 0 if there is none.
+   */
+  unsigned orientation(const BYTE *data, size_t size);
+
+  /**
+   * Overwrites the orientation tag of a JPEG file in memory.
+   * Returns false if the file has none to overwrite.
+   */
+  bool setOrientation(BYTE *data, size_t size, unsigned orientation);
+}
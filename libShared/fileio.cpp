@@ -0,0 +1,95 @@
+#include "fileio.h"
+
+#include <new>
+
+namespace {
+  class Handle
+  {
+  private:
+    HANDLE h_;
+
+    Handle(const Handle&) = delete;
+    Handle& operator=(const Handle&) = delete;
+
+  public:
+    explicit Handle(HANDLE h) : h_(h)
+    {}
+
+    ~Handle()
+    {
+      close();
+    }
+
+    operator HANDLE() const
+    {
+      return h_;
+    }
+
+    void close()
+    {
+      if (h_ != INVALID_HANDLE_VALUE) {
+        CloseHandle(h_);
+        h_ = INVALID_HANDLE_VALUE;
+      }
+    }
+  };
+}
+
+namespace fileio {
+
+  bool read(const std::wstring& file, std::vector<BYTE>& data)
+  {
+    Handle in(CreateFile(
+      file.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+      FILE_FLAG_SEQUENTIAL_SCAN, nullptr));
+    if (in == INVALID_HANDLE_VALUE) {
+      return false;
+    }
+    LARGE_INTEGER length;
+    if (!GetFileSizeEx(in, &length) || length.HighPart) {
+      return false;
+    }
+    try {
+      data.resize(length.LowPart);
+    }
+    catch (std::bad_alloc&) {
+      return false;
+    }
+    DWORD read = 0;
+    return data.empty() || (
+      ReadFile(in, &data[0], length.LowPart, &read, nullptr) &&
+      read == length.LowPart);
+  }
+
+  bool replace(const std::wstring& file, const void *data, DWORD size)
+  {
+    // The temporary file has to be on the same volume for ReplaceFile.
+    // Paths from the command line may use either separator, or only name
+    // a drive, as in C:photo.jpg.
+    std::wstring dir = file.substr(0, file.find_last_of(L"\\/") + 1);
+    if (dir.empty() && file.size() > 2 && file[1] == ':') {
+      dir = file.substr(0, 2);
+    }
+    wchar_t temp[MAX_PATH];
+    if (!GetTempFileName(dir.empty() ? L"." : dir.c_str(), L"fpt", 0, temp)) {
+      return false;
+    }
+
+    Handle out(CreateFile(
+      temp, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL,
+      nullptr));
+    DWORD written = 0;
+    bool rv = out != INVALID_HANDLE_VALUE &&
+      WriteFile(out, data, size, &written, nullptr) && written == size &&
+      FlushFileBuffers(out);
+    out.close();
+
+    rv = rv && ReplaceFile(
+      file.c_str(), temp, nullptr, REPLACEFILE_IGNORE_MERGE_ERRORS, nullptr,
+      nullptr);
+    if (!rv) {
+      DeleteFile(temp);
+    }
+    return rv;
+  }
+}
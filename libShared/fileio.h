@@ -0,0 +1,19 @@
+#pragma once
+
+#include <windows.h>
+#include <string>
+#include <vector>
+
+namespace fileio {
+
+  /// Reads all of file, which must be smaller than 4 GB
+  bool read(const std::wstring& file, std::vector<BYTE>& data);
+
+  /**
+   * Replaces the contents of file with data.
+   * The data is written to a temporary file next to it, which is then
+   * swapped in, so that file is either the old or the new one, never a
+   * partial write. Attributes, ACLs and the creation time are kept.
+   */
+  bool replace(const std::wstring& file, const void *data, DWORD size);
+}